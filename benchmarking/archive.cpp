@@ -0,0 +1,522 @@
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lib/Archive.hpp"
+#include "lib/BlockCache.hpp"
+#include "lib/BranchProfile.hpp"
+#include "lib/ColumnView.hpp"
+#include "lib/utils.hpp"
+
+// Usage: archive <write|read|scan|hot|info> [--flag value ...]
+// scan filters each float column once, decoding it whole and through a ColumnView, and compares time and memory
+// hot runs --threads analysis threads, each with its own reader, that filter the --branches columns --passes times
+// and, after each pass, one of the --coldBranches columns no other thread reads. It runs without a shared cache, then
+// with a BlockCache of --sharedCacheMB without and with admission, and writes time and cache statistics to --output.
+struct ArchiveParams {
+    std::string command;
+    std::string sourceFile;
+    std::string treeName;
+    std::string archiveFile;
+    std::vector<std::string> branches;
+
+    std::string codec;
+    std::string profileFile;
+    int precision;
+    int trunkCompressionLevel;
+    int intMode;
+    int boolMode;
+    double blockKB;
+
+    size_t cacheBlocks;
+    bool prefetch;
+    float cut;
+
+    std::vector<std::string> coldBranches;
+    int threads;
+    int passes;
+    double sharedCacheMB;
+    int shards;
+    std::string outputFile;
+
+    bool compareRoot;
+    bool debug;
+};
+
+ArchiveParams parseArchiveArguments(int argc, char* argv[]) {
+    if (argc < 2) {
+        throw std::invalid_argument("Usage: archive <write|read|scan|hot|info> [--flag value ...]");
+    }
+
+    // Set default parameters
+    ArchiveParams params;
+
+    params.command = argv[1];
+    params.sourceFile = "mc_361106.Zee.1largeRjet1lep.root";
+    params.treeName = "mini";
+    params.archiveFile = "mc_361106.Zee.1largeRjet1lep.c2p2";
+    params.branches = {};
+
+    params.codec = "trunk";
+    params.profileFile = "";
+    params.precision = 3;
+    params.trunkCompressionLevel = 9;
+    params.intMode = IntegerCompressor::DELTA;
+    params.boolMode = BooleanCompressor::RLE;
+    params.blockKB = 1000;
+
+    params.cacheBlocks = 4;
+    params.prefetch = true;
+    params.cut = 25000;
+
+    params.coldBranches = {};
+    params.threads = 4;
+    params.passes = 4;
+    params.sharedCacheMB = 256;
+    params.shards = 16;
+    params.outputFile = "archive_hot.csv";
+
+    params.compareRoot = false;
+    params.debug = false;
+
+    // Read parameters
+    for (int i{2}; i < argc; ++i) {
+        std::string arg{argv[i]};
+        if (arg == "--sourceFile") {
+            params.sourceFile = argv[++i];
+        } else if (arg == "--treeName") {
+            params.treeName = argv[++i];
+        } else if (arg == "--archive") {
+            params.archiveFile = argv[++i];
+        } else if (arg == "--branches") {
+            params.branches = splitList(argv[++i]);
+        } else if (arg == "--codec") {
+            params.codec = argv[++i];
+        } else if (arg == "--profile") {
+            params.profileFile = argv[++i];
+        } else if (arg == "--precision") {
+            params.precision = std::stoi(argv[++i]);
+        } else if (arg == "--trunkCompressionLevel") {
+            params.trunkCompressionLevel = std::stoi(argv[++i]);
+        } else if (arg == "--intMode") {
+            params.intMode = std::stoi(argv[++i]);
+        } else if (arg == "--boolMode") {
+            params.boolMode = std::stoi(argv[++i]);
+        } else if (arg == "--blockKB") {
+            params.blockKB = std::stod(argv[++i]);
+        } else if (arg == "--cacheBlocks") {
+            params.cacheBlocks = std::stoul(argv[++i]);
+        } else if (arg == "--prefetch") {
+            params.prefetch = std::stoi(argv[++i]);
+        } else if (arg == "--cut") {
+            params.cut = std::stof(argv[++i]);
+        } else if (arg == "--coldBranches") {
+            params.coldBranches = splitList(argv[++i]);
+        } else if (arg == "--threads") {
+            params.threads = std::stoi(argv[++i]);
+        } else if (arg == "--passes") {
+            params.passes = std::stoi(argv[++i]);
+        } else if (arg == "--sharedCacheMB") {
+            params.sharedCacheMB = std::stod(argv[++i]);
+        } else if (arg == "--shards") {
+            params.shards = std::stoi(argv[++i]);
+        } else if (arg == "--output") {
+            params.outputFile = argv[++i];
+        } else if (arg == "--compareRoot") {
+            params.compareRoot = std::stoi(argv[++i]);
+        } else if (arg == "--debug") {
+            params.debug = std::stoi(argv[++i]);
+        } else {
+            throw std::invalid_argument("Unknown argument: " + arg);
+        }
+    }
+
+    if (params.command != "write" && params.command != "read" && params.command != "scan" && params.command != "hot" && params.command != "info") {
+        throw std::invalid_argument("Unknown command: " + params.command);
+    }
+    if (params.blockKB <= 0) {
+        throw std::invalid_argument("Block size must be greater than 0");
+    }
+    if (params.threads <= 0 || params.passes <= 0 || params.shards <= 0) {
+        throw std::invalid_argument("Threads, passes and shards must be greater than 0");
+    }
+    if (params.sharedCacheMB <= 0) {
+        throw std::invalid_argument("Shared cache size must be greater than 0");
+    }
+
+    return params;
+}
+
+// Every branch the readers know how to load
+std::vector<std::string> allBranches() {
+    std::vector<std::string> branches{floatBranches};
+    branches.insert(branches.end(), vectorFloatBranches.begin(), vectorFloatBranches.end());
+    branches.insert(branches.end(), uint32Branches.begin(), uint32Branches.end());
+    branches.insert(branches.end(), boolBranches.begin(), boolBranches.end());
+    branches.insert(branches.end(), vectorBoolBranches.begin(), vectorBoolBranches.end());
+    return branches;
+}
+
+void writeArchive(const ArchiveParams& params) {
+    const std::vector<std::string> branches{params.branches.empty() ? allBranches() : params.branches};
+    const std::string floatCodec{codecSpec(params.codec, params.precision, params.trunkCompressionLevel)};
+    // Profiled branches use their tuned codec, the rest fall back to --codec
+    std::unique_ptr<ProfileCache> profiles{params.profileFile.empty() ? nullptr : std::make_unique<ProfileCache>(params.profileFile, params.debug)};
+    const std::string intCodec{std::format("int:{}", params.intMode)};
+    const std::string boolCodec{std::format("bool:{}", params.boolMode)};
+
+    ArchiveWriter writer(params.archiveFile, static_cast<size_t>(params.blockKB * static_cast<double>(KB)));
+    double readTime{0};
+    double compressionTime{0};
+
+    for (const std::string& branch : branches) {
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        if (isFloatBranch(branch)) {
+            std::vector<float> data{readRootFile(0, params.sourceFile, params.treeName, branch, params.debug)};
+            readTime += elapsedMs(start);
+            start = std::chrono::high_resolution_clock::now();
+            writer.addFloatColumn(branch, data, profiles ? profiles->codecFor(branch, params.precision, floatCodec) : floatCodec);
+        }
+        else if (isUInt32Branch(branch)) {
+            std::vector<uint32_t> data{readRootFileUInt32(params.sourceFile, params.treeName, branch, params.debug)};
+            readTime += elapsedMs(start);
+            start = std::chrono::high_resolution_clock::now();
+            writer.addUInt32Column(branch, data, intCodec);
+        }
+        else if (isBoolBranch(branch)) {
+            std::vector<uint8_t> data{readRootFileBool(params.sourceFile, params.treeName, branch, params.debug)};
+            readTime += elapsedMs(start);
+            start = std::chrono::high_resolution_clock::now();
+            writer.addBoolColumn(branch, data, boolCodec);
+        }
+        else {
+            throw std::invalid_argument("Invalid branch name: " + branch);
+        }
+        compressionTime += elapsedMs(start);
+    }
+    writer.close();
+
+    std::cout << std::format("Source file: {} ({} bytes)\n", params.sourceFile, std::filesystem::file_size(params.sourceFile));
+    std::cout << std::format("Archive file: {} ({} bytes)\n", params.archiveFile, std::filesystem::file_size(params.archiveFile));
+    std::cout << std::format("Columns: {}\n", writer.getColumns().size());
+    std::cout << std::format("Float codec: {}\n", floatCodec);
+    if (profiles) {
+        std::cout << std::format("Profile: {} ({} profiles)\n", params.profileFile, profiles->getProfiles().size());
+    }
+    std::cout << std::format("ROOT read time: {:.2f} ms\n", readTime);
+    std::cout << std::format("Compression and write time: {:.2f} ms\n", compressionTime);
+}
+
+void readArchive(const ArchiveParams& params) {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    ArchiveReader reader(params.archiveFile);
+    const double openTime{elapsedMs(start)};
+
+    std::vector<std::string> branches{params.branches};
+    if (branches.empty()) {
+        for (const ArchiveColumn& column : reader.getColumns()) {
+            branches.push_back(column.name);
+        }
+    }
+
+    // Decode each column, and optionally load the same branch from the ROOT file for comparison
+    double archiveTime{0};
+    double rootTime{0};
+    size_t uncompressedSize{0};
+    for (const std::string& branch : branches) {
+        const ArchiveColumn& column{reader.getColumn(branch)};
+        uncompressedSize += column.uncompressedSize();
+
+        start = std::chrono::high_resolution_clock::now();
+        switch (column.dataType) {
+            case ArchiveColumn::FLOAT:
+                reader.readFloatColumn(branch);
+                break;
+            case ArchiveColumn::UINT32:
+                reader.readUInt32Column(branch);
+                break;
+            default:
+                reader.readBoolColumn(branch);
+                break;
+        }
+        const double columnTime{elapsedMs(start)};
+        archiveTime += columnTime;
+
+        double columnRootTime{0};
+        if (params.compareRoot) {
+            start = std::chrono::high_resolution_clock::now();
+            if (isFloatBranch(branch)) {
+                readRootFile(0, params.sourceFile, params.treeName, branch, params.debug);
+            }
+            else if (isUInt32Branch(branch)) {
+                readRootFileUInt32(params.sourceFile, params.treeName, branch, params.debug);
+            }
+            else {
+                readRootFileBool(params.sourceFile, params.treeName, branch, params.debug);
+            }
+            columnRootTime = elapsedMs(start);
+            rootTime += columnRootTime;
+        }
+
+        std::cout << std::format("Column {}: {} values, {:.2f} ms{}\n", branch, column.numValues, columnTime,
+                                    params.compareRoot ? std::format(" (ROOT: {:.2f} ms)", columnRootTime) : "");
+    }
+
+    std::cout << std::format("Archive file: {} ({} bytes)\n", params.archiveFile, reader.getFileSize());
+    std::cout << std::format("Open time: {:.2f} ms\n", openTime);
+    std::cout << std::format("Archive read time: {:.2f} ms ({:.2f} MB/s)\n", archiveTime,
+                                archiveTime > 0 ? static_cast<double>(uncompressedSize) / MB / (archiveTime / 1000) : 0.0);
+    if (params.compareRoot) {
+        std::cout << std::format("ROOT read time: {:.2f} ms ({:.2f} MB/s)\n", rootTime,
+                                    rootTime > 0 ? static_cast<double>(uncompressedSize) / MB / (rootTime / 1000) : 0.0);
+    }
+}
+
+// Values above the cut and their sum, the kind of one-pass selection analysis code runs
+template <typename Range>
+std::pair<size_t, double> applyCut(Range& values, const float cut) {
+    size_t selected{0};
+    double sum{0};
+    for (const float value : values) {
+        if (value > cut) {
+            ++selected;
+            sum += value;
+        }
+    }
+    return {selected, sum};
+}
+
+void scanArchive(const ArchiveParams& params) {
+    ArchiveReader reader(params.archiveFile);
+
+    std::vector<std::string> branches{params.branches};
+    if (branches.empty()) {
+        for (const ArchiveColumn& column : reader.getColumns()) {
+            if (column.dataType == ArchiveColumn::FLOAT) {
+                branches.push_back(column.name);
+            }
+        }
+    }
+
+    double fullTime{0};
+    double viewTime{0};
+    size_t uncompressedSize{0};
+    for (const std::string& branch : branches) {
+        const ArchiveColumn& column{reader.getColumn(branch)};
+        uncompressedSize += column.uncompressedSize();
+
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        std::vector<float> data{reader.readFloatColumn(branch)};
+        const auto [fullSelected, fullSum] = applyCut(data, params.cut);
+        const double columnFullTime{elapsedMs(start)};
+        data = std::vector<float>{};
+
+        start = std::chrono::high_resolution_clock::now();
+        ColumnView<float> view(reader, branch, params.cacheBlocks, params.prefetch, nullptr, params.debug);
+        const auto [viewSelected, viewSum] = applyCut(view, params.cut);
+        const double columnViewTime{elapsedMs(start)};
+
+        if (viewSelected != fullSelected || viewSum != fullSum) {
+            throw std::runtime_error("ColumnView scan of " + branch + " does not match the full read");
+        }
+        fullTime += columnFullTime;
+        viewTime += columnViewTime;
+
+        // Decoded memory each way: the whole column, or at most cacheBlocks of the largest block
+        uint64_t largestBlock{0};
+        for (const ArchiveBlock& block : column.blocks) {
+            largestBlock = std::max(largestBlock, block.numValues * sizeof(float));
+        }
+        std::cout << std::format("Column {}: {} of {} values above {}, full {:.2f} ms ({} bytes), view {:.2f} ms (<= {} bytes), "
+                                    "{} hits, {} misses, {} prefetched\n",
+                                    branch, viewSelected, column.numValues, params.cut, columnFullTime, column.uncompressedSize(),
+                                    columnViewTime, std::min<uint64_t>(column.uncompressedSize(), view.getCacheBlocks() * largestBlock),
+                                    view.getHits(), view.getMisses(), view.getPrefetched());
+    }
+
+    std::cout << std::format("Archive file: {} ({} bytes)\n", params.archiveFile, reader.getFileSize());
+    std::cout << std::format("Cache blocks: {}, prefetch: {}\n", params.cacheBlocks, params.prefetch);
+    std::cout << std::format("Full read and scan: {:.2f} ms ({:.2f} MB/s)\n", fullTime,
+                                fullTime > 0 ? static_cast<double>(uncompressedSize) / MB / (fullTime / 1000) : 0.0);
+    std::cout << std::format("View scan: {:.2f} ms ({:.2f} MB/s)\n", viewTime,
+                                viewTime > 0 ? static_cast<double>(uncompressedSize) / MB / (viewTime / 1000) : 0.0);
+}
+
+// One run of the hot workload: time, and the shared cache's statistics if there was one
+struct HotRun {
+    double time{0};
+    BlockCacheStats stats{};
+};
+
+HotRun runHot(const ArchiveParams& params, const std::vector<std::string>& hot, const std::vector<std::string>& cold,
+              const std::map<std::string, std::pair<size_t, double>>& expected, BlockCache* cache) {
+    std::vector<std::exception_ptr> errors(params.threads);
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads{};
+    for (int t{0}; t < params.threads; ++t) {
+        threads.emplace_back([&, t] {
+            try {
+                ArchiveReader reader(params.archiveFile);
+                auto filter = [&](const std::string& branch) {
+                    ColumnView<float> view(reader, branch, params.cacheBlocks, params.prefetch, cache, params.debug);
+                    if (applyCut(view, params.cut) != expected.at(branch)) {
+                        throw std::runtime_error("Hot scan of " + branch + " does not match the full read");
+                    }
+                };
+
+                for (int pass{0}; pass < params.passes; ++pass) {
+                    for (const std::string& branch : hot) {
+                        filter(branch);
+                    }
+                    const size_t c{static_cast<size_t>(pass) * params.threads + t};
+                    if (c < cold.size()) {
+                        filter(cold[c]);
+                    }
+                }
+            }
+            catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    HotRun run{};
+    run.time = elapsedMs(start);
+    if (cache) {
+        run.stats = cache->getStats();
+    }
+    return run;
+}
+
+void hotArchive(const ArchiveParams& params) {
+    ArchiveReader reader(params.archiveFile);
+
+    std::vector<std::string> hot{params.branches};
+    if (hot.empty()) {
+        for (const ArchiveColumn& column : reader.getColumns()) {
+            if (column.dataType == ArchiveColumn::FLOAT) {
+                hot.push_back(column.name);
+            }
+        }
+    }
+
+    // Reference selection of every column, from a full read
+    std::map<std::string, std::pair<size_t, double>> expected{};
+    size_t uncompressedSize{0};
+    for (const std::string& branch : hot) {
+        std::vector<float> data{reader.readFloatColumn(branch)};
+        expected[branch] = applyCut(data, params.cut);
+        uncompressedSize += params.threads * params.passes * reader.getColumn(branch).uncompressedSize();
+    }
+    for (size_t c{0}; c < params.coldBranches.size(); ++c) {
+        const std::string& branch{params.coldBranches[c]};
+        std::vector<float> data{reader.readFloatColumn(branch)};
+        expected[branch] = applyCut(data, params.cut);
+        if (c < static_cast<size_t>(params.threads * params.passes)) {
+            uncompressedSize += reader.getColumn(branch).uncompressedSize();
+        }
+    }
+
+    std::ofstream csv(params.outputFile);
+    if (!csv) {
+        throw std::runtime_error("Could not open output file " + params.outputFile);
+    }
+    csv << "Shared cache,Admission,Threads,Passes,Shared cache size (bytes),Shards,Time (ms),Throughput (MB/s),"
+           "Hits,Misses,Hit rate,Bytes saved,Inserts,Rejected,Evictions,Cached bytes\n";
+
+    std::cout << std::format("Archive file: {} ({} bytes)\n", params.archiveFile, reader.getFileSize());
+    std::cout << std::format("Threads: {}, passes: {}, hot columns: {}, cold columns: {}\n",
+                                params.threads, params.passes, hot.size(), params.coldBranches.size());
+
+    const size_t cacheBytes{static_cast<size_t>(params.sharedCacheMB * MB)};
+    for (int config{0}; config < 3; ++config) {
+        const bool shared{config > 0};
+        const bool admission{config == 2};
+        std::unique_ptr<BlockCache> cache{};
+        if (shared) {
+            cache = std::make_unique<BlockCache>(cacheBytes, params.shards, 1024, admission, params.debug);
+        }
+
+        const HotRun run{runHot(params, hot, params.coldBranches, expected, cache.get())};
+        const double throughput{run.time > 0 ? static_cast<double>(uncompressedSize) / MB / (run.time / 1000) : 0.0};
+        const BlockCacheStats& stats{run.stats};
+
+        csv << std::format("{},{},{},{},{},{},{:.4f},{:.2f},{},{},{:.4f},{},{},{},{},{}\n",
+                            shared, admission, params.threads, params.passes, shared ? cacheBytes : 0, params.shards,
+                            run.time, throughput, stats.hits, stats.misses, stats.hitRate(), stats.bytesSaved,
+                            stats.inserts, stats.rejected, stats.evictions, stats.bytes);
+        csv.flush();
+
+        if (!shared) {
+            std::cout << std::format("No shared cache: {:.2f} ms ({:.2f} MB/s)\n", run.time, throughput);
+        }
+        else {
+            std::cout << std::format("Shared cache, admission {}: {:.2f} ms ({:.2f} MB/s), {} hits, {} misses ({:.1f}% hits), "
+                                        "{} bytes saved, {} inserted, {} rejected, {} evicted\n",
+                                        admission ? "on " : "off", run.time, throughput, stats.hits, stats.misses,
+                                        100 * stats.hitRate(), stats.bytesSaved, stats.inserts, stats.rejected, stats.evictions);
+        }
+    }
+    std::cout << std::format("Results: {}\n", params.outputFile);
+}
+
+void printArchiveInfo(const ArchiveParams& params) {
+    ArchiveReader reader(params.archiveFile);
+
+    uint64_t uncompressedSize{0};
+    uint64_t compressedSize{0};
+    for (const ArchiveColumn& column : reader.getColumns()) {
+        const uint64_t columnSize{column.compressedSize()};
+        uncompressedSize += column.uncompressedSize();
+        compressedSize += columnSize;
+        std::cout << std::format("Column {}: codec {}, {} values, {} blocks, {} bytes, ratio {:.2f}\n",
+                                    column.name, column.codec, column.numValues, column.blocks.size(), columnSize,
+                                    columnSize ? static_cast<double>(column.uncompressedSize()) / static_cast<double>(columnSize) : 0.0);
+    }
+
+    std::cout << std::format("Archive file: {} ({} bytes)\n", params.archiveFile, reader.getFileSize());
+    std::cout << std::format("Columns: {}\n", reader.getColumns().size());
+    std::cout << std::format("Original data size: {} bytes\n", uncompressedSize);
+    std::cout << std::format("Compressed data size: {} bytes\n", compressedSize);
+    if (std::filesystem::exists(params.sourceFile)) {
+        std::cout << std::format("Source file: {} ({} bytes)\n", params.sourceFile, std::filesystem::file_size(params.sourceFile));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    ArchiveParams params{parseArchiveArguments(argc, argv)};
+
+    if (params.command == "write") {
+        writeArchive(params);
+    }
+    else if (params.command == "read") {
+        readArchive(params);
+    }
+    else if (params.command == "scan") {
+        scanArchive(params);
+    }
+    else if (params.command == "hot") {
+        hotArchive(params);
+    }
+    else {
+        printArchiveInfo(params);
+    }
+}
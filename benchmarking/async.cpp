@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lib/AsyncCompressor.hpp"
+#include "lib/BatchCompressor.hpp"
+#include "lib/CodecChain.hpp"
+#include "lib/utils.hpp"
+
+// Simulates a service compressing many small baskets as they arrive, with a bounded number of requests in flight,
+// and compares a thread per request against AsyncCompressor with and without batching, and against BatchCompressor.
+// Writes one CSV row per mode.
+// Modes:
+//   blocking    every request gets its own thread and codec, as a naive service would do
+//   async:N     requests are co_awaited on an AsyncCompressor that batches requests under N KB (0 disables batching)
+//   batch       each round of requests in flight is compressed with one compressBatch call
+struct AsyncParams {
+    std::string dataName;
+    std::string sourceFile;
+    std::string treeName;
+    std::string branchName;
+    std::string outputFile;
+
+    std::string codec;
+    int precision;
+    int trunkCompressionLevel;
+
+    std::vector<std::string> modes;
+    int requests;
+    int inFlight;
+    double minKB;
+    double maxKB;
+    int threads;
+    double cancelFraction;
+    int seed;
+
+    bool debug;
+};
+
+AsyncParams parseAsyncArguments(int argc, char* argv[]) {
+    // Set default parameters
+    AsyncParams params;
+
+    params.dataName = "pt";
+    params.sourceFile = "mc_361106.Zee.1largeRjet1lep.root";
+    params.treeName = "mini";
+    params.branchName = "lep_pt";
+    params.outputFile = "async.csv";
+
+    params.codec = "trunk";
+    params.precision = 3;
+    params.trunkCompressionLevel = 1;
+
+    params.modes = {"blocking", "async:0", "async:256", "batch"};
+    params.requests = 20000;
+    params.inFlight = 256;
+    params.minKB = 4;
+    params.maxKB = 64;
+    params.threads = 0;
+    params.cancelFraction = 0;
+    params.seed = 12345;
+
+    params.debug = false;
+
+    // Read parameters
+    for (int i{1}; i < argc; ++i) {
+        std::string arg{argv[i]};
+        if (arg == "--dataSource") {
+            params.dataName = argv[++i];
+        } else if (arg == "--sourceFile") {
+            params.sourceFile = argv[++i];
+        } else if (arg == "--treeName") {
+            params.treeName = argv[++i];
+        } else if (arg == "--branchName") {
+            params.branchName = argv[++i];
+        } else if (arg == "--output") {
+            params.outputFile = argv[++i];
+        } else if (arg == "--codec") {
+            params.codec = argv[++i];
+        } else if (arg == "--precision") {
+            params.precision = std::stoi(argv[++i]);
+        } else if (arg == "--trunkCompressionLevel") {
+            params.trunkCompressionLevel = std::stoi(argv[++i]);
+        } else if (arg == "--modes") {
+            params.modes = splitList(argv[++i]);
+        } else if (arg == "--requests") {
+            params.requests = std::stoi(argv[++i]);
+        } else if (arg == "--inFlight") {
+            params.inFlight = std::stoi(argv[++i]);
+        } else if (arg == "--minKB") {
+            params.minKB = std::stod(argv[++i]);
+        } else if (arg == "--maxKB") {
+            params.maxKB = std::stod(argv[++i]);
+        } else if (arg == "--threads") {
+            params.threads = std::stoi(argv[++i]);
+        } else if (arg == "--cancelFraction") {
+            params.cancelFraction = std::stod(argv[++i]);
+        } else if (arg == "--seed") {
+            params.seed = std::stoi(argv[++i]);
+        } else if (arg == "--debug") {
+            params.debug = std::stoi(argv[++i]);
+        } else {
+            throw std::invalid_argument("Unknown argument: " + arg);
+        }
+    }
+
+    if (params.requests <= 0 || params.inFlight <= 0) {
+        throw std::invalid_argument("Number of requests and requests in flight must be greater than 0");
+    }
+    if (params.minKB <= 0 || params.maxKB < params.minKB) {
+        throw std::invalid_argument("Request sizes must be greater than 0, with minKB <= maxKB");
+    }
+    if (params.cancelFraction < 0 || params.cancelFraction > 1) {
+        throw std::invalid_argument("Cancel fraction must be between 0 and 1");
+    }
+    for (const std::string& mode : params.modes) {
+        if (mode != "blocking" && mode != "batch" && mode.rfind("async:", 0) != 0) {
+            throw std::invalid_argument("Unknown mode: " + mode);
+        }
+    }
+
+    return params;
+}
+
+// Coroutine that starts at once and frees itself when done, as a service would spawn per request
+struct DetachedRequest {
+    struct promise_type {
+        DetachedRequest get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Bounds the requests in flight, like a service's connection limit
+class InFlightLimit {
+    public:
+        explicit InFlightLimit(int limit) : _limit(limit) {}
+
+        void acquire() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _released.wait(lock, [this] { return _inFlight < _limit; });
+            ++_inFlight;
+        }
+
+        // Notifies under the lock, so drain cannot return and destroy the limit before the notify is done
+        void release() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            --_inFlight;
+            _released.notify_all();
+        }
+
+        void drain() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _released.wait(lock, [this] { return _inFlight == 0; });
+        }
+
+    private:
+        int _limit;
+        int _inFlight{0};
+        std::mutex _mutex{};
+        std::condition_variable _released{};
+};
+
+struct Request {
+    std::span<const float> data{};
+    bool cancel{false};
+
+    std::chrono::high_resolution_clock::time_point start{};
+    double latencyMs{0};
+    size_t compressedSize{0};
+    bool cancelled{false};
+};
+
+struct AsyncPoint {
+    std::string mode;
+    double wallTime{0};
+    size_t originalSize{0};
+    size_t compressedSize{0};
+    int completed{0};
+    int cancelled{0};
+    double p50LatencyMs{0};
+    double p99LatencyMs{0};
+    size_t tasks{0};
+    size_t steals{0};
+
+    double throughput() const {
+        return wallTime > 0 ? static_cast<double>(originalSize) / MB / (wallTime / 1000) : 0;
+    }
+};
+
+DetachedRequest runRequest(AsyncCompressor& compressor, Request& request, std::stop_token stopToken, InFlightLimit& limit) {
+    try {
+        const std::vector<uint8_t> compressedData{co_await compressor.compressAsync(request.data, stopToken)};
+        request.compressedSize = compressedData.size();
+    }
+    catch (const CompressionCancelled&) {
+        request.cancelled = true;
+    }
+    request.latencyMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - request.start).count();
+    limit.release();
+}
+
+AsyncPoint measureMode(const std::string& mode, const AsyncParams& params, std::vector<Request> requests) {
+    const std::unique_ptr<MyCompressor> prototype{std::make_unique<ChainCompressor>(codecSpec(params.codec, params.precision, params.trunkCompressionLevel), params.debug)};
+    InFlightLimit limit(params.inFlight);
+    AsyncPoint point{mode};
+
+    const std::chrono::high_resolution_clock::time_point start{std::chrono::high_resolution_clock::now()};
+    if (mode == "blocking") {
+        // Nothing in flight can be cancelled once its thread is running, so cancellation only skips queued requests
+        std::vector<std::thread> threads{};
+        threads.reserve(requests.size());
+        for (Request& request : requests) {
+            limit.acquire();
+            request.start = std::chrono::high_resolution_clock::now();
+            if (request.cancel) {
+                request.cancelled = true;
+                limit.release();
+                continue;
+            }
+            threads.emplace_back([&prototype, &request, &limit] {
+                std::vector<uint8_t> compressedData{};
+                prototype->clone()->compressInto(request.data, compressedData);
+                request.compressedSize = compressedData.size();
+                request.latencyMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - request.start).count();
+                limit.release();
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+    else if (mode == "batch") {
+        // Requests of a round all arrive when it starts and complete when the call returns
+        BatchCompressor compressor(*prototype, params.threads, 1 * MB, params.debug);
+        CompressedBatch batch{};
+        std::vector<std::span<const float>> buffers{};
+        std::vector<Request*> round{};
+        for (size_t first{0}; first < requests.size(); first += params.inFlight) {
+            const std::chrono::high_resolution_clock::time_point roundStart{std::chrono::high_resolution_clock::now()};
+            buffers.clear();
+            round.clear();
+            for (size_t r{first}; r < std::min(requests.size(), first + params.inFlight); ++r) {
+                requests[r].cancelled = requests[r].cancel;
+                if (!requests[r].cancel) {
+                    buffers.push_back(requests[r].data);
+                    round.push_back(&requests[r]);
+                }
+            }
+            compressor.compressBatchInto(buffers, batch);
+            const double latencyMs{std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - roundStart).count()};
+            for (size_t i{0}; i < round.size(); ++i) {
+                round[i]->compressedSize = batch[i].size();
+                round[i]->latencyMs = latencyMs;
+            }
+        }
+        point.tasks = (requests.size() + params.inFlight - 1) / params.inFlight;
+    }
+    else {
+        const size_t batchBytes{static_cast<size_t>(std::stod(mode.substr(mode.find(':') + 1)) * KB)};
+        AsyncCompressor compressor(*prototype, params.threads, batchBytes, params.debug);
+        std::vector<std::stop_source> stopSources(requests.size());
+        for (size_t r{0}; r < requests.size(); ++r) {
+            limit.acquire();
+            requests[r].start = std::chrono::high_resolution_clock::now();
+            runRequest(compressor, requests[r], stopSources[r].get_token(), limit);
+            // Cancel right after submitting, so some requests are still queued and some are already running
+            if (requests[r].cancel) {
+                stopSources[r].request_stop();
+            }
+        }
+        limit.drain();
+        point.tasks = compressor.getTasks();
+        point.steals = compressor.getSteals();
+    }
+    point.wallTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::vector<double> latencies{};
+    for (const Request& request : requests) {
+        if (request.cancelled) {
+            ++point.cancelled;
+            continue;
+        }
+        ++point.completed;
+        point.originalSize += request.data.size_bytes();
+        point.compressedSize += request.compressedSize;
+        latencies.push_back(request.latencyMs);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    if (!latencies.empty()) {
+        point.p50LatencyMs = latencies[latencies.size() / 2];
+        point.p99LatencyMs = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+    }
+    return point;
+}
+
+int main(int argc, char* argv[]) {
+    AsyncParams params{parseAsyncArguments(argc, argv)};
+
+    // Request sizes are drawn once, so every mode sees the same requests
+    std::mt19937 rng(params.seed);
+    std::uniform_real_distribution<double> sizeKB(params.minKB, params.maxKB);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<size_t> sizes(params.requests);
+    std::vector<bool> cancels(params.requests);
+    size_t totalSize{0};
+    for (int r{0}; r < params.requests; ++r) {
+        sizes[r] = std::max<size_t>(1, static_cast<size_t>(sizeKB(rng) * KB) / sizeof(float));
+        cancels[r] = uniform(rng) < params.cancelFraction;
+        totalSize += sizes[r];
+    }
+    const std::vector<float> data{loadFloatData(params.dataName, totalSize, params.sourceFile, params.treeName, params.branchName, params.seed, params.debug)};
+
+    std::vector<Request> requests(params.requests);
+    for (size_t r{0}, offset{0}; r < requests.size(); offset += sizes[r], ++r) {
+        requests[r].data = std::span<const float>(data).subspan(offset, sizes[r]);
+        requests[r].cancel = cancels[r];
+    }
+
+    std::cout << std::format("Requests: {} of {}-{} KB, {} in flight\n", params.requests, params.minKB, params.maxKB, params.inFlight);
+    std::cout << std::format("Data: {} ({} bytes)\n", params.dataName, totalSize * sizeof(float));
+
+    std::ofstream csv(params.outputFile);
+    if (!csv) {
+        throw std::runtime_error("Could not open output file " + params.outputFile);
+    }
+    csv << "Mode,Compressor,Threads,Requests,Requests in flight,Data name,Precision,Original data size (bytes),Compressed data size (bytes),"
+           "Completed,Cancelled,Wall time (ms),Throughput (MB/s),p50 latency (ms),p99 latency (ms),Tasks,Steals\n";
+
+    const int threads{params.threads > 0 ? params.threads : std::max(1, static_cast<int>(std::thread::hardware_concurrency()))};
+    for (const std::string& mode : params.modes) {
+        const AsyncPoint point{measureMode(mode, params, requests)};
+
+        csv << std::format("{},{},{},{},{},{},{},{},{},{},{},{:.4f},{:.2f},{:.4f},{:.4f},{},{}\n",
+                            mode, params.codec, mode == "blocking" ? params.inFlight : threads, params.requests, params.inFlight,
+                            params.dataName, params.precision, point.originalSize, point.compressedSize, point.completed,
+                            point.cancelled, point.wallTime, point.throughput(), point.p50LatencyMs, point.p99LatencyMs,
+                            point.tasks, point.steals);
+        csv.flush();
+
+        std::cout << std::format("{:<10}: {:>9.2f} MB/s, latency p50 {:>8.3f} ms p99 {:>8.3f} ms, {} completed, {} cancelled, {} tasks, {} steals\n",
+                                    mode, point.throughput(), point.p50LatencyMs, point.p99LatencyMs, point.completed,
+                                    point.cancelled, point.tasks, point.steals);
+    }
+}
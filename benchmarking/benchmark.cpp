@@ -1,66 +1,79 @@
 #include <iostream>
-#include <fstream>
 #include <format>
 #include <vector>
 
 #include "lib/CompressorBench.hpp"
+#include "lib/Trace.hpp"
 #include "lib/utils.hpp"
 
-std::ofstream& openCSV(std::string filename) {
-    std::ofstream& file{*(new std::ofstream(filename))};
-    if (!file.is_open()) {
-        throw std::runtime_error("Could not open file: " + filename);
+// Formatted reports are separated by a blank line; JSON lines and CSV rows are written as-is so they can be appended to a file
+void printReport(CompressorBench& bench, const BenchmarkParams& params) {
+    if (params.reportType == "formatted") {
+        std::cout << "\n" << bench.generateReport() << std::endl;
+    }
+    else {
+        std::cout << bench.generateReport() << std::flush;
     }
 
-    // Write header
-    file << "Compresser,";
-    file << "Iterations,";
-    file << "DataName,";
-    file << "Precision,";
-    file << "CompressionLevel,";
-    file << "ErrorBoundMode,";
-    file << "Algo,";
-    file << "InterpAlgo,";
-    file << "CompressionTimeMS,";
-    file << "DecompressionTimeMS,";
-    file << "CompressionRatio,";
-    file << "CompressedDataSize,";
-    file << "OriginalDataSize,";
-    file << "AvgRelativeError";
-    file << std::endl;
-    return file;
+    // Every run ends here, so this is where the trace is written
+    if (!params.traceFile.empty()) {
+        Trace::writeChromeJson(params.traceFile);
+        std::cerr << std::format("Wrote {} trace events to {}", Trace::events().size(), params.traceFile) << std::endl;
+    }
 }
 
 int main(int argc, char* argv[]) {
     // Set parameters
     BenchmarkParams params{parseArguments(argc, argv)};
+    Trace::setEnabled(!params.traceFile.empty());
 
     // Print parameters
     std::cerr << "Parameters:" << std::endl;
     std::cerr << "  doTrunk: " << params.doTrunk << std::endl;
     std::cerr << "  doSZ: " << params.doSZ << std::endl;
+    std::cerr << "  doQuant: " << params.doQuant << std::endl;
     // std::cerr << "  doSZZlib: " << params.doSZZlib << std::endl;
 
     std::cerr << "  iterations: " << params.iterations << std::endl;
+    std::cerr << "  warmup: " << params.warmup << std::endl;
+    std::cerr << "  flushCache: " << params.flushCache << std::endl;
+    std::cerr << "  freshInput: " << params.freshInput << std::endl;
     std::cerr << "  precision: " << params.precision << std::endl;
 
     std::cerr << "  dataMB: " << params.dataMB << std::endl;
+    std::cerr << "  basketKB: " << params.basketKB << std::endl;
     std::cerr << "  dataName: " << params.dataName << std::endl;
 
     // If data is from root file
     std::cerr << "  sourceFile: " << params.sourceFile << std::endl;
     std::cerr << "  treeName: " << params.treeName << std::endl;
     std::cerr << "  branchName: " << params.branchName << std::endl;
+    std::cerr << "  branchGroup: " << params.branchGroup << std::endl;
 
-    // If data is generated from normal distribution
+    // If data is generated
     std::cerr << "  seed: " << params.seed << std::endl;
+    std::cerr << "  threads: " << params.threads << std::endl;
     std::cerr << "  mean: " << params.mean << std::endl;
     std::cerr << "  stddev: " << params.stddev << std::endl;
+    std::cerr << "  min: " << params.minValue << std::endl;
+    std::cerr << "  max: " << params.maxValue << std::endl;
+    std::cerr << "  ptMin: " << params.ptMin << std::endl;
+    std::cerr << "  ptMean: " << params.ptMean << std::endl;
+    std::cerr << "  tailIndex: " << params.tailIndex << std::endl;
+    std::cerr << "  multiplicity: " << params.multiplicity << std::endl;
 
     std::cerr << "  trunkCompressionLevel: " << params.trunkCompressionLevel << std::endl;
+    std::cerr << "  trunkDictionary: " << params.trunkDictionary << std::endl;
     std::cerr << "  szErrorBoundMode: " << params.szErrorBoundMode << std::endl;
     std::cerr << "  szAlgo: " << params.szAlgo << std::endl;
     std::cerr << "  szInterpAlgo: " << params.szInterpAlgo << std::endl;
+    std::cerr << "  szMaxError: " << params.szMaxError << std::endl;
+    std::cerr << "  szTuneCache: " << params.szTuneCache << std::endl;
+    std::cerr << "  szLayout: " << params.szLayout << std::endl;
+    std::cerr << "  quantErrorBoundMode: " << params.quantErrorBoundMode << std::endl;
+    std::cerr << "  chain: " << params.chain << std::endl;
+    std::cerr << "  reportType: " << params.reportType << std::endl;
+    std::cerr << "  traceFile: " << params.traceFile << std::endl;
 
     std::cerr << "  host: " << getHost() << std::endl;
     std::cerr << "  timestamp: " << timestamp() << std::endl;
@@ -71,12 +84,54 @@ int main(int argc, char* argv[]) {
     // Get data
     size_t dataSize{static_cast<size_t>(params.dataMB * static_cast<double>(MB)) / sizeof(float)};
     std::vector<float> data{};
+    std::vector<uint32_t> eventCounts{};
 
     if (params.dataName == "normal") {
-        data = generateGaussianRandomData(dataSize, params.mean, params.stddev, params.seed);
+        data = generateGaussianRandomData(dataSize, params.mean, params.stddev, params.seed, params.threads);
+    }
+    else if (params.dataName == "uniform") {
+        data = generateUniformRandomData(dataSize, params.minValue, params.maxValue, params.seed, params.threads);
+    }
+    else if (params.dataName == "pt") {
+        data = generateExponentialPtData(dataSize, params.ptMin, params.ptMean, params.seed, params.threads);
+    }
+    else if (params.dataName == "phi") {
+        data = generateUniformPhiData(dataSize, params.seed, params.threads);
+    }
+    else if (params.dataName == "pareto") {
+        data = generateParetoData(dataSize, params.ptMin, params.tailIndex, params.seed, params.threads);
+    }
+    else if (params.dataName == "jagged") {
+        data = generateJaggedPtData(dataSize, params.multiplicity, params.ptMin, params.ptMean, params.seed, params.threads, &eventCounts);
+    }
+    else if (params.dataName == "root" && !params.branchGroup.empty()) {
+        // Aligned branches compressed jointly
+        std::vector<std::vector<float>> columns{};
+        for (const std::string& branch : branchGroups.at(params.branchGroup)) {
+            columns.push_back(readRootFile(0, params.sourceFile, params.treeName, branch, params.debug));
+        }
+        CompressorBench bench(params);
+        bench.runGroup(params.branchGroup, columns);
+        printReport(bench, params);
+        return 0;
+    }
+    else if (params.dataName == "root" && isUInt32Branch(params.branchName)) {
+        // Integer and boolean branches go through their own codecs
+        std::vector<uint32_t> integerData{readRootFileUInt32(params.sourceFile, params.treeName, params.branchName, params.debug)};
+        CompressorBench bench(params);
+        bench.runInteger(integerData);
+        printReport(bench, params);
+        return 0;
+    }
+    else if (params.dataName == "root" && isBoolBranch(params.branchName)) {
+        std::vector<uint8_t> booleanData{readRootFileBool(params.sourceFile, params.treeName, params.branchName, params.debug)};
+        CompressorBench bench(params);
+        bench.runBoolean(booleanData);
+        printReport(bench, params);
+        return 0;
     }
     else if (params.dataName == "root") {
-        data = readRootFile(0, params.sourceFile, params.treeName, params.branchName, params.debug);
+        data = readRootFile(0, params.sourceFile, params.treeName, params.branchName, params.debug, &eventCounts);
     }
     else {
         throw std::invalid_argument("Unknown data source: " + params.dataName);
@@ -85,8 +140,14 @@ int main(int argc, char* argv[]) {
 
     // Run compression benchmarks
     CompressorBench bench(params);
+    if (params.szLayout != "flat") {
+        if (eventCounts.empty()) {
+            throw std::invalid_argument("SZ layout " + params.szLayout + " needs jagged data; use --dataSource jagged or root");
+        }
+        bench.setEventCounts(eventCounts);
+    }
     bench.run(data);
 
     // Print report
-    std::cout << "\n" << bench.generateReport() << std::endl;
+    printReport(bench, params);
 }
\ No newline at end of file
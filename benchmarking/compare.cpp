@@ -0,0 +1,432 @@
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "lib/Report.hpp"
+
+// Compares two benchmark result sets, written with --reportType json or csv, and exits with 1 if any configuration got
+// significantly slower or compresses worse. Old formatted-log CSVs from the data-analysis notebook are read too, but
+// they only carry averages, so their configurations are compared against the thresholds alone.
+struct CompareParams {
+    std::string baselineFile;
+    std::string candidateFile;
+
+    double alpha;
+    double threshold;
+    double ratioThreshold;
+    int bootstrap;
+    int seed;
+
+    bool verbose;
+};
+
+CompareParams parseCompareArguments(int argc, char* argv[]) {
+    // Set default parameters
+    CompareParams params;
+
+    params.baselineFile = "";
+    params.candidateFile = "";
+
+    params.alpha = 0.05;
+    params.threshold = 0.05;
+    params.ratioThreshold = 0.01;
+    params.bootstrap = 2000;
+    params.seed = 12345;
+
+    params.verbose = false;
+
+    // Read parameters
+    for (int i{1}; i < argc; ++i) {
+        std::string arg{argv[i]};
+        if (arg == "--baseline") {
+            params.baselineFile = argv[++i];
+        } else if (arg == "--candidate") {
+            params.candidateFile = argv[++i];
+        } else if (arg == "--alpha") {
+            params.alpha = std::stod(argv[++i]);
+        } else if (arg == "--threshold") {
+            params.threshold = std::stod(argv[++i]);
+        } else if (arg == "--ratioThreshold") {
+            params.ratioThreshold = std::stod(argv[++i]);
+        } else if (arg == "--bootstrap") {
+            params.bootstrap = std::stoi(argv[++i]);
+        } else if (arg == "--seed") {
+            params.seed = std::stoi(argv[++i]);
+        } else if (arg == "--verbose") {
+            params.verbose = std::stoi(argv[++i]);
+        } else {
+            throw std::invalid_argument("Unknown argument: " + arg);
+        }
+    }
+
+    if (params.baselineFile.empty() || params.candidateFile.empty()) {
+        throw std::invalid_argument("Usage: compare --baseline <results> --candidate <results> [--flag value ...]");
+    }
+    if (params.alpha <= 0 || params.alpha >= 1) {
+        throw std::invalid_argument("Alpha must be between 0 and 1");
+    }
+    if (params.threshold < 0 || params.ratioThreshold < 0) {
+        throw std::invalid_argument("Thresholds must not be negative");
+    }
+    if (params.bootstrap <= 0) {
+        throw std::invalid_argument("Number of bootstrap resamples must be greater than 0");
+    }
+
+    return params;
+}
+
+// Fields that identify a configuration; only those present in both result sets are used for matching
+const std::vector<std::string> keyFields = {
+    "compressor", "data_type", "data_name", "branch_name", "branch_group", "precision", "basket_size_bytes", "cache_state",
+    "trunk_compression_level", "trunk_dictionary", "sz_error_bound_mode", "sz_algo", "sz_interp_algo", "sz_layout",
+    "sz_max_error", "quant_error_bound_mode", "chain_spec"
+};
+
+// Column names of the CSVs produced by benchmark-parser.ipynb from the formatted logs
+const std::map<std::string, std::string> legacyFields = {
+    {"Compressor", "compressor"},
+    {"Iterations", "iterations"},
+    {"Data name", "data_name"},
+    {"Source file", "source_file"},
+    {"Tree name", "tree_name"},
+    {"Branch name", "branch_name"},
+    {"Precision", "precision"},
+    {"Average compression time (ms)", "compression_time_ms"},
+    {"Average decompression time (ms)", "decompression_time_ms"},
+    {"Original data size (bytes)", "original_size_bytes"},
+    {"Compressed data size (bytes)", "compressed_size_bytes"},
+    {"Compression ratio", "compression_ratio"},
+    {"Average relative error", "avg_relative_error"},
+    {"Trunk compression level", "trunk_compression_level"},
+    {"SZ error bound mode", "sz_error_bound_mode"},
+    {"SZ algorithm", "sz_algo"},
+    {"SZ interpolation algorithm", "sz_interp_algo"}
+};
+
+// Settings the notebook writes as -1 when they do not apply; the structured reports leave them empty
+const std::set<std::string> notApplicableFields = {
+    "trunk_compression_level", "sz_error_bound_mode", "sz_algo", "sz_interp_algo"
+};
+
+// Rename legacy columns, and write numbers in one canonical form so "3.0" matches "3"
+ReportFields normalizeFields(const ReportFields& fields) {
+    ReportFields normalized{};
+    for (const auto& [key, value] : fields) {
+        const std::string name{legacyFields.contains(key) ? legacyFields.at(key) : key};
+        std::string canonical{value};
+        try {
+            size_t parsed{0};
+            const double number{std::stod(value, &parsed)};
+            if (parsed == value.size()) {
+                canonical = number == -1 && notApplicableFields.contains(name) ? "" : std::format("{}", number);
+            }
+        } catch (const std::exception&) {
+            // Not a number; keep as is
+        }
+        normalized[name] = canonical;
+    }
+    return normalized;
+}
+
+std::vector<double> parseList(const std::string& list) {
+    std::vector<double> values{};
+    std::istringstream iss(list);
+    std::string item;
+    while (std::getline(iss, item, ';')) {
+        if (!item.empty()) {
+            values.push_back(std::stod(item));
+        }
+    }
+    return values;
+}
+
+double fieldValue(const ReportFields& fields, const std::string& key) {
+    const auto it{fields.find(key)};
+    return it == fields.end() || it->second.empty() ? 0.0 : std::stod(it->second);
+}
+
+// Pooled measurements of one configuration in one result set
+struct ConfigResults {
+    std::vector<double> compressionThroughput;      // MB/s per iteration
+    std::vector<double> decompressionThroughput;    // MB/s per iteration
+    std::vector<double> compressionRatio;
+    bool perIteration{true};
+};
+
+// Throughput per timed iteration, falling back to the average time when the record has no per-iteration times
+void addThroughput(std::vector<double>& throughput, const ReportFields& fields, const std::string& metric, bool& perIteration) {
+    const double megabytes{fieldValue(fields, "original_size_bytes") / MB};
+    std::vector<double> times{fields.contains(metric + "_times_ms") ? parseList(fields.at(metric + "_times_ms")) : std::vector<double>{}};
+    if (times.empty()) {
+        times.push_back(fieldValue(fields, metric + "_time_ms"));
+        perIteration = false;
+    }
+    for (double time : times) {
+        if (time > 0) {
+            throughput.push_back(megabytes / (time / 1000));
+        }
+    }
+}
+
+std::set<std::string> columnsOf(const std::vector<ReportFields>& records) {
+    std::set<std::string> columns{};
+    for (const ReportFields& fields : records) {
+        for (const auto& [key, value] : fields) {
+            columns.insert(key);
+        }
+    }
+    return columns;
+}
+
+std::string configKey(const ReportFields& fields, const std::vector<std::string>& matchFields) {
+    std::string key{};
+    for (const std::string& field : matchFields) {
+        const auto it{fields.find(field)};
+        if (it != fields.end() && !it->second.empty()) {
+            key += (key.empty() ? "" : " ") + field + "=" + it->second;
+        }
+    }
+    return key;
+}
+
+std::map<std::string, ConfigResults> groupByConfig(const std::vector<ReportFields>& records, const std::vector<std::string>& matchFields) {
+    std::map<std::string, ConfigResults> configs{};
+    for (const ReportFields& fields : records) {
+        ConfigResults& results{configs[configKey(fields, matchFields)]};
+        addThroughput(results.compressionThroughput, fields, "compression", results.perIteration);
+        addThroughput(results.decompressionThroughput, fields, "decompression", results.perIteration);
+        results.compressionRatio.push_back(fieldValue(fields, "compression_ratio"));
+    }
+    return configs;
+}
+
+double median(std::vector<double> values) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    const size_t middle{values.size() / 2};
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+double mean(const std::vector<double>& values) {
+    return values.empty() ? 0 : std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+// Two-sided Mann-Whitney U test, with the normal approximation corrected for ties and continuity
+double mannWhitneyP(const std::vector<double>& a, const std::vector<double>& b) {
+    std::vector<std::pair<double, int>> combined{};
+    for (double value : a) {
+        combined.push_back({value, 0});
+    }
+    for (double value : b) {
+        combined.push_back({value, 1});
+    }
+    std::sort(combined.begin(), combined.end());
+
+    // Average ranks over ties
+    const double n1{static_cast<double>(a.size())};
+    const double n2{static_cast<double>(b.size())};
+    const double n{n1 + n2};
+    double rankSumA{0};
+    double tieCorrection{0};
+    for (size_t i{0}; i < combined.size();) {
+        size_t j{i};
+        while (j < combined.size() && combined[j].first == combined[i].first) {
+            ++j;
+        }
+        const double rank{(i + 1 + j) / 2.0};
+        for (size_t k{i}; k < j; ++k) {
+            if (combined[k].second == 0) {
+                rankSumA += rank;
+            }
+        }
+        const double ties{static_cast<double>(j - i)};
+        tieCorrection += ties * ties * ties - ties;
+        i = j;
+    }
+
+    const double u{rankSumA - n1 * (n1 + 1) / 2};
+    const double variance{n1 * n2 / 12 * ((n + 1) - tieCorrection / (n * (n - 1)))};
+    if (variance <= 0) {
+        return 1;
+    }
+    const double z{std::max(0.0, std::abs(u - n1 * n2 / 2) - 0.5) / std::sqrt(variance)};
+    return std::erfc(z / std::sqrt(2.0));
+}
+
+// Percentile bootstrap confidence interval for median(candidate) / median(baseline)
+std::pair<double, double> bootstrapRatioCI(const std::vector<double>& baseline, const std::vector<double>& candidate,
+                                            int resamples, double alpha, std::mt19937_64& rng) {
+    std::uniform_int_distribution<size_t> pickBaseline(0, baseline.size() - 1);
+    std::uniform_int_distribution<size_t> pickCandidate(0, candidate.size() - 1);
+    std::vector<double> baselineSample(baseline.size());
+    std::vector<double> candidateSample(candidate.size());
+
+    std::vector<double> ratios{};
+    ratios.reserve(resamples);
+    for (int r{0}; r < resamples; ++r) {
+        for (double& value : baselineSample) {
+            value = baseline[pickBaseline(rng)];
+        }
+        for (double& value : candidateSample) {
+            value = candidate[pickCandidate(rng)];
+        }
+        const double baselineMedian{median(baselineSample)};
+        if (baselineMedian > 0) {
+            ratios.push_back(median(candidateSample) / baselineMedian);
+        }
+    }
+    if (ratios.empty()) {
+        return {1, 1};
+    }
+
+    std::sort(ratios.begin(), ratios.end());
+    auto percentile = [&ratios](double p) {
+        return ratios[std::min(ratios.size() - 1, static_cast<size_t>(p * ratios.size()))];
+    };
+    return {percentile(alpha / 2), percentile(1 - alpha / 2)};
+}
+
+enum VERDICT{UNCHANGED, IMPROVED, REGRESSED};
+
+// Throughput changes need both statistical significance and a confidence interval beyond the threshold, so
+// tiny but consistent shifts don't fail the gate. Without per-iteration times only the threshold applies.
+VERDICT compareThroughput(const std::string& config, const std::string& metric, const std::vector<double>& baseline,
+                            const std::vector<double>& candidate, bool perIteration, const CompareParams& params, std::mt19937_64& rng) {
+    if (baseline.empty() || candidate.empty()) {
+        return UNCHANGED;
+    }
+
+    const double baselineMedian{median(baseline)};
+    const double candidateMedian{median(candidate)};
+    const double change{baselineMedian > 0 ? candidateMedian / baselineMedian - 1 : 0};
+
+    VERDICT verdict{UNCHANGED};
+    std::string detail{};
+    if (perIteration && baseline.size() > 1 && candidate.size() > 1) {
+        const double p{mannWhitneyP(baseline, candidate)};
+        const auto [low, high]{bootstrapRatioCI(baseline, candidate, params.bootstrap, params.alpha, rng)};
+        if (p < params.alpha && high < 1 - params.threshold) {
+            verdict = REGRESSED;
+        } else if (p < params.alpha && low > 1 + params.threshold) {
+            verdict = IMPROVED;
+        }
+        detail = std::format("{:.0f}% CI [{:+.1f}%, {:+.1f}%], p={:.3g}", 100 * (1 - params.alpha), 100 * (low - 1), 100 * (high - 1), p);
+    }
+    else {
+        if (change < -params.threshold) {
+            verdict = REGRESSED;
+        } else if (change > params.threshold) {
+            verdict = IMPROVED;
+        }
+        detail = "averages only";
+    }
+
+    if (verdict != UNCHANGED || params.verbose) {
+        std::cout << std::format("[{}] {}: {} throughput {:.2f} -> {:.2f} MB/s ({:+.1f}%, {})\n",
+                                    verdict == REGRESSED ? "REGRESSION" : verdict == IMPROVED ? "improved" : "ok", config, metric,
+                                    baselineMedian, candidateMedian, 100 * change, detail);
+    }
+    return verdict;
+}
+
+// Compression ratio is deterministic for a given codec and input, so any drop beyond the threshold counts
+VERDICT compareRatio(const std::string& config, const std::vector<double>& baseline, const std::vector<double>& candidate,
+                        const CompareParams& params) {
+    const double baselineRatio{mean(baseline)};
+    const double candidateRatio{mean(candidate)};
+    const double change{baselineRatio > 0 ? candidateRatio / baselineRatio - 1 : 0};
+
+    VERDICT verdict{UNCHANGED};
+    if (change < -params.ratioThreshold) {
+        verdict = REGRESSED;
+    } else if (change > params.ratioThreshold) {
+        verdict = IMPROVED;
+    }
+
+    if (verdict != UNCHANGED || params.verbose) {
+        std::cout << std::format("[{}] {}: compression ratio {:.3f} -> {:.3f} ({:+.2f}%)\n",
+                                    verdict == REGRESSED ? "REGRESSION" : verdict == IMPROVED ? "improved" : "ok", config,
+                                    baselineRatio, candidateRatio, 100 * change);
+    }
+    return verdict;
+}
+
+int main(int argc, char* argv[]) {
+    CompareParams params{parseCompareArguments(argc, argv)};
+
+    std::vector<ReportFields> baselineRecords{};
+    std::vector<ReportFields> candidateRecords{};
+    for (const ReportFields& fields : readReport(params.baselineFile)) {
+        ReportFields normalized{normalizeFields(fields)};
+        if (!normalized["compressor"].empty()) {
+            baselineRecords.push_back(normalized);
+        }
+    }
+    for (const ReportFields& fields : readReport(params.candidateFile)) {
+        ReportFields normalized{normalizeFields(fields)};
+        if (!normalized["compressor"].empty()) {
+            candidateRecords.push_back(normalized);
+        }
+    }
+
+    // Match on the identifying fields both sets know about
+    const std::set<std::string> baselineColumns{columnsOf(baselineRecords)};
+    const std::set<std::string> candidateColumns{columnsOf(candidateRecords)};
+    std::vector<std::string> matchFields{};
+    for (const std::string& field : keyFields) {
+        if (baselineColumns.contains(field) && candidateColumns.contains(field)) {
+            matchFields.push_back(field);
+        }
+    }
+
+    const std::map<std::string, ConfigResults> baseline{groupByConfig(baselineRecords, matchFields)};
+    const std::map<std::string, ConfigResults> candidate{groupByConfig(candidateRecords, matchFields)};
+
+    std::mt19937_64 rng(params.seed);
+    int compared{0};
+    int regressions{0};
+    int improvements{0};
+    for (const auto& [config, baselineResults] : baseline) {
+        if (!candidate.contains(config)) {
+            std::cout << std::format("[missing] {}: not in candidate results\n", config);
+            continue;
+        }
+        const ConfigResults& candidateResults{candidate.at(config)};
+        const bool perIteration{baselineResults.perIteration && candidateResults.perIteration};
+        ++compared;
+
+        for (VERDICT verdict : {
+                compareThroughput(config, "compression", baselineResults.compressionThroughput, candidateResults.compressionThroughput,
+                                    perIteration, params, rng),
+                compareThroughput(config, "decompression", baselineResults.decompressionThroughput, candidateResults.decompressionThroughput,
+                                    perIteration, params, rng),
+                compareRatio(config, baselineResults.compressionRatio, candidateResults.compressionRatio, params)}) {
+            regressions += verdict == REGRESSED;
+            improvements += verdict == IMPROVED;
+        }
+    }
+    for (const auto& [config, candidateResults] : candidate) {
+        if (!baseline.contains(config)) {
+            std::cout << std::format("[new] {}: not in baseline results\n", config);
+        }
+    }
+
+    std::cout << std::format("Baseline: {} ({} records)\n", params.baselineFile, baselineRecords.size());
+    std::cout << std::format("Candidate: {} ({} records)\n", params.candidateFile, candidateRecords.size());
+    std::cout << std::format("Configurations compared: {}\n", compared);
+    std::cout << std::format("Regressions: {}\n", regressions);
+    std::cout << std::format("Improvements: {}\n", improvements);
+
+    return regressions ? 1 : 0;
+}
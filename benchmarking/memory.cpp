@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <format>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lib/CodecChain.hpp"
+#include "lib/PageAllocator.hpp"
+#include "lib/PerfCounter.hpp"
+#include "lib/WorkerGroup.hpp"
+#include "lib/utils.hpp"
+
+// Compresses a multi-GB input with every page size and NUMA placement, writing throughput and dTLB misses per MB as CSV
+// Placements:
+//   firsttouch  the input and outputs are allocated and filled by the main thread and workers float, as the other
+//               benchmarks do, so on a multi-socket node most workers read from a remote node
+//   local       worker t is pinned to node t % nodes and its slice and output are bound to that node
+//   remote      as local, but each slice is bound to the next node, the worst case
+// Only the benchmark's own buffers follow the page policy; codec scratch buffers, such as the truncated copy in
+// TrunkCompressor, come from malloc. Run with GLIBC_TUNABLES=glibc.malloc.hugetlb=1 to give those THP as well.
+struct MemoryParams {
+    std::string dataName;
+    std::string sourceFile;
+    std::string treeName;
+    std::string branchName;
+    std::string outputFile;
+
+    std::vector<std::string> codecs;
+    int precision;
+    int trunkCompressionLevel;
+
+    double dataMB;
+    int threads;
+    std::vector<std::string> pages;
+    std::vector<std::string> placements;
+    int iterations;
+    int seed;
+
+    bool debug;
+};
+
+int pagePolicy(const std::string& pages) {
+    if (pages == "default") {
+        return PagePolicy::DEFAULT;
+    }
+    else if (pages == "thp") {
+        return PagePolicy::TRANSPARENT;
+    }
+    else if (pages == "hugetlb") {
+        return PagePolicy::EXPLICIT;
+    }
+    throw std::invalid_argument("Unknown page policy: " + pages);
+}
+
+MemoryParams parseMemoryArguments(int argc, char* argv[]) {
+    // Set default parameters
+    MemoryParams params;
+
+    params.dataName = "pt";
+    params.sourceFile = "mc_361106.Zee.1largeRjet1lep.root";
+    params.treeName = "mini";
+    params.branchName = "lep_pt";
+    params.outputFile = "memory.csv";
+
+    params.codecs = {"trunk", "truncate:3|shuffle|zstd:1"};
+    params.precision = 3;
+    params.trunkCompressionLevel = 1;
+
+    params.dataMB = 2000;
+    params.threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    params.pages = {"default", "thp", "hugetlb"};
+    params.placements = {"firsttouch", "local", "remote"};
+    params.iterations = 3;
+    params.seed = 12345;
+
+    params.debug = false;
+
+    // Read parameters
+    for (int i{1}; i < argc; ++i) {
+        std::string arg{argv[i]};
+        if (arg == "--dataSource") {
+            params.dataName = argv[++i];
+        } else if (arg == "--sourceFile") {
+            params.sourceFile = argv[++i];
+        } else if (arg == "--treeName") {
+            params.treeName = argv[++i];
+        } else if (arg == "--branchName") {
+            params.branchName = argv[++i];
+        } else if (arg == "--output") {
+            params.outputFile = argv[++i];
+        } else if (arg == "--codecs") {
+            params.codecs = splitList(argv[++i]);
+        } else if (arg == "--precision") {
+            params.precision = std::stoi(argv[++i]);
+        } else if (arg == "--trunkCompressionLevel") {
+            params.trunkCompressionLevel = std::stoi(argv[++i]);
+        } else if (arg == "--dataMB") {
+            params.dataMB = std::stod(argv[++i]);
+        } else if (arg == "--threads") {
+            params.threads = std::stoi(argv[++i]);
+        } else if (arg == "--pages") {
+            params.pages = splitList(argv[++i]);
+        } else if (arg == "--placements") {
+            params.placements = splitList(argv[++i]);
+        } else if (arg == "--iterations") {
+            params.iterations = std::stoi(argv[++i]);
+        } else if (arg == "--seed") {
+            params.seed = std::stoi(argv[++i]);
+        } else if (arg == "--debug") {
+            params.debug = std::stoi(argv[++i]);
+        } else {
+            throw std::invalid_argument("Unknown argument: " + arg);
+        }
+    }
+
+    if (params.dataMB <= 0) {
+        throw std::invalid_argument("Data size must be greater than 0");
+    }
+    if (params.threads <= 0) {
+        throw std::invalid_argument("Number of threads must be greater than 0");
+    }
+    if (params.iterations <= 0) {
+        throw std::invalid_argument("Number of iterations must be greater than 0");
+    }
+    for (const std::string& pages : params.pages) {
+        pagePolicy(pages);
+    }
+    for (const std::string& placement : params.placements) {
+        if (placement != "firsttouch" && placement != "local" && placement != "remote") {
+            throw std::invalid_argument("Unknown placement: " + placement);
+        }
+    }
+
+    return params;
+}
+
+// Every worker's buffers and counters for one page policy and placement
+struct WorkerBuffers {
+    std::span<const float> input{};
+    std::span<float> output{};
+    PageVector<float> ownedInput{};
+    PageVector<float> ownedOutput{};
+    std::vector<uint8_t> compressed{};
+    std::unique_ptr<MyCompressor> compressor{};
+    std::unique_ptr<PerfCounter> tlbMisses{};
+    std::optional<cpu_set_t> affinity{};    // Mask before pinning, restored when the point is done
+    uint64_t compressionMisses{0};
+    uint64_t decompressionMisses{0};
+    int runs{0};
+};
+
+struct MemoryPoint {
+    std::string codec;
+    std::string pages;
+    std::string placement;
+    size_t originalSize{0};
+    size_t compressedSize{0};
+    double compressionTime{0};
+    double decompressionTime{0};
+    double hugePageFraction{0};
+    bool countersOpen{false};
+    double compressionMissesPerMB{0};
+    double decompressionMissesPerMB{0};
+
+    double compressionThroughput() const {
+        return compressionTime > 0 ? static_cast<double>(originalSize) / MB / (compressionTime / 1000) : 0;
+    }
+    double decompressionThroughput() const {
+        return decompressionTime > 0 ? static_cast<double>(originalSize) / MB / (decompressionTime / 1000) : 0;
+    }
+    double ratio() const {
+        return compressedSize ? static_cast<double>(originalSize) / static_cast<double>(compressedSize) : 0;
+    }
+};
+
+MemoryPoint measurePoint(const std::string& codec, const std::string& pages, const std::string& placement, const MemoryParams& params,
+                            WorkerGroup& group, const std::vector<float>& data, const std::vector<int>& nodes) {
+    const int threads{params.threads};
+    const size_t sliceSize{(data.size() + threads - 1) / threads};
+    auto slice = [&](int t) {
+        const size_t begin{std::min(data.size(), t * sliceSize)};
+        return std::span<const float>(data).subspan(begin, std::min(data.size(), begin + sliceSize) - begin);
+    };
+
+    std::unique_ptr<MyCompressor> prototype{std::make_unique<ChainCompressor>(codecSpec(codec, params.precision, params.trunkCompressionLevel), params.debug)};
+    std::vector<WorkerBuffers> workers(threads);
+
+    // First touch: one buffer each for input and output, filled by this thread
+    PageVector<float> sharedInput{PageAllocator<float>(PagePolicy{pagePolicy(pages), -1})};
+    PageVector<float> sharedOutput{PageAllocator<float>(PagePolicy{pagePolicy(pages), -1})};
+    if (placement == "firsttouch") {
+        sharedInput.assign(data.begin(), data.end());
+        sharedOutput.resize(data.size());
+    }
+
+    // Each worker sets up its own buffers, so it can pin itself first and its counters count its own thread
+    group.run([&](int t) {
+        WorkerBuffers& worker{workers[t]};
+        const std::span<const float> source{slice(t)};
+        if (placement == "firsttouch") {
+            worker.input = std::span<const float>(sharedInput).subspan(source.data() - data.data(), source.size());
+            worker.output = std::span<float>(sharedOutput).subspan(source.data() - data.data(), source.size());
+        }
+        else {
+            const int node{nodes[t % nodes.size()]};
+            const int dataNode{placement == "local" ? node : nodes[(t + 1) % nodes.size()]};
+            worker.affinity = threadAffinity();
+            pinThreadToNode(node);
+            worker.ownedInput = PageVector<float>(source.begin(), source.end(), PageAllocator<float>(PagePolicy{pagePolicy(pages), dataNode}));
+            worker.ownedOutput = PageVector<float>(source.size(), PageAllocator<float>(PagePolicy{pagePolicy(pages), dataNode}));
+            worker.input = worker.ownedInput;
+            worker.output = worker.ownedOutput;
+        }
+
+        // Codecs size the output themselves; reserving first lets the pages be advised before they are touched
+        worker.compressed.reserve(source.size_bytes() + source.size_bytes() / 8 + 4096);
+        if (pages != "default") {
+            adviseHugePages(worker.compressed.data(), worker.compressed.capacity());
+        }
+        worker.compressor = prototype->clone();
+        worker.tlbMisses = std::make_unique<PerfCounter>();
+    });
+
+    MemoryPoint point{codec, pages, placement, data.size() * sizeof(float)};
+
+    point.compressionTime = timeRuns(group, [&](int t) {
+        WorkerBuffers& worker{workers[t]};
+        worker.tlbMisses->start();
+        worker.compressor->compressInto(worker.input, worker.compressed);
+        worker.compressionMisses += worker.tlbMisses->stop();
+        ++worker.runs;
+    }, params.iterations, 0);
+    const int compressionRuns{workers[0].runs};
+
+    point.decompressionTime = timeRuns(group, [&](int t) {
+        WorkerBuffers& worker{workers[t]};
+        worker.tlbMisses->start();
+        worker.compressor->decompressInto(worker.compressed, worker.output);
+        worker.decompressionMisses += worker.tlbMisses->stop();
+    }, params.iterations, 0);
+
+    // Huge page coverage of the input and output, which is what the policy controls
+    std::vector<std::span<const std::byte>> buffers{};
+    for (const WorkerBuffers& worker : workers) {
+        point.compressedSize += worker.compressed.size();
+        point.countersOpen = worker.tlbMisses->isOpen();
+        point.compressionMissesPerMB += static_cast<double>(worker.compressionMisses) / compressionRuns;
+        point.decompressionMissesPerMB += static_cast<double>(worker.decompressionMisses) / params.iterations;
+        buffers.push_back(std::as_bytes(worker.input));
+        buffers.push_back(std::as_bytes(std::span<const float>(worker.output)));
+    }
+    point.compressionMissesPerMB /= static_cast<double>(point.originalSize) / MB;
+    point.decompressionMissesPerMB /= static_cast<double>(point.originalSize) / MB;
+    point.hugePageFraction = std::min(1.0, static_cast<double>(hugePageBytes(buffers)) / (2.0 * static_cast<double>(point.originalSize)));
+
+    // Free on the workers, so pinned threads release their own pages, then unpin them: the group is reused, and a
+    // firsttouch point after a pinned one must not run on pinned threads
+    group.run([&](int t) {
+        const std::optional<cpu_set_t> affinity{workers[t].affinity};
+        workers[t] = WorkerBuffers{};
+        if (affinity) {
+            setThreadAffinity(*affinity);
+        }
+    });
+    return point;
+}
+
+int main(int argc, char* argv[]) {
+    MemoryParams params{parseMemoryArguments(argc, argv)};
+
+    const std::vector<int> nodes{numaNodes()};
+    const size_t size{static_cast<size_t>(params.dataMB * static_cast<double>(MB)) / sizeof(float)};
+    const std::vector<float> data{loadFloatData(params.dataName, size, params.sourceFile, params.treeName, params.branchName, params.seed, params.debug)};
+
+    std::cout << std::format("NUMA nodes: {}\n", nodes.size());
+    std::cout << std::format("Threads: {}\n", params.threads);
+    std::cout << std::format("Data: {} ({} bytes)\n", params.dataName, data.size() * sizeof(float));
+    if (nodes.size() == 1) {
+        std::cout << "Single NUMA node: local and remote placements only differ in pinning\n";
+    }
+
+    std::ofstream csv(params.outputFile);
+    if (!csv) {
+        throw std::runtime_error("Could not open output file " + params.outputFile);
+    }
+    csv << "Compressor,Pages,Placement,Threads,NUMA nodes,Data name,Precision,Original data size (bytes),Compressed data size (bytes),"
+           "Compression ratio,Average compression time (ms),Average decompression time (ms),Compression throughput (MB/s),"
+           "Decompression throughput (MB/s),Huge page fraction,Compression dTLB misses per MB,Decompression dTLB misses per MB\n";
+
+    WorkerGroup group(params.threads);
+    bool countersOpen{true};
+    for (const std::string& codec : params.codecs) {
+        for (const std::string& pages : params.pages) {
+            for (const std::string& placement : params.placements) {
+                const MemoryPoint point{measurePoint(codec, pages, placement, params, group, data, nodes)};
+                countersOpen = countersOpen && point.countersOpen;
+
+                csv << std::format("{},{},{},{},{},{},{},{},{},{:.4f},{:.4f},{:.4f},{:.2f},{:.2f},{:.4f},{},{}\n",
+                                    codec, pages, placement, params.threads, nodes.size(), params.dataName, params.precision,
+                                    point.originalSize, point.compressedSize, point.ratio(), point.compressionTime, point.decompressionTime,
+                                    point.compressionThroughput(), point.decompressionThroughput(), point.hugePageFraction,
+                                    point.countersOpen ? std::format("{:.1f}", point.compressionMissesPerMB) : "",
+                                    point.countersOpen ? std::format("{:.1f}", point.decompressionMissesPerMB) : "");
+                csv.flush();
+
+                std::cout << std::format("{} {:<8} {:<10}: {:>9.2f} / {:>9.2f} MB/s, huge pages {:>5.1f}%, dTLB misses per MB {} / {}\n",
+                                            codec, pages, placement, point.compressionThroughput(), point.decompressionThroughput(),
+                                            100 * point.hugePageFraction,
+                                            point.countersOpen ? std::format("{:.1f}", point.compressionMissesPerMB) : "n/a",
+                                            point.countersOpen ? std::format("{:.1f}", point.decompressionMissesPerMB) : "n/a");
+            }
+        }
+    }
+
+    if (!countersOpen) {
+        std::cout << "dTLB counters unavailable (perf_event_open failed); check kernel.perf_event_paranoid\n";
+    }
+    std::cout << std::format("Results: {}\n", params.outputFile);
+}
@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <iostream>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lib/BranchProfile.hpp"
+#include "lib/CodecChain.hpp"
+#include "lib/ErrorBound.hpp"
+#include "lib/Pipeline.hpp"
+#include "lib/Trace.hpp"
+#include "lib/utils.hpp"
+
+struct PipelineParams {
+    std::string dataName;
+    std::string sourceFile;
+    std::string treeName;
+    std::string branchName;
+    std::string outputFile;
+
+    std::string compressor;
+    std::string profileFile;
+    int precision;
+    int trunkCompressionLevel;
+
+    double dataMB;
+    double chunkKB;
+    double readKB;
+    int workers;
+    int queueDepth;
+    int seed;
+
+    bool verify;
+    std::string traceFile;
+    bool debug;
+};
+
+PipelineParams parsePipelineArguments(int argc, char* argv[]) {
+    // Set default parameters
+    PipelineParams params;
+
+    params.dataName = "root";
+    params.sourceFile = "mc_361106.Zee.1largeRjet1lep.root";
+    params.treeName = "mini";
+    params.branchName = "lep_pt";
+    params.outputFile = "";
+
+    params.compressor = "trunk";
+    params.profileFile = "";
+    params.precision = 3;
+    params.trunkCompressionLevel = 9;
+
+    params.dataMB = 64;
+    params.chunkKB = 1000;
+    params.readKB = 256;
+    params.workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 2);     // Leave cores for reading and writing
+    params.queueDepth = 8;
+    params.seed = 12345;
+
+    params.verify = false;
+    params.traceFile = "";
+    params.debug = false;
+
+    // Read parameters
+    for (int i{1}; i < argc; ++i) {
+        std::string arg{argv[i]};
+        if (arg == "--dataSource") {
+            params.dataName = argv[++i];
+        } else if (arg == "--sourceFile") {
+            params.sourceFile = argv[++i];
+        } else if (arg == "--treeName") {
+            params.treeName = argv[++i];
+        } else if (arg == "--branchName") {
+            params.branchName = argv[++i];
+        } else if (arg == "--output") {
+            params.outputFile = argv[++i];
+        } else if (arg == "--compressor") {
+            params.compressor = argv[++i];
+        } else if (arg == "--profile") {
+            params.profileFile = argv[++i];
+        } else if (arg == "--precision") {
+            params.precision = std::stoi(argv[++i]);
+        } else if (arg == "--trunkCompressionLevel") {
+            params.trunkCompressionLevel = std::stoi(argv[++i]);
+        } else if (arg == "--dataMB") {
+            params.dataMB = std::stod(argv[++i]);
+        } else if (arg == "--chunkKB") {
+            params.chunkKB = std::stod(argv[++i]);
+        } else if (arg == "--readKB") {
+            params.readKB = std::stod(argv[++i]);
+        } else if (arg == "--workers") {
+            params.workers = std::stoi(argv[++i]);
+        } else if (arg == "--queueDepth") {
+            params.queueDepth = std::stoi(argv[++i]);
+        } else if (arg == "--seed") {
+            params.seed = std::stoi(argv[++i]);
+        } else if (arg == "--verify") {
+            params.verify = std::stoi(argv[++i]);
+        } else if (arg == "--trace") {
+            params.traceFile = argv[++i];
+        } else if (arg == "--debug") {
+            params.debug = std::stoi(argv[++i]);
+        } else {
+            throw std::invalid_argument("Unknown argument: " + arg);
+        }
+    }
+
+    if (params.chunkKB <= 0 || params.readKB <= 0) {
+        throw std::invalid_argument("Chunk and read sizes must be greater than 0");
+    }
+    if (params.queueDepth <= 0) {
+        throw std::invalid_argument("Queue depth must be greater than 0");
+    }
+
+    // A profiled branch uses its tuned codec instead of --compressor
+    if (!params.profileFile.empty() && params.dataName == "root") {
+        params.compressor = ProfileCache(params.profileFile, params.debug).codecFor(params.branchName, params.precision, params.compressor);
+    }
+
+    if (params.outputFile.empty()) {
+        params.outputFile = std::format("{}_{}_p{}.frames", params.dataName == "root" ? params.branchName : params.dataName,
+                                        params.compressor, params.precision);
+    }
+
+    return params;
+}
+
+int main(int argc, char* argv[]) {
+    PipelineParams params{parsePipelineArguments(argc, argv)};
+    const std::string spec{codecSpec(params.compressor, params.precision, params.trunkCompressionLevel)};
+    std::unique_ptr<MyCompressor> compressor{std::make_unique<ChainCompressor>(spec, params.debug)};
+
+    const size_t chunkSize{static_cast<size_t>(params.chunkKB * static_cast<double>(KB)) / sizeof(float)};
+    const size_t readSize{std::max<size_t>(1, static_cast<size_t>(params.readKB * static_cast<double>(KB)) / sizeof(float))};
+
+    // ROOT branches are read entry by entry as the pipeline consumes them; synthetic data is generated up front and
+    // handed out in read-sized blocks
+    std::unique_ptr<RootBranchReader> reader{};
+    std::vector<float> generated{};
+    size_t generatedPosition{0};
+    if (params.dataName == "root") {
+        reader = std::make_unique<RootBranchReader>(params.sourceFile, params.treeName, params.branchName, params.debug);
+    }
+    else {
+        generated = loadFloatData(params.dataName, static_cast<size_t>(params.dataMB * static_cast<double>(MB)) / sizeof(float),
+                                  params.sourceFile, params.treeName, params.branchName, params.seed, params.debug);
+    }
+
+    CompressionPipeline::Source source = [&](std::vector<float>& block) -> size_t {
+        if (reader) {
+            return reader->read(block, readSize);
+        }
+        const size_t count{std::min(readSize, generated.size() - generatedPosition)};
+        block.assign(generated.begin() + generatedPosition, generated.begin() + generatedPosition + count);
+        generatedPosition += count;
+        return count;
+    };
+
+    // Codec stages of every worker, one track per thread
+    Trace::setEnabled(!params.traceFile.empty());
+    CompressionPipeline pipeline(*compressor, chunkSize, params.workers, params.queueDepth, params.debug);
+    PipelineResult result{pipeline.run(source, params.outputFile)};
+    Trace::setEnabled(false);
+
+    std::cout << std::format("Data source: {}\n", params.dataName == "root" ? params.sourceFile + ":" + params.branchName : params.dataName);
+    std::cout << std::format("Compressor: {}\n", params.compressor);
+    std::cout << std::format("Precision: {}\n", params.precision);
+    std::cout << std::format("Chunk size: {} bytes\n", chunkSize * sizeof(float));
+    std::cout << std::format("Workers: {}\n", params.workers);
+    std::cout << std::format("Queue depth: {}\n", params.queueDepth);
+    std::cout << std::format("Output file: {}\n", params.outputFile);
+    std::cout << std::format("Frames: {}\n", result.frames);
+    std::cout << std::format("Original data size: {} bytes\n", result.inputBytes);
+    std::cout << std::format("Compressed data size: {} bytes\n", result.outputBytes);
+    std::cout << std::format("Compression ratio: {:.2f}\n", result.outputBytes ? static_cast<double>(result.inputBytes) / static_cast<double>(result.outputBytes) : 0.0);
+    std::cout << std::format("Wall time: {:.2f} ms\n", result.wallTime);
+    std::cout << std::format("Throughput: {:.2f} MB/s\n", result.wallTime > 0 ? static_cast<double>(result.inputBytes) / MB / (result.wallTime / 1000) : 0.0);
+
+    // Utilization is busy time over busy plus queue wait time; the bottleneck stage is the one near 100%
+    for (const StageStats& stage : result.stages) {
+        std::cout << std::format("Stage {}: threads {}, items {}, busy {:.2f} ms, wait {:.2f} ms, utilization {:.1f}%\n",
+                                    stage.name, stage.threads, stage.items, stage.busyTime, stage.waitTime, 100 * stage.utilization());
+    }
+
+    // Every chunk is compressed on its own, so it is checked on its own: relative bounds scale with the chunk's range
+    if (params.verify) {
+        const std::vector<float> input{reader ? readRootFile(0, params.sourceFile, params.treeName, params.branchName, params.debug) : generated};
+        const std::vector<float> decompressed{CompressionPipeline::readFrames(params.outputFile, *compressor)};
+        if (decompressed.size() != input.size()) {
+            throw std::runtime_error("Pipeline output does not match the input size");
+        }
+
+        const ErrorBound bound{chainErrorBound(spec)};
+        size_t mismatches{0};
+        std::string first{};
+        for (size_t start{0}; start < input.size(); start += chunkSize) {
+            const size_t count{std::min(chunkSize, input.size() - start)};
+            const CheckResult check{checkFloats(bound, std::span<const float>(input).subspan(start, count),
+                                                std::span<const float>(decompressed).subspan(start, count))};
+            if (check.mismatches && !mismatches) {
+                first = std::format("chunk {}, {}", start / chunkSize, check.first);
+            }
+            mismatches += check.mismatches;
+        }
+        if (mismatches) {
+            throw std::runtime_error(std::format("Pipeline output exceeds the {} bound in {} values; first at {}", bound.description, mismatches, first));
+        }
+        std::cout << std::format("Verified: {} values, {}\n", decompressed.size(), bound.description);
+    }
+
+    if (!params.traceFile.empty()) {
+        Trace::writeChromeJson(params.traceFile);
+        std::cout << std::format("Trace: {} events in {}\n", Trace::events().size(), params.traceFile);
+    }
+}
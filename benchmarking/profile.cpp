@@ -0,0 +1,178 @@
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "lib/BranchProfile.hpp"
+#include "lib/CompressionEstimator.hpp"
+#include "lib/utils.hpp"
+
+// Sweeps candidate codecs over each float branch and records the best one per branch in a profile file, which
+// archive and pipeline load with --profile. With --prune, candidates the estimator rules out are not trial-compressed.
+// With --checkEstimates, every candidate is also compressed over the whole branch and compared with its estimate.
+struct ProfileParams {
+    std::string sourceFile;
+    std::string treeName;
+    std::vector<std::string> branches;
+    std::string profileFile;
+
+    std::vector<int> precisions;
+    std::vector<std::string> candidates;
+    double minCompressionMBps;
+    double minDecompressionMBps;
+    double sampleMB;
+    int iterations;
+    double pruneTolerance;
+    bool checkEstimates;
+
+    bool debug;
+};
+
+ProfileParams parseProfileArguments(int argc, char* argv[]) {
+    // Set default parameters
+    ProfileParams params;
+
+    params.sourceFile = "mc_361106.Zee.1largeRjet1lep.root";
+    params.treeName = "mini";
+    params.branches = {};
+    params.profileFile = "mc_361106.Zee.1largeRjet1lep.profile";
+
+    params.precisions = {3};
+    params.candidates = {};
+    params.minCompressionMBps = 0;
+    params.minDecompressionMBps = 0;
+    params.sampleMB = 4;
+    params.iterations = 3;
+    params.pruneTolerance = 0;
+    params.checkEstimates = false;
+
+    params.debug = false;
+
+    // Read parameters
+    for (int i{1}; i < argc; ++i) {
+        std::string arg{argv[i]};
+        if (arg == "--sourceFile") {
+            params.sourceFile = argv[++i];
+        } else if (arg == "--treeName") {
+            params.treeName = argv[++i];
+        } else if (arg == "--branches") {
+            params.branches = splitList(argv[++i]);
+        } else if (arg == "--profile") {
+            params.profileFile = argv[++i];
+        } else if (arg == "--precision") {
+            params.precisions.clear();
+            for (const std::string& precision : splitList(argv[++i])) {
+                params.precisions.push_back(std::stoi(precision));
+            }
+        } else if (arg == "--candidates") {
+            // Chain specs contain no commas, so a comma-separated list is unambiguous
+            params.candidates = splitList(argv[++i]);
+        } else if (arg == "--minCompressionMBps") {
+            params.minCompressionMBps = std::stod(argv[++i]);
+        } else if (arg == "--minDecompressionMBps") {
+            params.minDecompressionMBps = std::stod(argv[++i]);
+        } else if (arg == "--sampleMB") {
+            params.sampleMB = std::stod(argv[++i]);
+        } else if (arg == "--iterations") {
+            params.iterations = std::stoi(argv[++i]);
+        } else if (arg == "--prune") {
+            params.pruneTolerance = std::stod(argv[++i]);
+        } else if (arg == "--checkEstimates") {
+            params.checkEstimates = std::stoi(argv[++i]);
+        } else if (arg == "--debug") {
+            params.debug = std::stoi(argv[++i]);
+        } else {
+            throw std::invalid_argument("Unknown argument: " + arg);
+        }
+    }
+
+    // Every float branch by default
+    if (params.branches.empty()) {
+        params.branches = floatBranches;
+        params.branches.insert(params.branches.end(), vectorFloatBranches.begin(), vectorFloatBranches.end());
+    }
+    for (const std::string& branch : params.branches) {
+        if (!isFloatBranch(branch)) {
+            throw std::invalid_argument("Not a float branch: " + branch);
+        }
+    }
+    if (params.precisions.empty()) {
+        throw std::invalid_argument("At least one precision is needed");
+    }
+
+    return params;
+}
+
+// Estimate of each candidate against compressing the whole branch with it
+void checkEstimates(const std::vector<float>& data, const std::vector<std::string>& candidates, bool debug) {
+    CompressionEstimator estimator(4, 1024, 1, debug);
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    const std::vector<CompressionEstimate> estimates{estimator.estimateAll(data, candidates)};
+    const double estimateTime{elapsedMs(start)};
+
+    double compressionTime{0};
+    double maxError{0};
+    std::vector<uint8_t> compressed{};
+    for (const CompressionEstimate& estimate : estimates) {
+        ChainCompressor compressor(estimate.codec);
+        start = std::chrono::high_resolution_clock::now();
+        compressor.compressInto(data, compressed);
+        const double time{elapsedMs(start)};
+        compressionTime += time;
+
+        const double ratio{static_cast<double>(data.size() * sizeof(float)) / static_cast<double>(compressed.size())};
+        const double mbps{time > 0 ? static_cast<double>(data.size() * sizeof(float)) / MB / (time / 1000) : 0.0};
+        const double error{100 * (estimate.ratio - ratio) / ratio};
+        maxError = std::max(maxError, std::abs(error));
+        std::cout << std::format("    {:<32} estimated ratio {:>7.3f}  actual {:>7.3f} ({:+.1f}%)  estimated compression {:>8.1f} MB/s  actual {:>8.1f} MB/s\n",
+                                    estimate.codec, estimate.ratio, ratio, error, estimate.compressionMBps, mbps);
+    }
+    std::cout << std::format("  Estimates: {:.1f} ms, full compression: {:.1f} ms ({:.0f}x), largest ratio error {:.1f}%\n",
+                                estimateTime, compressionTime, estimateTime > 0 ? compressionTime / estimateTime : 0.0, maxError);
+}
+
+int main(int argc, char* argv[]) {
+    ProfileParams params{parseProfileArguments(argc, argv)};
+
+    // Existing profiles for other branches and precisions are kept
+    ProfileCache cache(params.profileFile, params.debug);
+
+    std::cout << std::format("Source file: {}\n", params.sourceFile);
+    std::cout << std::format("Profile file: {}\n", params.profileFile);
+    std::cout << std::format("Throughput floors: {} MB/s compression, {} MB/s decompression\n",
+                                params.minCompressionMBps, params.minDecompressionMBps);
+
+    for (const std::string& branch : params.branches) {
+        const std::vector<float> data{readRootFile(0, params.sourceFile, params.treeName, branch, params.debug)};
+
+        for (int precision : params.precisions) {
+            BranchProfiler profiler(precision, params.candidates, params.minCompressionMBps, params.minDecompressionMBps,
+                                    params.sampleMB, params.iterations, params.pruneTolerance, params.debug);
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            const BranchProfile best{profiler.profile(branch, data)};
+            const double profileTime{elapsedMs(start)};
+            cache.set(best);
+
+            std::cout << std::format("\nBranch {} ({} values), precision {}, {:.1f} ms\n", branch, data.size(), precision, profileTime);
+            for (const BranchProfile& trial : profiler.getTrials()) {
+                std::cout << std::format("  {} {:<32} ratio {:>7.3f}  compression {:>8.1f} MB/s  decompression {:>8.1f} MB/s\n",
+                                            trial.codec == best.codec ? "*" : " ", trial.codec, trial.ratio,
+                                            trial.compressionMBps, trial.decompressionMBps);
+            }
+            if (params.pruneTolerance > 0) {
+                std::cout << std::format("  Pruned {} of {} candidates\n", profiler.getCandidates().size() - profiler.getTrials().size(),
+                                            profiler.getCandidates().size());
+            }
+
+            if (params.checkEstimates) {
+                checkEstimates(data, profiler.getCandidates(), params.debug);
+            }
+        }
+    }
+
+    cache.save();
+    std::cout << std::format("\nWrote {} profiles to {}\n", cache.getProfiles().size(), params.profileFile);
+}
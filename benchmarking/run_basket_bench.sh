@@ -0,0 +1,43 @@
+#!/usr/bin/bash
+
+# Setup
+# Basket sizes in KB, covering the range ROOT uses for baskets
+BASKET_KBS=(4 8 16 32 64 128 256 512 1024)
+
+BRANCHES=(
+    "jet_E"
+    "jet_eta"
+    "jet_phi"
+    "jet_pt"
+    "largeRjet_E"
+    "largeRjet_eta"
+    "largeRjet_m"
+    "largeRjet_phi"
+    "largeRjet_pt"
+    "lep_E"
+    "lep_eta"
+    "lep_phi"
+    "lep_pt"
+)
+
+# Set up output files
+RESULTS_DIR="results"
+mkdir -p $RESULTS_DIR
+
+timestamp=$(date +%Y-%m-%d_%H-%M-%S)
+meta_log="${RESULTS_DIR}/${timestamp}_basket_meta.log"
+
+# Iterate over branches
+for branch in "${BRANCHES[@]}"; do
+    timestamp=$(date +%Y-%m-%d_%H-%M-%S)
+    echo "[$timestamp] Running basket benchmark for branch: $branch" >> $meta_log
+
+    # Iterate over basket sizes
+    for basket_kb in "${BASKET_KBS[@]}"; do
+        timestamp=$(date +%Y-%m-%d_%H-%M-%S)
+        results_log="${RESULTS_DIR}/${timestamp}_${branch}_basket_${basket_kb}KB.log"
+        cmd="./benchmark --doTrunk 1 --doSZ 1 --basketKB $basket_kb --branchName $branch"
+        echo "[$timestamp] Doing $cmd" >> $meta_log
+        $cmd > $results_log 2>> $meta_log
+    done
+done
@@ -60,6 +60,13 @@ for branch in "${BRANCHES[@]}"; do
     echo "[$timestamp] Doing $cmd" >> $meta_log
     $cmd > $results_log 2>> $meta_log
 
+    # Run benchmark for quantization + rANS
+    timestamp=$(date +%Y-%m-%d_%H-%M-%S)
+    results_log="${RESULTS_DIR}/${timestamp}_${branch}_quant.log"
+    cmd="./benchmark --debug 1 --doTrunk 0 --doSZ 0 --doQuant 1 --branchName $branch"
+    echo "[$timestamp] Doing $cmd" >> $meta_log
+    $cmd > $results_log 2>> $meta_log
+
     # Run benchmark for SZ3
     for algo in "${ALGOS[@]}"; do
         # Iterate over interpolation algorithms
@@ -0,0 +1,44 @@
+#!/usr/bin/bash
+
+# Setup
+# SZ layouts for jagged branches: flattened 1-D, events x objects, objects x events
+LAYOUTS=("flat" "event" "object")
+
+# SZ predictors: Lorenzo/regression and interpolation
+SZ_ALGOS=(0 2)
+
+BRANCHES=(
+    "jet_E"
+    "jet_eta"
+    "jet_phi"
+    "jet_pt"
+    "largeRjet_E"
+    "largeRjet_eta"
+    "largeRjet_m"
+    "largeRjet_phi"
+    "largeRjet_pt"
+)
+
+# Set up output files
+RESULTS_DIR="results"
+mkdir -p $RESULTS_DIR
+
+timestamp=$(date +%Y-%m-%d_%H-%M-%S)
+meta_log="${RESULTS_DIR}/${timestamp}_layout_meta.log"
+
+# Iterate over branches
+for branch in "${BRANCHES[@]}"; do
+    timestamp=$(date +%Y-%m-%d_%H-%M-%S)
+    echo "[$timestamp] Running layout benchmark for branch: $branch" >> $meta_log
+
+    # Iterate over layouts and predictors
+    for layout in "${LAYOUTS[@]}"; do
+        for algo in "${SZ_ALGOS[@]}"; do
+            timestamp=$(date +%Y-%m-%d_%H-%M-%S)
+            results_log="${RESULTS_DIR}/${timestamp}_${branch}_layout_${layout}_algo_${algo}.log"
+            cmd="./benchmark --doTrunk 0 --doSZ 1 --szLayout $layout --szAlgo $algo --branchName $branch"
+            echo "[$timestamp] Doing $cmd" >> $meta_log
+            $cmd > $results_log 2>> $meta_log
+        done
+    done
+done
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <format>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lib/CodecChain.hpp"
+#include "lib/WorkerGroup.hpp"
+#include "lib/utils.hpp"
+
+// Sweeps input size and thread count for each codec, writing one CSV row per point
+struct ScalingParams {
+    std::string dataName;
+    std::string sourceFile;
+    std::string treeName;
+    std::string branchName;
+    std::string outputFile;
+
+    std::vector<std::string> codecs;
+    int precision;
+    int trunkCompressionLevel;
+
+    double minKB;
+    double maxMB;
+    double sizeStep;
+    std::vector<int> threads;
+    int iterations;
+    double minTimeMs;
+    int seed;
+
+    bool debug;
+};
+
+// 1, 2, 4, ... up to the number of hardware threads, always including the hardware thread count itself
+std::vector<int> defaultThreadCounts() {
+    const int hardwareThreads{std::max(1, static_cast<int>(std::thread::hardware_concurrency()))};
+    std::vector<int> threads{};
+    for (int t{1}; t < hardwareThreads; t *= 2) {
+        threads.push_back(t);
+    }
+    threads.push_back(hardwareThreads);
+    return threads;
+}
+
+ScalingParams parseScalingArguments(int argc, char* argv[]) {
+    // Set default parameters
+    ScalingParams params;
+
+    params.dataName = "pt";
+    params.sourceFile = "mc_361106.Zee.1largeRjet1lep.root";
+    params.treeName = "mini";
+    params.branchName = "lep_pt";
+    params.outputFile = "scaling.csv";
+
+    params.codecs = {"trunk", "sz", "quant"};
+    params.precision = 3;
+    params.trunkCompressionLevel = 9;
+
+    params.minKB = 16;
+    params.maxMB = 1000;
+    params.sizeStep = 2;
+    params.threads = defaultThreadCounts();
+    params.iterations = 3;
+    params.minTimeMs = 100;
+    params.seed = 12345;
+
+    params.debug = false;
+
+    // Read parameters
+    for (int i{1}; i < argc; ++i) {
+        std::string arg{argv[i]};
+        if (arg == "--dataSource") {
+            params.dataName = argv[++i];
+        } else if (arg == "--sourceFile") {
+            params.sourceFile = argv[++i];
+        } else if (arg == "--treeName") {
+            params.treeName = argv[++i];
+        } else if (arg == "--branchName") {
+            params.branchName = argv[++i];
+        } else if (arg == "--output") {
+            params.outputFile = argv[++i];
+        } else if (arg == "--codecs") {
+            params.codecs = splitList(argv[++i]);
+        } else if (arg == "--precision") {
+            params.precision = std::stoi(argv[++i]);
+        } else if (arg == "--trunkCompressionLevel") {
+            params.trunkCompressionLevel = std::stoi(argv[++i]);
+        } else if (arg == "--minKB") {
+            params.minKB = std::stod(argv[++i]);
+        } else if (arg == "--maxMB") {
+            params.maxMB = std::stod(argv[++i]);
+        } else if (arg == "--sizeStep") {
+            params.sizeStep = std::stod(argv[++i]);
+        } else if (arg == "--threads") {
+            params.threads.clear();
+            for (const std::string& t : splitList(argv[++i])) {
+                params.threads.push_back(std::stoi(t));
+            }
+        } else if (arg == "--iterations") {
+            params.iterations = std::stoi(argv[++i]);
+        } else if (arg == "--minTimeMs") {
+            params.minTimeMs = std::stod(argv[++i]);
+        } else if (arg == "--seed") {
+            params.seed = std::stoi(argv[++i]);
+        } else if (arg == "--debug") {
+            params.debug = std::stoi(argv[++i]);
+        } else {
+            throw std::invalid_argument("Unknown argument: " + arg);
+        }
+    }
+
+    if (params.minKB <= 0 || params.maxMB * static_cast<double>(MB) < params.minKB * static_cast<double>(KB)) {
+        throw std::invalid_argument("Size range must be positive and minKB must not exceed maxMB");
+    }
+    if (params.sizeStep <= 1) {
+        throw std::invalid_argument("Size step must be greater than 1");
+    }
+    if (params.threads.empty() || *std::min_element(params.threads.begin(), params.threads.end()) <= 0) {
+        throw std::invalid_argument("Thread counts must be greater than 0");
+    }
+    if (params.iterations <= 0) {
+        throw std::invalid_argument("Number of iterations must be greater than 0");
+    }
+
+    return params;
+}
+
+// Copy bandwidth with every worker streaming its own slice of a buffer far larger than the LLC, counting both the
+// read and the write. This is the ceiling a codec could reach if it did no work at all.
+double memoryBandwidth(WorkerGroup& group, int threads, size_t llcSize) {
+    const size_t bytes{std::max<size_t>(64 * MB, 4 * llcSize)};
+    std::vector<uint8_t> source(bytes, 1);
+    std::vector<uint8_t> destination(bytes, 0);
+    const size_t slice{bytes / static_cast<size_t>(threads)};
+
+    const double time{timeRuns(group, [&](int t) {
+        std::memcpy(destination.data() + t * slice, source.data() + t * slice, slice);
+    }, 3, 0)};
+    return 2 * static_cast<double>(slice * threads) / MB / (time / 1000);
+}
+
+// Where the working set lives: each thread's input slice against the per-core L2, and the whole input against the LLC
+std::string workingSet(size_t bytes, int threads, size_t l2Size, size_t llcSize) {
+    if (l2Size && bytes / static_cast<size_t>(threads) <= l2Size) {
+        return "L2";
+    }
+    if (llcSize && bytes <= llcSize) {
+        return "LLC";
+    }
+    return "DRAM";
+}
+
+struct ScalingPoint {
+    std::string codec;
+    int threads;
+    size_t originalSize;
+    size_t compressedSize;
+    double compressionTime;
+    double decompressionTime;
+    std::string workingSet;
+
+    double compressionThroughput() const {
+        return compressionTime > 0 ? static_cast<double>(originalSize) / MB / (compressionTime / 1000) : 0;
+    }
+    double decompressionThroughput() const {
+        return decompressionTime > 0 ? static_cast<double>(originalSize) / MB / (decompressionTime / 1000) : 0;
+    }
+    double ratio() const {
+        return compressedSize ? static_cast<double>(originalSize) / static_cast<double>(compressedSize) : 0;
+    }
+};
+
+ScalingPoint measurePoint(const std::string& codec, const ScalingParams& params, WorkerGroup& group, int threads,
+                            std::span<const float> data) {
+    // Each thread owns a compressor and a contiguous slice, so the only thing they share is memory bandwidth
+    std::unique_ptr<MyCompressor> prototype{std::make_unique<ChainCompressor>(codecSpec(codec, params.precision, params.trunkCompressionLevel), params.debug)};
+    std::vector<std::unique_ptr<MyCompressor>> compressors{};
+    std::vector<std::span<const float>> slices{};
+    const size_t sliceSize{(data.size() + threads - 1) / threads};
+    for (int t{0}; t < threads; ++t) {
+        const size_t begin{std::min(data.size(), t * sliceSize)};
+        slices.push_back(data.subspan(begin, std::min(data.size(), begin + sliceSize) - begin));
+        compressors.push_back(prototype->clone());
+    }
+
+    std::vector<std::vector<uint8_t>> compressed(threads);
+    std::vector<std::vector<float>> decompressed(threads);
+    for (int t{0}; t < threads; ++t) {
+        decompressed[t].resize(slices[t].size());
+    }
+
+    ScalingPoint point{codec, threads, data.size_bytes(), 0, 0, 0, ""};
+    point.compressionTime = timeRuns(group, [&](int t) {
+        compressors[t]->compressInto(slices[t], compressed[t]);
+    }, params.iterations, params.minTimeMs);
+    point.decompressionTime = timeRuns(group, [&](int t) {
+        compressors[t]->decompressInto(compressed[t], decompressed[t]);
+    }, params.iterations, params.minTimeMs);
+
+    for (const std::vector<uint8_t>& bytes : compressed) {
+        point.compressedSize += bytes.size();
+    }
+    return point;
+}
+
+int main(int argc, char* argv[]) {
+    ScalingParams params{parseScalingArguments(argc, argv)};
+
+    const size_t l2Size{cacheSize(2)};
+    const size_t llcSize{cacheSize(3)};
+    // Input data of maxMB, replicating the branch for ROOT data
+    const size_t size{static_cast<size_t>(params.maxMB * static_cast<double>(MB)) / sizeof(float)};
+    const std::vector<float> data{loadFloatData(params.dataName, size, params.sourceFile, params.treeName, params.branchName, params.seed, params.debug)};
+
+    std::vector<size_t> sizes{};
+    for (double bytes{params.minKB * static_cast<double>(KB)}; bytes <= params.maxMB * static_cast<double>(MB) * 1.0001; bytes *= params.sizeStep) {
+        sizes.push_back(std::min(data.size(), static_cast<size_t>(bytes) / sizeof(float)));
+    }
+
+    std::ofstream csv(params.outputFile);
+    if (!csv) {
+        throw std::runtime_error("Could not open output file " + params.outputFile);
+    }
+    csv << "Compressor,Threads,Data name,Precision,Original data size (bytes),Compressed data size (bytes),Compression ratio,"
+           "Average compression time (ms),Average decompression time (ms),Compression throughput (MB/s),Decompression throughput (MB/s),"
+           "Working set,L2 cache size (bytes),LLC size (bytes),Memory bandwidth (MB/s),Fraction of memory bandwidth\n";
+
+    std::cout << std::format("L2 cache size: {} bytes\n", l2Size);
+    std::cout << std::format("LLC size: {} bytes\n", llcSize);
+
+    std::vector<ScalingPoint> points{};
+    for (int threads : params.threads) {
+        WorkerGroup group(threads);
+        const double bandwidth{memoryBandwidth(group, threads, llcSize)};
+        std::cout << std::format("Memory bandwidth with {} threads: {:.2f} MB/s\n", threads, bandwidth);
+
+        for (const std::string& codec : params.codecs) {
+            for (size_t size : sizes) {
+                if (size < static_cast<size_t>(threads)) {
+                    continue;
+                }
+                ScalingPoint point{measurePoint(codec, params, group, threads, std::span<const float>(data.data(), size))};
+                point.workingSet = workingSet(point.originalSize, threads, l2Size, llcSize);
+                points.push_back(point);
+
+                csv << std::format("{},{},{},{},{},{},{:.4f},{:.4f},{:.4f},{:.2f},{:.2f},{},{},{},{:.2f},{:.4f}\n",
+                                    codec, threads, params.dataName, params.precision, point.originalSize, point.compressedSize,
+                                    point.ratio(), point.compressionTime, point.decompressionTime, point.compressionThroughput(),
+                                    point.decompressionThroughput(), point.workingSet, l2Size, llcSize, bandwidth,
+                                    bandwidth > 0 ? point.compressionThroughput() / bandwidth : 0.0);
+                csv.flush();
+
+                if (params.debug) {
+                    std::cerr << std::format("[DEBUG scaling]: {} threads {} size {} bytes: {:.2f} / {:.2f} MB/s\n", codec, threads,
+                                                point.originalSize, point.compressionThroughput(), point.decompressionThroughput());
+                }
+            }
+        }
+    }
+
+    // Summary per codec and thread count: mean throughput in each working set region, and the size after which
+    // compression throughput fell the most, which is where the working set spilled out of a cache level
+    std::cout << std::format("Results: {}\n", params.outputFile);
+    std::map<std::pair<std::string, int>, std::vector<const ScalingPoint*>> series{};
+    for (const ScalingPoint& point : points) {
+        series[{point.codec, point.threads}].push_back(&point);
+    }
+    for (const auto& [key, curve] : series) {
+        std::map<std::string, std::pair<double, int>> regions{};
+        size_t dropSize{0};
+        double largestDrop{0};
+        for (size_t i{0}; i < curve.size(); ++i) {
+            std::pair<double, int>& region{regions[curve[i]->workingSet]};
+            region.first += curve[i]->compressionThroughput();
+            ++region.second;
+            if (i > 0 && curve[i - 1]->compressionThroughput() > 0) {
+                const double drop{1 - curve[i]->compressionThroughput() / curve[i - 1]->compressionThroughput()};
+                if (drop > largestDrop) {
+                    largestDrop = drop;
+                    dropSize = curve[i]->originalSize;
+                }
+            }
+        }
+
+        std::string regionSummary{};
+        for (const char* name : {"L2", "LLC", "DRAM"}) {
+            if (regions.contains(name)) {
+                regionSummary += std::format(", {} {:.2f} MB/s", name, regions[name].first / regions[name].second);
+            }
+        }
+        std::cout << std::format("{} with {} threads{}", key.first, key.second, regionSummary);
+        if (largestDrop > 0) {
+            std::cout << std::format(", largest drop {:.1f}% at {} bytes", 100 * largestDrop, dropSize);
+        }
+        std::cout << "\n";
+    }
+}
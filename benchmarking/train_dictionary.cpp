@@ -0,0 +1,130 @@
+#include <iostream>
+#include <format>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "lib/DictionaryTrainer.hpp"
+#include "lib/TrunkCompressor.hpp"
+#include "lib/utils.hpp"
+
+struct TrainingParams {
+    std::string sourceFile;
+    std::string treeName;
+    std::string branchName;
+    std::string outputFile;
+
+    int precision;
+    int compressionLevel;
+    double basketKB;
+    double dictionaryKB;
+    double sampleMB;
+};
+
+TrainingParams parseTrainingArguments(int argc, char* argv[]) {
+    // Set default parameters
+    TrainingParams params;
+
+    params.sourceFile = "mc_361106.Zee.1largeRjet1lep.root";
+    params.treeName = "mini";
+    params.branchName = "lep_pt";
+    params.outputFile = "";
+
+    params.precision = 3;
+    params.compressionLevel = 9;
+    params.basketKB = 4;
+    params.dictionaryKB = 32;
+    params.sampleMB = 8;
+
+    // Read parameters
+    for (int i{1}; i < argc; ++i) {
+        std::string arg{argv[i]};
+        if (arg == "--sourceFile") {
+            params.sourceFile = argv[++i];
+        } else if (arg == "--treeName") {
+            params.treeName = argv[++i];
+        } else if (arg == "--branchName") {
+            params.branchName = argv[++i];
+        } else if (arg == "--output") {
+            params.outputFile = argv[++i];
+        } else if (arg == "--precision") {
+            params.precision = std::stoi(argv[++i]);
+        } else if (arg == "--trunkCompressionLevel") {
+            params.compressionLevel = std::stoi(argv[++i]);
+        } else if (arg == "--basketKB") {
+            params.basketKB = std::stod(argv[++i]);
+        } else if (arg == "--dictionaryKB") {
+            params.dictionaryKB = std::stod(argv[++i]);
+        } else if (arg == "--sampleMB") {
+            params.sampleMB = std::stod(argv[++i]);
+        } else {
+            throw std::invalid_argument("Unknown argument: " + arg);
+        }
+    }
+
+    if (params.basketKB <= 0 || params.dictionaryKB <= 0 || params.sampleMB <= 0) {
+        throw std::invalid_argument("Basket, dictionary and sample sizes must be greater than 0");
+    }
+
+    // Dictionaries only apply to the precision they were trained at
+    if (params.outputFile.empty()) {
+        params.outputFile = std::format("{}_p{}.dict", params.branchName, params.precision);
+    }
+
+    return params;
+}
+
+// Aggregate ratio when compressing every basket independently
+double basketRatio(TrunkCompressor& compressor, std::span<const float> data, size_t basketFloats) {
+    std::vector<uint8_t> compressedData{};
+    size_t compressedSize{0};
+    for (size_t start{0}; start < data.size(); start += basketFloats) {
+        compressor.compressInto(data.subspan(start, std::min(basketFloats, data.size() - start)), compressedData);
+        compressedSize += compressedData.size();
+    }
+    return static_cast<double>(data.size() * sizeof(float)) / static_cast<double>(compressedSize);
+}
+
+int main(int argc, char* argv[]) {
+    TrainingParams params{parseTrainingArguments(argc, argv)};
+
+    // Read branch
+    std::vector<float> data{readRootFile(0, params.sourceFile, params.treeName, params.branchName)};
+    const size_t basketSize{static_cast<size_t>(params.basketKB * static_cast<double>(KB))};
+    const size_t basketFloats{basketSize / sizeof(float)};
+    if (basketFloats == 0 || data.empty()) {
+        throw std::invalid_argument("Need a non-empty branch and a basket of at least one float");
+    }
+
+    // Alternate baskets between a training sample and a held-out set, capping the sample size
+    const size_t sampleFloats{static_cast<size_t>(params.sampleMB * static_cast<double>(MB)) / sizeof(float)};
+    std::vector<float> samples{};
+    std::vector<float> heldOut{};
+    for (size_t start{0}, basket{0}; start < data.size(); start += basketFloats, ++basket) {
+        const size_t end{std::min(start + basketFloats, data.size())};
+        std::vector<float>& target{(basket % 2 == 0 && samples.size() < sampleFloats) ? samples : heldOut};
+        target.insert(target.end(), data.begin() + start, data.begin() + end);
+    }
+
+    // Train and store
+    std::vector<uint8_t> dictionary{trainDeflateDictionary(samples, params.precision, basketSize,
+                                        static_cast<size_t>(params.dictionaryKB * static_cast<double>(KB)))};
+    writeDictionary(params.outputFile, dictionary);
+
+    // Compare ratios on the held-out baskets
+    TrunkCompressor plain(params.precision, params.compressionLevel);
+    TrunkCompressor primed(params.precision, params.compressionLevel);
+    primed.setDictionary(dictionary);
+
+    std::cout << std::format("Branch name: {}\n", params.branchName);
+    std::cout << std::format("Precision: {}\n", params.precision);
+    std::cout << std::format("Basket size: {} bytes\n", basketSize);
+    std::cout << std::format("Training sample size: {} bytes\n", samples.size() * sizeof(float));
+    std::cout << std::format("Dictionary size: {} bytes\n", dictionary.size());
+    std::cout << std::format("Dictionary file: {}\n", params.outputFile);
+    if (!heldOut.empty()) {
+        std::cout << std::format("Held-out compression ratio without dictionary: {:.2f}\n", basketRatio(plain, heldOut, basketFloats));
+        std::cout << std::format("Held-out compression ratio with dictionary: {:.2f}\n", basketRatio(primed, heldOut, basketFloats));
+    }
+}
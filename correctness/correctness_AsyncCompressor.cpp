@@ -0,0 +1,112 @@
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "lib/AsyncCompressor.hpp"
+#include "lib/TrunkCompressor.hpp"
+#include "lib/utils.hpp"
+
+// Cancellation of queued AsyncCompressor requests. The cancelled coroutine resumes inside request_stop and frees its
+// frame, stop callback included, before request_stop returns; build with -fsanitize=address to catch any use of the
+// callback after that.
+
+// Holds every compression until the gate opens, so the single worker stays busy while requests queue behind it
+std::atomic<bool> gateOpen{false};
+
+class GatedCompressor : public TrunkCompressor {
+    public:
+        GatedCompressor(const int precision, const int compressionLevel) : TrunkCompressor(precision, compressionLevel) {}
+
+        std::unique_ptr<MyCompressor> clone() const override {
+            return std::make_unique<GatedCompressor>(getPrecision(), getCompressionLevel());
+        }
+
+        void compressInto(std::span<const float> data, std::vector<uint8_t>& compressedData) override {
+            while (!gateOpen.load()) {
+                std::this_thread::yield();
+            }
+            TrunkCompressor::compressInto(data, compressedData);
+        }
+};
+
+struct DetachedRequest {
+    struct promise_type {
+        DetachedRequest get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+enum OUTCOME{WAITING, COMPLETED, CANCELLED, FAILED};
+
+DetachedRequest request(AsyncCompressor& compressor, std::span<const float> data, std::stop_token stopToken,
+                        std::atomic<int>& outcome, size_t& compressedSize) {
+    try {
+        const std::vector<uint8_t> compressedData{co_await compressor.compressAsync(data, stopToken)};
+        compressedSize = compressedData.size();
+        outcome = COMPLETED;
+    }
+    catch (const CompressionCancelled&) {
+        outcome = CANCELLED;
+    }
+    catch (...) {
+        outcome = FAILED;
+    }
+}
+
+int main() {
+    const int numCancelled{64};
+    const std::vector<float> data{generateUniformRandomData(MB / sizeof(float), -1.0f, 1.0f)};
+    int failures{0};
+
+    {
+        AsyncCompressor compressor(GatedCompressor(7, 1), 1);
+
+        // Occupies the only worker until the gate opens
+        std::atomic<int> blockingOutcome{WAITING};
+        size_t blockingSize{0};
+        request(compressor, data, {}, blockingOutcome, blockingSize);
+
+        // Queued behind it, small enough to share a batch, then cancelled from this thread
+        std::vector<std::stop_source> stopSources(numCancelled);
+        std::vector<std::atomic<int>> outcomes(numCancelled);
+        std::vector<size_t> sizes(numCancelled, 0);
+        for (int i{0}; i < numCancelled; ++i) {
+            outcomes[i] = WAITING;
+            request(compressor, std::span<const float>(data).first(256), stopSources[i].get_token(), outcomes[i], sizes[i]);
+        }
+        for (int i{0}; i < numCancelled; ++i) {
+            stopSources[i].request_stop();
+            if (outcomes[i] != CANCELLED) {
+                std::cout << std::format("FAIL: request {} was not resumed as cancelled by request_stop\n", i);
+                ++failures;
+            }
+        }
+        if (compressor.getCancelled() != numCancelled) {
+            std::cout << std::format("FAIL: {} cancellations counted, expected {}\n", compressor.getCancelled(), numCancelled);
+            ++failures;
+        }
+
+        // Cancelled jobs stay queued and must be skipped once the worker gets to them
+        gateOpen = true;
+        while (blockingOutcome == WAITING) {
+            std::this_thread::yield();
+        }
+        if (blockingOutcome != COMPLETED || blockingSize == 0) {
+            std::cout << "FAIL: request ahead of the cancelled ones did not complete\n";
+            ++failures;
+        }
+    }
+
+    std::cout << std::format("Cancel while queued: {} requests, {}\n", numCancelled, failures ? "FAIL" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "lib/BatchCompressor.hpp"
+#include "lib/QuantCompressor.hpp"
+#include "lib/SZCompressor.hpp"
+#include "lib/TrunkCompressor.hpp"
+#include "lib/utils.hpp"
+
+// Batch round trips on one thread and on several, against one codec call per buffer. Every entry must come back
+// exactly as a lone round trip of the same buffer on a fresh codec does, and the serial and parallel arenas must be
+// identical. The batches include empty buffers and an empty batch; SZ3 gets non-empty buffers only, but of every size,
+// so its configuration is reused across shapes.
+
+int checkBatches(const std::string& name, const MyCompressor& prototype, const std::vector<std::vector<float>>& buffers) {
+    std::vector<std::span<const float>> inputs(buffers.begin(), buffers.end());
+    int failures{0};
+
+    // Reference: one fresh codec per buffer
+    std::vector<std::vector<float>> expected{};
+    for (const std::vector<float>& buffer : buffers) {
+        std::unique_ptr<MyCompressor> reference{prototype.clone()};
+        std::vector<uint8_t> compressedData{};
+        reference->compressInto(buffer, compressedData);
+        expected.emplace_back(buffer.size());
+        reference->decompressInto(compressedData, expected.back());
+    }
+
+    // Serial on one worker, parallel with every batch above the threshold
+    BatchCompressor serial(prototype, 1);
+    BatchCompressor parallel(prototype, 4, 0);
+    const CompressedBatch serialBatch{serial.compressBatch(inputs)};
+    CompressedBatch parallelBatch{};
+    for (int round{0}; round < 2; ++round) {
+        // The second round reuses the arenas and codec state of the first
+        parallel.compressBatchInto(inputs, parallelBatch);
+    }
+
+    if (serialBatch.size() != buffers.size() || parallelBatch.size() != buffers.size()) {
+        std::cout << std::format("FAIL {}: batch holds {} / {} buffers, expected {}\n", name, serialBatch.size(), parallelBatch.size(), buffers.size());
+        return 1;
+    }
+    if (serialBatch.arena != parallelBatch.arena || serialBatch.offsets != parallelBatch.offsets) {
+        std::cout << std::format("FAIL {}: serial and parallel arenas differ\n", name);
+        ++failures;
+    }
+
+    // Decompress each batch with the other instance, into one contiguous buffer and into caller spans
+    const std::vector<float> contiguous{serial.decompressBatch(parallelBatch)};
+    std::vector<std::vector<float>> separate{};
+    std::vector<std::span<float>> outputs{};
+    for (const std::vector<float>& buffer : buffers) {
+        separate.emplace_back(buffer.size());
+    }
+    outputs.assign(separate.begin(), separate.end());
+    parallel.decompressBatchInto(serialBatch, outputs);
+
+    size_t offset{0};
+    for (size_t i{0}; i < buffers.size(); ++i) {
+        const std::span<const float> joined{std::span<const float>(contiguous).subspan(offset, buffers[i].size())};
+        if (!std::equal(joined.begin(), joined.end(), expected[i].begin()) || separate[i] != expected[i]) {
+            std::cout << std::format("FAIL {}: buffer {} ({} values) does not match a lone round trip\n", name, i, buffers[i].size());
+            ++failures;
+        }
+        offset += buffers[i].size();
+    }
+    if (offset != contiguous.size()) {
+        std::cout << std::format("FAIL {}: {} values decompressed, expected {}\n", name, contiguous.size(), offset);
+        ++failures;
+    }
+
+    std::cout << std::format("{:<8} {:>4} buffers: {}\n", name, buffers.size(), failures ? "FAIL" : "ok");
+    return failures;
+}
+
+int main() {
+    // Mixed sizes, with empty buffers at the start, in the middle and at the end
+    std::vector<std::vector<float>> buffers{};
+    buffers.emplace_back();
+    for (size_t i{0}; i < 64; ++i) {
+        const size_t size{i % 7 == 3 ? 0 : (i * 977) % 20000 + 1};
+        buffers.push_back(generateUniformRandomData(size, -1.0f, 1.0f));
+    }
+    buffers.emplace_back();
+
+    std::vector<std::vector<float>> nonEmpty{};
+    std::copy_if(buffers.begin(), buffers.end(), std::back_inserter(nonEmpty), [](const std::vector<float>& buffer) { return !buffer.empty(); });
+    const std::vector<std::vector<float>> onlyEmpty(3);
+    const std::vector<std::vector<float>> none{};
+
+    int failures{0};
+    const TrunkCompressor trunk(4, 1);
+    const QuantCompressor quant(4, QuantCompressor::REL);
+    const SZCompressor sz(4, SZ3::EB_REL, SZ3::ALGO_LORENZO_REG, SZ3::INTERP_ALGO_LINEAR);
+    failures += checkBatches("trunk", trunk, buffers);
+    failures += checkBatches("trunk", trunk, onlyEmpty);
+    failures += checkBatches("trunk", trunk, none);
+    failures += checkBatches("quant", quant, buffers);
+    failures += checkBatches("quant", quant, onlyEmpty);
+    failures += checkBatches("quant", quant, none);
+    failures += checkBatches("sz", sz, nonEmpty);
+    failures += checkBatches("sz", sz, none);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lib/CodecChain.hpp"
+#include "lib/utils.hpp"
+
+// Codec chains fed a corrupt header or the wrong uncompressed size must throw rather than write past a buffer; build
+// with -fsanitize=address so an overflow that does not crash is still caught.
+
+int expectThrow(const std::string& chain, const std::string& what, const std::function<void()>& decode) {
+    try {
+        decode();
+    }
+    catch (const std::exception&) {
+        return 0;
+    }
+    std::cout << std::format("FAIL {}: {} did not throw\n", chain, what);
+    return 1;
+}
+
+int main() {
+    const std::vector<float> data{generateGaussianRandomData(100003, 0.0f, 1.0f, 7)};
+    const std::vector<std::string> chains{
+        "truncate:3", "shuffle", "delta", "truncate:3|shuffle|zstd:1", "truncate:3|delta|zlib:1", "truncate:4|shuffle|delta",
+        "quant:3|zstd:1", "trunk:3:1", "delta|zstd:3"
+    };
+
+    int failures{0};
+    for (const std::string& spec : chains) {
+        ChainCompressor compressor(spec);
+        const std::vector<uint8_t> compressedData{compressor.compress(data)};
+        int chainFailures{0};
+
+        // Intact stream round trips
+        try {
+            const std::vector<float> decompressedData{compressor.decompress(compressedData, data.size())};
+            if (decompressedData.size() != data.size()) {
+                std::cout << std::format("FAIL {}: round trip returned {} values\n", spec, decompressedData.size());
+                ++chainFailures;
+            }
+        }
+        catch (const std::exception& e) {
+            std::cout << std::format("FAIL {}: intact stream threw: {}\n", spec, e.what());
+            ++chainFailures;
+        }
+
+        // Wrong uncompressed size, shorter and longer
+        for (const size_t size : {data.size() - 1, data.size() - 4096, data.size() + 1, data.size() + 4096}) {
+            chainFailures += expectThrow(spec, std::format("decompressing into {} values", size), [&] {
+                compressor.decompress(compressedData, size);
+            });
+        }
+
+        // Corrupt intermediate sizes: absurdly large, a few bytes off either way
+        const size_t stages{static_cast<size_t>(std::count(spec.begin(), spec.end(), '|')) + 1};
+        for (size_t stage{0}; stage + 1 < stages; ++stage) {
+            uint64_t size;
+            std::memcpy(&size, compressedData.data() + stage * sizeof(uint64_t), sizeof(size));
+            for (const uint64_t corrupt : {uint64_t{1} << 60, size + 4, size - 4}) {
+                std::vector<uint8_t> corrupted{compressedData};
+                std::memcpy(corrupted.data() + stage * sizeof(uint64_t), &corrupt, sizeof(corrupt));
+                chainFailures += expectThrow(spec, std::format("stage {} size {} instead of {}", stage + 1, corrupt, size), [&] {
+                    compressor.decompress(corrupted, data.size());
+                });
+            }
+        }
+
+        // Stream shorter than the header
+        if (stages > 1) {
+            const std::vector<uint8_t> truncated(compressedData.begin(), compressedData.begin() + sizeof(uint64_t) * (stages - 1) - 1);
+            chainFailures += expectThrow(spec, "a truncated header", [&] {
+                compressor.decompress(truncated, data.size());
+            });
+        }
+
+        std::cout << std::format("{:<28} {}\n", spec, chainFailures ? "FAIL" : "ok");
+        failures += chainFailures;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,68 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lib/CodecChain.hpp"
+#include "lib/CompressionEstimator.hpp"
+#include "lib/utils.hpp"
+
+// Estimated against actual compression ratios and throughputs on noisy physics-like data. Ratios must be within
+// RATIO_TOLERANCE of the ratio on the whole array, as CompressionEstimator documents. Throughputs come from one small
+// probe and are only checked to be within THROUGHPUT_FACTOR of the whole array's, which is still close enough for
+// BranchProfiler to prune on them.
+
+constexpr double RATIO_TOLERANCE{0.05};
+constexpr double THROUGHPUT_FACTOR{3};
+
+int main() {
+    const size_t size{24 * MB / sizeof(float)};
+    const std::vector<std::pair<std::string, std::vector<float>>> datasets{
+        {"normal", generateGaussianRandomData(size, 0.0f, 1.0f, 1)},
+        {"exponentialPt", generateExponentialPtData(size, 3.0f, 5.0f, 2)},
+        {"jaggedPt", generateJaggedPtData(size, 30.0f, 3.0f, 5.0f, 3)}
+    };
+    const std::vector<std::string> codecs{
+        "trunk:3:1", "trunk:5:6", "truncate:3|delta|zstd:1", "truncate:4|shuffle|zstd:3", "quant:3", "quant:4:0"
+    };
+
+    const double dataMB{static_cast<double>(size * sizeof(float)) / MB};
+    std::cout << "Estimated / actual, on the whole array\n";
+
+    // Best of three probe runs, so a single slow run does not decide the throughput estimate
+    CompressionEstimator estimator(4, 1024, 3);
+    int failures{0};
+    for (const auto& [name, data] : datasets) {
+        for (const CompressionEstimate& estimate : estimator.estimateAll(data, codecs)) {
+            ChainCompressor compressor(estimate.codec);
+            std::vector<uint8_t> compressedData{};
+            std::vector<float> decompressedData(data.size());
+            std::chrono::high_resolution_clock::time_point start{std::chrono::high_resolution_clock::now()};
+            compressor.compressInto(data, compressedData);
+            const double compressionMBps{dataMB / elapsedSeconds(start)};
+            start = std::chrono::high_resolution_clock::now();
+            compressor.decompressInto(compressedData, decompressedData);
+            const double decompressionMBps{dataMB / elapsedSeconds(start)};
+
+            const double ratio{static_cast<double>(data.size() * sizeof(float)) / static_cast<double>(compressedData.size())};
+            const double error{estimate.ratio / ratio - 1};
+            auto withinFactor = [](double estimated, double measured) {
+                return estimated * THROUGHPUT_FACTOR >= measured && estimated <= measured * THROUGHPUT_FACTOR;
+            };
+            const bool ok{std::abs(error) <= RATIO_TOLERANCE && withinFactor(estimate.compressionMBps, compressionMBps)
+                          && withinFactor(estimate.decompressionMBps, decompressionMBps)};
+            failures += !ok;
+
+            std::cout << std::format("{:<14} {:<28} ratio {:>7.3f} / {:>7.3f} ({:>+5.1f}%)  compression {:>7.1f} / {:>7.1f} MB/s  "
+                                        "decompression {:>7.1f} / {:>7.1f} MB/s  {}\n",
+                                        name, estimate.codec, estimate.ratio, ratio, 100 * error,
+                                        estimate.compressionMBps, compressionMBps, estimate.decompressionMBps, decompressionMBps,
+                                        ok ? "ok" : "FAIL");
+        }
+    }
+    return failures ? 1 : 0;
+}
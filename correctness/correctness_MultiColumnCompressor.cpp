@@ -0,0 +1,95 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lib/MultiColumnCompressor.hpp"
+#include "lib/utils.hpp"
+
+// Joint column round trips, and streams whose header has been corrupted: wrong column counts, value counts too large
+// for the stream, or a stream cut short must throw before anything is read out of bounds or allocated for them. Build
+// with -fsanitize=address so a read past a column that does not crash is still caught.
+
+int expectThrow(const std::string& mode, const std::string& what, const std::function<void()>& decode) {
+    try {
+        decode();
+    }
+    catch (const std::exception&) {
+        return 0;
+    }
+    std::cout << std::format("FAIL {}: {} did not throw\n", mode, what);
+    return 1;
+}
+
+// Header is mode (uint32), number of columns (uint32), number of values (uint64)
+std::vector<uint8_t> withHeader(std::vector<uint8_t> compressedData, uint32_t numColumns, uint64_t numValues) {
+    std::memcpy(compressedData.data() + sizeof(uint32_t), &numColumns, sizeof(numColumns));
+    std::memcpy(compressedData.data() + 2 * sizeof(uint32_t), &numValues, sizeof(numValues));
+    return compressedData;
+}
+
+int main() {
+    const size_t size{50000};
+    const std::vector<float> pt{generateExponentialPtData(size, 3.0f, 5.0f, 1)};
+    const std::vector<float> eta{generateGaussianRandomData(size, 0.0f, 2.0f, 2)};
+    const std::vector<float> phi{generateUniformPhiData(size, 3)};
+    const std::vector<float> mass{generateUniformRandomData(size, 0.0f, 1.0f, 4)};
+    std::vector<float> energy(size);
+    for (size_t i{0}; i < size; ++i) {
+        const double momentum{pt[i] * std::cosh(static_cast<double>(eta[i]))};
+        energy[i] = static_cast<float>(std::sqrt(momentum * momentum + mass[i] * mass[i]));
+    }
+    const std::vector<std::vector<float>> columns{pt, eta, phi, energy, mass};
+
+    int failures{0};
+    for (const int mode : {MultiColumnCompressor::PREDICT_ENERGY, MultiColumnCompressor::SZ_2D}) {
+        const std::string name{mode == MultiColumnCompressor::PREDICT_ENERGY ? "PREDICT_ENERGY" : "SZ_2D"};
+        MultiColumnCompressor compressor(mode, 4, 1, SZ3::ALGO_LORENZO_REG, SZ3::INTERP_ALGO_LINEAR);
+        const std::vector<uint8_t> compressedData{compressor.compress(columns)};
+        int modeFailures{0};
+
+        try {
+            const std::vector<std::vector<float>> decompressed{compressor.decompress(compressedData)};
+            if (decompressed.size() != columns.size() || decompressed[0].size() != size) {
+                std::cout << std::format("FAIL {}: round trip returned {} columns\n", name, decompressed.size());
+                ++modeFailures;
+            }
+        }
+        catch (const std::exception& e) {
+            std::cout << std::format("FAIL {}: intact stream threw: {}\n", name, e.what());
+            ++modeFailures;
+        }
+
+        // Column counts the mode cannot have, or too many for the stream
+        const std::vector<uint32_t> badColumns{mode == MultiColumnCompressor::PREDICT_ENERGY ? std::vector<uint32_t>{0, 1, 3, 6, 1u << 30}
+                                                                                          : std::vector<uint32_t>{1u << 30}};
+        for (const uint32_t numColumns : badColumns) {
+            modeFailures += expectThrow(name, std::format("{} columns", numColumns), [&] {
+                compressor.decompress(withHeader(compressedData, numColumns, size));
+            });
+        }
+
+        // Value counts far beyond what the stream can hold
+        for (const uint64_t numValues : {uint64_t{1} << 40, uint64_t{1} << 62, ~uint64_t{0}}) {
+            modeFailures += expectThrow(name, std::format("{} values", numValues), [&] {
+                compressor.decompress(withHeader(compressedData, static_cast<uint32_t>(columns.size()), numValues));
+            });
+        }
+
+        // Streams cut short, inside the header and inside the columns
+        for (const size_t length : {size_t{3}, size_t{15}, compressedData.size() / 2, compressedData.size() - 1}) {
+            modeFailures += expectThrow(name, std::format("a stream cut to {} bytes", length), [&] {
+                compressor.decompress(std::vector<uint8_t>(compressedData.begin(), compressedData.begin() + length));
+            });
+        }
+
+        std::cout << std::format("{:<16} {}\n", name, modeFailures ? "FAIL" : "ok");
+        failures += modeFailures;
+    }
+    return failures ? 1 : 0;
+}
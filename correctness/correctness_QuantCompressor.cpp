@@ -0,0 +1,44 @@
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lib/QuantCompressor.hpp"
+#include "lib/utils.hpp"
+
+// Columns where every value quantizes to the same symbol, e.g. a constant or all-zero branch. The rANS table then holds
+// a single symbol with the whole probability, which must code to (almost) nothing rather than a word per value.
+// Checks the round trip and that the ratio is at least MIN_RATIO.
+
+constexpr double MIN_RATIO{1000};
+
+int main() {
+    const size_t size{1000000};
+    const std::vector<std::pair<std::string, std::vector<float>>> columns{
+        {"zeros", std::vector<float>(size, 0.0f)},
+        {"constant", std::vector<float>(size, 3.25f)},
+        {"negative", std::vector<float>(size, -1.0e6f)}
+    };
+
+    int failures{0};
+    for (const auto& [name, data] : columns) {
+        for (const int mode : {QuantCompressor::ABS, QuantCompressor::REL}) {
+            for (const int precision : {1, 3, 7}) {
+                QuantCompressor compressor(precision, mode);
+                const std::vector<uint8_t> compressedData{compressor.compress(data)};
+                const std::vector<float> decompressedData{compressor.decompress(compressedData, data.size())};
+                const double ratio{static_cast<double>(data.size() * sizeof(float)) / static_cast<double>(compressedData.size())};
+                const bool ok{decompressedData == data && ratio >= MIN_RATIO};
+                failures += !ok;
+
+                std::cout << std::format("{:<10} {} precision {}: {:>8} bytes, ratio {:>10.1f}  {}\n",
+                                            name, mode == QuantCompressor::ABS ? "ABS" : "REL", precision,
+                                            compressedData.size(), ratio, ok ? "ok" : "FAIL");
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,550 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lib/BooleanCompressor.hpp"
+#include "lib/CodecChain.hpp"
+#include "lib/ErrorBound.hpp"
+#include "lib/IntegerCompressor.hpp"
+#include "lib/Philox.hpp"
+#include "lib/QuantCompressor.hpp"
+#include "lib/SZCompressor.hpp"
+#include "lib/TrunkCompressor.hpp"
+#include "lib/utils.hpp"
+
+// Randomized round-trip verification: streams generated and real data through every codec on all threads, and checks
+// that lossless codecs are bit-exact and lossy codecs stay within their per-value error bound.
+// Float codecs are chain specs (see CodecChain.hpp); integer and boolean codecs are int:mode and bool:mode, as in archives.
+struct VerifyParams {
+    std::vector<std::string> codecs;
+    std::vector<std::string> datasets;
+    std::string sourceFile;
+    std::string treeName;
+    std::vector<std::string> branches;
+
+    double totalMB;
+    double maxChunkKB;
+    int threads;
+    int seed;
+    int maxFailures;
+
+    bool debug;
+};
+
+VerifyParams parseVerifyArguments(int argc, char* argv[]) {
+    // Set default parameters
+    VerifyParams params;
+
+    params.codecs = {"trunk:1", "trunk:3", "trunk:5", "trunk:7", "truncate:3|shuffle|zstd:3", "shuffle|delta|zlib:6", "zstd:1",
+                     "quant:3:0", "quant:3:1", "quant:6:1", "sz:3", "sz:5",
+                     "int:0", "int:1", "int:2", "bool:0", "bool:1"};
+    params.datasets = {};
+    params.sourceFile = "";
+    params.treeName = "mini";
+    params.branches = {};
+
+    params.totalMB = 64;
+    params.maxChunkKB = 1000;
+    params.threads = 0;
+    params.seed = 12345;
+    params.maxFailures = 10;
+
+    params.debug = false;
+
+    // Read parameters
+    for (int i{1}; i < argc; ++i) {
+        std::string arg{argv[i]};
+        if (arg == "--codecs") {
+            params.codecs = splitList(argv[++i]);
+        } else if (arg == "--datasets") {
+            params.datasets = splitList(argv[++i]);
+        } else if (arg == "--sourceFile") {
+            params.sourceFile = argv[++i];
+        } else if (arg == "--treeName") {
+            params.treeName = argv[++i];
+        } else if (arg == "--branches") {
+            params.branches = splitList(argv[++i]);
+        } else if (arg == "--totalMB") {
+            params.totalMB = std::stod(argv[++i]);
+        } else if (arg == "--maxChunkKB") {
+            params.maxChunkKB = std::stod(argv[++i]);
+        } else if (arg == "--threads") {
+            params.threads = std::stoi(argv[++i]);
+        } else if (arg == "--seed") {
+            params.seed = std::stoi(argv[++i]);
+        } else if (arg == "--maxFailures") {
+            params.maxFailures = std::stoi(argv[++i]);
+        } else if (arg == "--debug") {
+            params.debug = std::stoi(argv[++i]);
+        } else {
+            throw std::invalid_argument("Unknown argument: " + arg);
+        }
+    }
+
+    if (params.totalMB <= 0) {
+        throw std::invalid_argument("totalMB must be greater than 0");
+    }
+    if (params.maxChunkKB <= 0) {
+        throw std::invalid_argument("maxChunkKB must be greater than 0");
+    }
+    if (params.threads <= 0) {
+        params.threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    if (!params.sourceFile.empty() && params.branches.empty()) {
+        throw std::invalid_argument("--sourceFile needs --branches");
+    }
+
+    return params;
+}
+
+// Datasets --------------------------------------------------------------------------------------------------------
+// Each chunk is generated from (seed, chunk index) alone, so a failure can be reproduced with the same seed.
+
+template <typename T>
+struct Dataset {
+    std::string name;
+    std::function<std::vector<T>(size_t size, int seed)> generate;
+    bool nonFinite{false};          // Contains NaN or Inf
+    bool extremeRange{false};       // Value range overflows float, e.g. -FLT_MAX and FLT_MAX in one chunk
+};
+
+float bitsToFloat(uint32_t bits) {
+    return std::bit_cast<float>(bits);
+}
+
+// Values that stress float codecs: signed zeros, denormals, the smallest normals, values at and just below FLT_MAX, and
+// random finite bit patterns, mixed with ordinary values. With nonFinite, Inf and NaNs with assorted payloads are added,
+// including payloads that live only in the low mantissa bits, which a truncating codec must not turn into Inf.
+std::vector<float> generateEdgeData(size_t size, int seed, bool nonFinite) {
+    std::vector<float> data(size);
+    Philox4x32 rng(seed);
+    const uint32_t categories{nonFinite ? 11u : 8u};
+
+    for (size_t i{0}; i < size; ++i) {
+        const Philox4x32::Counter words{rng(i)};
+        const uint32_t sign{words[2] & 0x80000000u};
+        uint32_t bits{};
+        switch (words[0] % categories) {
+            case 0:     // Signed zero
+                bits = sign;
+                break;
+            case 1:     // Denormal
+                bits = sign | (words[1] & 0x007FFFFFu);
+                break;
+            case 2:     // Smallest denormal and smallest normal
+                bits = sign | (words[1] & 1u ? 0x00000001u : 0x00800000u);
+                break;
+            case 3:     // Within 2^16 ULP of FLT_MAX, where rounding up overflows
+                bits = sign | (0x7F7FFFFFu - (words[1] & 0xFFFFu));
+                break;
+            case 4:     // FLT_MAX
+                bits = sign | 0x7F7FFFFFu;
+                break;
+            case 5:     // Any finite value
+                bits = sign | (words[1] % 0x7F800000u);
+                break;
+            case 8:     // Inf
+                bits = sign | 0x7F800000u;
+                break;
+            case 9:     // NaN with a random payload, never zero
+                bits = sign | 0x7F800000u | std::max(1u, words[1] & 0x007FFFFFu);
+                break;
+            case 10:    // NaN with a payload only in the lowest bits
+                bits = sign | 0x7F800000u | (1u + (words[1] & 0xFFu));
+                break;
+            default:    // Ordinary values over a few decades
+                data[i] = std::ldexp(Philox4x32::toUniform(words[1]) - 0.5f, static_cast<int>(words[3] % 40) - 20);
+                continue;
+        }
+        data[i] = bitsToFloat(bits);
+    }
+
+    return data;
+}
+
+// Random 32-bit patterns, about 1 in 256 of which are NaN or Inf
+std::vector<float> generateBitPatternData(size_t size, int seed) {
+    std::vector<float> data(size);
+    Philox4x32 rng(seed);
+    for (size_t i{0}; i < size; ++i) {
+        data[i] = bitsToFloat(rng(i)[0]);
+    }
+    return data;
+}
+
+// A random slice of a branch read once from the source file
+template <typename T>
+std::vector<T> sliceData(const std::vector<T>& source, size_t size, int seed) {
+    size = std::min(size, source.size());
+    const size_t offset{Philox4x32(seed)(0)[0] % (source.size() - size + 1)};
+    return std::vector<T>(source.begin() + offset, source.begin() + offset + size);
+}
+
+std::vector<Dataset<float>> floatDatasets(const VerifyParams& params) {
+    std::vector<Dataset<float>> datasets{
+        {"uniform", [](size_t size, int seed) { return generateUniformRandomData(size, -1.0f, 1.0f, seed, 1); }},
+        {"gaussian", [](size_t size, int seed) { return generateGaussianRandomData(size, 0.0f, 1.0f, seed, 1); }},
+        {"pt", [](size_t size, int seed) { return generateExponentialPtData(size, 25.0f, 30.0f, seed, 1); }},
+        {"jagged", [](size_t size, int seed) { return generateJaggedPtData(size, 4.0f, 25.0f, 30.0f, seed, 1); }},
+        {"pareto", [](size_t size, int seed) { return generateParetoData(size, 1.0f, 1.5f, seed, 1); }},
+        {"edge", [](size_t size, int seed) { return generateEdgeData(size, seed, false); }, false, true},
+        {"special", [](size_t size, int seed) { return generateEdgeData(size, seed, true); }, true, true},
+        {"bits", [](size_t size, int seed) { return generateBitPatternData(size, seed); }, true, true},
+    };
+
+    for (const std::string& branch : params.branches) {
+        if (isFloatBranch(branch)) {
+            std::shared_ptr<std::vector<float>> source{std::make_shared<std::vector<float>>(
+                readRootFile(0, params.sourceFile, params.treeName, branch, params.debug))};
+            datasets.push_back({"root:" + branch, [source](size_t size, int seed) { return sliceData(*source, size, seed); }});
+        }
+    }
+    return datasets;
+}
+
+std::vector<Dataset<uint32_t>> uint32Datasets(const VerifyParams& params) {
+    std::vector<Dataset<uint32_t>> datasets{
+        {"uniform", [](size_t size, int seed) {
+            std::vector<uint32_t> data(size);
+            Philox4x32 rng(seed);
+            for (size_t i{0}; i < size; ++i) {
+                data[i] = rng(i)[0];
+            }
+            return data;
+        }},
+        // Small per-event counts, like jet_n
+        {"counts", [](size_t size, int seed) {
+            std::vector<uint32_t> data(size);
+            Philox4x32 rng(seed);
+            for (size_t i{0}; i < size; ++i) {
+                data[i] = std::popcount(rng(i)[0] & 0x3FFu);
+            }
+            return data;
+        }},
+        // Increasing identifiers with random gaps, wrapping around 2^32
+        {"sorted", [](size_t size, int seed) {
+            std::vector<uint32_t> data(size);
+            Philox4x32 rng(seed);
+            uint32_t value{0xFFFFF000u};
+            for (size_t i{0}; i < size; ++i) {
+                value += rng(i)[0] % 64;
+                data[i] = value;
+            }
+            return data;
+        }},
+        // Extremes, so every delta wraps
+        {"edge", [](size_t size, int seed) {
+            std::vector<uint32_t> data(size);
+            Philox4x32 rng(seed);
+            constexpr uint32_t extremes[]{0u, 1u, 0x7FFFFFFFu, 0x80000000u, 0xFFFFFFFEu, 0xFFFFFFFFu};
+            for (size_t i{0}; i < size; ++i) {
+                data[i] = extremes[rng(i)[0] % std::size(extremes)];
+            }
+            return data;
+        }},
+    };
+
+    for (const std::string& branch : params.branches) {
+        if (isUInt32Branch(branch)) {
+            std::shared_ptr<std::vector<uint32_t>> source{std::make_shared<std::vector<uint32_t>>(
+                readRootFileUInt32(params.sourceFile, params.treeName, branch, params.debug))};
+            datasets.push_back({"root:" + branch, [source](size_t size, int seed) { return sliceData(*source, size, seed); }});
+        }
+    }
+    return datasets;
+}
+
+std::vector<Dataset<uint8_t>> boolDatasets(const VerifyParams& params) {
+    std::vector<Dataset<uint8_t>> datasets{
+        {"random", [](size_t size, int seed) {
+            std::vector<uint8_t> data(size);
+            Philox4x32 rng(seed);
+            for (size_t i{0}; i < size; ++i) {
+                data[i] = rng(i)[0] & 1u;
+            }
+            return data;
+        }},
+        // Runs of up to 2^16, longer than a varint byte
+        {"runs", [](size_t size, int seed) {
+            std::vector<uint8_t> data(size);
+            Philox4x32 rng(seed);
+            uint8_t value{0};
+            for (size_t i{0}, run{0}; i < size; ++i) {
+                if (!run) {
+                    run = 1 + rng(i)[0] % 65536;
+                    value = !value;
+                }
+                data[i] = value;
+                --run;
+            }
+            return data;
+        }},
+        // Any byte; every non-zero byte reads back as 1
+        {"bytes", [](size_t size, int seed) {
+            std::vector<uint8_t> data(size);
+            Philox4x32 rng(seed);
+            for (size_t i{0}; i < size; ++i) {
+                data[i] = static_cast<uint8_t>(rng(i)[0]);
+            }
+            return data;
+        }},
+    };
+
+    for (const std::string& branch : params.branches) {
+        if (isBoolBranch(branch)) {
+            std::shared_ptr<std::vector<uint8_t>> source{std::make_shared<std::vector<uint8_t>>(
+                readRootFileBool(params.sourceFile, params.treeName, branch, params.debug))};
+            datasets.push_back({"root:" + branch, [source](size_t size, int seed) { return sliceData(*source, size, seed); }});
+        }
+    }
+    return datasets;
+}
+
+// Checks ----------------------------------------------------------------------------------------------------------
+
+template <typename T>
+CheckResult checkExact(std::span<const T> input, std::span<const T> output) {
+    CheckResult result{};
+    for (size_t i{0}; i < input.size(); ++i) {
+        if (input[i] != output[i]) {
+            result.add(i, std::format("input {}, output {}", input[i], output[i]));
+        }
+    }
+    return result;
+}
+
+CheckResult checkBools(std::span<const uint8_t> input, std::span<const uint8_t> output) {
+    CheckResult result{};
+    for (size_t i{0}; i < input.size(); ++i) {
+        if (output[i] != (input[i] != 0)) {
+            result.add(i, std::format("input {}, output {}", input[i], output[i]));
+        }
+    }
+    return result;
+}
+
+// Running a job -----------------------------------------------------------------------------------------------------
+
+// Compresses input into compressed, then decompresses into output; built once per thread, since codecs keep state
+template <typename T>
+using RoundTrip = std::function<void(std::span<const T> input, std::vector<uint8_t>& compressed, std::span<T> output)>;
+
+template <typename T>
+using Check = std::function<CheckResult(std::span<const T> input, std::span<const T> output)>;
+
+struct JobResult {
+    size_t chunks{0};
+    size_t bytes{0};
+    size_t compressedBytes{0};
+    size_t failedChunks{0};
+    size_t mismatches{0};
+    double wallTime{0};             // ms, including data generation
+    double codecTime{0};            // ms, summed over threads
+    double checkTime{0};            // ms, summed over threads
+    std::vector<std::string> failures{};
+};
+
+// Chunk sizes in values: empty and tiny chunks first, then uniform up to the maximum, until totalMB is covered
+std::vector<size_t> chunkSizes(const VerifyParams& params, size_t valueSize) {
+    const size_t maxValues{std::max<size_t>(1, static_cast<size_t>(params.maxChunkKB * KB) / valueSize)};
+    const size_t totalBytes{static_cast<size_t>(params.totalMB * MB)};
+    constexpr uint32_t CHUNK_STREAM{1};
+    Philox4x32 rng(params.seed);
+
+    std::vector<size_t> sizes{0, 1, 3, 7};
+    size_t bytes{11 * valueSize};
+    while (bytes < totalBytes) {
+        sizes.push_back(1 + rng(sizes.size(), CHUNK_STREAM)[0] % maxValues);
+        bytes += sizes.back() * valueSize;
+    }
+    return sizes;
+}
+
+template <typename T>
+JobResult runJob(const VerifyParams& params, const Dataset<T>& dataset, std::function<RoundTrip<T>()> makeRoundTrip, Check<T> check) {
+    const std::vector<size_t> sizes{chunkSizes(params, sizeof(T))};
+    JobResult result{};
+    std::mutex resultMutex{};
+    std::atomic<size_t> nextChunk{0};
+
+    auto worker = [&]() {
+        RoundTrip<T> roundTrip{makeRoundTrip()};
+        std::vector<uint8_t> compressed{};
+        std::vector<T> output{};
+        JobResult local{};
+
+        for (size_t chunk{nextChunk++}; chunk < sizes.size(); chunk = nextChunk++) {
+            const std::vector<T> input{dataset.generate(sizes[chunk], params.seed + static_cast<int>(chunk))};
+            // Poison the output so values the codec never writes are caught
+            output.assign(input.size(), static_cast<T>(0x5A));
+
+            std::chrono::high_resolution_clock::time_point start{std::chrono::high_resolution_clock::now()};
+            CheckResult checked{};
+            try {
+                roundTrip(input, compressed, output);
+                local.codecTime += elapsedMs(start);
+                start = std::chrono::high_resolution_clock::now();
+                checked = check(input, output);
+                local.checkTime += elapsedMs(start);
+            }
+            catch (const std::exception& e) {
+                checked.add(0, std::format("exception: {}", e.what()));
+            }
+
+            ++local.chunks;
+            local.bytes += input.size() * sizeof(T);
+            local.compressedBytes += compressed.size();
+            if (checked.mismatches) {
+                ++local.failedChunks;
+                local.mismatches += checked.mismatches;
+                local.failures.push_back(std::format("chunk {} ({} values, seed {}): {} mismatches, first at {}",
+                                                        chunk, input.size(), params.seed + static_cast<int>(chunk), checked.mismatches, checked.first));
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        result.chunks += local.chunks;
+        result.bytes += local.bytes;
+        result.compressedBytes += local.compressedBytes;
+        result.failedChunks += local.failedChunks;
+        result.mismatches += local.mismatches;
+        result.codecTime += local.codecTime;
+        result.checkTime += local.checkTime;
+        result.failures.insert(result.failures.end(), local.failures.begin(), local.failures.end());
+    };
+
+    const std::chrono::high_resolution_clock::time_point start{std::chrono::high_resolution_clock::now()};
+    std::vector<std::thread> workers{};
+    for (int t{1}; t < params.threads; ++t) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+    result.wallTime = elapsedMs(start);
+
+    return result;
+}
+
+// Returns true if the job passed
+bool printJob(const VerifyParams& params, const std::string& codec, const std::string& dataset, const std::string& bound, const JobResult& result) {
+    const double mb{static_cast<double>(result.bytes) / MB};
+    std::cout << std::format("{:<28} {:<16} {:>6} chunks {:>9.1f} MB  ratio {:>6.2f}  {:>8.1f} MB/s  codec {:>8.1f} MB/s/thread  {:<6} {}\n",
+                                codec, dataset, result.chunks, mb,
+                                result.compressedBytes ? static_cast<double>(result.bytes) / static_cast<double>(result.compressedBytes) : 0.0,
+                                result.wallTime > 0 ? mb / (result.wallTime / 1000) : 0.0,
+                                result.codecTime > 0 ? mb / (result.codecTime / 1000) : 0.0,
+                                result.failedChunks ? "FAIL" : "ok", bound);
+
+    for (size_t i{0}; i < result.failures.size() && static_cast<int>(i) < params.maxFailures; ++i) {
+        std::cout << "    " << result.failures[i] << "\n";
+    }
+    if (static_cast<int>(result.failures.size()) > params.maxFailures) {
+        std::cout << std::format("    ... {} more failed chunks\n", result.failures.size() - params.maxFailures);
+    }
+    return !result.failedChunks;
+}
+
+bool selected(const VerifyParams& params, const std::string& dataset) {
+    return params.datasets.empty() || std::find(params.datasets.begin(), params.datasets.end(), dataset) != params.datasets.end();
+}
+
+int main(int argc, char* argv[]) {
+    VerifyParams params{parseVerifyArguments(argc, argv)};
+
+    std::cout << std::format("Threads: {}\n", params.threads);
+    std::cout << std::format("Data per codec and dataset: {} MB in chunks of up to {} KB\n", params.totalMB, params.maxChunkKB);
+    std::cout << std::format("Seed: {}\n", params.seed);
+
+    const std::vector<Dataset<float>> floats{floatDatasets(params)};
+    const std::vector<Dataset<uint32_t>> uint32s{uint32Datasets(params)};
+    const std::vector<Dataset<uint8_t>> bools{boolDatasets(params)};
+
+    size_t failedJobs{0};
+    size_t jobs{0};
+    double totalBytes{0};
+    const std::chrono::high_resolution_clock::time_point start{std::chrono::high_resolution_clock::now()};
+
+    for (const std::string& codec : params.codecs) {
+        if (codec.starts_with("int:")) {
+            const int mode{std::stoi(codec.substr(4))};
+            for (const Dataset<uint32_t>& dataset : uint32s) {
+                if (!selected(params, dataset.name)) {
+                    continue;
+                }
+                JobResult result{runJob<uint32_t>(params, dataset, [&]() -> RoundTrip<uint32_t> {
+                    std::shared_ptr<IntegerCompressor> compressor{std::make_shared<IntegerCompressor>(mode, params.debug)};
+                    return [compressor](std::span<const uint32_t> input, std::vector<uint8_t>& compressed, std::span<uint32_t> output) {
+                        compressor->compressInto(input, compressed);
+                        compressor->decompressInto(compressed, output);
+                    };
+                }, checkExact<uint32_t>)};
+                failedJobs += !printJob(params, codec, dataset.name, "bit-exact", result);
+                totalBytes += static_cast<double>(result.bytes);
+                ++jobs;
+            }
+        }
+        else if (codec.starts_with("bool:")) {
+            const int mode{std::stoi(codec.substr(5))};
+            for (const Dataset<uint8_t>& dataset : bools) {
+                if (!selected(params, dataset.name)) {
+                    continue;
+                }
+                JobResult result{runJob<uint8_t>(params, dataset, [&]() -> RoundTrip<uint8_t> {
+                    std::shared_ptr<BooleanCompressor> compressor{std::make_shared<BooleanCompressor>(mode, params.debug)};
+                    return [compressor](std::span<const uint8_t> input, std::vector<uint8_t>& compressed, std::span<uint8_t> output) {
+                        compressor->compressInto(input, compressed);
+                        compressor->decompressInto(compressed, output);
+                    };
+                }, checkBools)};
+                failedJobs += !printJob(params, codec, dataset.name, "non-zero as 1", result);
+                totalBytes += static_cast<double>(result.bytes);
+                ++jobs;
+            }
+        }
+        else {
+            const ErrorBound bound{chainErrorBound(codec)};
+            const ChainCompressor prototype(codec, params.debug);
+            for (const Dataset<float>& dataset : floats) {
+                if (!selected(params, dataset.name)) {
+                    continue;
+                }
+                if (bound.finiteOnly && (dataset.nonFinite || dataset.extremeRange)) {
+                    std::cout << std::format("{:<28} {:<16} skipped: codec needs finite values and a finite value range\n", codec, dataset.name);
+                    continue;
+                }
+                JobResult result{runJob<float>(params, dataset, [&]() -> RoundTrip<float> {
+                    std::shared_ptr<MyCompressor> compressor{prototype.clone()};
+                    return [compressor](std::span<const float> input, std::vector<uint8_t>& compressed, std::span<float> output) {
+                        compressor->compressInto(input, compressed);
+                        compressor->decompressInto(compressed, output);
+                    };
+                }, [&bound](std::span<const float> input, std::span<const float> output) { return checkFloats(bound, input, output); })};
+                failedJobs += !printJob(params, codec, dataset.name, bound.description, result);
+                totalBytes += static_cast<double>(result.bytes);
+                ++jobs;
+            }
+        }
+    }
+
+    const double totalTime{elapsedMs(start)};
+    std::cout << std::format("Verified {:.1f} MB in {:.1f} s ({:.1f} MB/s), {} of {} codec and dataset pairs failed\n",
+                                totalBytes / MB, totalTime / 1000, totalTime > 0 ? totalBytes / MB / (totalTime / 1000) : 0.0, failedJobs, jobs);
+
+    return failedJobs ? 1 : 0;
+}
@@ -0,0 +1,454 @@
+#ifndef ARCHIVE_HPP
+#define ARCHIVE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BooleanCompressor.hpp"
+#include "CodecChain.hpp"
+#include "IntegerCompressor.hpp"
+#include "MyCompressor.hpp"
+#include "QuantCompressor.hpp"
+#include "SZCompressor.hpp"
+#include "TrunkCompressor.hpp"
+
+// Standalone columnar archive: one compressed column per branch, split into independently decodable blocks
+// Layout is [magic][blocks of every column][footer][uint64 footer size][magic]. The footer lists each column's name,
+// type, codec spec, value count and the offset, size and value count of its blocks, so a reader can map the file and
+// decode any column, or any block of it, without touching the rest.
+// Codec specs are colon-separated, with the arguments of the matching constructor:
+//   trunk:<precision>:<compressionLevel>
+//   sz:<precision>:<errorBoundMode>:<algo>:<interpAlgo>
+//   quant:<precision>:<errorBoundMode>
+//   int:<mode>            (IntegerCompressor, uint32 columns)
+//   bool:<mode>           (BooleanCompressor, bool columns stored one byte per value)
+
+constexpr char ARCHIVE_MAGIC[8]{'C', '2', 'P', '2', 'A', 'R', 'C', '1'};
+
+// Largest uncompressed block. Some codecs (RLE, rANS on a single symbol) have no fixed maximum ratio, so a block's byte
+// size cannot bound its value count; this cap does, and lets readers reject a corrupt footer before allocating for it.
+constexpr uint64_t ARCHIVE_MAX_BLOCK_SIZE{1ull << 28};
+
+struct ArchiveBlock {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t numValues;
+};
+
+struct ArchiveColumn {
+    enum DATATYPE{FLOAT, UINT32, BOOL};
+
+    std::string name;
+    int dataType;
+    std::string codec;
+    uint64_t numValues;
+    std::vector<ArchiveBlock> blocks;
+
+    uint64_t compressedSize() const {
+        uint64_t size{0};
+        for (const ArchiveBlock& block : blocks) {
+            size += block.size;
+        }
+        return size;
+    }
+
+    uint64_t uncompressedSize() const {
+        return numValues * (dataType == BOOL ? sizeof(uint8_t) : sizeof(float));
+    }
+};
+
+// Split a codec spec into its name and integer arguments
+std::pair<std::string, std::vector<int>> parseCodecSpec(const std::string& spec) {
+    std::istringstream iss(spec);
+    std::string name;
+    std::getline(iss, name, ':');
+
+    std::vector<int> arguments{};
+    std::string argument;
+    while (std::getline(iss, argument, ':')) {
+        arguments.push_back(std::stoi(argument));
+    }
+    return {name, arguments};
+}
+
+// Float compressor for a codec spec, which can be any codec chain. A chain of just trunk, sz or quant writes the same
+// bytes as that compressor alone, so single-codec columns read the same as before chains existed.
+std::unique_ptr<MyCompressor> makeFloatCodec(const std::string& spec) {
+    return std::make_unique<ChainCompressor>(spec);
+}
+
+int codecMode(const std::string& spec, const std::string& expectedName) {
+    auto [name, arguments] = parseCodecSpec(spec);
+    if (name != expectedName || arguments.size() != 1) {
+        throw std::invalid_argument(std::format("Invalid {} codec: {}", expectedName, spec));
+    }
+    return arguments[0];
+}
+
+class ArchiveWriter {
+    public:
+        ArchiveWriter(const std::string& filename, const size_t blockSize=DEFAULT_BLOCK_SIZE)
+            : _file(filename, std::ios::binary), _filename(filename), _blockSize(blockSize)
+        {
+            if (!_file.is_open()) {
+                throw std::runtime_error("Could not open file: " + filename);
+            }
+            if (blockSize == 0 || blockSize > ARCHIVE_MAX_BLOCK_SIZE) {
+                throw std::invalid_argument(std::format("block size must be between 1 and {} bytes", ARCHIVE_MAX_BLOCK_SIZE));
+            }
+            _write(ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+        }
+
+        ~ArchiveWriter() {
+            if (!_closed) {
+                try {
+                    close();
+                }
+                catch (...) {
+                    // Destructors must not throw; call close() to see errors
+                }
+            }
+        }
+
+        ArchiveWriter(const ArchiveWriter&) = delete;
+        ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+        void addFloatColumn(const std::string& name, std::span<const float> data, const std::string& codec) {
+            std::unique_ptr<MyCompressor> compressor{makeFloatCodec(codec)};
+            _addColumn<float>(name, ArchiveColumn::FLOAT, codec, data, [&](std::span<const float> block) {
+                compressor->compressInto(block, _buffer);
+            });
+        }
+
+        void addUInt32Column(const std::string& name, std::span<const uint32_t> data, const std::string& codec) {
+            IntegerCompressor compressor(codecMode(codec, "int"));
+            _addColumn<uint32_t>(name, ArchiveColumn::UINT32, codec, data, [&](std::span<const uint32_t> block) {
+                compressor.compressInto(block, _buffer);
+            });
+        }
+
+        void addBoolColumn(const std::string& name, std::span<const uint8_t> data, const std::string& codec) {
+            BooleanCompressor compressor(codecMode(codec, "bool"));
+            _addColumn<uint8_t>(name, ArchiveColumn::BOOL, codec, data, [&](std::span<const uint8_t> block) {
+                compressor.compressInto(block, _buffer);
+            });
+        }
+
+        // Write the footer; no columns can be added afterwards
+        void close() {
+            if (_closed) {
+                return;
+            }
+            _closed = true;
+
+            std::vector<uint8_t> footer{};
+            _appendValue(footer, static_cast<uint64_t>(_columns.size()));
+            for (const ArchiveColumn& column : _columns) {
+                _appendString(footer, column.name);
+                _appendValue(footer, static_cast<uint8_t>(column.dataType));
+                _appendString(footer, column.codec);
+                _appendValue(footer, column.numValues);
+                _appendValue(footer, static_cast<uint64_t>(column.blocks.size()));
+                for (const ArchiveBlock& block : column.blocks) {
+                    _appendValue(footer, block.offset);
+                    _appendValue(footer, block.size);
+                    _appendValue(footer, block.numValues);
+                }
+            }
+
+            _write(footer.data(), footer.size());
+            const uint64_t footerSize{footer.size()};
+            _write(&footerSize, sizeof(footerSize));
+            _write(ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+
+            _file.close();
+            if (!_file) {
+                throw std::runtime_error("Could not write file: " + _filename);
+            }
+        }
+
+        const std::vector<ArchiveColumn>& getColumns() const { return _columns; }
+
+    private:
+        static constexpr size_t DEFAULT_BLOCK_SIZE{1'000'000};
+
+        std::ofstream _file;
+        std::string _filename;
+        size_t _blockSize;      // bytes of uncompressed data per block
+        uint64_t _position{0};
+        bool _closed{false};
+
+        std::vector<ArchiveColumn> _columns{};
+        std::vector<uint8_t> _buffer{};
+
+        template <typename T, typename Compress>
+        void _addColumn(const std::string& name, int dataType, const std::string& codec, std::span<const T> data, Compress compress) {
+            if (_closed) {
+                throw std::runtime_error("ArchiveWriter: archive is already closed");
+            }
+            for (const ArchiveColumn& column : _columns) {
+                if (column.name == name) {
+                    throw std::invalid_argument("ArchiveWriter: duplicate column " + name);
+                }
+            }
+
+            ArchiveColumn column{name, dataType, codec, data.size(), {}};
+            const size_t blockValues{std::max<size_t>(1, _blockSize / sizeof(T))};
+            for (size_t start{0}; start < data.size(); start += blockValues) {
+                const size_t count{std::min(blockValues, data.size() - start)};
+                compress(data.subspan(start, count));
+                column.blocks.push_back({_position, _buffer.size(), count});
+                _write(_buffer.data(), _buffer.size());
+            }
+            _columns.push_back(std::move(column));
+        }
+
+        void _write(const void* data, size_t size) {
+            _file.write(static_cast<const char*>(data), size);
+            if (!_file) {
+                throw std::runtime_error("Could not write file: " + _filename);
+            }
+            _position += size;
+        }
+
+        template <typename T>
+        static void _appendValue(std::vector<uint8_t>& buffer, T value) {
+            const uint8_t* bytes{reinterpret_cast<const uint8_t*>(&value)};
+            buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+        }
+
+        static void _appendString(std::vector<uint8_t>& buffer, const std::string& value) {
+            _appendValue(buffer, static_cast<uint32_t>(value.size()));
+            buffer.insert(buffer.end(), value.begin(), value.end());
+        }
+};
+
+// Maps an archive read-only and decodes columns on demand
+class ArchiveReader {
+    public:
+        ArchiveReader(const std::string& filename) : _filename(filename) {
+            _fd = open(filename.c_str(), O_RDONLY);
+            if (_fd < 0) {
+                throw std::runtime_error("Could not open file: " + filename);
+            }
+
+            struct stat status;
+            if (fstat(_fd, &status) != 0) {
+                ::close(_fd);
+                throw std::runtime_error("Could not stat file: " + filename);
+            }
+            _size = static_cast<size_t>(status.st_size);
+            _fileId = std::hash<std::string>{}(std::format("{}:{}:{}:{}.{}", status.st_dev, status.st_ino, status.st_size,
+                                                            status.st_mtim.tv_sec, status.st_mtim.tv_nsec));
+
+            if (_size > 0) {
+                void* mapped{mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0)};
+                if (mapped == MAP_FAILED) {
+                    ::close(_fd);
+                    throw std::runtime_error("Could not map file: " + filename);
+                }
+                _data = static_cast<const uint8_t*>(mapped);
+            }
+
+            try {
+                _readFooter();
+            }
+            catch (...) {
+                _unmap();
+                throw;
+            }
+        }
+
+        ~ArchiveReader() {
+            _unmap();
+        }
+
+        ArchiveReader(const ArchiveReader&) = delete;
+        ArchiveReader& operator=(const ArchiveReader&) = delete;
+
+        const std::vector<ArchiveColumn>& getColumns() const { return _columns; }
+        size_t getFileSize() const { return _size; }
+
+        // Same for every reader of the same file, and different once the file is rewritten, so caches shared between
+        // readers can key blocks on it
+        uint64_t getFileId() const { return _fileId; }
+
+        const ArchiveColumn& getColumn(const std::string& name) const {
+            for (const ArchiveColumn& column : _columns) {
+                if (column.name == name) {
+                    return column;
+                }
+            }
+            throw std::invalid_argument("ArchiveReader: no column " + name);
+        }
+
+        // Compressed bytes of one block, straight from the mapping
+        std::span<const uint8_t> getBlockData(const ArchiveBlock& block) const {
+            return {_data + block.offset, block.size};
+        }
+
+        std::vector<float> readFloatColumn(const std::string& name) const {
+            const ArchiveColumn& column{_getColumn(name, ArchiveColumn::FLOAT)};
+            std::unique_ptr<MyCompressor> compressor{makeFloatCodec(column.codec)};
+            std::vector<float> data(column.numValues);
+            _decodeBlocks<float>(column, data, [&](std::span<const uint8_t> block, std::span<float> output) {
+                compressor->decompressInto(block, output);
+            });
+            return data;
+        }
+
+        std::vector<uint32_t> readUInt32Column(const std::string& name) const {
+            const ArchiveColumn& column{_getColumn(name, ArchiveColumn::UINT32)};
+            IntegerCompressor compressor(codecMode(column.codec, "int"));
+            std::vector<uint32_t> data(column.numValues);
+            _decodeBlocks<uint32_t>(column, data, [&](std::span<const uint8_t> block, std::span<uint32_t> output) {
+                compressor.decompressInto(block, output);
+            });
+            return data;
+        }
+
+        std::vector<uint8_t> readBoolColumn(const std::string& name) const {
+            const ArchiveColumn& column{_getColumn(name, ArchiveColumn::BOOL)};
+            BooleanCompressor compressor(codecMode(column.codec, "bool"));
+            std::vector<uint8_t> data(column.numValues);
+            _decodeBlocks<uint8_t>(column, data, [&](std::span<const uint8_t> block, std::span<uint8_t> output) {
+                compressor.decompressInto(block, output);
+            });
+            return data;
+        }
+
+    private:
+        std::string _filename;
+        int _fd{-1};
+        size_t _size{0};
+        uint64_t _fileId{0};
+        const uint8_t* _data{nullptr};
+
+        std::vector<ArchiveColumn> _columns{};
+
+        void _unmap() {
+            if (_data) {
+                munmap(const_cast<uint8_t*>(_data), _size);
+                _data = nullptr;
+            }
+            if (_fd >= 0) {
+                ::close(_fd);
+                _fd = -1;
+            }
+        }
+
+        const ArchiveColumn& _getColumn(const std::string& name, int dataType) const {
+            const ArchiveColumn& column{getColumn(name)};
+            if (column.dataType != dataType) {
+                throw std::invalid_argument("ArchiveReader: column " + name + " has a different type");
+            }
+            return column;
+        }
+
+        template <typename T, typename Decompress>
+        void _decodeBlocks(const ArchiveColumn& column, std::span<T> data, Decompress decompress) const {
+            size_t position{0};
+            for (const ArchiveBlock& block : column.blocks) {
+                decompress(getBlockData(block), data.subspan(position, block.numValues));
+                position += block.numValues;
+            }
+        }
+
+        void _readFooter() {
+            const size_t trailerSize{sizeof(uint64_t) + sizeof(ARCHIVE_MAGIC)};
+            if (_size < sizeof(ARCHIVE_MAGIC) + trailerSize
+                    || std::memcmp(_data, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0
+                    || std::memcmp(_data + _size - sizeof(ARCHIVE_MAGIC), ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0) {
+                throw std::runtime_error("Not an archive: " + _filename);
+            }
+
+            uint64_t footerSize;
+            std::memcpy(&footerSize, _data + _size - trailerSize, sizeof(footerSize));
+            if (footerSize > _size - sizeof(ARCHIVE_MAGIC) - trailerSize) {
+                throw std::runtime_error("ArchiveReader: invalid footer size in " + _filename);
+            }
+
+            const size_t footerStart{_size - trailerSize - footerSize};
+            std::span<const uint8_t> footer{_data + footerStart, footerSize};
+            size_t position{0};
+
+            const uint64_t numColumns{_readValue<uint64_t>(footer, position)};
+            for (uint64_t i{0}; i < numColumns; ++i) {
+                ArchiveColumn column{};
+                column.name = _readString(footer, position);
+                column.dataType = _readValue<uint8_t>(footer, position);
+                column.codec = _readString(footer, position);
+                column.numValues = _readValue<uint64_t>(footer, position);
+                if (column.dataType > ArchiveColumn::BOOL) {
+                    throw std::runtime_error("ArchiveReader: invalid column " + column.name + " in " + _filename);
+                }
+
+                // Value counts size the readers' allocations, so check them before any reader trusts them: every block
+                // holds at most ARCHIVE_MAX_BLOCK_SIZE bytes and a non-empty block has compressed bytes, and the block
+                // count is bounded by the footer, which is bounded by the file size
+                const uint64_t numBlocks{_readValue<uint64_t>(footer, position)};
+                if (numBlocks > (footer.size() - position) / (3 * sizeof(uint64_t))) {
+                    throw std::runtime_error("ArchiveReader: footer is truncated");
+                }
+                const uint64_t maxBlockValues{ARCHIVE_MAX_BLOCK_SIZE / (column.dataType == ArchiveColumn::BOOL ? sizeof(uint8_t) : sizeof(float))};
+                uint64_t blockValues{0};
+                for (uint64_t b{0}; b < numBlocks; ++b) {
+                    ArchiveBlock block{};
+                    block.offset = _readValue<uint64_t>(footer, position);
+                    block.size = _readValue<uint64_t>(footer, position);
+                    block.numValues = _readValue<uint64_t>(footer, position);
+                    if (block.offset < sizeof(ARCHIVE_MAGIC) || block.offset > footerStart || block.size > footerStart - block.offset) {
+                        throw std::runtime_error("ArchiveReader: block outside the data section in " + _filename);
+                    }
+                    if (block.numValues > maxBlockValues || (block.numValues && !block.size)) {
+                        throw std::runtime_error("ArchiveReader: invalid block value count in column " + column.name + " in " + _filename);
+                    }
+                    blockValues += block.numValues;
+                    column.blocks.push_back(block);
+                }
+                if (blockValues != column.numValues) {
+                    throw std::runtime_error("ArchiveReader: invalid column " + column.name + " in " + _filename);
+                }
+
+                _columns.push_back(std::move(column));
+            }
+        }
+
+        template <typename T>
+        static T _readValue(std::span<const uint8_t> buffer, size_t& position) {
+            if (position + sizeof(T) > buffer.size()) {
+                throw std::runtime_error("ArchiveReader: footer is truncated");
+            }
+            T value;
+            std::memcpy(&value, buffer.data() + position, sizeof(T));
+            position += sizeof(T);
+            return value;
+        }
+
+        static std::string _readString(std::span<const uint8_t> buffer, size_t& position) {
+            const uint32_t size{_readValue<uint32_t>(buffer, position)};
+            if (size > buffer.size() - position) {
+                throw std::runtime_error("ArchiveReader: footer is truncated");
+            }
+            std::string value(reinterpret_cast<const char*>(buffer.data() + position), size);
+            position += size;
+            return value;
+        }
+};
+
+#endif
@@ -0,0 +1,376 @@
+#ifndef ASYNC_COMPRESSOR_HPP
+#define ASYNC_COMPRESSOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "MyCompressor.hpp"
+#include "utils.hpp"
+
+// Fixed pool of workers, each with its own task deque. A worker runs its own tasks oldest first and, when it runs out,
+// steals the newest task of another worker. Tasks submitted from a worker go to that worker's deque, so follow-up work
+// stays on the core that has the data in cache; tasks from other threads are spread round-robin.
+class WorkStealingExecutor {
+    public:
+        using Task = std::function<void(int worker)>;
+
+        explicit WorkStealingExecutor(int threads=0) {
+            if (threads <= 0) {
+                threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+            }
+            for (int t{0}; t < threads; ++t) {
+                _queues.push_back(std::make_unique<Queue>());
+            }
+            for (int t{0}; t < threads; ++t) {
+                _workers.emplace_back([this, t] { _run(t); });
+            }
+        }
+
+        // Runs every task already submitted, then joins the workers
+        ~WorkStealingExecutor() {
+            {
+                std::lock_guard<std::mutex> lock(_sleepMutex);
+                _stop = true;
+            }
+            _wake.notify_all();
+            for (std::thread& worker : _workers) {
+                worker.join();
+            }
+        }
+
+        WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+        WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+        void submit(Task task) {
+            const int worker{_currentExecutor == this ? _currentWorker
+                             : static_cast<int>(_next.fetch_add(1, std::memory_order_relaxed) % _queues.size())};
+            {
+                std::lock_guard<std::mutex> lock(_queues[worker]->mutex);
+                _queues[worker]->tasks.push_back(std::move(task));
+            }
+            {
+                std::lock_guard<std::mutex> lock(_sleepMutex);
+                ++_pending;
+            }
+            _wake.notify_one();
+        }
+
+        int getThreads() const { return static_cast<int>(_workers.size()); }
+        size_t getSteals() const { return _steals.load(std::memory_order_relaxed); }
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::unique_ptr<Queue>> _queues{};
+        std::vector<std::thread> _workers{};
+        std::atomic<size_t> _next{0};
+        std::atomic<size_t> _steals{0};
+
+        // Number of queued tasks, guarded by _sleepMutex so a worker cannot miss a wake-up
+        std::mutex _sleepMutex{};
+        std::condition_variable _wake{};
+        size_t _pending{0};
+        bool _stop{false};
+
+        static inline thread_local WorkStealingExecutor* _currentExecutor{nullptr};
+        static inline thread_local int _currentWorker{-1};
+
+        bool _tryPop(int worker, Task& task) {
+            {
+                Queue& own{*_queues[worker]};
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.tasks.empty()) {
+                    task = std::move(own.tasks.front());
+                    own.tasks.pop_front();
+                    return true;
+                }
+            }
+            for (size_t offset{1}; offset < _queues.size(); ++offset) {
+                Queue& victim{*_queues[(worker + offset) % _queues.size()]};
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty()) {
+                    task = std::move(victim.tasks.back());
+                    victim.tasks.pop_back();
+                    _steals.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void _run(int worker) {
+            _currentExecutor = this;
+            _currentWorker = worker;
+
+            Task task{};
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(_sleepMutex);
+                    _wake.wait(lock, [this] { return _pending > 0 || _stop; });
+                    if (!_pending) {
+                        return;
+                    }
+                    --_pending;
+                }
+                // A pending count always has a task behind it, though another worker may pop it first; then keep
+                // looking rather than going back to sleep
+                while (!_tryPop(worker, task)) {
+                    std::this_thread::yield();
+                }
+                task(worker);
+            }
+        }
+};
+
+// Thrown from co_await when the request was cancelled before a worker started it
+class CompressionCancelled : public std::runtime_error {
+    public:
+        CompressionCancelled() : std::runtime_error("AsyncCompressor: request cancelled") {}
+};
+
+// Awaitable compression and decompression on a WorkStealingExecutor, so an event loop can run many requests without a
+// thread each:
+//     std::vector<uint8_t> compressed{co_await compressor.compressAsync(data, stopToken)};
+// The data must stay alive until the co_await returns. The coroutine resumes on the worker that ran the request, or
+// on the thread that requested the stop if it was cancelled while queued; services that need to resume on their loop
+// should post back from there. Requests that have started are not interrupted.
+// Requests smaller than batchBytes are grouped: the first small request of a batch queues one task, and every small
+// request that arrives before a worker picks that task up joins it, up to batchBytes of input in total. Busy workers
+// therefore get fewer, larger tasks, while an idle worker still picks up a lone small request straight away.
+class AsyncCompressor {
+    public:
+        AsyncCompressor(const MyCompressor& prototype, int threads=0, size_t batchBytes=256 * KB, bool debug=false)
+            : _batchBytes(batchBytes), _debug(debug), _executor(threads)
+        {
+            // Codecs keep state, so each worker has its own
+            for (int t{0}; t < _executor.getThreads(); ++t) {
+                _compressors.push_back(prototype.clone());
+            }
+        }
+
+        template <typename Result>
+        class Awaiter;
+
+        Awaiter<std::vector<uint8_t>> compressAsync(std::span<const float> data, std::stop_token stopToken={}) {
+            return Awaiter<std::vector<uint8_t>>(*this, data.size_bytes(), std::move(stopToken), [data](MyCompressor& compressor) {
+                std::vector<uint8_t> compressedData{};
+                compressor.compressInto(data, compressedData);
+                return compressedData;
+            });
+        }
+
+        Awaiter<std::vector<float>> decompressAsync(std::span<const uint8_t> compressedData, size_t uncompressedSize, std::stop_token stopToken={}) {
+            return Awaiter<std::vector<float>>(*this, uncompressedSize * sizeof(float), std::move(stopToken),
+                                                [compressedData, uncompressedSize](MyCompressor& compressor) {
+                std::vector<float> decompressedData(uncompressedSize);
+                compressor.decompressInto(compressedData, decompressedData);
+                return decompressedData;
+            });
+        }
+
+        // Getters
+        int getThreads() const { return _executor.getThreads(); }
+        size_t getBatchBytes() const { return _batchBytes; }
+        size_t getTasks() const { return _tasks.load(std::memory_order_relaxed); }
+        size_t getBatchedRequests() const { return _batchedRequests.load(std::memory_order_relaxed); }
+        size_t getCancelled() const { return _cancelled.load(std::memory_order_relaxed); }
+        size_t getSteals() const { return _executor.getSteals(); }
+
+    private:
+        // One request: the work, its outcome, and the handshake that decides who resumes the coroutine
+        struct Job {
+            enum STATUS{PENDING, RUNNING, CANCELLED};
+
+            std::atomic<int> status{PENDING};
+            std::atomic<int> arrivals{0};
+            std::coroutine_handle<> handle{};
+            std::exception_ptr error{};
+            size_t bytes{0};
+
+            virtual ~Job() = default;
+            virtual void execute(MyCompressor& compressor) = 0;
+
+            // The suspending coroutine and the completion both arrive; whoever is second resumes
+            bool arrive() {
+                return arrivals.fetch_add(1, std::memory_order_acq_rel) == 1;
+            }
+
+            void run(MyCompressor& compressor) {
+                int expected{PENDING};
+                if (!status.compare_exchange_strong(expected, RUNNING)) {
+                    return;     // Cancelled while queued, and already resumed
+                }
+                try {
+                    execute(compressor);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+                if (arrive()) {
+                    handle.resume();
+                }
+            }
+
+            // Counts the cancellation before resuming: the resumed coroutine may destroy the caller
+            bool cancel(std::atomic<size_t>& cancelled) {
+                int expected{PENDING};
+                if (!status.compare_exchange_strong(expected, CANCELLED)) {
+                    return false;
+                }
+                ++cancelled;
+                error = std::make_exception_ptr(CompressionCancelled());
+                if (arrive()) {
+                    handle.resume();
+                }
+                return true;
+            }
+        };
+
+        template <typename Result>
+        struct TypedJob : public Job {
+            std::function<Result(MyCompressor&)> work;
+            Result result{};
+
+            void execute(MyCompressor& compressor) override {
+                result = work(compressor);
+            }
+        };
+
+        struct Batch {
+            std::vector<std::shared_ptr<Job>> jobs{};
+            size_t bytes{0};
+        };
+
+        std::vector<std::unique_ptr<MyCompressor>> _compressors{};
+        size_t _batchBytes;
+        bool _debug;
+
+        std::mutex _batchMutex{};
+        std::shared_ptr<Batch> _openBatch{};
+
+        std::atomic<size_t> _tasks{0};
+        std::atomic<size_t> _batchedRequests{0};
+        std::atomic<size_t> _cancelled{0};
+
+        // Declared last, so it is destroyed first: its destructor runs the queued requests, which still need everything above
+        WorkStealingExecutor _executor;
+
+        void _submit(std::shared_ptr<Job> job) {
+            if (job->bytes >= _batchBytes) {
+                ++_tasks;
+                _executor.submit([this, job](int worker) { job->run(*_compressors[worker]); });
+                return;
+            }
+
+            std::shared_ptr<Batch> newBatch{};
+            {
+                std::lock_guard<std::mutex> lock(_batchMutex);
+                if (_openBatch && _openBatch->bytes + job->bytes > _batchBytes) {
+                    _openBatch.reset();     // Full; its task is already queued
+                }
+                if (!_openBatch) {
+                    _openBatch = newBatch = std::make_shared<Batch>();
+                }
+                _openBatch->jobs.push_back(job);
+                _openBatch->bytes += job->bytes;
+            }
+            ++_batchedRequests;
+
+            if (newBatch) {
+                ++_tasks;
+                _executor.submit([this, newBatch](int worker) {
+                    {
+                        // Close the batch, so later requests start a new one
+                        std::lock_guard<std::mutex> lock(_batchMutex);
+                        if (_openBatch == newBatch) {
+                            _openBatch.reset();
+                        }
+                    }
+                    if (_debug) {
+                        std::cerr << std::format("[DEBUG AsyncCompressor]: worker = {}, batch requests = {}, batch bytes = {}",
+                                                    worker, newBatch->jobs.size(), newBatch->bytes) << std::endl;
+                    }
+                    for (const std::shared_ptr<Job>& job : newBatch->jobs) {
+                        job->run(*_compressors[worker]);
+                    }
+                });
+            }
+        }
+
+    public:
+        template <typename Result>
+        class Awaiter {
+            public:
+                Awaiter(AsyncCompressor& owner, size_t bytes, std::stop_token stopToken, std::function<Result(MyCompressor&)> work)
+                    : _owner(owner), _stopToken(std::move(stopToken)), _job(std::make_shared<TypedJob<Result>>())
+                {
+                    _job->work = std::move(work);
+                    _job->bytes = bytes;
+                }
+
+                // Already cancelled requests never reach the executor
+                bool await_ready() const noexcept {
+                    return _stopToken.stop_requested();
+                }
+
+                bool await_suspend(std::coroutine_handle<> handle) {
+                    _job->handle = handle;
+                    if (_stopToken.stop_possible()) {
+                        _stopCallback.emplace(_stopToken, StopRequest{_job, &_owner});
+                    }
+                    _owner._submit(_job);
+                    // Stay suspended unless the request already completed on another thread
+                    return !_job->arrive();
+                }
+
+                Result await_resume() {
+                    if (_stopToken.stop_requested() && _job->status.load() == Job::PENDING) {
+                        ++_owner._cancelled;
+                        throw CompressionCancelled();
+                    }
+                    if (_job->error) {
+                        std::rethrow_exception(_job->error);
+                    }
+                    return std::move(_job->result);
+                }
+
+            private:
+                // Runs inside the stop_callback, which the coroutine resumed by cancel() may destroy, so nothing of this
+                // object is used after the call
+                struct StopRequest {
+                    std::shared_ptr<Job> job;
+                    AsyncCompressor* owner;
+
+                    void operator()() {
+                        const std::shared_ptr<Job> request{job};
+                        request->cancel(owner->_cancelled);
+                    }
+                };
+
+                AsyncCompressor& _owner;
+                std::stop_token _stopToken;
+                std::shared_ptr<TypedJob<Result>> _job;
+                std::optional<std::stop_callback<StopRequest>> _stopCallback{};
+        };
+};
+
+#endif
@@ -0,0 +1,238 @@
+#ifndef BATCH_COMPRESSOR_HPP
+#define BATCH_COMPRESSOR_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "MyCompressor.hpp"
+#include "WorkerGroup.hpp"
+#include "utils.hpp"
+
+// Many compressed buffers in one contiguous arena: buffer i is arena[offsets[i], offsets[i + 1])
+struct CompressedBatch {
+    std::vector<uint8_t> arena{};
+    std::vector<size_t> offsets{0};
+    std::vector<size_t> sizes{};       // Uncompressed number of floats of each buffer
+
+    size_t size() const { return sizes.size(); }
+
+    std::span<const uint8_t> operator[](size_t i) const {
+        return std::span<const uint8_t>(arena).subspan(offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+    // Floats before buffer i when the batch is decompressed into one contiguous buffer
+    size_t valueOffset(size_t i) const {
+        size_t offset{0};
+        for (size_t j{0}; j < i; ++j) {
+            offset += sizes[j];
+        }
+        return offset;
+    }
+};
+
+// Compresses many small buffers per call, e.g. one per event or basket, where a call per buffer would mostly pay for
+// setup. The workers and their codecs are created once and kept: each codec keeps its stream state and scratch
+// buffers between calls, and each worker reuses its staging arena. A batch is split into contiguous runs of buffers of
+// about equal size, one per worker, so each worker's output is already contiguous and is copied into the arena in one
+// piece. Batches smaller than minParallelBytes run on the calling thread, where waking the workers would cost more
+// than it saves.
+class BatchCompressor {
+    public:
+        BatchCompressor(const MyCompressor& prototype, int threads=0, size_t minParallelBytes=1 * MB, bool debug=false)
+            : _minParallelBytes(minParallelBytes), _debug(debug)
+        {
+            if (threads <= 0) {
+                threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+            }
+            _workers.resize(threads);
+            for (Worker& worker : _workers) {
+                worker.compressor = prototype.clone();
+            }
+            if (threads > 1) {
+                _group = std::make_unique<WorkerGroup>(threads);
+            }
+        }
+
+        CompressedBatch compressBatch(std::span<const std::span<const float>> buffers) {
+            CompressedBatch batch{};
+            compressBatchInto(buffers, batch);
+            return batch;
+        }
+
+        // Compress into a caller-owned batch, so the arena's capacity is reused across calls
+        void compressBatchInto(std::span<const std::span<const float>> buffers, CompressedBatch& batch) {
+            batch.sizes.resize(buffers.size());
+            batch.offsets.assign(buffers.size() + 1, 0);
+            size_t totalBytes{0};
+            for (size_t i{0}; i < buffers.size(); ++i) {
+                batch.sizes[i] = buffers[i].size();
+                totalBytes += buffers[i].size_bytes();
+            }
+
+            // One worker: compress straight into the arena
+            if (!_parallel(totalBytes)) {
+                Worker& worker{_workers[0]};
+                batch.arena.clear();
+                for (size_t i{0}; i < buffers.size(); ++i) {
+                    worker.compressor->compressInto(buffers[i], worker.scratch);
+                    batch.arena.insert(batch.arena.end(), worker.scratch.begin(), worker.scratch.end());
+                    batch.offsets[i + 1] = batch.arena.size();
+                }
+                _printDebug("compress", buffers.size(), totalBytes, 1);
+                return;
+            }
+
+            // Each worker stages its run of buffers in its own arena, recording the end offset of each buffer
+            const std::vector<size_t> bounds{_partition(batch.sizes)};
+            _runWorkers([&](int t) {
+                Worker& worker{_workers[t]};
+                worker.arena.clear();
+                for (size_t i{bounds[t]}; i < bounds[t + 1]; ++i) {
+                    worker.compressor->compressInto(buffers[i], worker.scratch);
+                    worker.arena.insert(worker.arena.end(), worker.scratch.begin(), worker.scratch.end());
+                    batch.offsets[i + 1] = worker.arena.size();
+                }
+            });
+
+            // Shift each run's offsets past the runs before it, then copy the staged runs into place in parallel
+            std::vector<size_t> runStarts(_workers.size() + 1, 0);
+            for (size_t t{0}; t < _workers.size(); ++t) {
+                runStarts[t + 1] = runStarts[t] + _workers[t].arena.size();
+                for (size_t i{bounds[t]}; i < bounds[t + 1]; ++i) {
+                    batch.offsets[i + 1] += runStarts[t];
+                }
+            }
+            batch.arena.resize(runStarts.back());
+            _runWorkers([&](int t) {
+                if (!_workers[t].arena.empty()) {
+                    std::memcpy(batch.arena.data() + runStarts[t], _workers[t].arena.data(), _workers[t].arena.size());
+                }
+            });
+            _printDebug("compress", buffers.size(), totalBytes, static_cast<int>(_workers.size()));
+        }
+
+        // Decompress every buffer into one contiguous buffer, in batch order
+        std::vector<float> decompressBatch(const CompressedBatch& batch) {
+            std::vector<float> decompressedData(batch.valueOffset(batch.size()));
+            std::vector<std::span<float>> buffers(batch.size());
+            for (size_t i{0}, offset{0}; i < batch.size(); offset += batch.sizes[i], ++i) {
+                buffers[i] = std::span<float>(decompressedData).subspan(offset, batch.sizes[i]);
+            }
+            decompressBatchInto(batch, buffers);
+            return decompressedData;
+        }
+
+        // Decompress into caller-owned buffers, one per batch entry, each holding exactly its uncompressed size
+        void decompressBatchInto(const CompressedBatch& batch, std::span<const std::span<float>> buffers) {
+            if (buffers.size() != batch.size()) {
+                throw std::invalid_argument(std::format("BatchCompressor: {} output buffers for a batch of {}", buffers.size(), batch.size()));
+            }
+            size_t totalBytes{0};
+            for (size_t i{0}; i < buffers.size(); ++i) {
+                if (buffers[i].size() != batch.sizes[i]) {
+                    throw std::invalid_argument(std::format("BatchCompressor: output buffer {} holds {} floats, expected {}",
+                                                            i, buffers[i].size(), batch.sizes[i]));
+                }
+                totalBytes += buffers[i].size_bytes();
+            }
+
+            if (!_parallel(totalBytes)) {
+                for (size_t i{0}; i < buffers.size(); ++i) {
+                    _workers[0].compressor->decompressInto(batch[i], buffers[i]);
+                }
+                _printDebug("decompress", buffers.size(), totalBytes, 1);
+                return;
+            }
+
+            const std::vector<size_t> bounds{_partition(batch.sizes)};
+            _runWorkers([&](int t) {
+                for (size_t i{bounds[t]}; i < bounds[t + 1]; ++i) {
+                    _workers[t].compressor->decompressInto(batch[i], buffers[i]);
+                }
+            });
+            _printDebug("decompress", buffers.size(), totalBytes, static_cast<int>(_workers.size()));
+        }
+
+        // Getters
+        int getThreads() const { return static_cast<int>(_workers.size()); }
+        size_t getMinParallelBytes() const { return _minParallelBytes; }
+
+    private:
+        struct Worker {
+            std::unique_ptr<MyCompressor> compressor{};
+            std::vector<uint8_t> scratch{};
+            std::vector<uint8_t> arena{};
+            std::exception_ptr error{};
+        };
+
+        size_t _minParallelBytes;
+        bool _debug;
+
+        std::vector<Worker> _workers{};
+        std::unique_ptr<WorkerGroup> _group{};
+
+        bool _parallel(size_t totalBytes) const {
+            return _group && totalBytes >= _minParallelBytes;
+        }
+
+        // Boundaries of one contiguous run of buffers per worker, cut where the running size passes each worker's share
+        std::vector<size_t> _partition(const std::vector<size_t>& sizes) const {
+            size_t total{0};
+            for (size_t size : sizes) {
+                total += size;
+            }
+
+            std::vector<size_t> bounds(_workers.size() + 1, sizes.size());
+            bounds[0] = 0;
+            size_t running{0};
+            size_t worker{1};
+            for (size_t i{0}; i < sizes.size() && worker < _workers.size(); ++i) {
+                running += sizes[i];
+                while (worker < _workers.size() && running * _workers.size() >= total * worker) {
+                    bounds[worker++] = i + 1;
+                }
+            }
+            return bounds;
+        }
+
+        // WorkerGroup jobs must not throw, so errors are carried back to the caller
+        void _runWorkers(const std::function<void(int)>& job) {
+            _group->run([&](int t) {
+                try {
+                    job(t);
+                }
+                catch (...) {
+                    _workers[t].error = std::current_exception();
+                }
+            });
+            std::exception_ptr error{};
+            for (Worker& worker : _workers) {
+                if (worker.error && !error) {
+                    error = worker.error;
+                }
+                worker.error = nullptr;
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        void _printDebug(const char* operation, size_t buffers, size_t totalBytes, int threads) const {
+            if (_debug) {
+                std::cerr << std::format("[DEBUG BatchCompressor]: {} buffers = {}, bytes = {}, threads = {}",
+                                            operation, buffers, totalBytes, threads) << std::endl;
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,312 @@
+#ifndef BLOCK_CACHE_HPP
+#define BLOCK_CACHE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+// One decoded block: the archive it came from (ArchiveReader::getFileId), the column's position in the archive, and
+// the block's position in the column
+struct BlockKey {
+    uint64_t file;
+    uint32_t column;
+    uint32_t block;
+
+    bool operator==(const BlockKey&) const = default;
+};
+
+struct BlockCacheStats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+    uint64_t inserts{0};
+    uint64_t rejected{0};       // Blocks not admitted, or larger than a shard
+    uint64_t evictions{0};
+    uint64_t bytesSaved{0};     // Decoded bytes served from the cache instead of decoded again
+    uint64_t bytes{0};          // Decoded bytes held now
+    uint64_t entries{0};
+
+    double hitRate() const {
+        return hits + misses ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+    }
+};
+
+// Decoded archive blocks shared by every reader and thread in a process, so threads that keep scanning the same hot
+// columns decode each block once. Bounded by decoded bytes, split evenly over shards picked by key hash.
+// Lookups never take a shard's mutex: each slot is an atomic shared_ptr, so a hit is a probe of a few slots plus a
+// reference count increment, and a block handed out stays valid after it is evicted. Inserts and evictions lock their
+// shard. Eviction is CLOCK: a hit marks the entry, and the hand evicts the first unmarked entry, clearing marks as it
+// passes.
+// With admission on, a block that misses while its shard is full is only admitted the second time it misses, so a
+// column scanned once does not push out the blocks other threads keep coming back to. Each shard remembers the hashes
+// of recent rejected misses in a small direct-mapped table for this.
+class BlockCache {
+    public:
+        BlockCache(size_t maxBytes, int shards=16, size_t slotsPerShard=1024, bool admission=true, bool debug=false)
+            : _maxBytes(maxBytes), _admission(admission), _debug(debug)
+        {
+            if (shards <= 0 || slotsPerShard == 0) {
+                throw std::invalid_argument("BlockCache: shards and slots per shard must be greater than 0");
+            }
+            _shardMask = std::bit_ceil(static_cast<size_t>(shards)) - 1;
+            const size_t slots{std::bit_ceil(std::max<size_t>(slotsPerShard, PROBE_SLOTS))};
+            for (size_t s{0}; s <= _shardMask; ++s) {
+                _shards.push_back(std::make_unique<Shard>(slots, maxBytes / (_shardMask + 1)));
+            }
+        }
+
+        BlockCache(const BlockCache&) = delete;
+        BlockCache& operator=(const BlockCache&) = delete;
+
+        // Cached block, or null. T must be the type the block was inserted with, which a column's type fixes.
+        template <typename T>
+        std::shared_ptr<const std::vector<T>> find(const BlockKey& key) {
+            return std::static_pointer_cast<const std::vector<T>>(_find(key));
+        }
+
+        // Cache a decoded block, unless admission turns it away. Returns the cached block, which is an equal block
+        // another thread inserted first if there was one, so concurrent readers end up sharing one copy.
+        template <typename T>
+        std::shared_ptr<const std::vector<T>> insert(const BlockKey& key, std::shared_ptr<const std::vector<T>> block) {
+            const size_t bytes{block->size() * sizeof(T)};
+            return std::static_pointer_cast<const std::vector<T>>(_insert(key, std::move(block), bytes));
+        }
+
+        // Drop every block; blocks already handed out stay valid
+        void clear() {
+            for (const std::unique_ptr<Shard>& shard : _shards) {
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                for (size_t i{0}; i < shard->slots.size(); ++i) {
+                    shard->slots[i].store(nullptr, std::memory_order_release);
+                }
+                shard->bytes = 0;
+                shard->entries = 0;
+            }
+        }
+
+        // Totals over all shards; counters are read one by one, so the totals may be mid-update under load
+        BlockCacheStats getStats() const {
+            BlockCacheStats stats{};
+            for (const std::unique_ptr<Shard>& shard : _shards) {
+                stats.hits += shard->hits.load(std::memory_order_relaxed);
+                stats.misses += shard->misses.load(std::memory_order_relaxed);
+                stats.inserts += shard->inserts.load(std::memory_order_relaxed);
+                stats.rejected += shard->rejected.load(std::memory_order_relaxed);
+                stats.evictions += shard->evictions.load(std::memory_order_relaxed);
+                stats.bytesSaved += shard->bytesSaved.load(std::memory_order_relaxed);
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                stats.bytes += shard->bytes;
+                stats.entries += shard->entries;
+            }
+            return stats;
+        }
+
+        void resetStats() {
+            for (const std::unique_ptr<Shard>& shard : _shards) {
+                shard->hits = 0;
+                shard->misses = 0;
+                shard->inserts = 0;
+                shard->rejected = 0;
+                shard->evictions = 0;
+                shard->bytesSaved = 0;
+            }
+        }
+
+        // Getters
+        size_t getMaxBytes() const { return _maxBytes; }
+        int getShards() const { return static_cast<int>(_shards.size()); }
+        bool getAdmission() const { return _admission; }
+
+    private:
+        // Slots probed from a key's home slot; a key lives in one of these or is not cached
+        static constexpr size_t PROBE_SLOTS{8};
+
+        struct Entry {
+            BlockKey key;
+            uint64_t hash;
+            std::shared_ptr<const void> block;
+            size_t bytes;
+            std::atomic<bool> referenced{false};
+        };
+
+        // Aligned so one shard's counters do not share a cache line with the next shard's
+        struct alignas(64) Shard {
+            Shard(size_t numSlots, size_t capacity)
+                : slots(numSlots), ghosts(numSlots, 0), capacity(capacity) {}
+
+            std::vector<std::atomic<std::shared_ptr<Entry>>> slots;
+
+            // Everything below is guarded by the mutex, except the statistics
+            std::mutex mutex{};
+            std::vector<uint64_t> ghosts;
+            size_t capacity;
+            size_t bytes{0};
+            size_t entries{0};
+            size_t hand{0};
+
+            std::atomic<uint64_t> hits{0};
+            std::atomic<uint64_t> misses{0};
+            std::atomic<uint64_t> inserts{0};
+            std::atomic<uint64_t> rejected{0};
+            std::atomic<uint64_t> evictions{0};
+            std::atomic<uint64_t> bytesSaved{0};
+        };
+
+        size_t _maxBytes;
+        bool _admission;
+        bool _debug;
+
+        size_t _shardMask{0};
+        std::vector<std::unique_ptr<Shard>> _shards{};
+
+        // splitmix64 finalizer over the key fields
+        static uint64_t _hash(const BlockKey& key) {
+            uint64_t h{key.file ^ (static_cast<uint64_t>(key.column) << 32 | key.block)};
+            h ^= h >> 30;
+            h *= 0xbf58476d1ce4e5b9ULL;
+            h ^= h >> 27;
+            h *= 0x94d049bb133111ebULL;
+            h ^= h >> 31;
+            return h;
+        }
+
+        Shard& _shardOf(uint64_t hash) const {
+            return *_shards[hash & _shardMask];
+        }
+
+        // Home slot from bits the shard index does not use
+        static size_t _homeSlot(const Shard& shard, uint64_t hash) {
+            return (hash >> 32) & (shard.slots.size() - 1);
+        }
+
+        std::shared_ptr<const void> _find(const BlockKey& key) {
+            const uint64_t hash{_hash(key)};
+            Shard& shard{_shardOf(hash)};
+            const size_t home{_homeSlot(shard, hash)};
+            for (size_t p{0}; p < PROBE_SLOTS; ++p) {
+                const std::shared_ptr<Entry> entry{shard.slots[(home + p) & (shard.slots.size() - 1)].load(std::memory_order_acquire)};
+                if (entry && entry->hash == hash && entry->key == key) {
+                    // Only write the mark when it is clear, so hot entries do not bounce their cache line between readers
+                    if (!entry->referenced.load(std::memory_order_relaxed)) {
+                        entry->referenced.store(true, std::memory_order_relaxed);
+                    }
+                    shard.hits.fetch_add(1, std::memory_order_relaxed);
+                    shard.bytesSaved.fetch_add(entry->bytes, std::memory_order_relaxed);
+                    return entry->block;
+                }
+            }
+            shard.misses.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        std::shared_ptr<const void> _insert(const BlockKey& key, std::shared_ptr<const void> block, size_t bytes) {
+            const uint64_t hash{_hash(key)};
+            Shard& shard{_shardOf(hash)};
+            const size_t home{_homeSlot(shard, hash)};
+            const size_t mask{shard.slots.size() - 1};
+
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            // Another thread may have decoded and inserted the same block meanwhile
+            for (size_t p{0}; p < PROBE_SLOTS; ++p) {
+                const std::shared_ptr<Entry> entry{shard.slots[(home + p) & mask].load(std::memory_order_relaxed)};
+                if (entry && entry->hash == hash && entry->key == key) {
+                    return entry->block;
+                }
+            }
+
+            if (bytes > shard.capacity) {
+                shard.rejected.fetch_add(1, std::memory_order_relaxed);
+                return block;
+            }
+            if (_admission && shard.bytes + bytes > shard.capacity) {
+                uint64_t& ghost{shard.ghosts[home]};
+                if (ghost != hash) {
+                    ghost = hash;       // Admitted if it misses again before another block takes the ghost slot
+                    shard.rejected.fetch_add(1, std::memory_order_relaxed);
+                    return block;
+                }
+                ghost = 0;
+            }
+
+            // Make room for the bytes, then for a slot in the probe window
+            std::optional<size_t> free{};
+            while (shard.bytes + bytes > shard.capacity) {
+                _evictNext(shard);
+            }
+            for (size_t p{0}; p < PROBE_SLOTS && !free; ++p) {
+                if (!shard.slots[(home + p) & mask].load(std::memory_order_relaxed)) {
+                    free = (home + p) & mask;
+                }
+            }
+            if (!free) {
+                free = _evictInWindow(shard, home);
+            }
+
+            std::shared_ptr<Entry> entry{std::make_shared<Entry>()};
+            entry->key = key;
+            entry->hash = hash;
+            entry->block = block;
+            entry->bytes = bytes;
+            shard.slots[*free].store(std::move(entry), std::memory_order_release);
+            shard.bytes += bytes;
+            ++shard.entries;
+            shard.inserts.fetch_add(1, std::memory_order_relaxed);
+
+            if (_debug) {
+                std::cerr << std::format("[DEBUG BlockCache]: insert file = {:x}, column = {}, block = {}, bytes = {}, shard bytes = {}",
+                                            key.file, key.column, key.block, bytes, shard.bytes) << std::endl;
+            }
+            return block;
+        }
+
+        // Both need the shard's mutex
+        void _evict(Shard& shard, size_t slot) {
+            const std::shared_ptr<Entry> entry{shard.slots[slot].exchange(nullptr, std::memory_order_acq_rel)};
+            shard.bytes -= entry->bytes;
+            --shard.entries;
+            shard.evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Advance the hand to the first unmarked entry and evict it; at most two turns, since the first clears every mark
+        void _evictNext(Shard& shard) {
+            const size_t mask{shard.slots.size() - 1};
+            for (size_t step{0}; step < 2 * shard.slots.size(); ++step) {
+                const size_t slot{shard.hand};
+                shard.hand = (shard.hand + 1) & mask;
+                const std::shared_ptr<Entry> entry{shard.slots[slot].load(std::memory_order_relaxed)};
+                if (!entry) {
+                    continue;
+                }
+                if (entry->referenced.exchange(false, std::memory_order_relaxed)) {
+                    continue;
+                }
+                _evict(shard, slot);
+                return;
+            }
+        }
+
+        // A full probe window gives up its first unmarked entry, or its first entry if every one is marked
+        size_t _evictInWindow(Shard& shard, size_t home) {
+            const size_t mask{shard.slots.size() - 1};
+            size_t victim{home};
+            for (size_t p{0}; p < PROBE_SLOTS; ++p) {
+                const std::shared_ptr<Entry> entry{shard.slots[(home + p) & mask].load(std::memory_order_relaxed)};
+                if (!entry->referenced.load(std::memory_order_relaxed)) {
+                    victim = (home + p) & mask;
+                    break;
+                }
+            }
+            _evict(shard, victim);
+            return victim;
+        }
+};
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef BOOLEAN_COMPRESSOR_HPP
+#define BOOLEAN_COMPRESSOR_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// Lossless codecs for bool and vector<bool> columns such as trigger flags, stored one byte per value
+// BITMAP packs eight values per byte; RLE stores the first value followed by alternating run lengths as varints,
+// which wins when flags are mostly constant.
+class BooleanCompressor {
+    public:
+        enum MODE{BITMAP, RLE};
+
+        BooleanCompressor() {}
+
+        BooleanCompressor(const int mode, bool debug=false) : _debug(debug) {
+            // Validate mode
+            if (mode < BITMAP || mode > RLE) {
+                throw std::invalid_argument("mode must be between 0 and 1");
+            }
+            else {
+                _mode = mode;
+            }
+        }
+
+        std::vector<uint8_t> compress(const std::vector<uint8_t>& data) {
+            std::vector<uint8_t> compressedData{};
+            compressInto(data, compressedData);
+            return compressedData;
+        }
+
+        void compressInto(std::span<const uint8_t> data, std::vector<uint8_t>& compressedData) {
+            if (_debug) {
+                std::cerr << std::format("[DEBUG BooleanCompressor]: mode = {}, dataSize = {}", _mode, data.size()) << std::endl;
+            }
+
+            compressedData.clear();
+
+            if (_mode == BITMAP) {
+                compressedData.resize((data.size() + 7) / 8);
+
+                // Whole bytes first, so the inner loop has a fixed trip count
+                const size_t wholeBytes{data.size() / 8};
+                for (size_t byte{0}; byte < wholeBytes; ++byte) {
+                    uint8_t bits{0};
+                    for (size_t bit{0}; bit < 8; ++bit) {
+                        bits |= static_cast<uint8_t>((data[8 * byte + bit] != 0) << bit);
+                    }
+                    compressedData[byte] = bits;
+                }
+                for (size_t i{8 * wholeBytes}; i < data.size(); ++i) {
+                    compressedData[wholeBytes] |= static_cast<uint8_t>((data[i] != 0) << (i % 8));
+                }
+            }
+            else {
+                if (data.empty()) {
+                    return;
+                }
+
+                bool current{data[0] != 0};
+                compressedData.push_back(current);
+
+                size_t run{0};
+                for (uint8_t value : data) {
+                    if ((value != 0) == current) {
+                        ++run;
+                    }
+                    else {
+                        _appendVarint(compressedData, run);
+                        current = !current;
+                        run = 1;
+                    }
+                }
+                _appendVarint(compressedData, run);
+            }
+        }
+
+        std::vector<uint8_t> decompress(const std::vector<uint8_t>& compressedData, const size_t& uncompressedSize) {
+            std::vector<uint8_t> decompressedData(uncompressedSize);
+            decompressInto(compressedData, decompressedData);
+            return decompressedData;
+        }
+
+        void decompressInto(std::span<const uint8_t> compressedData, std::span<uint8_t> decompressedData) {
+            if (_mode == BITMAP) {
+                if (compressedData.size() != (decompressedData.size() + 7) / 8) {
+                    throw std::runtime_error("BooleanCompressor: compressed data has the wrong size");
+                }
+
+                for (size_t i{0}; i < decompressedData.size(); ++i) {
+                    decompressedData[i] = (compressedData[i / 8] >> (i % 8)) & 1u;
+                }
+            }
+            else {
+                if (decompressedData.empty()) {
+                    return;
+                }
+                if (compressedData.empty()) {
+                    throw std::runtime_error("BooleanCompressor: compressed data is truncated");
+                }
+
+                uint8_t current{compressedData[0]};
+                size_t position{1};
+                size_t filled{0};
+                while (filled < decompressedData.size()) {
+                    const size_t run{_readVarint(compressedData, position)};
+                    if (run > decompressedData.size() - filled) {
+                        throw std::runtime_error("BooleanCompressor: run exceeds uncompressed size");
+                    }
+                    std::fill_n(decompressedData.begin() + filled, run, current);
+                    filled += run;
+                    current ^= 1u;
+                }
+            }
+        }
+
+        // Getters
+        int getMode() const { return _mode; }
+
+    private:
+        int _mode;
+        bool _debug;
+
+        static void _appendVarint(std::vector<uint8_t>& buffer, size_t value) {
+            while (value >= 0x80) {
+                buffer.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            buffer.push_back(static_cast<uint8_t>(value));
+        }
+
+        static size_t _readVarint(std::span<const uint8_t> buffer, size_t& position) {
+            size_t value{0};
+            for (int shift{0}; shift < 64; shift += 7) {
+                if (position >= buffer.size()) {
+                    throw std::runtime_error("BooleanCompressor: compressed data is truncated");
+                }
+                const uint8_t byte{buffer[position++]};
+                value |= static_cast<size_t>(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) {
+                    return value;
+                }
+            }
+            throw std::runtime_error("BooleanCompressor: invalid run length");
+        }
+};
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef BRANCH_PROFILE_HPP
+#define BRANCH_PROFILE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CodecChain.hpp"
+#include "CompressionEstimator.hpp"
+#include "utils.hpp"
+
+// Codec chosen for one branch and precision, with what it reached on the profiling sample
+struct BranchProfile {
+    std::string branch;
+    int precision;
+    std::string codec;              // Codec chain spec, which carries the codec's precision and level
+    double ratio;
+    double compressionMBps;
+    double decompressionMBps;
+};
+
+// Persisted branch -> codec choices, so the compression path picks up tuned codecs at startup without searching.
+// Profiles are keyed by branch and precision. The file has one profile per line:
+// branch precision codec ratio compressionMBps decompressionMBps
+class ProfileCache {
+    public:
+        ProfileCache(const std::string& profileFile, bool debug=false) : _profileFile(profileFile), _debug(debug) {
+            _load();
+        }
+
+        // nullptr when the branch has no profile at this precision
+        const BranchProfile* find(const std::string& branch, const int precision) const {
+            auto it{_profiles.find({branch, precision})};
+            return it == _profiles.end() ? nullptr : &it->second;
+        }
+
+        // Profiled codec for the branch, or the fallback if there is none
+        std::string codecFor(const std::string& branch, const int precision, const std::string& fallback) const {
+            const BranchProfile* profile{find(branch, precision)};
+            if (_debug) {
+                std::cerr << std::format("[DEBUG ProfileCache]: branch = {}, precision = {}, codec = {}{}",
+                                            branch, precision, profile ? profile->codec : fallback, profile ? "" : " (no profile)") << std::endl;
+            }
+            return profile ? profile->codec : fallback;
+        }
+
+        void set(const BranchProfile& profile) {
+            _profiles[{profile.branch, profile.precision}] = profile;
+        }
+
+        void save() const {
+            std::ofstream file(_profileFile);
+            if (!file.is_open()) {
+                throw std::runtime_error("Could not open file: " + _profileFile);
+            }
+
+            for (const auto& [key, profile] : _profiles) {
+                file << std::format("{} {} {} {} {} {}\n", profile.branch, profile.precision, profile.codec,
+                                    profile.ratio, profile.compressionMBps, profile.decompressionMBps);
+            }
+        }
+
+        // Getters
+        const std::map<std::pair<std::string, int>, BranchProfile>& getProfiles() const { return _profiles; }
+        const std::string& getProfileFile() const { return _profileFile; }
+
+    private:
+        std::string _profileFile;
+        bool _debug;
+
+        std::map<std::pair<std::string, int>, BranchProfile> _profiles{};
+
+        void _load() {
+            std::ifstream file(_profileFile);
+            if (!file.is_open()) {
+                return;     // No profiles yet
+            }
+
+            std::string line;
+            while (std::getline(file, line)) {
+                std::istringstream iss(line);
+                BranchProfile profile;
+                if (iss >> profile.branch >> profile.precision >> profile.codec >> profile.ratio
+                        >> profile.compressionMBps >> profile.decompressionMBps) {
+                    // Reject bad specs here rather than on the first column that uses them
+                    ChainCompressor(profile.codec);
+                    _profiles[{profile.branch, profile.precision}] = profile;
+                }
+            }
+        }
+};
+
+// Picks a codec per branch by trial-compressing a sample with each candidate chain: the highest ratio among candidates
+// that meet the throughput floors, or the fastest compressor if none does. Times are the best of a few iterations.
+// With a prune tolerance, a CompressionEstimator ranks the candidates on the whole branch first, and only those
+// estimated within the tolerance of the throughput floors and of the best estimated ratio are trial-compressed.
+class BranchProfiler {
+    public:
+        BranchProfiler(const int precision, const std::vector<std::string>& candidates, const double minCompressionMBps=0,
+                        const double minDecompressionMBps=0, const double sampleMB=4, const int iterations=3,
+                        const double pruneTolerance=0, bool debug=false)
+            : _precision(precision), _candidates(candidates), _minCompressionMBps(minCompressionMBps),
+              _minDecompressionMBps(minDecompressionMBps), _iterations(iterations), _pruneTolerance(pruneTolerance), _debug(debug)
+        {
+            if (precision <= 0 || precision > 7) {
+                throw std::invalid_argument("float precision must be between 1 and 7");
+            }
+            if (_candidates.empty()) {
+                _candidates = defaultCandidates(precision);
+            }
+            if (sampleMB <= 0 || iterations <= 0) {
+                throw std::invalid_argument("sampleMB and iterations must be greater than 0");
+            }
+            if (pruneTolerance < 0 || pruneTolerance >= 1) {
+                throw std::invalid_argument("pruneTolerance must be at least 0 and less than 1");
+            }
+            _sampleSize = std::max<size_t>(1, static_cast<size_t>(sampleMB * MB) / sizeof(float));
+        }
+
+        // Truncation with each entropy coder at a few levels. These all keep the same per-value guarantee; quant and sz
+        // bound the error against the value range instead, so they are only tried when passed as candidates.
+        static std::vector<std::string> defaultCandidates(const int precision) {
+            return {std::format("trunk:{}:1", precision),
+                    std::format("trunk:{}:6", precision),
+                    std::format("trunk:{}:9", precision),
+                    std::format("truncate:{}|shuffle|zlib:6", precision),
+                    std::format("truncate:{}|shuffle|zstd:1", precision),
+                    std::format("truncate:{}|shuffle|zstd:3", precision),
+                    std::format("truncate:{}|shuffle|zstd:9", precision)};
+        }
+
+        BranchProfile profile(const std::string& branch, std::span<const float> data) {
+            const std::vector<float> sample{sampleBlocks(data, _sampleSize, SAMPLE_BLOCK_SIZE)};
+            const double sampleMB{static_cast<double>(sample.size() * sizeof(float)) / MB};
+
+            _trials.clear();
+            _estimates.clear();
+            std::vector<std::string> candidates{_candidates};
+            if (_pruneTolerance > 0) {
+                candidates = _prune(branch, data);
+            }
+
+            std::vector<uint8_t> compressed{};
+            std::vector<float> decompressed(sample.size());
+            for (const std::string& codec : candidates) {
+                ChainCompressor compressor(codec);
+                double compressionTime{std::numeric_limits<double>::max()};
+                double decompressionTime{std::numeric_limits<double>::max()};
+                for (int iteration{0}; iteration < _iterations; ++iteration) {
+                    std::chrono::high_resolution_clock::time_point start{std::chrono::high_resolution_clock::now()};
+                    compressor.compressInto(sample, compressed);
+                    compressionTime = std::min(compressionTime, elapsedSeconds(start));
+
+                    start = std::chrono::high_resolution_clock::now();
+                    compressor.decompressInto(compressed, decompressed);
+                    decompressionTime = std::min(decompressionTime, elapsedSeconds(start));
+                }
+
+                BranchProfile trial{branch, _precision, codec,
+                                    compressed.empty() ? 0.0 : static_cast<double>(sample.size() * sizeof(float)) / static_cast<double>(compressed.size()),
+                                    compressionTime > 0 ? sampleMB / compressionTime : 0.0,
+                                    decompressionTime > 0 ? sampleMB / decompressionTime : 0.0};
+                _trials.push_back(trial);
+
+                if (_debug) {
+                    std::cerr << std::format("[DEBUG BranchProfiler]: branch = {}, codec = {}, ratio = {:.3f}, compression = {:.1f} MB/s, decompression = {:.1f} MB/s",
+                                                branch, codec, trial.ratio, trial.compressionMBps, trial.decompressionMBps) << std::endl;
+                }
+            }
+
+            // Best ratio within the throughput floors, otherwise the fastest compressor
+            const BranchProfile* best{nullptr};
+            for (const BranchProfile& trial : _trials) {
+                if (trial.compressionMBps >= _minCompressionMBps && trial.decompressionMBps >= _minDecompressionMBps
+                        && (!best || trial.ratio > best->ratio)) {
+                    best = &trial;
+                }
+            }
+            if (!best) {
+                best = &*std::max_element(_trials.begin(), _trials.end(), [](const BranchProfile& a, const BranchProfile& b) {
+                    return a.compressionMBps < b.compressionMBps;
+                });
+            }
+            return *best;
+        }
+
+        // Getters
+        int getPrecision() const { return _precision; }
+        const std::vector<std::string>& getCandidates() const { return _candidates; }
+        const std::vector<BranchProfile>& getTrials() const { return _trials; }     // Every candidate trial-compressed by the last profile call
+        const std::vector<CompressionEstimate>& getEstimates() const { return _estimates; }     // Every candidate, when pruning
+
+    private:
+        static constexpr size_t SAMPLE_BLOCK_SIZE{16384};
+
+        int _precision;
+        std::vector<std::string> _candidates;
+        double _minCompressionMBps;
+        double _minDecompressionMBps;
+        size_t _sampleSize;
+        int _iterations;
+        double _pruneTolerance;
+        bool _debug;
+
+        std::vector<BranchProfile> _trials{};
+        std::vector<CompressionEstimate> _estimates{};
+
+        // Candidates estimated to meet the floors and to come within the tolerance of the best estimated ratio; all of
+        // them if none is estimated to meet the floors, since then the fastest is picked from measurements
+        std::vector<std::string> _prune(const std::string& branch, std::span<const float> data) {
+            CompressionEstimator estimator(4, 1024, 1, _debug);
+            _estimates = estimator.estimateAll(data, _candidates);
+
+            auto meetsFloors = [this](const CompressionEstimate& estimate) {
+                return estimate.compressionMBps >= (1 - _pruneTolerance) * _minCompressionMBps
+                    && estimate.decompressionMBps >= (1 - _pruneTolerance) * _minDecompressionMBps;
+            };
+            double bestRatio{0};
+            for (const CompressionEstimate& estimate : _estimates) {
+                if (meetsFloors(estimate)) {
+                    bestRatio = std::max(bestRatio, estimate.ratio);
+                }
+            }
+            if (bestRatio == 0) {
+                return _candidates;
+            }
+
+            std::vector<std::string> kept{};
+            for (const CompressionEstimate& estimate : _estimates) {
+                if (meetsFloors(estimate) && estimate.ratio >= (1 - _pruneTolerance) * bestRatio) {
+                    kept.push_back(estimate.codec);
+                }
+            }
+            if (_debug) {
+                std::cerr << std::format("[DEBUG BranchProfiler]: branch = {}, kept {} of {} candidates after estimation",
+                                            branch, kept.size(), _candidates.size()) << std::endl;
+            }
+            return kept;
+        }
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Pool of reusable vectors, so output and scratch buffers keep their capacity across iterations
+// instead of going back to the allocator on every call
+template <typename T>
+class BufferPool {
+    public:
+        BufferPool(size_t maxBuffers=16) : _maxBuffers(maxBuffers) {}
+
+        // Get an empty buffer with at least the requested capacity
+        std::vector<T> acquire(size_t capacity=0) {
+            std::vector<T> buffer{};
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_buffers.empty()) {
+                    // Prefer the smallest buffer that is already large enough
+                    auto best{_buffers.end()};
+                    for (auto it{_buffers.begin()}; it != _buffers.end(); ++it) {
+                        if (it->capacity() >= capacity && (best == _buffers.end() || it->capacity() < best->capacity())) {
+                            best = it;
+                        }
+                    }
+                    if (best == _buffers.end()) {
+                        best = std::max_element(_buffers.begin(), _buffers.end(),
+                                    [](const std::vector<T>& a, const std::vector<T>& b) { return a.capacity() < b.capacity(); });
+                    }
+                    buffer = std::move(*best);
+                    _buffers.erase(best);
+                }
+            }
+
+            buffer.clear();
+            buffer.reserve(capacity);
+            return buffer;
+        }
+
+        // Return a buffer to the pool; buffers beyond the pool limit are freed
+        void release(std::vector<T>&& buffer) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_buffers.size() < _maxBuffers) {
+                _buffers.push_back(std::move(buffer));
+            }
+        }
+
+        size_t size() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _buffers.size();
+        }
+
+    private:
+        size_t _maxBuffers;
+        std::vector<std::vector<T>> _buffers;
+        std::mutex _mutex;
+};
+
+#endif
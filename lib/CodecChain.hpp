@@ -0,0 +1,509 @@
+#ifndef CODEC_CHAIN_HPP
+#define CODEC_CHAIN_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+#include <zstd.h>
+
+#include "MyCompressor.hpp"
+#include "TrunkCompressor.hpp"
+#include "SZCompressor.hpp"
+#include "QuantCompressor.hpp"
+#include "Trace.hpp"
+
+// One step of a codec chain, transforming a byte buffer. Stages that work on floats read their input as floats, which
+// is only allowed while every stage before them has kept the data as floats.
+class ChainStage {
+    public:
+        virtual ~ChainStage() = default;
+
+        // Encode input into output, replacing its contents
+        virtual void encode(std::span<const uint8_t> input, std::vector<uint8_t>& output) = 0;
+
+        // Decode input into output, which has exactly the size of the input this stage encoded
+        virtual void decode(std::span<const uint8_t> input, std::span<uint8_t> output) = 0;
+
+        virtual bool needsFloats() const { return false; }
+        virtual bool keepsFloats() const { return false; }
+
+    protected:
+        // Size-preserving stages decode into a buffer of their input's size; anything else is a corrupt stream or the
+        // wrong uncompressed size, and would write past the output
+        static void _checkSameSize(const char* stage, std::span<const uint8_t> input, std::span<uint8_t> output) {
+            if (input.size() != output.size()) {
+                throw std::runtime_error(std::format("{}: size mismatch, {} bytes in, {} bytes out", stage, input.size(), output.size()));
+            }
+        }
+};
+
+// Any float compressor as the last float stage: trunk, sz or quant
+class CompressorStage : public ChainStage {
+    public:
+        explicit CompressorStage(std::unique_ptr<MyCompressor> compressor) : _compressor(std::move(compressor)) {}
+
+        void encode(std::span<const uint8_t> input, std::vector<uint8_t>& output) override {
+            _compressor->compressInto(_asFloats(input), output);
+        }
+
+        void decode(std::span<const uint8_t> input, std::span<uint8_t> output) override {
+            if (output.size() % sizeof(float) != 0) {
+                throw std::runtime_error("CompressorStage: output is not a whole number of floats");
+            }
+            _compressor->decompressInto(input, std::span<float>(reinterpret_cast<float*>(output.data()), output.size() / sizeof(float)));
+        }
+
+        bool needsFloats() const override { return true; }
+
+    private:
+        std::unique_ptr<MyCompressor> _compressor;
+
+        static std::span<const float> _asFloats(std::span<const uint8_t> bytes) {
+            return {reinterpret_cast<const float*>(bytes.data()), bytes.size() / sizeof(float)};
+        }
+};
+
+// Mantissa truncation without the entropy coder, the same rounding as TrunkCompressor
+class TruncateStage : public ChainStage {
+    public:
+        explicit TruncateStage(const int precision) : _truncator(precision, 0) {}
+
+        void encode(std::span<const uint8_t> input, std::vector<uint8_t>& output) override {
+            output.resize(input.size());
+            _truncator.truncateInto(std::span<const float>(reinterpret_cast<const float*>(input.data()), input.size() / sizeof(float)),
+                                    std::span<float>(reinterpret_cast<float*>(output.data()), output.size() / sizeof(float)));
+        }
+
+        // Truncation is lossy; the truncated values are the decoded values
+        void decode(std::span<const uint8_t> input, std::span<uint8_t> output) override {
+            _checkSameSize("TruncateStage", input, output);
+            std::copy(input.begin(), input.end(), output.begin());
+        }
+
+        bool needsFloats() const override { return true; }
+        bool keepsFloats() const override { return true; }
+
+    private:
+        TrunkCompressor _truncator;
+};
+
+// Byte transpose: byte b of every width-byte element goes into plane b, so the slowly changing sign and exponent bytes
+// end up next to each other. Trailing bytes that do not fill an element are copied as is.
+class ShuffleStage : public ChainStage {
+    public:
+        explicit ShuffleStage(const int width) : _width(width) {
+            if (width <= 0) {
+                throw std::invalid_argument("ShuffleStage: width must be greater than 0");
+            }
+        }
+
+        void encode(std::span<const uint8_t> input, std::vector<uint8_t>& output) override {
+            output.resize(input.size());
+            const size_t elements{input.size() / _width};
+            for (size_t b{0}; b < _width; ++b) {
+                for (size_t i{0}; i < elements; ++i) {
+                    output[b * elements + i] = input[i * _width + b];
+                }
+            }
+            std::copy(input.begin() + elements * _width, input.end(), output.begin() + elements * _width);
+        }
+
+        void decode(std::span<const uint8_t> input, std::span<uint8_t> output) override {
+            _checkSameSize("ShuffleStage", input, output);
+            const size_t elements{input.size() / _width};
+            for (size_t b{0}; b < _width; ++b) {
+                for (size_t i{0}; i < elements; ++i) {
+                    output[i * _width + b] = input[b * elements + i];
+                }
+            }
+            std::copy(input.begin() + elements * _width, input.end(), output.begin() + elements * _width);
+        }
+
+    private:
+        size_t _width;
+};
+
+// Wrapping difference of consecutive 32-bit words, lossless on any bytes; trailing bytes are copied as is
+class DeltaStage : public ChainStage {
+    public:
+        void encode(std::span<const uint8_t> input, std::vector<uint8_t>& output) override {
+            output.resize(input.size());
+            const size_t words{input.size() / sizeof(uint32_t)};
+            uint32_t previous{0};
+            for (size_t i{0}; i < words; ++i) {
+                uint32_t word;
+                std::memcpy(&word, input.data() + i * sizeof(uint32_t), sizeof(uint32_t));
+                const uint32_t delta{word - previous};
+                std::memcpy(output.data() + i * sizeof(uint32_t), &delta, sizeof(uint32_t));
+                previous = word;
+            }
+            std::copy(input.begin() + words * sizeof(uint32_t), input.end(), output.begin() + words * sizeof(uint32_t));
+        }
+
+        void decode(std::span<const uint8_t> input, std::span<uint8_t> output) override {
+            _checkSameSize("DeltaStage", input, output);
+            const size_t words{input.size() / sizeof(uint32_t)};
+            uint32_t previous{0};
+            for (size_t i{0}; i < words; ++i) {
+                uint32_t delta;
+                std::memcpy(&delta, input.data() + i * sizeof(uint32_t), sizeof(uint32_t));
+                previous += delta;
+                std::memcpy(output.data() + i * sizeof(uint32_t), &previous, sizeof(uint32_t));
+            }
+            std::copy(input.begin() + words * sizeof(uint32_t), input.end(), output.begin() + words * sizeof(uint32_t));
+        }
+};
+
+// Deflate on bytes, keeping the z_streams between calls
+class ZlibStage : public ChainStage {
+    public:
+        explicit ZlibStage(const int level) : _level(level) {
+            if (level < 0 || level > 9) {
+                throw std::invalid_argument("ZlibStage: level must be between 0 and 9");
+            }
+        }
+
+        ~ZlibStage() override {
+            if (_deflateReady) {
+                deflateEnd(&_deflateStream);
+            }
+            if (_inflateReady) {
+                inflateEnd(&_inflateStream);
+            }
+        }
+
+        ZlibStage(const ZlibStage&) = delete;
+        ZlibStage& operator=(const ZlibStage&) = delete;
+
+        void encode(std::span<const uint8_t> input, std::vector<uint8_t>& output) override {
+            int result{_deflateReady ? deflateReset(&_deflateStream) : deflateInit(&_deflateStream, _level)};
+            if (result != Z_OK) {
+                throw std::runtime_error("ZlibStage: failed to initialize deflate stream");
+            }
+            _deflateReady = true;
+
+            output.resize(deflateBound(&_deflateStream, input.size()));
+            _check(input.size(), output.size());
+            _deflateStream.next_in = const_cast<Bytef*>(input.data());
+            _deflateStream.avail_in = static_cast<uInt>(input.size());
+            _deflateStream.next_out = output.data();
+            _deflateStream.avail_out = static_cast<uInt>(output.size());
+            if (deflate(&_deflateStream, Z_FINISH) != Z_STREAM_END) {
+                throw std::runtime_error("ZlibStage: compression failed");
+            }
+            output.resize(_deflateStream.total_out);
+        }
+
+        void decode(std::span<const uint8_t> input, std::span<uint8_t> output) override {
+            int result{_inflateReady ? inflateReset(&_inflateStream) : inflateInit(&_inflateStream)};
+            if (result != Z_OK) {
+                throw std::runtime_error("ZlibStage: failed to initialize inflate stream");
+            }
+            _inflateReady = true;
+
+            _check(input.size(), output.size());
+            Bytef emptyOutput{};
+            _inflateStream.next_in = const_cast<Bytef*>(input.data());
+            _inflateStream.avail_in = static_cast<uInt>(input.size());
+            _inflateStream.next_out = output.empty() ? &emptyOutput : output.data();
+            _inflateStream.avail_out = static_cast<uInt>(output.size());
+            if (inflate(&_inflateStream, Z_FINISH) != Z_STREAM_END || _inflateStream.total_out != output.size()) {
+                throw std::runtime_error("ZlibStage: decompression failed");
+            }
+        }
+
+    private:
+        int _level;
+        z_stream _deflateStream{};
+        z_stream _inflateStream{};
+        bool _deflateReady{false};
+        bool _inflateReady{false};
+
+        // One deflate call per buffer, so both sides must fit in zlib's 32-bit counts; TrunkCompressor streams larger ones
+        static void _check(size_t inputSize, size_t outputSize) {
+            constexpr size_t maxSize{std::numeric_limits<uInt>::max()};
+            if (inputSize > maxSize || outputSize > maxSize) {
+                throw std::invalid_argument("ZlibStage: buffers larger than 4 GB are not supported");
+            }
+        }
+};
+
+// Zstandard on bytes, keeping the compression and decompression contexts between calls
+class ZstdStage : public ChainStage {
+    public:
+        // Contexts are owned by unique_ptrs so that a constructor which throws part way does not leak them
+        explicit ZstdStage(const int level)
+            : _level(level), _cctx(nullptr, &ZSTD_freeCCtx), _dctx(nullptr, &ZSTD_freeDCtx)
+        {
+            if (level < ZSTD_minCLevel() || level > ZSTD_maxCLevel()) {
+                throw std::invalid_argument(std::format("ZstdStage: level must be between {} and {}", ZSTD_minCLevel(), ZSTD_maxCLevel()));
+            }
+            _cctx.reset(ZSTD_createCCtx());
+            _dctx.reset(ZSTD_createDCtx());
+            if (!_cctx || !_dctx) {
+                throw std::runtime_error("ZstdStage: failed to create contexts");
+            }
+        }
+
+        void encode(std::span<const uint8_t> input, std::vector<uint8_t>& output) override {
+            output.resize(ZSTD_compressBound(input.size()));
+            const size_t size{ZSTD_compressCCtx(_cctx.get(), output.data(), output.size(), input.data(), input.size(), _level)};
+            if (ZSTD_isError(size)) {
+                throw std::runtime_error(std::format("ZstdStage: compression failed: {}", ZSTD_getErrorName(size)));
+            }
+            output.resize(size);
+        }
+
+        void decode(std::span<const uint8_t> input, std::span<uint8_t> output) override {
+            const size_t size{ZSTD_decompressDCtx(_dctx.get(), output.data(), output.size(), input.data(), input.size())};
+            if (ZSTD_isError(size) || size != output.size()) {
+                throw std::runtime_error("ZstdStage: decompression failed");
+            }
+        }
+
+    private:
+        int _level;
+        std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> _cctx;
+        std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> _dctx;
+};
+
+// Named stage factories. Stage specs are name:arg:arg, with defaults for missing trailing arguments; the trunk, sz
+// and quant arguments match the archive codec specs.
+class StageRegistry {
+    public:
+        using Factory = std::function<std::unique_ptr<ChainStage>(const std::vector<int>& arguments, bool debug)>;
+
+        static StageRegistry& instance() {
+            static StageRegistry registry{};
+            return registry;
+        }
+
+        // Register a stage; usage is shown when a spec names an unknown stage
+        void add(const std::string& name, const std::string& usage, Factory factory) {
+            if (name.empty() || name.find_first_of(":|") != std::string::npos) {
+                throw std::invalid_argument("StageRegistry: invalid stage name: " + name);
+            }
+            _factories[name] = {usage, std::move(factory)};
+        }
+
+        bool contains(const std::string& name) const {
+            return _factories.contains(name);
+        }
+
+        std::unique_ptr<ChainStage> create(const std::string& stageSpec, bool debug=false) const {
+            std::istringstream iss(stageSpec);
+            std::string name;
+            std::getline(iss, name, ':');
+
+            std::vector<int> arguments{};
+            std::string argument;
+            while (std::getline(iss, argument, ':')) {
+                arguments.push_back(std::stoi(argument));
+            }
+
+            const auto it{_factories.find(name)};
+            if (it == _factories.end()) {
+                throw std::invalid_argument(std::format("StageRegistry: unknown stage '{}'; known stages: {}", name, usage()));
+            }
+            return it->second.factory(arguments, debug);
+        }
+
+        std::string usage() const {
+            std::string stages{};
+            for (const auto& [name, entry] : _factories) {
+                stages += (stages.empty() ? "" : ", ") + entry.usage;
+            }
+            return stages;
+        }
+
+    private:
+        struct Entry {
+            std::string usage;
+            Factory factory;
+        };
+
+        std::map<std::string, Entry> _factories{};
+
+        StageRegistry() {
+            add("truncate", "truncate:precision", [](const std::vector<int>& args, bool) {
+                return std::make_unique<TruncateStage>(_argument(args, 0, 3));
+            });
+            add("shuffle", "shuffle[:width]", [](const std::vector<int>& args, bool) {
+                return std::make_unique<ShuffleStage>(_argument(args, 0, sizeof(float)));
+            });
+            add("delta", "delta", [](const std::vector<int>&, bool) {
+                return std::make_unique<DeltaStage>();
+            });
+            add("zlib", "zlib[:level]", [](const std::vector<int>& args, bool) {
+                return std::make_unique<ZlibStage>(_argument(args, 0, 6));
+            });
+            add("zstd", "zstd[:level]", [](const std::vector<int>& args, bool) {
+                return std::make_unique<ZstdStage>(_argument(args, 0, 3));
+            });
+            add("trunk", "trunk[:precision[:level]]", [](const std::vector<int>& args, bool debug) {
+                return std::make_unique<CompressorStage>(std::make_unique<TrunkCompressor>(_argument(args, 0, 3), _argument(args, 1, 9), debug));
+            });
+            add("sz", "sz[:precision[:errorBoundMode[:algo[:interpAlgo]]]]", [](const std::vector<int>& args, bool debug) {
+                return std::make_unique<CompressorStage>(std::make_unique<SZCompressor>(_argument(args, 0, 3), _argument(args, 1, SZ3::EB_REL),
+                                                            _argument(args, 2, SZ3::ALGO_LORENZO_REG), _argument(args, 3, SZ3::INTERP_ALGO_LINEAR), debug));
+            });
+            add("quant", "quant[:precision[:errorBoundMode]]", [](const std::vector<int>& args, bool debug) {
+                return std::make_unique<CompressorStage>(std::make_unique<QuantCompressor>(_argument(args, 0, 3), _argument(args, 1, QuantCompressor::REL), debug));
+            });
+        }
+
+        static int _argument(const std::vector<int>& arguments, size_t index, int defaultValue) {
+            return index < arguments.size() ? arguments[index] : defaultValue;
+        }
+};
+
+// Chain spec for a tool's --codec value: trunk, sz and quant take the tool's precision (and trunk its compression
+// level), with SZ3 and quant bounds relative to the value range; anything else is already a chain spec, e.g.
+// truncate:3|shuffle|zstd:5. Every argument is spelled out, so archives record the full spec. A single-stage chain
+// writes exactly what its compressor writes.
+std::string codecSpec(const std::string& codec, const int precision, const int trunkCompressionLevel) {
+    if (codec == "trunk") {
+        return std::format("trunk:{}:{}", precision, trunkCompressionLevel);
+    }
+    else if (codec == "sz") {
+        return std::format("sz:{}:{}:{}:{}", precision, static_cast<int>(SZ3::EB_REL),
+                            static_cast<int>(SZ3::ALGO_LORENZO_REG), static_cast<int>(SZ3::INTERP_ALGO_LINEAR));
+    }
+    else if (codec == "quant") {
+        return std::format("quant:{}:{}", precision, static_cast<int>(QuantCompressor::REL));
+    }
+    return codec;
+}
+
+// Float compressor built from a chain spec like "truncate:3|shuffle|zstd:5", applied left to right on compression.
+// The stream starts with the size of every intermediate buffer, so a single-stage chain writes exactly what its stage
+// writes on its own.
+class ChainCompressor : public MyCompressor {
+    public:
+        ChainCompressor(const std::string& spec, bool debug=false) : _spec(spec), _debug(debug) {
+            std::istringstream iss(spec);
+            std::string stageSpec;
+            bool floats{true};
+            while (std::getline(iss, stageSpec, '|')) {
+                std::unique_ptr<ChainStage> stage{StageRegistry::instance().create(stageSpec, debug)};
+                if (stage->needsFloats() && !floats) {
+                    throw std::invalid_argument(std::format("ChainCompressor: stage '{}' needs float input, but an earlier stage in '{}' changes the data to bytes",
+                                                            stageSpec, spec));
+                }
+                floats = floats && stage->keepsFloats();
+                _stageSpecs.push_back(stageSpec);
+                _stageNames.push_back(Trace::intern(stageSpec));
+                _stages.push_back(std::move(stage));
+            }
+            if (_stages.empty()) {
+                throw std::invalid_argument("ChainCompressor: empty chain");
+            }
+            _buffers.resize(_stages.size());
+        }
+
+        // Stages keep codec state, so a clone builds its own from the spec
+        std::unique_ptr<MyCompressor> clone() const override {
+            return std::make_unique<ChainCompressor>(_spec, _debug);
+        }
+
+        std::vector<uint8_t> compress(const std::vector<float>& data) override {
+            std::vector<uint8_t> compressedData{};
+            compressInto(data, compressedData);
+            return compressedData;
+        }
+
+        void compressInto(std::span<const float> data, std::vector<uint8_t>& compressedData) override {
+            std::span<const uint8_t> input{reinterpret_cast<const uint8_t*>(data.data()), data.size_bytes()};
+            for (size_t stage{0}; stage < _stages.size(); ++stage) {
+                {
+                    TraceSpan span("ChainCompressor", _stageNames[stage], _debug, input.size());
+                    _stages[stage]->encode(input, _buffers[stage]);
+                }
+                input = _buffers[stage];
+
+                if (_debug) {
+                    std::cerr << std::format("[DEBUG ChainCompressor]: stage {} '{}' output {} bytes", stage, _stageSpecs[stage], input.size()) << std::endl;
+                }
+            }
+
+            // Intermediate sizes, then the last stage's output
+            TraceSpan span("ChainCompressor", "copy-out", _debug, input.size());
+            compressedData.clear();
+            for (size_t stage{0}; stage + 1 < _stages.size(); ++stage) {
+                const uint64_t size{_buffers[stage].size()};
+                compressedData.insert(compressedData.end(), reinterpret_cast<const uint8_t*>(&size), reinterpret_cast<const uint8_t*>(&size) + sizeof(size));
+            }
+            compressedData.insert(compressedData.end(), input.begin(), input.end());
+        }
+
+        std::vector<float> decompress(const std::vector<uint8_t>& compressedData, const size_t& uncompressedSize) override {
+            std::vector<float> decompressedData(uncompressedSize);
+            decompressInto(compressedData, decompressedData);
+            return decompressedData;
+        }
+
+        void decompressInto(std::span<const uint8_t> compressedData, std::span<float> decompressedData) override {
+            const size_t headerSize{(_stages.size() - 1) * sizeof(uint64_t)};
+            if (compressedData.size() < headerSize) {
+                throw std::runtime_error("ChainCompressor: truncated stream");
+            }
+
+            // Recorded sizes come from the stream, so they are checked before anything is allocated: no stage writes more
+            // than MAX_EXPANSION times the chain's input plus its headers
+            const size_t outputBytes{decompressedData.size_bytes()};
+            const uint64_t maxSize{MAX_EXPANSION * static_cast<uint64_t>(outputBytes) + MAX_HEADER_BYTES};
+
+            // Run the stages backwards, each decoding into a buffer of its recorded input size; the first stage decodes
+            // straight into the caller's buffer, and every stage checks that its output has the size it expects
+            std::span<const uint8_t> input{compressedData.subspan(headerSize)};
+            for (size_t stage{_stages.size()}; stage-- > 0;) {
+                std::span<uint8_t> output{reinterpret_cast<uint8_t*>(decompressedData.data()), outputBytes};
+                if (stage > 0) {
+                    uint64_t size;
+                    std::memcpy(&size, compressedData.data() + (stage - 1) * sizeof(uint64_t), sizeof(size));
+                    if (size > maxSize) {
+                        throw std::runtime_error(std::format("ChainCompressor: stage {} size {} is too large for {} output bytes", stage, size, outputBytes));
+                    }
+                    _buffers[stage - 1].resize(size);
+                    output = _buffers[stage - 1];
+                }
+                {
+                    TraceSpan span("ChainCompressor", _stageNames[stage], _debug, output.size());
+                    _stages[stage]->decode(input, output);
+                }
+                input = output;
+            }
+        }
+
+        const std::string& getSpec() const { return _spec; }
+
+    private:
+        // Bounds on what a stage may write for its input: the codecs store values they cannot predict raw, plus
+        // escapes, and the byte coders add at most a few percent
+        static constexpr uint64_t MAX_EXPANSION{4};
+        static constexpr uint64_t MAX_HEADER_BYTES{1 << 20};
+
+        std::string _spec;
+        bool _debug;
+        std::vector<std::string> _stageSpecs{};
+        std::vector<const char*> _stageNames{};     // Stage specs as trace span names
+        std::vector<std::unique_ptr<ChainStage>> _stages{};
+
+        // Output of each stage on compression, and input of the next stage on decompression; capacity is kept between calls
+        std::vector<std::vector<uint8_t>> _buffers{};
+};
+
+#endif
@@ -0,0 +1,356 @@
+#ifndef COLUMN_VIEW_HPP
+#define COLUMN_VIEW_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <compare>
+#include <condition_variable>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Archive.hpp"
+#include "BlockCache.hpp"
+
+// Lazy, read-only view of one archive column as a random-access range, for analysis code that scans a column once
+// instead of holding all of it: float for float columns, uint32_t for uint32 columns, uint8_t for bool columns.
+// Blocks are decoded on first access into a small LRU cache of decoded blocks, so memory stays at cacheBlocks blocks
+// however long the column is. With prefetch, touching block b also starts decoding block b + 1 on a background thread,
+// so a forward scan overlaps decoding the next block with computing on the current one.
+// Iterators hold the block they point into, so they stay valid when the cache evicts it. The reader must outlive the
+// view. A view is meant for one thread; give each thread its own view.
+// Views on several threads can also share a BlockCache: a block missing from the view's own cache is looked up there
+// before it is decoded, and blocks the view decodes are offered to it, so threads scanning the same column decode each
+// block once between them. The shared cache must outlive the view.
+template <typename T>
+class ColumnView {
+    public:
+        using Block = std::shared_ptr<const std::vector<T>>;
+
+        ColumnView(const ArchiveReader& reader, const std::string& name, const size_t cacheBlocks=4, bool prefetch=true,
+                   BlockCache* sharedCache=nullptr, bool debug=false)
+            : _reader(reader), _column(reader.getColumn(name)), _cacheBlocks(std::max<size_t>(cacheBlocks, 2)),
+              _sharedCache(sharedCache), _debug(debug)
+        {
+            if (_column.dataType != _expectedType()) {
+                throw std::invalid_argument("ColumnView: column " + name + " has a different type");
+            }
+            _columnIndex = static_cast<uint32_t>(&_column - reader.getColumns().data());
+
+            // First value of each block, for locating an index
+            _blockStarts.reserve(_column.blocks.size() + 1);
+            _blockStarts.push_back(0);
+            for (const ArchiveBlock& block : _column.blocks) {
+                _blockStarts.push_back(_blockStarts.back() + block.numValues);
+            }
+
+            _decode = _makeDecoder();
+            if (prefetch && _column.blocks.size() > 1) {
+                _prefetchDecode = _makeDecoder();
+                _prefetcher = std::thread([this] { _prefetchLoop(); });
+            }
+        }
+
+        ~ColumnView() {
+            if (_prefetcher.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _stop = true;
+                }
+                _changed.notify_all();
+                _prefetcher.join();
+            }
+        }
+
+        ColumnView(const ColumnView&) = delete;
+        ColumnView& operator=(const ColumnView&) = delete;
+
+        class Iterator {
+            public:
+                using iterator_concept = std::random_access_iterator_tag;
+                using iterator_category = std::input_iterator_tag;     // Values are returned by value
+                using value_type = T;
+                using difference_type = std::ptrdiff_t;
+                using reference = T;
+
+                Iterator() {}
+                Iterator(ColumnView* view, size_t index) : _view(view), _index(index) {}
+
+                T operator*() const {
+                    if (!_block || _index < _blockBegin || _index >= _blockEnd) {
+                        const size_t b{_view->blockOf(_index)};
+                        _block = _view->getBlock(b);
+                        _blockBegin = _view->_blockStarts[b];
+                        _blockEnd = _view->_blockStarts[b + 1];
+                    }
+                    return (*_block)[_index - _blockBegin];
+                }
+
+                T operator[](difference_type n) const { return *(*this + n); }
+
+                Iterator& operator++() { ++_index; return *this; }
+                Iterator operator++(int) { Iterator previous{*this}; ++_index; return previous; }
+                Iterator& operator--() { --_index; return *this; }
+                Iterator operator--(int) { Iterator previous{*this}; --_index; return previous; }
+                Iterator& operator+=(difference_type n) { _index += n; return *this; }
+                Iterator& operator-=(difference_type n) { _index -= n; return *this; }
+
+                friend Iterator operator+(Iterator it, difference_type n) { return it += n; }
+                friend Iterator operator+(difference_type n, Iterator it) { return it += n; }
+                friend Iterator operator-(Iterator it, difference_type n) { return it -= n; }
+                friend difference_type operator-(const Iterator& a, const Iterator& b) {
+                    return static_cast<difference_type>(a._index) - static_cast<difference_type>(b._index);
+                }
+
+                friend bool operator==(const Iterator& a, const Iterator& b) { return a._index == b._index; }
+                friend std::strong_ordering operator<=>(const Iterator& a, const Iterator& b) { return a._index <=> b._index; }
+
+            private:
+                ColumnView* _view{nullptr};
+                size_t _index{0};
+
+                // Block the iterator last read from
+                mutable Block _block{};
+                mutable size_t _blockBegin{0};
+                mutable size_t _blockEnd{0};
+        };
+
+        Iterator begin() { return Iterator(this, 0); }
+        Iterator end() { return Iterator(this, size()); }
+
+        size_t size() const { return _column.numValues; }
+        bool empty() const { return size() == 0; }
+
+        // Random access, decoding the block if it is not cached; a forward loop is faster through the iterators
+        T operator[](size_t index) {
+            const size_t b{blockOf(index)};
+            return (*getBlock(b))[index - _blockStarts[b]];
+        }
+
+        T at(size_t index) {
+            if (index >= size()) {
+                throw std::out_of_range(std::format("ColumnView: index {} out of range for {} values", index, size()));
+            }
+            return (*this)[index];
+        }
+
+        size_t blockOf(size_t index) const {
+            return static_cast<size_t>(std::upper_bound(_blockStarts.begin(), _blockStarts.end(), index) - _blockStarts.begin()) - 1;
+        }
+
+        // Decoded block, from the cache or the prefetcher if it has it
+        Block getBlock(size_t b) {
+            if (b >= _column.blocks.size()) {
+                throw std::out_of_range(std::format("ColumnView: block {} out of range for {} blocks", b, _column.blocks.size()));
+            }
+
+            Block block{};
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                block = _lookup(b);
+                if (!block && _decoding == b) {
+                    // Already being prefetched; waiting is cheaper than decoding it twice
+                    _changed.wait(lock, [this, b] { return _decoding != b; });
+                    block = _lookup(b);
+                    ++_prefetchWaits;
+                }
+                if (block) {
+                    ++_hits;
+                }
+                else if (_requested == b) {
+                    _requested.reset();     // Decoded here instead
+                }
+            }
+
+            if (!block) {
+                block = _sharedLookup(b);
+                if (block) {
+                    ++_sharedHits;
+                }
+                else {
+                    ++_misses;
+                    block = _share(b, _decodeBlock(b, _decode));
+                }
+                std::lock_guard<std::mutex> lock(_mutex);
+                _insert(b, block);
+            }
+
+            _prefetch(b + 1);
+            return block;
+        }
+
+        // Getters
+        const ArchiveColumn& getColumn() const { return _column; }
+        size_t getCacheBlocks() const { return _cacheBlocks; }
+        size_t getHits() const { return _hits; }                   // Blocks found cached, including prefetched ones
+        size_t getMisses() const { return _misses; }               // Blocks decoded on the calling thread
+        size_t getSharedHits() const { return _sharedHits; }       // Blocks found in the shared cache instead
+        size_t getPrefetched() const { return _prefetched.load(); } // Blocks decoded by the prefetcher
+        size_t getPrefetchWaits() const { return _prefetchWaits; } // Accesses that waited for the prefetcher to finish
+
+    private:
+        using Decoder = std::function<void(std::span<const uint8_t>, std::span<T>)>;
+
+        const ArchiveReader& _reader;
+        const ArchiveColumn& _column;
+        size_t _cacheBlocks;
+        BlockCache* _sharedCache;
+        bool _debug;
+        uint32_t _columnIndex{0};
+
+        std::vector<size_t> _blockStarts{};
+        Decoder _decode{};
+
+        // Most recently used block first
+        std::list<std::pair<size_t, Block>> _cache{};
+
+        // The prefetcher has its own codec, since codecs keep per-call state
+        Decoder _prefetchDecode{};
+        std::thread _prefetcher{};
+        std::mutex _mutex{};
+        std::condition_variable _changed{};
+        std::optional<size_t> _requested{};
+        std::optional<size_t> _decoding{};
+        bool _stop{false};
+
+        size_t _hits{0};
+        size_t _misses{0};
+        size_t _sharedHits{0};
+        std::atomic<size_t> _prefetched{0};
+        size_t _prefetchWaits{0};
+
+        static int _expectedType() {
+            if constexpr (std::is_same_v<T, float>) {
+                return ArchiveColumn::FLOAT;
+            }
+            else if constexpr (std::is_same_v<T, uint32_t>) {
+                return ArchiveColumn::UINT32;
+            }
+            else {
+                static_assert(std::is_same_v<T, uint8_t>, "ColumnView: float, uint32_t or uint8_t columns only");
+                return ArchiveColumn::BOOL;
+            }
+        }
+
+        Decoder _makeDecoder() const {
+            if constexpr (std::is_same_v<T, float>) {
+                std::shared_ptr<MyCompressor> compressor{makeFloatCodec(_column.codec)};
+                return [compressor](std::span<const uint8_t> block, std::span<float> output) { compressor->decompressInto(block, output); };
+            }
+            else if constexpr (std::is_same_v<T, uint32_t>) {
+                std::shared_ptr<IntegerCompressor> compressor{std::make_shared<IntegerCompressor>(codecMode(_column.codec, "int"))};
+                return [compressor](std::span<const uint8_t> block, std::span<uint32_t> output) { compressor->decompressInto(block, output); };
+            }
+            else {
+                std::shared_ptr<BooleanCompressor> compressor{std::make_shared<BooleanCompressor>(codecMode(_column.codec, "bool"))};
+                return [compressor](std::span<const uint8_t> block, std::span<uint8_t> output) { compressor->decompressInto(block, output); };
+            }
+        }
+
+        Block _decodeBlock(size_t b, const Decoder& decode) const {
+            const ArchiveBlock& block{_column.blocks[b]};
+            std::shared_ptr<std::vector<T>> values{std::make_shared<std::vector<T>>(block.numValues)};
+            decode(_reader.getBlockData(block), *values);
+            if (_debug) {
+                std::cerr << std::format("[DEBUG ColumnView]: column = {}, block = {}, values = {}", _column.name, b, block.numValues) << std::endl;
+            }
+            return values;
+        }
+
+        BlockKey _sharedKey(size_t b) const {
+            return BlockKey{_reader.getFileId(), _columnIndex, static_cast<uint32_t>(b)};
+        }
+
+        Block _sharedLookup(size_t b) const {
+            return _sharedCache ? _sharedCache->find<T>(_sharedKey(b)) : nullptr;
+        }
+
+        // Offer a decoded block to the shared cache, and keep its copy if another view got there first
+        Block _share(size_t b, Block block) const {
+            return _sharedCache ? _sharedCache->insert<T>(_sharedKey(b), std::move(block)) : block;
+        }
+
+        // Both need the lock
+        Block _lookup(size_t b) {
+            for (auto it{_cache.begin()}; it != _cache.end(); ++it) {
+                if (it->first == b) {
+                    _cache.splice(_cache.begin(), _cache, it);
+                    return it->second;
+                }
+            }
+            return nullptr;
+        }
+
+        void _insert(size_t b, Block block) {
+            for (auto it{_cache.begin()}; it != _cache.end(); ++it) {
+                if (it->first == b) {
+                    _cache.erase(it);
+                    break;
+                }
+            }
+            _cache.emplace_front(b, std::move(block));
+            while (_cache.size() > _cacheBlocks) {
+                _cache.pop_back();
+            }
+        }
+
+        void _prefetch(size_t b) {
+            if (!_prefetcher.joinable() || b >= _column.blocks.size()) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (_decoding == b || std::any_of(_cache.begin(), _cache.end(), [b](const auto& entry) { return entry.first == b; })) {
+                    return;
+                }
+                _requested = b;     // Replaces an older request the prefetcher has not started
+            }
+            _changed.notify_all();
+        }
+
+        void _prefetchLoop() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true) {
+                _changed.wait(lock, [this] { return _requested || _stop; });
+                if (_stop) {
+                    return;
+                }
+                const size_t b{*_requested};
+                _requested.reset();
+                _decoding = b;
+
+                lock.unlock();
+                Block block{_sharedLookup(b)};
+                try {
+                    if (!block) {
+                        block = _share(b, _decodeBlock(b, _prefetchDecode));
+                    }
+                }
+                catch (...) {
+                    // Left to the reading thread, which decodes the block itself and sees the error
+                }
+                lock.lock();
+
+                if (block) {
+                    _insert(b, std::move(block));
+                    ++_prefetched;
+                }
+                _decoding.reset();
+                _changed.notify_all();
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,292 @@
+#ifndef COMPRESSION_ESTIMATOR_HPP
+#define COMPRESSION_ESTIMATOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CodecChain.hpp"
+#include "utils.hpp"
+
+// Predicted ratio and throughput of one codec chain on one array
+struct CompressionEstimate {
+    std::string codec;
+    double ratio;
+    double compressionMBps;
+    double decompressionMBps;
+    double bitsPerValue;        // Order-0 entropy of what the chain's entropy coder sees, per value, on the sample
+};
+
+// Predicts a codec chain's ratio and throughput on an array without compressing the array, to rank candidates before
+// trial-compressing the few worth measuring.
+// Two samples of evenly spaced contiguous blocks are taken: a statistics sample of sampleMB, and a much smaller probe.
+// On both, the estimator computes the order-0 entropy of what the chain's entropy coder works on:
+//   - truncate/trunk chains: the four byte planes of the truncated bit patterns, after the delta stage if there is one
+//   - quant/sz chains: the quantized residuals at the chain's error bound, with the predictor QuantCompressor would
+//     pick and escapes included
+//   - anything else: the byte planes of the raw bit patterns
+// The probe is compressed with the real chain, which measures how far the codec is from that entropy and how fast it
+// runs. The ratio on the whole array is the probe's ratio scaled by the probe's entropy over the sample's entropy, so
+// the sample captures how the data varies along the array and the probe captures what the codec makes of it.
+// Throughput is the probe's, best of the given iterations. Keep the probe above 256 KB: below that, zstd switches to
+// parameters tuned for small inputs, and its fast levels compress noticeably worse than they do on the whole array.
+// The cost is fixed by the sample and probe sizes, apart from one pass over the array for its value range when a chain
+// quantizes, so the saving over compressing the array grows with the array.
+// On noisy physics-like data the ratio lands within 5%, and throughput within a factor of a few since the probe runs hot
+// in cache. Smooth or periodic data, where the LZ coders find matches no order-0 statistic sees, comes out low:
+// estimates err towards the lower ratio, so prune with a margin.
+class CompressionEstimator {
+    public:
+        CompressionEstimator(const double sampleMB=4, const double probeKB=1024, const int iterations=1, bool debug=false)
+            : _iterations(iterations), _debug(debug)
+        {
+            if (sampleMB <= 0 || probeKB <= 0 || iterations <= 0) {
+                throw std::invalid_argument("sampleMB, probeKB and iterations must be greater than 0");
+            }
+            _sampleSize = std::max<size_t>(1, static_cast<size_t>(sampleMB * MB) / sizeof(float));
+            _probeSize = std::max<size_t>(1, static_cast<size_t>(probeKB * KB) / sizeof(float));
+        }
+
+        CompressionEstimate estimate(std::span<const float> data, const std::string& codec) {
+            return estimateAll(data, {codec}).front();
+        }
+
+        // The samples, and the entropy of each distinct transform, are shared by all codecs
+        std::vector<CompressionEstimate> estimateAll(std::span<const float> data, const std::vector<std::string>& codecs) {
+            const std::vector<float> sample{sampleBlocks(data, _sampleSize, SAMPLE_BLOCK_SIZE)};
+            const std::vector<float> probe{sampleBlocks(data, _probeSize, PROBE_BLOCK_SIZE)};
+            const double probeMB{static_cast<double>(probe.size() * sizeof(float)) / MB};
+
+            std::map<Transform, std::pair<double, double>> entropies{};
+            std::vector<CompressionEstimate> estimates{};
+            std::vector<uint8_t> compressed{};
+            std::vector<float> decompressed(probe.size());
+            for (const std::string& codec : codecs) {
+                const Transform transform{_transformOf(codec)};
+                auto it{entropies.find(transform)};
+                if (it == entropies.end()) {
+                    it = entropies.emplace(transform, std::make_pair(_bitsPerValue(sample, data, transform), _bitsPerValue(probe, probe, transform))).first;
+                }
+                const auto [sampleBits, probeBits] = it->second;
+
+                ChainCompressor compressor(codec);
+                double compressionTime{std::numeric_limits<double>::max()};
+                double decompressionTime{std::numeric_limits<double>::max()};
+                for (int iteration{0}; iteration < _iterations; ++iteration) {
+                    std::chrono::high_resolution_clock::time_point start{std::chrono::high_resolution_clock::now()};
+                    compressor.compressInto(probe, compressed);
+                    compressionTime = std::min(compressionTime, elapsedSeconds(start));
+
+                    start = std::chrono::high_resolution_clock::now();
+                    compressor.decompressInto(compressed, decompressed);
+                    decompressionTime = std::min(decompressionTime, elapsedSeconds(start));
+                }
+
+                const double probeRatio{compressed.empty() ? 0.0 : static_cast<double>(probe.size() * sizeof(float)) / static_cast<double>(compressed.size())};
+                CompressionEstimate estimate{codec,
+                                             probeRatio * std::max(probeBits, MIN_BITS) / std::max(sampleBits, MIN_BITS),
+                                             compressionTime > 0 ? probeMB / compressionTime : 0.0,
+                                             decompressionTime > 0 ? probeMB / decompressionTime : 0.0,
+                                             sampleBits};
+                estimates.push_back(estimate);
+
+                if (_debug) {
+                    std::cerr << std::format("[DEBUG CompressionEstimator]: codec = {}, sample bits = {:.3f}, probe bits = {:.3f}, probe ratio = {:.3f}, "
+                                                "ratio = {:.3f}, compression = {:.1f} MB/s, decompression = {:.1f} MB/s",
+                                                codec, sampleBits, probeBits, probeRatio, estimate.ratio,
+                                                estimate.compressionMBps, estimate.decompressionMBps) << std::endl;
+                }
+            }
+            return estimates;
+        }
+
+        // Getters
+        size_t getSampleSize() const { return _sampleSize; }
+        size_t getProbeSize() const { return _probeSize; }
+
+    private:
+        // Contiguous runs, so neighbouring values still look like neighbours to the codecs and the predictor
+        static constexpr size_t SAMPLE_BLOCK_SIZE{16384};
+        static constexpr size_t PROBE_BLOCK_SIZE{16384};
+
+        // Keeps near-constant data from dividing by zero; such data compresses to its headers either way
+        static constexpr double MIN_BITS{1e-3};
+
+        // As QuantCompressor codes residuals: zigzag symbols from FIRST_RESIDUAL, ESCAPE_SYMBOL plus a varint beyond
+        static constexpr size_t ESCAPE_SYMBOL{1};
+        static constexpr size_t FIRST_RESIDUAL{2};
+        static constexpr size_t MAX_ALPHABET_SIZE{4096};
+        static constexpr double ESCAPE_BITS{24};
+        static constexpr size_t PREDICTOR_SAMPLE{65536};
+
+        // What the chain's entropy coder sees: truncated bits (with delta), or residuals at an error bound
+        struct Transform {
+            enum KIND{BYTES, RESIDUALS};
+
+            int kind{BYTES};
+            int truncatedBits{0};
+            bool delta{false};
+            double errorBound{0};       // Residuals only
+            bool relative{true};
+
+            auto operator<=>(const Transform&) const = default;
+        };
+
+        size_t _sampleSize;
+        size_t _probeSize;
+        int _iterations;
+        bool _debug;
+
+        static Transform _transformOf(const std::string& codec) {
+            Transform transform{};
+            std::istringstream stages(codec);
+            std::string stage;
+            while (std::getline(stages, stage, '|')) {
+                std::istringstream iss(stage);
+                std::string name;
+                std::getline(iss, name, ':');
+                std::vector<int> arguments{};
+                std::string argument;
+                while (std::getline(iss, argument, ':')) {
+                    arguments.push_back(std::stoi(argument));
+                }
+                const int precision{arguments.empty() ? 3 : arguments[0]};
+
+                if (name == "truncate" || name == "trunk") {
+                    transform.truncatedBits = TrunkCompressor(precision, 0).getBitsTruncated();
+                }
+                else if (name == "delta") {
+                    transform.delta = true;
+                }
+                else if (name == "quant" || name == "sz") {
+                    // Both default to a bound relative to the value range; mode 0 is absolute for both
+                    transform.kind = Transform::RESIDUALS;
+                    transform.errorBound = 0.5 * std::pow(10, -precision);
+                    transform.relative = arguments.size() < 2 || arguments[1] != 0;
+                }
+            }
+            return transform;
+        }
+
+        static double _bitsPerValue(std::span<const float> values, std::span<const float> whole, const Transform& transform) {
+            if (values.empty()) {
+                return 0;
+            }
+            return transform.kind == Transform::RESIDUALS ? _residualBits(values, whole, transform) : _byteBits(values, transform);
+        }
+
+        // Sum of the order-0 entropies of the four byte planes
+        static double _byteBits(std::span<const float> values, const Transform& transform) {
+            std::array<std::array<uint32_t, 256>, sizeof(float)> planes{};
+            const uint32_t keepMask{~((1u << transform.truncatedBits) - 1u)};
+            constexpr uint32_t exponentMask{0x7F800000u};
+            uint32_t previous{0};
+            for (float value : values) {
+                uint32_t bits{std::bit_cast<uint32_t>(value)};
+                if ((bits & exponentMask) != exponentMask) {
+                    bits &= keepMask;
+                }
+                const uint32_t word{transform.delta ? bits - previous : bits};
+                previous = bits;
+                for (size_t b{0}; b < sizeof(float); ++b) {
+                    ++planes[b][(word >> (8 * b)) & 0xFF];
+                }
+            }
+
+            double bits{0};
+            for (const std::array<uint32_t, 256>& plane : planes) {
+                bits += _entropy(plane, values.size());
+            }
+            return bits / static_cast<double>(values.size());
+        }
+
+        // Residuals of the predictor QuantCompressor would pick, quantized without error feedback. whole is the array
+        // the codec is given: its range sets a relative bound and the midrange, and the codec picks the predictor on
+        // its first PREDICTOR_SAMPLE values. The range of a sample can be well short of the array's on long-tailed
+        // data, which changes the step and can flip the predictor choice.
+        static double _residualBits(std::span<const float> values, std::span<const float> whole, const Transform& transform) {
+            float minValue{std::numeric_limits<float>::max()};
+            float maxValue{std::numeric_limits<float>::lowest()};
+            for (float value : whole) {
+                if (std::isfinite(value)) {
+                    minValue = std::min(minValue, value);
+                    maxValue = std::max(maxValue, value);
+                }
+            }
+            if (maxValue < minValue) {
+                return 0;
+            }
+            const double absErrorBound{transform.relative ? transform.errorBound * (static_cast<double>(maxValue) - minValue) : transform.errorBound};
+            if (absErrorBound <= 0) {
+                return sizeof(float) * 8;     // Stored raw
+            }
+            const double step{2 * absErrorBound};
+            const double midrange{0.5 * (static_cast<double>(minValue) + maxValue)};
+
+            // The codec compares residual magnitudes only, so the choice is made the same way here
+            std::vector<uint32_t> lorenzo(MAX_ALPHABET_SIZE, 0);
+            std::vector<uint32_t> middle(MAX_ALPHABET_SIZE, 0);
+            float previous{0};
+            size_t finite{0};
+            for (float value : whole.first(std::min(whole.size(), PREDICTOR_SAMPLE))) {
+                if (std::isfinite(value)) {
+                    ++lorenzo[_symbol(std::abs(std::round((static_cast<double>(value) - previous) / step)) * 2)];
+                    ++middle[_symbol(std::abs(std::round((static_cast<double>(value) - midrange) / step)) * 2)];
+                    previous = value;
+                    ++finite;
+                }
+            }
+            const bool useMidrange{_entropy(middle, finite) + ESCAPE_BITS * middle[ESCAPE_SYMBOL]
+                                   < _entropy(lorenzo, finite) + ESCAPE_BITS * lorenzo[ESCAPE_SYMBOL]};
+
+            // Then the signed residuals the codec actually codes
+            std::vector<uint32_t> residuals(MAX_ALPHABET_SIZE, 0);
+            previous = useMidrange ? static_cast<float>(midrange) : 0.0f;
+            finite = 0;
+            for (float value : values) {
+                if (std::isfinite(value)) {
+                    const double quantized{std::round((static_cast<double>(value) - previous) / step)};
+                    ++residuals[_symbol(quantized < 0 ? -2 * quantized - 1 : 2 * quantized)];
+                    if (!useMidrange) {
+                        previous = value;
+                    }
+                    ++finite;
+                }
+            }
+
+            const double codedBits{_entropy(residuals, finite) + ESCAPE_BITS * residuals[ESCAPE_SYMBOL]};
+            const double rawBits{static_cast<double>(values.size() - finite) * sizeof(float) * 8};
+            return (codedBits + rawBits) / static_cast<double>(values.size());
+        }
+
+        static size_t _symbol(double zigzag) {
+            return zigzag < MAX_ALPHABET_SIZE - FIRST_RESIDUAL ? static_cast<size_t>(zigzag) + FIRST_RESIDUAL : ESCAPE_SYMBOL;
+        }
+
+        // Total bits of an order-0 code for a histogram of total counts
+        template <typename Histogram>
+        static double _entropy(const Histogram& histogram, size_t total) {
+            double bits{0};
+            for (uint32_t count : histogram) {
+                if (count) {
+                    bits -= count * std::log2(static_cast<double>(count) / static_cast<double>(total));
+                }
+            }
+            return bits;
+        }
+
+};
+
+#endif
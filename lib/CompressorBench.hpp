@@ -1,9 +1,14 @@
 #ifndef COMPRESSOR_BENCH_HPP
 #define COMPRESSOR_BENCH_HPP
 
+#include <algorithm>
+#include <cmath>
 #include <format>
 #include <fstream>
 #include <functional>
+#include <memory>
+#include <numeric>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -12,36 +17,81 @@
 #include <unistd.h>
 
 #include "utils.hpp"
+#include "BufferPool.hpp"
+#include "DictionaryTrainer.hpp"
 #include "TrunkCompressor.hpp"
 #include "SZCompressor.hpp"
+#include "SZAutoTuner.hpp"
+#include "QuantCompressor.hpp"
+#include "IntegerCompressor.hpp"
+#include "BooleanCompressor.hpp"
+#include "MultiColumnCompressor.hpp"
+#include "CodecChain.hpp"
+#include "Report.hpp"
 // #include "SZZlibCompressor.hpp"
 
 struct BenchmarkParams {
     bool doTrunk;
     bool doSZ;
+    bool doQuant;
     bool sortData;
 
     int iterations;
     int precision;
     bool debug;
 
+    int warmup;
+    bool flushCache;
+    bool freshInput;
+
     double dataMB;
+    double basketKB;
     std::string dataName;
     std::string sourceFile;
     std::string treeName;
     std::string branchName;
+    std::string branchGroup;
 
     int seed;
+    int threads;
     float mean;
     float stddev;
+    float minValue;
+    float maxValue;
+    float ptMin;
+    float ptMean;
+    float tailIndex;
+    float multiplicity;
 
     int trunkCompressionLevel;
+    std::string trunkDictionary;
 
     int szErrorBoundMode;
     int szAlgo;
     int szInterpAlgo;
+    double szMaxError;
+    std::string szTuneCache;
+    std::string szLayout;
+
+    int quantErrorBoundMode;
+
+    std::string chain;
 
     std::string reportType;
+    bool reportHeader;
+
+    std::string traceFile;      // Chrome trace JSON of the codec stages; empty to leave tracing off
+};
+
+// Joint or summed per-branch result for a group of aligned branches
+struct GroupResult {
+    std::string name;
+    size_t compressedDataSize;
+    double compressionTime;     // ms
+    double decompressionTime;   // ms
+    std::vector<double> avgRelativeError;
+    std::vector<double> compressionTimes;       // ms per iteration, summed over branches
+    std::vector<double> decompressionTimes;     // ms per iteration, summed over branches
 };
 
 struct TimeCollector {
@@ -50,34 +100,93 @@ struct TimeCollector {
     double real;
 };
 
+// Distribution of per-call latencies, in microseconds
+struct LatencyStats {
+    size_t count;
+    double mean;
+    double min;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+};
+
+LatencyStats summarizeLatencies(std::vector<double> samples) {
+    LatencyStats stats{0, 0, 0, 0, 0, 0, 0};
+    if (samples.empty()) {
+        return stats;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    // Nearest-rank percentile
+    auto percentile = [&samples](double p) {
+        size_t rank{static_cast<size_t>(std::ceil(p * samples.size()))};
+        return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+    };
+
+    stats.count = samples.size();
+    stats.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    stats.min = samples.front();
+    stats.p50 = percentile(0.50);
+    stats.p90 = percentile(0.90);
+    stats.p99 = percentile(0.99);
+    stats.max = samples.back();
+
+    return stats;
+}
+
 BenchmarkParams parseArguments(int argc, char* argv[]) {
     // Set default parameters
     BenchmarkParams params;
 
     params.doTrunk = false;
     params.doSZ = true;
+    params.doQuant = false;
     params.sortData = false;
 
     params.iterations = 5;
     params.precision = 3;
     params.debug = false;
 
+    params.warmup = 0;
+    params.flushCache = false;
+    params.freshInput = false;
+
     params.dataMB = 0;
+    params.basketKB = 0;
     params.dataName = "root";
     params.sourceFile = "mc_361106.Zee.1largeRjet1lep.root";
     params.treeName = "mini";
     params.branchName = "lep_pt";
+    params.branchGroup = "";
 
     params.seed = 12345;
+    params.threads = 0;
     params.mean = 0.0;
     params.stddev = 1.0f;
+    params.minValue = -1.0f;
+    params.maxValue = 1.0f;
+    params.ptMin = 25000.0f;     // MeV, as in the ATLAS trees
+    params.ptMean = 20000.0f;
+    params.tailIndex = 3.0f;
+    params.multiplicity = 3.0f;
 
     params.trunkCompressionLevel = 9;
+    params.trunkDictionary = "";
     params.szErrorBoundMode = SZ3::EB_REL;
     params.szAlgo = SZ3::ALGO_LORENZO_REG;
     params.szInterpAlgo = SZ3::INTERP_ALGO_LINEAR;
+    params.szMaxError = 0;
+    params.szTuneCache = "";
+    params.szLayout = "flat";
+    params.quantErrorBoundMode = QuantCompressor::REL;
+    params.chain = "";
 
     params.reportType = "formatted";
+    params.reportHeader = true;
+
+    params.traceFile = "";
 
     // Read parameters
     for (int i{1}; i < argc; ++i) {
@@ -88,62 +197,126 @@ BenchmarkParams parseArguments(int argc, char* argv[]) {
             params.precision = std::stoi(argv[++i]);
         } else if (arg == "--debug") {
             params.debug = std::stoi(argv[++i]);
+        } else if (arg == "--warmup") {
+            params.warmup = std::stoi(argv[++i]);
+        } else if (arg == "--flushCache") {
+            params.flushCache = std::stoi(argv[++i]);
+        } else if (arg == "--freshInput") {
+            params.freshInput = std::stoi(argv[++i]);
         } else if (arg == "--dataMB") {
             params.dataMB = std::stod(argv[++i]);
+        } else if (arg == "--basketKB") {
+            params.basketKB = std::stod(argv[++i]);
         } else if (arg == "--dataSource") {
             params.dataName = argv[++i];
         } else if (arg == "--sourceFile") {
             params.sourceFile = argv[++i];
         } else if (arg == "--branchName") {
             params.branchName = argv[++i];
+        } else if (arg == "--branchGroup") {
+            params.branchGroup = argv[++i];
         } else if (arg == "--mean") {
             params.mean = std::stof(argv[++i]);
         } else if (arg == "--stddev") {
             params.stddev = std::stof(argv[++i]);
+        } else if (arg == "--min") {
+            params.minValue = std::stof(argv[++i]);
+        } else if (arg == "--max") {
+            params.maxValue = std::stof(argv[++i]);
+        } else if (arg == "--ptMin") {
+            params.ptMin = std::stof(argv[++i]);
+        } else if (arg == "--ptMean") {
+            params.ptMean = std::stof(argv[++i]);
+        } else if (arg == "--tailIndex") {
+            params.tailIndex = std::stof(argv[++i]);
+        } else if (arg == "--multiplicity") {
+            params.multiplicity = std::stof(argv[++i]);
+        } else if (arg == "--threads") {
+            params.threads = std::stoi(argv[++i]);
         } else if (arg == "--trunkCompressionLevel") {
             params.trunkCompressionLevel = std::stoi(argv[++i]);
+        } else if (arg == "--trunkDictionary") {
+            params.trunkDictionary = argv[++i];
         } else if (arg == "--szErrorBoundMode") {
             params.szErrorBoundMode = std::stoi(argv[++i]);
         } else if (arg == "--szAlgo") {
             params.szAlgo = std::stoi(argv[++i]);
         } else if (arg == "--szInterpAlgo") {
             params.szInterpAlgo = std::stoi(argv[++i]);
+        } else if (arg == "--szMaxError") {
+            params.szMaxError = std::stod(argv[++i]);
+        } else if (arg == "--szTuneCache") {
+            params.szTuneCache = argv[++i];
+        } else if (arg == "--szLayout") {
+            params.szLayout = argv[++i];
         } else if (arg == "--seed") {
             params.seed = std::stoi(argv[++i]);
         } else if (arg == "--doTrunk") {
             params.doTrunk = std::stoi(argv[++i]);
         } else if (arg == "--doSZ") {
             params.doSZ = std::stoi(argv[++i]);
+        } else if (arg == "--doQuant") {
+            params.doQuant = std::stoi(argv[++i]);
+        } else if (arg == "--quantErrorBoundMode") {
+            params.quantErrorBoundMode = std::stoi(argv[++i]);
+        } else if (arg == "--chain") {
+            params.chain = argv[++i];
         } else if (arg == "--sortData") {
             params.sortData = std::stoi(argv[++i]);
         } else if (arg == "--reportType") {
             params.reportType = argv[++i];
+        } else if (arg == "--reportHeader") {
+            params.reportHeader = std::stoi(argv[++i]);
+        } else if (arg == "--trace") {
+            params.traceFile = argv[++i];
         } else {
             throw std::invalid_argument("Unknown argument: " + arg);
         }
     }
 
     // Validate branch name
-    // Name should be in floatBranches or vectorFloatBranches
-    if (std::find(floatBranches.begin(), floatBranches.end(), params.branchName) == floatBranches.end() &&
-        std::find(vectorFloatBranches.begin(), vectorFloatBranches.end(), params.branchName) == vectorFloatBranches.end()) {
+    // Name should be in one of the float, uint32 or bool branch lists
+    if (!isFloatBranch(params.branchName) && !isUInt32Branch(params.branchName) && !isBoolBranch(params.branchName)) {
         throw std::invalid_argument("Invalid branch name: " + params.branchName);
     }
 
+    // Validate generator parameters; written to also reject NaN
+    if (!(params.ptMean > 0)) {
+        throw std::invalid_argument("ptMean must be greater than 0");
+    }
+    if (!(params.tailIndex > 0)) {
+        throw std::invalid_argument("tailIndex must be greater than 0");
+    }
+    if (!(params.multiplicity > 0)) {
+        throw std::invalid_argument("multiplicity must be greater than 0");
+    }
+
+    // Validate report type
+    if (params.reportType != "formatted" && params.reportType != "json" && params.reportType != "csv") {
+        throw std::invalid_argument("Invalid report type: " + params.reportType);
+    }
+
+    // Validate branch group
+    if (!params.branchGroup.empty() && !branchGroups.contains(params.branchGroup)) {
+        throw std::invalid_argument("Invalid branch group: " + params.branchGroup);
+    }
+
     return params;
 }
 
-constexpr int NUMCOMPRESSORS{3};
+constexpr int NUMCOMPRESSORS{9};
 
 class CompressorBench{
     public:
-        enum COMPRESSOR{TRUNK, SZ};
+        enum COMPRESSOR{TRUNK, SZ, QUANT, CHAIN, INT_DELTA, INT_DELTA_OF_DELTA, INT_FOR, BOOL_BITMAP, BOOL_RLE};
+        enum DATATYPE{FLOAT, UINT32, BOOL, GROUP};
 
         CompressorBench(const BenchmarkParams& params)
-            :   _doSZ(params.doSZ), _doTrunk(params.doTrunk),
-                _dataName(params.dataName), _precision(params.precision), _debug(params.debug),
-                _trunkCompressionLevel(params.trunkCompressionLevel),
-                _szErrorBoundMode(params.szErrorBoundMode), _szAlgo(params.szAlgo), _szInterpAlgo(params.szInterpAlgo)
+            :   _doTrunk(params.doTrunk), _doSZ(params.doSZ), _doQuant(params.doQuant),
+                _precision(params.precision), _debug(params.debug), _dataName(params.dataName), _chainSpec(params.chain),
+                _trunkCompressionLevel(params.trunkCompressionLevel), _trunkDictionary(params.trunkDictionary),
+                _szErrorBoundMode(params.szErrorBoundMode), _szAlgo(params.szAlgo), _szInterpAlgo(params.szInterpAlgo),
+                _reportType(params.reportType), _reportHeader(params.reportHeader)
         {
             // Validation iterations
             if (params.iterations <= 0) {
@@ -151,6 +324,29 @@ class CompressorBench{
             }
             _iterations = params.iterations;
 
+            // Validate warmup iterations
+            if (params.warmup < 0) {
+                throw std::invalid_argument("Warmup iterations must not be negative");
+            }
+            _warmup = params.warmup;
+            _freshInput = params.freshInput;
+
+            // Twice the LLC is enough to evict everything the previous iteration touched
+            _flushCache = params.flushCache;
+            if (_flushCache) {
+                const size_t llcSize{cacheSize(3)};
+                _flushBuffer.assign(llcSize ? 2 * llcSize : 64 * MB, 0);
+            }
+
+            // Validate basket size; 0 compresses the whole buffer at once
+            if (params.basketKB < 0) {
+                throw std::invalid_argument("Basket size must not be negative");
+            }
+            _basketSize = static_cast<size_t>(params.basketKB * static_cast<double>(KB));
+            if (params.basketKB > 0 && _basketSize < sizeof(float)) {
+                throw std::invalid_argument("Basket size must hold at least one float");
+            }
+
             if (_dataName == "root") {
                 // Validate source file
                 if (params.sourceFile.empty()) {
@@ -171,10 +367,54 @@ class CompressorBench{
                 _branchName = params.branchName;
             }
 
-            // Create compressor objects
-            _compressor.push_back(new TrunkCompressor(_precision, _trunkCompressionLevel, _debug));
-            _compressor.push_back(new SZCompressor(_precision, _szErrorBoundMode, _szAlgo, _szInterpAlgo, _debug));
+            // Create compressor objects, indexed by COMPRESSOR; the chain slot stays empty without a --chain spec
+            std::unique_ptr<TrunkCompressor> trunkCompressor{std::make_unique<TrunkCompressor>(_precision, _trunkCompressionLevel, _debug)};
+            if (!_trunkDictionary.empty()) {
+                trunkCompressor->setDictionary(readDictionary(_trunkDictionary));
+            }
+            _compressor.push_back(std::move(trunkCompressor));
+            std::unique_ptr<SZCompressor> szCompressor{std::make_unique<SZCompressor>(_precision, _szErrorBoundMode, _szAlgo, _szInterpAlgo, _debug)};
+            _szCompressor = szCompressor.get();
+            _compressor.push_back(std::move(szCompressor));
+            _compressor.push_back(std::make_unique<QuantCompressor>(_precision, params.quantErrorBoundMode, _debug));
+            _compressor.push_back(_chainSpec.empty() ? nullptr : std::make_unique<ChainCompressor>(_chainSpec, _debug));
+
+            // Jagged layouts pad whole events, so they cannot be split into baskets
+            if (params.szLayout == "flat") {
+                _szLayout = SZCompressor::FLAT;
+            }
+            else if (params.szLayout == "event") {
+                _szLayout = SZCompressor::EVENT_MAJOR;
+            }
+            else if (params.szLayout == "object") {
+                _szLayout = SZCompressor::OBJECT_MAJOR;
+            }
+            else {
+                throw std::invalid_argument("Invalid SZ layout: " + params.szLayout);
+            }
+            if (_szLayout != SZCompressor::FLAT && _basketSize) {
+                throw std::invalid_argument("SZ layout must be flat when compressing baskets");
+            }
+
+            _integerCompressor = {IntegerCompressor(IntegerCompressor::DELTA, _debug),
+                                  IntegerCompressor(IntegerCompressor::DELTA_OF_DELTA, _debug),
+                                  IntegerCompressor(IntegerCompressor::FRAME_OF_REFERENCE, _debug)};
+            _booleanCompressor = {BooleanCompressor(BooleanCompressor::BITMAP, _debug),
+                                  BooleanCompressor(BooleanCompressor::RLE, _debug)};
+
+            // A max-error target replaces the SZ settings above with tuned ones
+            if (params.szMaxError > 0) {
+                _szTuner = std::make_unique<SZAutoTuner>(params.szMaxError, params.szTuneCache, _debug);
+                _szTuningKey = _tuningKey(params);
+            }
             // _compressor.push_back(new SZZlibCompressor(_precision, _trunkCompressionLevel, _szErrorBoundMode, _szAlgo, _szInterpAlgo, params.debug));
+
+            reset();
+        }
+
+        // Per-event counts of the data passed to run, needed by the jagged SZ layouts
+        void setEventCounts(const std::vector<uint32_t>& eventCounts) {
+            _szCompressor->setLayout(_szLayout, eventCounts);
         }
 
         void run(std::vector<float>& data, int iterations=-1) {
@@ -183,109 +423,193 @@ class CompressorBench{
                 iterations = _iterations;
             }
 
-            std::vector<uint8_t> compressedData{};
-            std::vector<std::vector<float>> decompressedData(NUMCOMPRESSORS);
-
+            _dataType = FLOAT;
             _originalDataSize = data.size() * sizeof(float);
+
+            // Output buffers come from the pools, so their capacity survives across iterations and runs
+            std::vector<float> decompressedData{_decompressedPool.acquire(data.size())};
+            decompressedData.resize(data.size());
             
-            for (int compressor{TRUNK}; compressor <= SZ; compressor++) {
-                if ((compressor == TRUNK && !_doTrunk) || (compressor == SZ && !_doSZ)) {
+            for (int compressor{TRUNK}; compressor <= CHAIN; compressor++) {
+                if (!_isEnabled(compressor)) {
                     continue;
                 }
-                
-                for (int i{0}; i < iterations; ++i) {
-                    // Clear compressed data, just to be safe
-                    compressedData.clear();
 
-                    // Start timing
-                    _startReal = std::chrono::high_resolution_clock::now();
-                    _getCPUTime(_startUser, _startSystem);
-                    _startMemory = _getMemoryUsage();
+                if (compressor == SZ && _szTuner) {
+                    _tuneSZ(data);
+                }
 
-                    // Perform compression
-                    compressedData = _compressor[compressor]->compress(data);
-                    
-                    // Stop timing
-                    _endReal = std::chrono::high_resolution_clock::now();
-                    _getCPUTime(_endUser, _endSystem);
-                    _endMemory = _getMemoryUsage();
+                if (_basketSize) {
+                    _runBaskets(static_cast<COMPRESSOR>(compressor), data, decompressedData, iterations);
+                }
+                else {
+                    _runWhole<float>(compressor, *_compressor[compressor], data, decompressedData, iterations);
+                }
 
-                    // Calculate time spent
-                    _compressionTime[compressor].real += std::chrono::duration_cast<std::chrono::milliseconds>(_endReal - _startReal).count();
-                    _compressionTime[compressor].user += _endUser - _startUser;
-                    _compressionTime[compressor].system += _endSystem - _startSystem;
+                // Calculate average relative error
+                _avgRelativeError[compressor] = _averageRelativeError<float>(data, decompressedData);
+            }
 
-                    // Calculate memory usage
-                    _compressionMemory[compressor] = _endMemory - _startMemory;
-                }
+            // Hand buffer back for the next run
+            _decompressedPool.release(std::move(decompressedData));
+        }
 
-                // Average time over iterations
-                _compressionTime[compressor].real /= iterations;
-                _compressionTime[compressor].user /= iterations;
-                _compressionTime[compressor].system /= iterations;
+        // Benchmark the lossless integer codecs on a uint32 column
+        void runInteger(const std::vector<uint32_t>& data, int iterations=-1) {
+            if (iterations == -1) {
+                iterations = _iterations;
+            }
 
-                // Average memory usage over iterations
-                _compressionMemory[compressor] /= iterations;
+            _dataType = UINT32;
+            _originalDataSize = data.size() * sizeof(uint32_t);
 
-                // Store compressed data size
-                _compressedDataSize[compressor] = compressedData.size();
+            std::vector<uint32_t> decompressedData(data.size());
+            for (int compressor{INT_DELTA}; compressor <= INT_FOR; compressor++) {
+                _runWhole<uint32_t>(compressor, _integerCompressor[compressor - INT_DELTA], data, decompressedData, iterations);
+                _avgRelativeError[compressor] = _averageRelativeError<uint32_t>(data, decompressedData);
+            }
+        }
 
-                // Calculate compression ratio
-                _compressionRatio[compressor] = static_cast<double>(_originalDataSize) / static_cast<double>(_compressedDataSize[compressor]);
+        // Benchmark the lossless boolean codecs on a bool column stored one byte per value
+        void runBoolean(const std::vector<uint8_t>& data, int iterations=-1) {
+            if (iterations == -1) {
+                iterations = _iterations;
+            }
 
-                // Decompress data
-                for (int i{0}; i < iterations; ++i) {
-                    // Start timing
-                    _startReal = std::chrono::high_resolution_clock::now();
-                    _getCPUTime(_startUser, _startSystem);
-                    _startMemory = _getMemoryUsage();
+            _dataType = BOOL;
+            _originalDataSize = data.size() * sizeof(uint8_t);
 
-                    // Perform decompression
-                    decompressedData[compressor] = _compressor[compressor]->decompress(compressedData, data.size());
+            std::vector<uint8_t> decompressedData(data.size());
+            for (int compressor{BOOL_BITMAP}; compressor <= BOOL_RLE; compressor++) {
+                _runWhole<uint8_t>(compressor, _booleanCompressor[compressor - BOOL_BITMAP], data, decompressedData, iterations);
+                _avgRelativeError[compressor] = _averageRelativeError<uint8_t>(data, decompressedData);
+            }
+        }
 
-                    // Stop timing
-                    _endReal = std::chrono::high_resolution_clock::now();
-                    _getCPUTime(_endUser, _endSystem);
-                    _endMemory = _getMemoryUsage();
+        // Compress a group of aligned branches jointly with each MultiColumnCompressor mode, and per branch with the
+        // enabled single-column compressors for comparison
+        void runGroup(const std::string& groupName, const std::vector<std::vector<float>>& columns, int iterations=-1) {
+            if (iterations == -1) {
+                iterations = _iterations;
+            }
 
-                    // Calculate time spent
-                    _decompressionTime[compressor].real += std::chrono::duration_cast<std::chrono::milliseconds>(_endReal - _startReal).count();
-                    _decompressionTime[compressor].user += _endUser - _startUser;
-                    _decompressionTime[compressor].system += _endSystem - _startSystem;
+            _dataType = GROUP;
+            _groupName = groupName;
+            _groupResults.clear();
+            _originalDataSize = 0;
+            for (const std::vector<float>& column : columns) {
+                _originalDataSize += column.size() * sizeof(float);
+            }
 
-                    // Calculate memory usage
-                    _decompressionMemory[compressor] = _endMemory - _startMemory;
+            // Per-branch baselines
+            std::vector<uint8_t> compressedData{_compressedPool.acquire()};
+            for (int compressor{TRUNK}; compressor <= CHAIN; compressor++) {
+                if (!_isEnabled(compressor)) {
+                    continue;
                 }
 
-                // Average time over iterations
-                _decompressionTime[compressor].real /= iterations;
-                _decompressionTime[compressor].user /= iterations;
-                _decompressionTime[compressor].system /= iterations;
-
-                // Average memory usage over iterations
-                _decompressionMemory[compressor] /= iterations;
+                GroupResult result{"Per-branch " + _getName(compressor), 0, 0, 0, {}, std::vector<double>(iterations, 0), std::vector<double>(iterations, 0)};
+                std::vector<float> freshColumn{};
+                std::vector<uint8_t> freshCompressedData{};
+                for (const std::vector<float>& column : columns) {
+                    std::vector<float> decompressedData(column.size());
+                    for (int i{0}; i < _warmup; ++i) {
+                        _compressor[compressor]->compressInto(column, compressedData);
+                        _compressor[compressor]->decompressInto(compressedData, decompressedData);
+                    }
+                    for (int i{0}; i < iterations; ++i) {
+                        std::span<const float> input{column};
+                        if (_freshInput) {
+                            freshColumn = std::vector<float>(column.begin(), column.end());
+                            input = freshColumn;
+                        }
+                        _prepareIteration();
+                        _startReal = std::chrono::high_resolution_clock::now();
+                        _compressor[compressor]->compressInto(input, compressedData);
+                        _endReal = std::chrono::high_resolution_clock::now();
+                        result.compressionTimes[i] += std::chrono::duration<double, std::milli>(_endReal - _startReal).count();
+
+                        std::span<const uint8_t> compressedInput{compressedData};
+                        if (_freshInput) {
+                            freshCompressedData = std::vector<uint8_t>(compressedData.begin(), compressedData.end());
+                            compressedInput = freshCompressedData;
+                        }
+                        _prepareIteration();
+                        _startReal = std::chrono::high_resolution_clock::now();
+                        _compressor[compressor]->decompressInto(compressedInput, decompressedData);
+                        _endReal = std::chrono::high_resolution_clock::now();
+                        result.decompressionTimes[i] += std::chrono::duration<double, std::milli>(_endReal - _startReal).count();
+                    }
+                    result.compressedDataSize += compressedData.size();
+                    result.avgRelativeError.push_back(_averageRelativeError<float>(column, decompressedData));
+                }
+                result.compressionTime = std::accumulate(result.compressionTimes.begin(), result.compressionTimes.end(), 0.0) / iterations;
+                result.decompressionTime = std::accumulate(result.decompressionTimes.begin(), result.decompressionTimes.end(), 0.0) / iterations;
+                _groupResults.push_back(result);
+            }
+            _compressedPool.release(std::move(compressedData));
+
+            // Joint compression
+            for (int mode{MultiColumnCompressor::PREDICT_ENERGY}; mode <= MultiColumnCompressor::SZ_2D; mode++) {
+                MultiColumnCompressor compressor(mode, _precision, _trunkCompressionLevel, _szAlgo, _szInterpAlgo, _debug);
+                GroupResult result{mode == MultiColumnCompressor::PREDICT_ENERGY ? "Joint PredictEnergy" : "Joint SZ2D", 0, 0, 0, {}, {}, {}};
+
+                std::vector<uint8_t> jointData{};
+                std::vector<std::vector<float>> decompressedColumns{};
+                std::vector<std::vector<float>> freshColumns{};
+                std::vector<uint8_t> freshJointData{};
+                for (int i{0}; i < _warmup; ++i) {
+                    decompressedColumns = compressor.decompress(compressor.compress(columns));
+                }
+                for (int i{0}; i < iterations; ++i) {
+                    if (_freshInput) {
+                        freshColumns = columns;
+                    }
+                    _prepareIteration();
+                    _startReal = std::chrono::high_resolution_clock::now();
+                    jointData = compressor.compress(_freshInput ? freshColumns : columns);
+                    _endReal = std::chrono::high_resolution_clock::now();
+                    result.compressionTimes.push_back(std::chrono::duration<double, std::milli>(_endReal - _startReal).count());
+                    result.compressionTime += result.compressionTimes.back() / iterations;
 
-                // Calculate average relative error
-                _avgRelativeError[compressor] = 0;
-                for (size_t i{0}; i < data.size(); ++i) {
-                    if (data[i]) {
-                        _avgRelativeError[compressor] += std::abs((data[i] - decompressedData[compressor][i]) / data[i]);
+                    if (_freshInput) {
+                        freshJointData = jointData;
                     }
+                    _prepareIteration();
+                    _startReal = std::chrono::high_resolution_clock::now();
+                    decompressedColumns = compressor.decompress(_freshInput ? freshJointData : jointData);
+                    _endReal = std::chrono::high_resolution_clock::now();
+                    result.decompressionTimes.push_back(std::chrono::duration<double, std::milli>(_endReal - _startReal).count());
+                    result.decompressionTime += result.decompressionTimes.back() / iterations;
                 }
-                _avgRelativeError[compressor] /= data.size();
+
+                result.compressedDataSize = jointData.size();
+                for (size_t column{0}; column < columns.size(); ++column) {
+                    result.avgRelativeError.push_back(_averageRelativeError<float>(columns[column], decompressedColumns[column]));
+                }
+                _groupResults.push_back(result);
             }
         }
 
         std::string generateReport() {
             std::string report{};
 
-            for (int compressor{TRUNK}; compressor <= SZ; compressor++) {
-                if ((compressor == TRUNK && !_doTrunk) || (compressor == SZ && !_doSZ)) {
+            if (_reportType != "formatted") {
+                return _generateStructuredReport();
+            }
+
+            if (_dataType == GROUP) {
+                return _generateGroupReport();
+            }
+
+            for (int compressor{0}; compressor < NUMCOMPRESSORS; compressor++) {
+                if (!_isEnabled(compressor)) {
                     continue;
                 }
 
-                report += std::format("Compressor: {}\n", (compressor == CompressorBench::TRUNK ? "Trunk" : "SZ"));
+                report += std::format("Compressor: {}\n", _getName(compressor));
                 report += std::format("Iterations: {}\n", _iterations);
+                report += _formatCacheState();
 
                 report += std::format("Data name: {}\n", _dataName);
                 if (_dataName == "root") {
@@ -294,16 +618,42 @@ class CompressorBench{
                     report += std::format("Branch name: {}\n", _branchName);
                 }
 
-                report += std::format("Precision: {}\n", _precision);
+                if (_dataType == FLOAT) {
+                    report += std::format("Precision: {}\n", _precision);
+                }
+
+                if (_basketSize && _dataType == FLOAT) {
+                    report += std::format("Basket size: {} bytes\n", _basketSize);
+                    report += std::format("Number of baskets: {}\n", _numBaskets);
+                }
 
                 if ((compressor == TRUNK && _doTrunk)) {
                     report += std::format("Trunk compression level: {}\n", _trunkCompressionLevel);
+                    if (!_trunkDictionary.empty()) {
+                        report += std::format("Trunk dictionary: {}\n", _trunkDictionary);
+                    }
                 }
                 
                 if ((compressor == SZ && _doSZ)) {
                     report += std::format("SZ error bound mode: {}\n", _szErrorBoundMode);
                     report += std::format("SZ algorithm: {}\n", _szAlgo);
                     report += std::format("SZ interpolation algorithm: {}\n", _szInterpAlgo);
+                    report += std::format("SZ layout: {}\n", _szCompressor->getLayoutString());
+                    if (_szTuner) {
+                        report += std::format("SZ auto-tune max error: {}\n", _szTuner->getMaxError());
+                        report += std::format("SZ tuned error bound: {}\n", _szCompressor->getErrorBound());
+                        report += std::format("SZ tuning time: {:.2f} ms{}\n", _szTuningTime, _szTuningCached ? " (cached)" : "");
+                    }
+                }
+
+                if ((compressor == QUANT && _doQuant)) {
+                    QuantCompressor* quantCompressor{static_cast<QuantCompressor*>(_compressor[QUANT].get())};
+                    report += std::format("Quant error bound mode: {}\n", quantCompressor->getErrorBoundMode());
+                    report += std::format("Quant error bound: {}\n", quantCompressor->getErrorBound());
+                }
+
+                if (compressor == CHAIN) {
+                    report += std::format("Chain: {}\n", _chainSpec);
                 }
 
                 report += std::format("Average compression time: {:.2f} ms (user: {:.2f} ms, system: {:.2f} ms)\n",
@@ -312,6 +662,11 @@ class CompressorBench{
                 report += std::format("Average decompression time: {:.2f} ms (user: {:.2f} ms, system: {:.2f} ms)\n",
                     _decompressionTime[compressor].real, _decompressionTime[compressor].user, _decompressionTime[compressor].system);
 
+                if (_basketSize && _dataType == FLOAT) {
+                    report += _formatLatencies("Basket compression latency", _compressionLatency[compressor]);
+                    report += _formatLatencies("Basket decompression latency", _decompressionLatency[compressor]);
+                }
+
                 report += std::format("Average compression memory: {} KB\n", _compressionMemory[compressor]);
 
                 report += std::format("Original data size: {} bytes\n", _originalDataSize);
@@ -349,39 +704,81 @@ class CompressorBench{
             return _originalDataSize;
         }
 
+        LatencyStats getCompressionLatency(const COMPRESSOR compressor) const {
+            return _compressionLatency[compressor];
+        }
+
+        LatencyStats getDecompressionLatency(const COMPRESSOR compressor) const {
+            return _decompressionLatency[compressor];
+        }
+
         void reset() {  
-            for (int compressor{TRUNK}; compressor <= SZ; ++compressor) {
+            for (int compressor{0}; compressor < NUMCOMPRESSORS; ++compressor) {
                 _compressionTime[compressor] = TimeCollector{0, 0, 0};
                 _decompressionTime[compressor] = TimeCollector{0, 0, 0};
                 _compressedDataSize[compressor] = 0;
                 _compressionRatio[compressor] = 0;
                 _compressionMemory[compressor] = 0;
                 _decompressionMemory[compressor] = 0;
+                _avgRelativeError[compressor] = 0;
+                _compressionLatency[compressor] = LatencyStats{0, 0, 0, 0, 0, 0, 0};
+                _decompressionLatency[compressor] = LatencyStats{0, 0, 0, 0, 0, 0, 0};
+                _compressionTimes[compressor].clear();
+                _decompressionTimes[compressor].clear();
             }
             _originalDataSize = 0;
+            _numBaskets = 0;
         }
 
     private:        
         bool _doTrunk;
         bool _doSZ;
+        bool _doQuant;
 
         int _iterations;
         int _precision;
         bool _debug;
+
+        int _warmup;
+        bool _flushCache;
+        bool _freshInput;
+        std::vector<uint8_t> _flushBuffer{};
+
+        size_t _basketSize;
+        size_t _numBaskets;
       
         std::string _dataName;
         std::string _sourceFile;
         std::string _treeName;
         std::string _branchName;
 
-        std::vector<MyCompressor*> _compressor;
+        std::vector<std::unique_ptr<MyCompressor>> _compressor;
+        std::string _chainSpec;
+        std::vector<IntegerCompressor> _integerCompressor;
+        std::vector<BooleanCompressor> _booleanCompressor;
+
+        DATATYPE _dataType{FLOAT};
+
+        std::string _groupName;
+        std::vector<GroupResult> _groupResults;
+
+        BufferPool<uint8_t> _compressedPool{};
+        BufferPool<float> _decompressedPool{};
 
         int _trunkCompressionLevel;
+        std::string _trunkDictionary;
 
         int _szErrorBoundMode;
         int _szAlgo;
         int _szInterpAlgo;
 
+        SZCompressor* _szCompressor;
+        int _szLayout{SZCompressor::FLAT};
+        std::unique_ptr<SZAutoTuner> _szTuner;
+        std::string _szTuningKey;
+        double _szTuningTime{0};
+        bool _szTuningCached{false};
+
         size_t _originalDataSize;
         size_t _compressedDataSize[NUMCOMPRESSORS];
         double _compressionRatio[NUMCOMPRESSORS];
@@ -390,6 +787,16 @@ class CompressorBench{
 
         TimeCollector _compressionTime[NUMCOMPRESSORS];
         TimeCollector _decompressionTime[NUMCOMPRESSORS];
+
+        // Real time of each timed iteration, in ms
+        std::vector<double> _compressionTimes[NUMCOMPRESSORS];
+        std::vector<double> _decompressionTimes[NUMCOMPRESSORS];
+
+        std::string _reportType;
+        bool _reportHeader;
+
+        LatencyStats _compressionLatency[NUMCOMPRESSORS];
+        LatencyStats _decompressionLatency[NUMCOMPRESSORS];
         
         std::chrono::high_resolution_clock::time_point _startReal;
         std::chrono::high_resolution_clock::time_point _endReal;
@@ -403,6 +810,569 @@ class CompressorBench{
         size_t _startMemory;
         size_t _endMemory;
 
+        // Compress and decompress the data as a single buffer
+        template <typename T, typename Codec>
+        void _runWhole(const int compressor, Codec& codec, std::span<const T> data, std::vector<T>& decompressedData, int iterations) {
+            std::vector<uint8_t> compressedData{_compressedPool.acquire()};
+
+            for (int i{0}; i < _warmup; ++i) {
+                codec.compressInto(data, compressedData);
+                codec.decompressInto(compressedData, decompressedData);
+            }
+
+            std::vector<T> freshData{};
+            for (int i{0}; i < iterations; ++i) {
+                // Clear compressed data, just to be safe
+                compressedData.clear();
+
+                std::span<const T> input{data};
+                if (_freshInput) {
+                    freshData = std::vector<T>(data.begin(), data.end());
+                    input = freshData;
+                }
+                _prepareIteration();
+
+                // Start timing
+                _startReal = std::chrono::high_resolution_clock::now();
+                _getCPUTime(_startUser, _startSystem);
+                _startMemory = _getMemoryUsage();
+
+                // Perform compression
+                codec.compressInto(input, compressedData);
+                    
+                // Stop timing
+                _endReal = std::chrono::high_resolution_clock::now();
+                _getCPUTime(_endUser, _endSystem);
+                _endMemory = _getMemoryUsage();
+
+                // Calculate time spent
+                _compressionTimes[compressor].push_back(std::chrono::duration<double, std::milli>(_endReal - _startReal).count());
+                _compressionTime[compressor].real += _compressionTimes[compressor].back();
+                _compressionTime[compressor].user += _endUser - _startUser;
+                _compressionTime[compressor].system += _endSystem - _startSystem;
+
+                // Calculate memory usage
+                _compressionMemory[compressor] = _endMemory - _startMemory;
+            }
+
+            // Average time over iterations
+            _compressionTime[compressor].real /= iterations;
+            _compressionTime[compressor].user /= iterations;
+            _compressionTime[compressor].system /= iterations;
+
+            // Average memory usage over iterations
+            _compressionMemory[compressor] /= iterations;
+
+            // Store compressed data size
+            _compressedDataSize[compressor] = compressedData.size();
+
+            // Calculate compression ratio
+            _compressionRatio[compressor] = static_cast<double>(_originalDataSize) / static_cast<double>(_compressedDataSize[compressor]);
+
+            // Decompress data
+            std::vector<uint8_t> freshCompressedData{};
+            for (int i{0}; i < iterations; ++i) {
+                std::span<const uint8_t> compressedInput{compressedData};
+                if (_freshInput) {
+                    freshCompressedData = std::vector<uint8_t>(compressedData.begin(), compressedData.end());
+                    compressedInput = freshCompressedData;
+                }
+                _prepareIteration();
+
+                // Start timing
+                _startReal = std::chrono::high_resolution_clock::now();
+                _getCPUTime(_startUser, _startSystem);
+                _startMemory = _getMemoryUsage();
+
+                // Perform decompression
+                codec.decompressInto(compressedInput, decompressedData);
+
+                // Stop timing
+                _endReal = std::chrono::high_resolution_clock::now();
+                _getCPUTime(_endUser, _endSystem);
+                _endMemory = _getMemoryUsage();
+
+                // Calculate time spent
+                _decompressionTimes[compressor].push_back(std::chrono::duration<double, std::milli>(_endReal - _startReal).count());
+                _decompressionTime[compressor].real += _decompressionTimes[compressor].back();
+                _decompressionTime[compressor].user += _endUser - _startUser;
+                _decompressionTime[compressor].system += _endSystem - _startSystem;
+
+                // Calculate memory usage
+                _decompressionMemory[compressor] = _endMemory - _startMemory;
+            }
+
+            // Average time over iterations
+            _decompressionTime[compressor].real /= iterations;
+            _decompressionTime[compressor].user /= iterations;
+            _decompressionTime[compressor].system /= iterations;
+
+            // Average memory usage over iterations
+            _decompressionMemory[compressor] /= iterations;
+
+            // Hand buffer back for the next run
+            _compressedPool.release(std::move(compressedData));
+        }
+
+        // Average of |original - decompressed| / |original| over all values, with zeros contributing nothing
+        template <typename T>
+        double _averageRelativeError(std::span<const T> data, std::span<const T> decompressedData) const {
+            if (data.empty()) {
+                return 0;
+            }
+
+            double error{0};
+            for (size_t i{0}; i < data.size(); ++i) {
+                if (data[i]) {
+                    error += std::abs((static_cast<double>(data[i]) - static_cast<double>(decompressedData[i])) / static_cast<double>(data[i]));
+                }
+            }
+            return error / data.size();
+        }
+
+        bool _isEnabled(const int compressor) const {
+            switch (compressor) {
+                case TRUNK:
+                    return (_dataType == FLOAT || _dataType == GROUP) && _doTrunk;
+                case SZ:
+                    return (_dataType == FLOAT || _dataType == GROUP) && _doSZ;
+                case QUANT:
+                    return (_dataType == FLOAT || _dataType == GROUP) && _doQuant;
+                case CHAIN:
+                    return (_dataType == FLOAT || _dataType == GROUP) && !_chainSpec.empty();
+                case INT_DELTA:
+                case INT_DELTA_OF_DELTA:
+                case INT_FOR:
+                    return _dataType == UINT32;
+                default:
+                    return _dataType == BOOL;
+            }
+        }
+
+        std::string _getName(const int compressor) const {
+            constexpr const char* names[NUMCOMPRESSORS]{"Trunk", "SZ", "Quant", "Chain", "IntDelta", "IntDeltaOfDelta", "IntFOR", "BoolBitmap", "BoolRLE"};
+            return names[compressor];
+        }
+
+        // Compress and decompress the data in independent baskets of _basketSize bytes, the granularity of ROOT I/O
+        // Real time is the sum of per-basket latencies; CPU time and memory cover the whole pass over the baskets.
+        // Caches are flushed once per pass rather than per basket, since each basket's data is only touched once anyway.
+        void _runBaskets(const COMPRESSOR compressor, const std::vector<float>& data, std::vector<float>& decompressedData, int iterations) {
+            const size_t basketFloats{_basketSize / sizeof(float)};
+            _numBaskets = (data.size() + basketFloats - 1) / basketFloats;
+
+            // All compressed baskets go into one arena, with an offset table marking basket boundaries
+            std::vector<uint8_t> arena{_compressedPool.acquire(data.size() * sizeof(float))};
+            std::vector<uint8_t> basketBuffer{_compressedPool.acquire()};
+            std::vector<size_t> offsets(_numBaskets + 1, 0);
+
+            std::vector<double> latencies{};
+            latencies.reserve(_numBaskets * iterations);
+
+            for (int i{0}; i < _warmup; ++i) {
+                for (size_t basket{0}; basket < _numBaskets; ++basket) {
+                    const size_t begin{basket * basketFloats};
+                    const size_t count{std::min(basketFloats, data.size() - begin)};
+                    _compressor[compressor]->compressInto(std::span<const float>(data).subspan(begin, count), basketBuffer);
+                    _compressor[compressor]->decompressInto(basketBuffer, std::span<float>(decompressedData).subspan(begin, count));
+                }
+            }
+
+            std::vector<float> freshData{};
+            for (int i{0}; i < iterations; ++i) {
+                arena.clear();
+
+                std::span<const float> input{data};
+                if (_freshInput) {
+                    freshData = std::vector<float>(data.begin(), data.end());
+                    input = freshData;
+                }
+                _prepareIteration();
+
+                // Start timing
+                _getCPUTime(_startUser, _startSystem);
+                _startMemory = _getMemoryUsage();
+
+                for (size_t basket{0}; basket < _numBaskets; ++basket) {
+                    std::span<const float> basketData{input.subspan(basket * basketFloats,
+                                                        std::min(basketFloats, data.size() - basket * basketFloats))};
+
+                    // Perform compression
+                    _startReal = std::chrono::high_resolution_clock::now();
+                    _compressor[compressor]->compressInto(basketData, basketBuffer);
+                    _endReal = std::chrono::high_resolution_clock::now();
+
+                    latencies.push_back(std::chrono::duration<double, std::micro>(_endReal - _startReal).count());
+
+                    arena.insert(arena.end(), basketBuffer.begin(), basketBuffer.end());
+                    offsets[basket + 1] = arena.size();
+                }
+
+                // Stop timing
+                _getCPUTime(_endUser, _endSystem);
+                _endMemory = _getMemoryUsage();
+
+                // Calculate time spent
+                _compressionTimes[compressor].push_back(std::accumulate(latencies.end() - _numBaskets, latencies.end(), 0.0) / 1000.0);
+                _compressionTime[compressor].real += _compressionTimes[compressor].back();
+                _compressionTime[compressor].user += _endUser - _startUser;
+                _compressionTime[compressor].system += _endSystem - _startSystem;
+
+                // Calculate memory usage
+                _compressionMemory[compressor] = _endMemory - _startMemory;
+            }
+
+            // Average time over iterations
+            _compressionTime[compressor].real /= iterations;
+            _compressionTime[compressor].user /= iterations;
+            _compressionTime[compressor].system /= iterations;
+
+            // Average memory usage over iterations
+            _compressionMemory[compressor] /= iterations;
+
+            // Aggregate compressed size and ratio over all baskets
+            _compressedDataSize[compressor] = arena.size();
+            _compressionRatio[compressor] = static_cast<double>(_originalDataSize) / static_cast<double>(_compressedDataSize[compressor]);
+
+            _compressionLatency[compressor] = summarizeLatencies(latencies);
+            latencies.clear();
+
+            // Decompress data
+            std::vector<uint8_t> freshArena{};
+            for (int i{0}; i < iterations; ++i) {
+                std::span<const uint8_t> compressedInput{arena};
+                if (_freshInput) {
+                    freshArena = std::vector<uint8_t>(arena.begin(), arena.end());
+                    compressedInput = freshArena;
+                }
+                _prepareIteration();
+
+                // Start timing
+                _getCPUTime(_startUser, _startSystem);
+                _startMemory = _getMemoryUsage();
+
+                for (size_t basket{0}; basket < _numBaskets; ++basket) {
+                    std::span<const uint8_t> compressedBasket{compressedInput.subspan(offsets[basket], offsets[basket + 1] - offsets[basket])};
+                    std::span<float> basketData{std::span<float>(decompressedData).subspan(basket * basketFloats,
+                                                    std::min(basketFloats, data.size() - basket * basketFloats))};
+
+                    // Perform decompression
+                    _startReal = std::chrono::high_resolution_clock::now();
+                    _compressor[compressor]->decompressInto(compressedBasket, basketData);
+                    _endReal = std::chrono::high_resolution_clock::now();
+
+                    latencies.push_back(std::chrono::duration<double, std::micro>(_endReal - _startReal).count());
+                }
+
+                // Stop timing
+                _getCPUTime(_endUser, _endSystem);
+                _endMemory = _getMemoryUsage();
+
+                // Calculate time spent
+                _decompressionTimes[compressor].push_back(std::accumulate(latencies.end() - _numBaskets, latencies.end(), 0.0) / 1000.0);
+                _decompressionTime[compressor].real += _decompressionTimes[compressor].back();
+                _decompressionTime[compressor].user += _endUser - _startUser;
+                _decompressionTime[compressor].system += _endSystem - _startSystem;
+
+                // Calculate memory usage
+                _decompressionMemory[compressor] = _endMemory - _startMemory;
+            }
+
+            // Average time over iterations
+            _decompressionTime[compressor].real /= iterations;
+            _decompressionTime[compressor].user /= iterations;
+            _decompressionTime[compressor].system /= iterations;
+
+            // Average memory usage over iterations
+            _decompressionMemory[compressor] /= iterations;
+
+            _decompressionLatency[compressor] = summarizeLatencies(latencies);
+
+            // Hand buffers back for the next run
+            _compressedPool.release(std::move(arena));
+            _compressedPool.release(std::move(basketBuffer));
+        }
+
+        // Tuner cache key: the branch for ROOT data, otherwise the generator with the parameters that shape its values,
+        // so a cached tuning is not reused for a different distribution. No spaces, as the cache file splits on them.
+        static std::string _tuningKey(const BenchmarkParams& params) {
+            std::string key{};
+            if (params.dataName == "root") {
+                key = params.branchName;
+            }
+            else if (params.dataName == "normal") {
+                key = std::format("normal:mean={}:stddev={}", params.mean, params.stddev);
+            }
+            else if (params.dataName == "uniform") {
+                key = std::format("uniform:min={}:max={}", params.minValue, params.maxValue);
+            }
+            else if (params.dataName == "pt") {
+                key = std::format("pt:ptMin={}:ptMean={}", params.ptMin, params.ptMean);
+            }
+            else if (params.dataName == "pareto") {
+                key = std::format("pareto:ptMin={}:tailIndex={}", params.ptMin, params.tailIndex);
+            }
+            else if (params.dataName == "jagged") {
+                key = std::format("jagged:multiplicity={}:ptMin={}:ptMean={}", params.multiplicity, params.ptMin, params.ptMean);
+            }
+            else {
+                key = params.dataName;
+            }
+            if (params.dataName != "root") {
+                key += std::format(":seed={}", params.seed);
+            }
+            return key;
+        }
+
+        // Pick SZ settings for this data from the tuner; not counted towards compression time
+        void _tuneSZ(const std::vector<float>& data) {
+            std::chrono::high_resolution_clock::time_point startTuning{std::chrono::high_resolution_clock::now()};
+            SZTuning tuning{_szTuner->tune(_szTuningKey, data)};
+            std::chrono::high_resolution_clock::time_point endTuning{std::chrono::high_resolution_clock::now()};
+
+            _szTuningTime = std::chrono::duration<double, std::milli>(endTuning - startTuning).count();
+            _szTuningCached = _szTuner->lastWasCached();
+
+            applySZTuning(*_szCompressor, tuning);
+            _szErrorBoundMode = tuning.errorBoundMode;
+            _szAlgo = tuning.algo;
+            _szInterpAlgo = tuning.interpAlgo;
+        }
+
+        std::string _generateGroupReport() const {
+            std::string report{};
+
+            std::string branches{};
+            for (const std::string& branch : branchGroups.at(_groupName)) {
+                branches += (branches.empty() ? "" : ", ") + branch;
+            }
+
+            for (const GroupResult& result : _groupResults) {
+                report += std::format("Compressor: {}\n", result.name);
+                report += std::format("Iterations: {}\n", _iterations);
+                report += _formatCacheState();
+                report += std::format("Source file: {}\n", _sourceFile);
+                report += std::format("Tree name: {}\n", _treeName);
+                report += std::format("Branch group: {} ({})\n", _groupName, branches);
+                report += std::format("Precision: {}\n", _precision);
+
+                report += std::format("Average compression time: {:.2f} ms\n", result.compressionTime);
+                report += std::format("Average decompression time: {:.2f} ms\n", result.decompressionTime);
+
+                report += std::format("Original data size: {} bytes\n", _originalDataSize);
+                report += std::format("Compressed data size: {} bytes\n", result.compressedDataSize);
+                report += std::format("Compression ratio: {:.2f}\n", static_cast<double>(_originalDataSize) / static_cast<double>(result.compressedDataSize));
+
+                std::string errors{};
+                for (double error : result.avgRelativeError) {
+                    errors += std::format("{}{:.6f}", errors.empty() ? "" : ", ", error);
+                }
+                report += std::format("Average relative error per branch: {}\n\n", errors);
+            }
+
+            return report;
+        }
+
+        // Cold runs flush the caches before every timed iteration; warm runs leave whatever the last iteration touched
+        std::string _formatCacheState() const {
+            std::string state{std::format("Cache state: {}\n", _flushCache ? "cold" : "warm")};
+            state += std::format("Warmup iterations: {}\n", _warmup);
+            state += std::format("Fresh input: {}\n", _freshInput ? "yes" : "no");
+            return state;
+        }
+
+        // Untimed set-up before each timed iteration
+        void _prepareIteration() {
+            if (_flushCache) {
+                _flushCaches();
+            }
+        }
+
+        // Evict the codec's input, output and tables from every cache level by writing one byte per line of a buffer
+        // larger than the LLC
+        void _flushCaches() {
+            constexpr size_t CACHE_LINE{64};
+            for (size_t i{0}; i < _flushBuffer.size(); i += CACHE_LINE) {
+                _flushBuffer[i] += 1;
+            }
+        }
+
+        // One JSON line or CSV row per result. Every record carries the environment and all parameters, and has the same
+        // fields in the same order whatever the data type, so rows from different runs can be concatenated directly.
+        std::string _generateStructuredReport() const {
+            const ReportRecord environment{captureEnvironment()};
+            std::vector<ReportRecord> records{};
+
+            if (_dataType == GROUP) {
+                for (const GroupResult& result : _groupResults) {
+                    ReportRecord record{_parameterRecord(environment, result.name, -1)};
+                    const double avgRelativeError{result.avgRelativeError.empty() ? 0.0 :
+                        std::accumulate(result.avgRelativeError.begin(), result.avgRelativeError.end(), 0.0) / result.avgRelativeError.size()};
+
+                    record.add("compression_time_ms", result.compressionTime);
+                    record.addNull("compression_user_ms");
+                    record.addNull("compression_system_ms");
+                    record.add("decompression_time_ms", result.decompressionTime);
+                    record.addNull("decompression_user_ms");
+                    record.addNull("decompression_system_ms");
+                    record.add("compression_times_ms", result.compressionTimes);
+                    record.add("decompression_times_ms", result.decompressionTimes);
+                    _addLatencies(record, "compression_latency", nullptr);
+                    _addLatencies(record, "decompression_latency", nullptr);
+                    record.addNull("compression_memory_kb");
+                    record.add("original_size_bytes", _originalDataSize);
+                    record.add("compressed_size_bytes", result.compressedDataSize);
+                    record.add("compression_ratio", static_cast<double>(_originalDataSize) / static_cast<double>(result.compressedDataSize));
+                    record.add("avg_relative_error", avgRelativeError);
+                    record.add("avg_relative_error_per_branch", result.avgRelativeError);
+                    records.push_back(record);
+                }
+            }
+            else {
+                for (int compressor{0}; compressor < NUMCOMPRESSORS; compressor++) {
+                    if (!_isEnabled(compressor)) {
+                        continue;
+                    }
+
+                    ReportRecord record{_parameterRecord(environment, _getName(compressor), compressor)};
+                    const bool baskets{_basketSize && _dataType == FLOAT};
+
+                    record.add("compression_time_ms", _compressionTime[compressor].real);
+                    record.add("compression_user_ms", _compressionTime[compressor].user);
+                    record.add("compression_system_ms", _compressionTime[compressor].system);
+                    record.add("decompression_time_ms", _decompressionTime[compressor].real);
+                    record.add("decompression_user_ms", _decompressionTime[compressor].user);
+                    record.add("decompression_system_ms", _decompressionTime[compressor].system);
+                    record.add("compression_times_ms", _compressionTimes[compressor]);
+                    record.add("decompression_times_ms", _decompressionTimes[compressor]);
+                    _addLatencies(record, "compression_latency", baskets ? &_compressionLatency[compressor] : nullptr);
+                    _addLatencies(record, "decompression_latency", baskets ? &_decompressionLatency[compressor] : nullptr);
+                    record.add("compression_memory_kb", _compressionMemory[compressor]);
+                    record.add("original_size_bytes", _originalDataSize);
+                    record.add("compressed_size_bytes", _compressedDataSize[compressor]);
+                    record.add("compression_ratio", _compressionRatio[compressor]);
+                    record.add("avg_relative_error", _avgRelativeError[compressor]);
+                    record.addNull("avg_relative_error_per_branch");
+                    records.push_back(record);
+                }
+            }
+
+            std::string report{};
+            for (size_t i{0}; i < records.size(); ++i) {
+                if (_reportType == "json") {
+                    report += records[i].toJSON();
+                }
+                else {
+                    if (i == 0 && _reportHeader) {
+                        report += records[i].toCSVHeader();
+                    }
+                    report += records[i].toCSVRow();
+                }
+            }
+            return report;
+        }
+
+        // Environment and run parameters; codec settings are null for codecs other than the one reported, and compressor
+        // is -1 for group results
+        ReportRecord _parameterRecord(const ReportRecord& environment, const std::string& name, const int compressor) const {
+            constexpr const char* dataTypes[]{"float", "uint32", "bool", "group"};
+
+            ReportRecord record{environment};
+            record.add("compressor", name);
+            record.add("data_type", dataTypes[_dataType]);
+            record.add("data_name", _dataName);
+            record.add("source_file", _sourceFile);
+            record.add("tree_name", _treeName);
+            record.add("branch_name", _dataType == GROUP ? "" : _branchName);
+            record.add("branch_group", _dataType == GROUP ? _groupName : "");
+            record.add("iterations", _iterations);
+            record.add("warmup", _warmup);
+            record.add("cache_state", _flushCache ? "cold" : "warm");
+            record.add("fresh_input", _freshInput);
+            record.add("basket_size_bytes", _basketSize);
+            record.add("num_baskets", _numBaskets);
+
+            if (_dataType == FLOAT || _dataType == GROUP) {
+                record.add("precision", _precision);
+            } else {
+                record.addNull("precision");
+            }
+
+            if (compressor == TRUNK || _dataType == GROUP) {
+                record.add("trunk_compression_level", _trunkCompressionLevel);
+                record.add("trunk_dictionary", _trunkDictionary);
+            } else {
+                record.addNull("trunk_compression_level");
+                record.addNull("trunk_dictionary");
+            }
+
+            if (compressor == SZ) {
+                record.add("sz_error_bound_mode", _szErrorBoundMode);
+                record.add("sz_abs_error_bound", _szCompressor->getAbsErrorBound());
+                record.add("sz_rel_error_bound", _szCompressor->getRelErrorBound());
+                record.add("sz_algo", _szAlgo);
+                record.add("sz_interp_algo", _szInterpAlgo);
+                record.add("sz_layout", _szCompressor->getLayoutString());
+                if (_szTuner) {
+                    record.add("sz_max_error", _szTuner->getMaxError());
+                    record.add("sz_tuning_time_ms", _szTuningTime);
+                } else {
+                    record.addNull("sz_max_error");
+                    record.addNull("sz_tuning_time_ms");
+                }
+            } else if (_dataType == GROUP) {
+                record.addNull("sz_error_bound_mode");
+                record.addNull("sz_abs_error_bound");
+                record.addNull("sz_rel_error_bound");
+                record.add("sz_algo", _szAlgo);
+                record.add("sz_interp_algo", _szInterpAlgo);
+                record.addNull("sz_layout");
+                record.addNull("sz_max_error");
+                record.addNull("sz_tuning_time_ms");
+            } else {
+                for (const char* key : {"sz_error_bound_mode", "sz_abs_error_bound", "sz_rel_error_bound", "sz_algo", "sz_interp_algo",
+                                        "sz_layout", "sz_max_error", "sz_tuning_time_ms"}) {
+                    record.addNull(key);
+                }
+            }
+
+            if (compressor == QUANT) {
+                const QuantCompressor* quantCompressor{static_cast<const QuantCompressor*>(_compressor[QUANT].get())};
+                record.add("quant_error_bound_mode", quantCompressor->getErrorBoundMode());
+                record.add("quant_error_bound", quantCompressor->getErrorBound());
+            } else {
+                record.addNull("quant_error_bound_mode");
+                record.addNull("quant_error_bound");
+            }
+
+            if (compressor == CHAIN) {
+                record.add("chain_spec", _chainSpec);
+            } else {
+                record.addNull("chain_spec");
+            }
+
+            return record;
+        }
+
+        void _addLatencies(ReportRecord& record, const std::string& prefix, const LatencyStats* stats) const {
+            if (stats) {
+                record.add(prefix + "_mean_us", stats->mean);
+                record.add(prefix + "_p50_us", stats->p50);
+                record.add(prefix + "_p90_us", stats->p90);
+                record.add(prefix + "_p99_us", stats->p99);
+                record.add(prefix + "_max_us", stats->max);
+            } else {
+                for (const char* suffix : {"_mean_us", "_p50_us", "_p90_us", "_p99_us", "_max_us"}) {
+                    record.addNull(prefix + suffix);
+                }
+            }
+        }
+
+        std::string _formatLatencies(const std::string& label, const LatencyStats& stats) const {
+            return std::format("{}: mean {:.2f} us (min: {:.2f} us, p50: {:.2f} us, p90: {:.2f} us, p99: {:.2f} us, max: {:.2f} us)\n",
+                label, stats.mean, stats.min, stats.p50, stats.p90, stats.p99, stats.max);
+        }
+
         // Get user and system CPU time for this process from /proc/self/stat
         // Time is measured in milliseconds
         void _getCPUTime(double& user, double& system) {
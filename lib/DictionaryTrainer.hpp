@@ -0,0 +1,102 @@
+#ifndef DICTIONARY_TRAINER_HPP
+#define DICTIONARY_TRAINER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TrunkCompressor.hpp"
+
+// zlib only looks back one window, so a longer preset dictionary is never used
+constexpr size_t MAX_DEFLATE_DICTIONARY_SIZE{32768};
+
+// Build a preset deflate dictionary for TrunkCompressor from sample data
+// Samples are truncated at the given precision, then cut into baskets of basketSize bytes. Two-float segments that
+// recur across baskets are the matches a basket cannot find in its own short history, so the most frequent ones fill
+// the dictionary, with the most frequent placed last where match distances are shortest.
+std::vector<uint8_t> trainDeflateDictionary(std::span<const float> samples, const int precision, const size_t basketSize,
+                                            size_t dictionarySize=MAX_DEFLATE_DICTIONARY_SIZE) {
+    constexpr size_t segmentFloats{2};
+    constexpr size_t segmentSize{segmentFloats * sizeof(float)};
+
+    if (basketSize < segmentSize) {
+        throw std::invalid_argument("Basket size must hold at least one dictionary segment");
+    }
+    dictionarySize = std::min(dictionarySize, MAX_DEFLATE_DICTIONARY_SIZE) / segmentSize * segmentSize;
+
+    // Truncate the samples exactly as the compressor will
+    TrunkCompressor truncator(precision, 0);
+    std::vector<float> truncatedSamples{truncator.truncate(samples)};
+
+    // Count how many baskets each segment appears in; repeats within one basket are already cheap for deflate
+    const size_t basketFloats{basketSize / sizeof(float)};
+    std::unordered_map<uint64_t, uint32_t> basketCounts{};
+    std::unordered_map<uint64_t, size_t> lastBasket{};
+
+    for (size_t start{0}, basket{0}; start < truncatedSamples.size(); start += basketFloats, ++basket) {
+        const size_t end{std::min(start + basketFloats, truncatedSamples.size())};
+        for (size_t i{start}; i + segmentFloats <= end; ++i) {
+            uint64_t segment;
+            std::memcpy(&segment, &truncatedSamples[i], segmentSize);
+
+            auto [it, inserted] = lastBasket.try_emplace(segment, basket);
+            if (inserted || it->second != basket) {
+                it->second = basket;
+                ++basketCounts[segment];
+            }
+        }
+    }
+
+    // Keep segments seen in more than one basket, most frequent first
+    std::vector<std::pair<uint64_t, uint32_t>> ranked{};
+    for (const auto& [segment, count] : basketCounts) {
+        if (count > 1) {
+            ranked.emplace_back(segment, count);
+        }
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    ranked.resize(std::min(ranked.size(), dictionarySize / segmentSize));
+
+    // Lay out dictionary with the most frequent segments at the end
+    std::vector<uint8_t> dictionary(ranked.size() * segmentSize);
+    for (size_t i{0}; i < ranked.size(); ++i) {
+        std::memcpy(dictionary.data() + (ranked.size() - 1 - i) * segmentSize, &ranked[i].first, segmentSize);
+    }
+
+    return dictionary;
+}
+
+// Dictionaries are stored as raw bytes, the form zlib takes them in
+void writeDictionary(const std::string& filename, const std::vector<uint8_t>& dictionary) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + filename);
+    }
+    file.write(reinterpret_cast<const char*>(dictionary.data()), dictionary.size());
+}
+
+std::vector<uint8_t> readDictionary(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + filename);
+    }
+
+    std::vector<uint8_t> dictionary(static_cast<size_t>(file.tellg()));
+    if (dictionary.size() > MAX_DEFLATE_DICTIONARY_SIZE) {
+        throw std::runtime_error("Dictionary is larger than the deflate window: " + filename);
+    }
+
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(dictionary.data()), dictionary.size());
+    return dictionary;
+}
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef ERROR_BOUND_HPP
+#define ERROR_BOUND_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "QuantCompressor.hpp"
+#include "SZCompressor.hpp"
+#include "TrunkCompressor.hpp"
+
+// Per-value guarantees of float codec chains, and checks of decompressed data against them
+
+// What a float chain guarantees per value. Non-finite values must always come back bit-exact.
+struct ErrorBound {
+    enum KIND{EXACT, TRUNCATED, VALUE};
+
+    int kind{EXACT};
+    int bitsTruncated{0};
+    double absErrorBound{0};
+    double relErrorBound{0};        // Relative to the finite value range of the chunk
+    bool useAbs{false};
+    bool useRel{false};
+    bool combineWithMax{false};     // Either bound is enough, rather than both
+    bool finiteOnly{false};         // Codec needs finite values and a finite value range
+    std::string description{"bit-exact"};
+};
+
+// Bound of the one lossy stage in a chain, from the same compressor the stage would build
+ErrorBound chainErrorBound(const std::string& spec) {
+    ErrorBound bound{};
+    int lossyStages{0};
+
+    std::istringstream iss(spec);
+    std::string stageSpec;
+    while (std::getline(iss, stageSpec, '|')) {
+        std::istringstream stageStream(stageSpec);
+        std::string name;
+        std::getline(stageStream, name, ':');
+        std::vector<int> arguments{};
+        std::string argument;
+        while (std::getline(stageStream, argument, ':')) {
+            arguments.push_back(std::stoi(argument));
+        }
+        auto argumentOr = [&](size_t index, int defaultValue) { return index < arguments.size() ? arguments[index] : defaultValue; };
+
+        if (name == "truncate" || name == "trunk") {
+            const int bits{TrunkCompressor(argumentOr(0, 3), 0).getBitsTruncated()};
+            if (bits) {
+                ++lossyStages;
+                bound.kind = ErrorBound::TRUNCATED;
+                bound.bitsTruncated = bits;
+                bound.description = std::format("{} bits truncated", bits);
+            }
+        }
+        else if (name == "quant") {
+            ++lossyStages;
+            QuantCompressor compressor(argumentOr(0, 3), argumentOr(1, QuantCompressor::REL));
+            bound.kind = ErrorBound::VALUE;
+            const bool relative{compressor.getErrorBoundMode() == QuantCompressor::REL};
+            bound.useAbs = !relative;
+            bound.useRel = relative;
+            (relative ? bound.relErrorBound : bound.absErrorBound) = compressor.getErrorBound();
+            bound.description = std::format("{} error {}", relative ? "relative" : "absolute", compressor.getErrorBound());
+        }
+        else if (name == "sz") {
+            ++lossyStages;
+            SZCompressor compressor(argumentOr(0, 3), argumentOr(1, SZ3::EB_REL), argumentOr(2, SZ3::ALGO_LORENZO_REG),
+                                    argumentOr(3, SZ3::INTERP_ALGO_LINEAR));
+            const int mode{compressor.getErrorBoundMode()};
+            if (mode != SZ3::EB_ABS && mode != SZ3::EB_REL && mode != SZ3::EB_ABS_AND_REL && mode != SZ3::EB_ABS_OR_REL) {
+                throw std::invalid_argument("Only per-value SZ3 error bound modes can be verified: " + spec);
+            }
+            bound.kind = ErrorBound::VALUE;
+            bound.absErrorBound = compressor.getAbsErrorBound();
+            bound.relErrorBound = compressor.getRelErrorBound();
+            bound.useAbs = mode != SZ3::EB_REL;
+            bound.useRel = mode != SZ3::EB_ABS;
+            // SZ3 takes the tighter of the two for ABS_AND_REL, the looser for ABS_OR_REL
+            bound.combineWithMax = mode == SZ3::EB_ABS_OR_REL;
+            bound.finiteOnly = true;
+            bound.description = compressor.getErrorBound();
+        }
+    }
+
+    if (lossyStages > 1) {
+        throw std::invalid_argument("Only chains with at most one lossy stage can be verified: " + spec);
+    }
+    return bound;
+}
+
+// Mismatches in one chunk, with the first one described
+struct CheckResult {
+    size_t mismatches{0};
+    std::string first{};
+
+    void add(size_t index, const std::string& description) {
+        if (!mismatches++) {
+            first = std::format("value {}: {}", index, description);
+        }
+    }
+};
+
+std::string describeFloat(float value) {
+    return std::format("{:g} (0x{:08x})", value, std::bit_cast<uint32_t>(value));
+}
+
+CheckResult checkFloats(const ErrorBound& bound, std::span<const float> input, std::span<const float> output) {
+    CheckResult result{};
+
+    // Absolute bound for this chunk; relative bounds scale with the finite value range, computed in double
+    double absErrorBound{0};
+    if (bound.kind == ErrorBound::VALUE) {
+        double minValue{std::numeric_limits<double>::max()};
+        double maxValue{std::numeric_limits<double>::lowest()};
+        for (float value : input) {
+            if (std::isfinite(value)) {
+                minValue = std::min(minValue, static_cast<double>(value));
+                maxValue = std::max(maxValue, static_cast<double>(value));
+            }
+        }
+        const double relativeBound{maxValue >= minValue ? bound.relErrorBound * (maxValue - minValue) : 0.0};
+        if (bound.useAbs && bound.useRel) {
+            absErrorBound = bound.combineWithMax ? std::max(bound.absErrorBound, relativeBound) : std::min(bound.absErrorBound, relativeBound);
+        } else {
+            absErrorBound = bound.useAbs ? bound.absErrorBound : relativeBound;
+        }
+    }
+
+    const uint32_t halfStep{bound.bitsTruncated ? 1u << (bound.bitsTruncated - 1) : 0u};
+    const uint32_t dropMask{(1u << bound.bitsTruncated) - 1u};
+    for (size_t i{0}; i < input.size(); ++i) {
+        const uint32_t inBits{std::bit_cast<uint32_t>(input[i])};
+        const uint32_t outBits{std::bit_cast<uint32_t>(output[i])};
+        if (inBits == outBits) {
+            continue;
+        }
+
+        if (bound.kind == ErrorBound::EXACT || !std::isfinite(input[i])) {
+            result.add(i, std::format("input {}, output {}: not bit-exact", describeFloat(input[i]), describeFloat(output[i])));
+        }
+        else if (bound.kind == ErrorBound::TRUNCATED) {
+            // Sign kept, dropped bits zero, and rounded to the nearest kept value: at most half a step away, in units of
+            // the input's ULP. Values whose round-up would overflow to Inf are truncated instead, up to a full step.
+            const uint32_t inMagnitude{inBits & 0x7FFFFFFFu};
+            const uint32_t outMagnitude{outBits & 0x7FFFFFFFu};
+            const uint32_t distance{inMagnitude > outMagnitude ? inMagnitude - outMagnitude : outMagnitude - inMagnitude};
+            const bool overflowGuard{((inMagnitude & ~dropMask) + (dropMask + 1u)) >= 0x7F800000u && outMagnitude < inMagnitude};
+            if ((inBits ^ outBits) & 0x80000000u || outBits & dropMask || !std::isfinite(output[i])
+                    || distance > (overflowGuard ? dropMask : halfStep)) {
+                result.add(i, std::format("input {}, output {}: {} ULP off with {} bits truncated",
+                                            describeFloat(input[i]), describeFloat(output[i]), distance, bound.bitsTruncated));
+            }
+        }
+        else {
+            const double error{std::abs(static_cast<double>(output[i]) - static_cast<double>(input[i]))};
+            if (!(error <= absErrorBound)) {
+                result.add(i, std::format("input {}, output {}: error {:g} > bound {:g}",
+                                            describeFloat(input[i]), describeFloat(output[i]), error, absErrorBound));
+            }
+        }
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef INTEGER_COMPRESSOR_HPP
+#define INTEGER_COMPRESSOR_HPP
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// Lossless codecs for uint32 columns such as run/event numbers and object counts
+// Values are transformed according to the mode, then bit-packed in blocks of 128 with a per-block reference and width.
+// Each block is stored as four interleaved 32-value lanes (the SIMD-BP128 layout), so the pack and unpack inner loops
+// work on four independent words and vectorize.
+class IntegerCompressor {
+    public:
+        enum MODE{DELTA, DELTA_OF_DELTA, FRAME_OF_REFERENCE};
+
+        static constexpr size_t BLOCK_SIZE{128};
+
+        IntegerCompressor() {}
+
+        IntegerCompressor(const int mode, bool debug=false) : _debug(debug) {
+            // Validate mode
+            if (mode < DELTA || mode > FRAME_OF_REFERENCE) {
+                throw std::invalid_argument("mode must be between 0 and 2");
+            }
+            else {
+                _mode = mode;
+            }
+        }
+
+        std::vector<uint8_t> compress(const std::vector<uint32_t>& data) {
+            std::vector<uint8_t> compressedData{};
+            compressInto(data, compressedData);
+            return compressedData;
+        }
+
+        void compressInto(std::span<const uint32_t> data, std::vector<uint8_t>& compressedData) {
+            if (_debug) {
+                std::cerr << std::format("[DEBUG IntegerCompressor]: mode = {}, dataSize = {}", _mode, data.size() * sizeof(uint32_t)) << std::endl;
+            }
+
+            compressedData.clear();
+
+            uint32_t block[BLOCK_SIZE];
+            uint32_t packed[BLOCK_SIZE];
+            uint32_t previous{0};
+            uint32_t previousDelta{0};
+
+            for (size_t start{0}; start < data.size(); start += BLOCK_SIZE) {
+                const size_t count{std::min(BLOCK_SIZE, data.size() - start)};
+
+                // Transform; the tail of a partial block is padded with zeros
+                for (size_t i{0}; i < count; ++i) {
+                    const uint32_t value{data[start + i]};
+                    switch (_mode) {
+                        case DELTA:
+                            block[i] = _zigzag(value - previous);
+                            break;
+                        case DELTA_OF_DELTA:
+                            block[i] = _zigzag((value - previous) - previousDelta);
+                            previousDelta = value - previous;
+                            break;
+                        default:
+                            block[i] = value;
+                            break;
+                    }
+                    previous = value;
+                }
+                std::fill(block + count, block + BLOCK_SIZE, 0);
+
+                // Frame of reference
+                const uint32_t reference{*std::min_element(block, block + count)};
+                uint32_t maxOffset{0};
+                for (size_t i{0}; i < count; ++i) {
+                    block[i] -= reference;
+                    maxOffset = std::max(maxOffset, block[i]);
+                }
+                const int width{static_cast<int>(std::bit_width(maxOffset))};
+
+                // Block header is width then reference, followed by the packed lanes
+                compressedData.push_back(static_cast<uint8_t>(width));
+                _append(compressedData, &reference, sizeof(reference));
+
+                _pack(block, width, packed);
+                _append(compressedData, packed, 4 * width * sizeof(uint32_t));
+            }
+        }
+
+        std::vector<uint32_t> decompress(const std::vector<uint8_t>& compressedData, const size_t& uncompressedSize) {
+            std::vector<uint32_t> decompressedData(uncompressedSize);
+            decompressInto(compressedData, decompressedData);
+            return decompressedData;
+        }
+
+        void decompressInto(std::span<const uint8_t> compressedData, std::span<uint32_t> decompressedData) {
+            uint32_t block[BLOCK_SIZE];
+            uint32_t packed[BLOCK_SIZE];
+            uint32_t previous{0};
+            uint32_t previousDelta{0};
+            size_t position{0};
+
+            for (size_t start{0}; start < decompressedData.size(); start += BLOCK_SIZE) {
+                const size_t count{std::min(BLOCK_SIZE, decompressedData.size() - start)};
+
+                // Read block header
+                if (position + 1 + sizeof(uint32_t) > compressedData.size()) {
+                    throw std::runtime_error("IntegerCompressor: compressed data is truncated");
+                }
+                const int width{compressedData[position++]};
+                if (width > 32) {
+                    throw std::runtime_error("IntegerCompressor: invalid bit width");
+                }
+                uint32_t reference;
+                std::memcpy(&reference, compressedData.data() + position, sizeof(reference));
+                position += sizeof(reference);
+
+                // Unpack lanes
+                const size_t packedSize{4 * width * sizeof(uint32_t)};
+                if (position + packedSize > compressedData.size()) {
+                    throw std::runtime_error("IntegerCompressor: compressed data is truncated");
+                }
+                std::memcpy(packed, compressedData.data() + position, packedSize);
+                position += packedSize;
+                _unpack(packed, width, block);
+
+                // Undo frame of reference and transform
+                for (size_t i{0}; i < count; ++i) {
+                    const uint32_t value{block[i] + reference};
+                    switch (_mode) {
+                        case DELTA:
+                            previous += _unzigzag(value);
+                            break;
+                        case DELTA_OF_DELTA:
+                            previousDelta += _unzigzag(value);
+                            previous += previousDelta;
+                            break;
+                        default:
+                            previous = value;
+                            break;
+                    }
+                    decompressedData[start + i] = previous;
+                }
+            }
+        }
+
+        // Getters
+        int getMode() const { return _mode; }
+
+    private:
+        int _mode;
+        bool _debug;
+
+        static uint32_t _zigzag(uint32_t value) {
+            return (value << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(value) >> 31);
+        }
+
+        static uint32_t _unzigzag(uint32_t value) {
+            return (value >> 1) ^ (0u - (value & 1u));
+        }
+
+        static void _append(std::vector<uint8_t>& buffer, const void* source, size_t size) {
+            const uint8_t* bytes{static_cast<const uint8_t*>(source)};
+            buffer.insert(buffer.end(), bytes, bytes + size);
+        }
+
+        // Value i goes to lane i % 4, at bit (i / 4) * width of that lane
+        static void _pack(const uint32_t* in, int width, uint32_t* out) {
+            std::fill(out, out + 4 * width, 0);
+            if (width == 0) {
+                return;
+            }
+
+            for (size_t j{0}; j < BLOCK_SIZE / 4; ++j) {
+                const size_t bit{j * width};
+                const size_t word{bit / 32};
+                const size_t shift{bit % 32};
+                const bool spills{shift + width > 32};
+
+                for (size_t lane{0}; lane < 4; ++lane) {
+                    const uint32_t value{in[4 * j + lane]};
+                    out[4 * word + lane] |= value << shift;
+                    if (spills) {
+                        out[4 * (word + 1) + lane] |= value >> (32 - shift);
+                    }
+                }
+            }
+        }
+
+        static void _unpack(const uint32_t* in, int width, uint32_t* out) {
+            if (width == 0) {
+                std::fill(out, out + BLOCK_SIZE, 0);
+                return;
+            }
+
+            const uint32_t mask{width == 32 ? ~0u : (1u << width) - 1u};
+            for (size_t j{0}; j < BLOCK_SIZE / 4; ++j) {
+                const size_t bit{j * width};
+                const size_t word{bit / 32};
+                const size_t shift{bit % 32};
+                const bool spills{shift + width > 32};
+
+                for (size_t lane{0}; lane < 4; ++lane) {
+                    uint32_t value{in[4 * word + lane] >> shift};
+                    if (spills) {
+                        value |= in[4 * (word + 1) + lane] << (32 - shift);
+                    }
+                    out[4 * j + lane] = value & mask;
+                }
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,274 @@
+#ifndef MULTI_COLUMN_COMPRESSOR_HPP
+#define MULTI_COLUMN_COMPRESSOR_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include <SZ3/api/sz.hpp>
+
+#include "SZCompressor.hpp"
+#include "TrunkCompressor.hpp"
+
+// Compresses a group of aligned columns (one value per object in each) together
+// PREDICT_ENERGY takes the columns pt, eta, phi, E and optionally m. pt, eta, phi and m are truncated and deflated as
+// TrunkCompressor does; E is stored as its ratio to the prediction sqrt((pt cosh eta)^2 + m^2) from the *decompressed*
+// columns, so the decoder rebuilds the same prediction and the ratio carries E's relative precision.
+// SZ_2D scales each column to [0, 1] and hands SZ3 the columns as rows of one 2-D field, so its predictors can use the
+// neighbouring column of the same object. The absolute bound on the scaled field is the relative error for precision,
+// i.e. each column keeps SZ's EB_REL guarantee against its own range.
+class MultiColumnCompressor {
+    public:
+        enum MODE{PREDICT_ENERGY, SZ_2D};
+
+        enum COLUMN{PT, ETA, PHI, E, M};
+
+        MultiColumnCompressor() {}
+
+        MultiColumnCompressor(const int mode, const int precision, const int compressionLevel,
+                                const int szAlgo, const int szInterpAlgo, bool debug=false)
+            : _precision(precision), _compressionLevel(compressionLevel), _szAlgo(szAlgo), _szInterpAlgo(szInterpAlgo), _debug(debug)
+        {
+            // Validate mode
+            if (mode < PREDICT_ENERGY || mode > SZ_2D) {
+                throw std::invalid_argument("mode must be between 0 and 1");
+            }
+            else {
+                _mode = mode;
+            }
+
+            // Validates precision and compression level
+            TrunkCompressor validation(precision, compressionLevel);
+        }
+
+        std::vector<uint8_t> compress(const std::vector<std::vector<float>>& columns) {
+            const size_t numValues{columns.empty() ? 0 : columns[0].size()};
+            for (const std::vector<float>& column : columns) {
+                if (column.size() != numValues) {
+                    throw std::invalid_argument("MultiColumnCompressor: columns must have the same length");
+                }
+            }
+
+            if (_debug) {
+                std::cerr << std::format("[DEBUG MultiColumnCompressor]: mode = {}, precision = {}, columns = {}, dataSize = {}",
+                                            _mode, _precision, columns.size(), columns.size() * numValues * sizeof(float)) << std::endl;
+            }
+
+            // Header is mode, number of columns and number of values
+            std::vector<uint8_t> compressedData{};
+            _appendValue(compressedData, static_cast<uint32_t>(_mode));
+            _appendValue(compressedData, static_cast<uint32_t>(columns.size()));
+            _appendValue(compressedData, static_cast<uint64_t>(numValues));
+
+            if (_mode == PREDICT_ENERGY) {
+                _compressPredicted(columns, compressedData);
+            }
+            else {
+                _compressSZ2D(columns, compressedData);
+            }
+
+            return compressedData;
+        }
+
+        std::vector<std::vector<float>> decompress(const std::vector<uint8_t>& compressedData) {
+            size_t position{0};
+            const uint32_t mode{_readValue<uint32_t>(compressedData, position)};
+            const uint32_t numColumns{_readValue<uint32_t>(compressedData, position)};
+            const uint64_t numValues{_readValue<uint64_t>(compressedData, position)};
+            if (mode != static_cast<uint32_t>(_mode)) {
+                throw std::runtime_error("MultiColumnCompressor: data was compressed with a different mode");
+            }
+            _checkHeader(numColumns, numValues, compressedData.size() - position);
+
+            std::vector<std::vector<float>> columns(numColumns, std::vector<float>(numValues));
+            if (_mode == PREDICT_ENERGY) {
+                _decompressPredicted(compressedData, position, columns);
+            }
+            else {
+                _decompressSZ2D(compressedData, position, columns);
+            }
+
+            return columns;
+        }
+
+        // Getters
+        int getMode() const { return _mode; }
+        int getPrecision() const { return _precision; }
+
+    private:
+        int _mode;
+        int _precision;
+        int _compressionLevel;
+        int _szAlgo;
+        int _szInterpAlgo;
+        bool _debug;
+
+        // Largest ratio a stream can have, to bound the counts in a header. Deflate never exceeds 1032:1. SZ3 codes a
+        // constant field at about a bit per value and zstd then stores runs as RLE blocks, about 10^6:1 on floats;
+        // the limit has headroom above that and only stops a corrupt header from asking for an absurd allocation.
+        static constexpr uint64_t MAX_DEFLATE_RATIO{1032};
+        static constexpr uint64_t MAX_SZ_RATIO{1 << 22};
+
+        // The header is read from the stream, so its counts are checked before anything is allocated
+        void _checkHeader(uint64_t numColumns, uint64_t numValues, size_t remaining) const {
+            if (_mode == PREDICT_ENERGY && numColumns != 4 && numColumns != 5) {
+                throw std::runtime_error(std::format("MultiColumnCompressor: energy prediction needs 4 or 5 columns, stream has {}", numColumns));
+            }
+            if (_mode == SZ_2D && numColumns * 2 * sizeof(float) > remaining) {
+                throw std::runtime_error("MultiColumnCompressor: compressed data is truncated");
+            }
+            const uint64_t maxBytes{(_mode == PREDICT_ENERGY ? MAX_DEFLATE_RATIO : MAX_SZ_RATIO) * remaining};
+            if (numColumns && numValues > maxBytes / sizeof(float) / numColumns) {
+                throw std::runtime_error(std::format("MultiColumnCompressor: {} columns of {} values cannot fit in {} bytes",
+                                                        numColumns, numValues, remaining));
+            }
+        }
+
+        void _compressPredicted(const std::vector<std::vector<float>>& columns, std::vector<uint8_t>& compressedData) {
+            if (columns.size() != 4 && columns.size() != 5) {
+                throw std::invalid_argument("MultiColumnCompressor: energy prediction needs columns pt, eta, phi, E and optionally m");
+            }
+
+            TrunkCompressor compressor(_precision, _compressionLevel);
+            std::vector<uint8_t> blob{};
+            std::vector<std::vector<float>> decoded(columns.size());
+
+            // Kinematic columns on their own; keep what the decoder will see
+            for (size_t column{0}; column < columns.size(); ++column) {
+                if (column == E) {
+                    continue;
+                }
+                compressor.compressInto(columns[column], blob);
+                _appendBlob(compressedData, blob);
+
+                decoded[column].resize(columns[column].size());
+                compressor.decompressInto(blob, decoded[column]);
+            }
+
+            // Energy as a ratio to its prediction
+            std::vector<float> residual(columns[E].size());
+            for (size_t i{0}; i < residual.size(); ++i) {
+                const float prediction{_predictEnergy(decoded, i)};
+                residual[i] = prediction ? columns[E][i] / prediction : columns[E][i];
+            }
+            compressor.compressInto(residual, blob);
+            _appendBlob(compressedData, blob);
+        }
+
+        void _decompressPredicted(const std::vector<uint8_t>& compressedData, size_t& position, std::vector<std::vector<float>>& columns) {
+            TrunkCompressor compressor(_precision, _compressionLevel);
+
+            for (size_t column{0}; column < columns.size(); ++column) {
+                if (column == E) {
+                    continue;
+                }
+                compressor.decompressInto(_readBlob(compressedData, position), columns[column]);
+            }
+
+            compressor.decompressInto(_readBlob(compressedData, position), columns[E]);
+            for (size_t i{0}; i < columns[E].size(); ++i) {
+                const float prediction{_predictEnergy(columns, i)};
+                if (prediction) {
+                    columns[E][i] *= prediction;
+                }
+            }
+        }
+
+        // Energy from pt, eta and (if present) mass; 0 when there is no usable prediction
+        static float _predictEnergy(const std::vector<std::vector<float>>& columns, size_t i) {
+            const double momentum{static_cast<double>(columns[PT][i]) * std::cosh(static_cast<double>(columns[ETA][i]))};
+            const double mass{columns.size() > M ? static_cast<double>(columns[M][i]) : 0.0};
+            const float prediction{static_cast<float>(std::sqrt(momentum * momentum + mass * mass))};
+            return (std::isfinite(prediction) && prediction > 0) ? prediction : 0.0f;
+        }
+
+        void _compressSZ2D(const std::vector<std::vector<float>>& columns, std::vector<uint8_t>& compressedData) {
+            const size_t numValues{columns.empty() ? 0 : columns[0].size()};
+
+            // Scale each column to [0, 1], keeping its range for the decoder
+            std::vector<float> field(columns.size() * numValues);
+            for (size_t column{0}; column < columns.size(); ++column) {
+                auto [minIt, maxIt] = std::minmax_element(columns[column].begin(), columns[column].end());
+                const float minValue{numValues ? *minIt : 0.0f};
+                const float maxValue{numValues ? *maxIt : 0.0f};
+                const float range{maxValue - minValue};
+                _appendValue(compressedData, minValue);
+                _appendValue(compressedData, maxValue);
+
+                for (size_t i{0}; i < numValues; ++i) {
+                    field[column * numValues + i] = range > 0 ? (columns[column][i] - minValue) / range : 0.0f;
+                }
+            }
+
+            SZCompressor compressor(_precision, SZ3::EB_ABS, _szAlgo, _szInterpAlgo);
+            compressor.setErrorBounds(SZ3::EB_ABS, 0.5 * std::pow(10, -_precision), 0.0);
+            compressor.setDimensions({columns.size(), numValues});
+
+            std::vector<uint8_t> blob{};
+            compressor.compressInto(field, blob);
+            _appendBlob(compressedData, blob);
+        }
+
+        void _decompressSZ2D(const std::vector<uint8_t>& compressedData, size_t& position, std::vector<std::vector<float>>& columns) {
+            const size_t numValues{columns.empty() ? 0 : columns[0].size()};
+
+            std::vector<std::pair<float, float>> ranges(columns.size());
+            for (auto& [minValue, maxValue] : ranges) {
+                minValue = _readValue<float>(compressedData, position);
+                maxValue = _readValue<float>(compressedData, position);
+            }
+
+            std::vector<float> field(columns.size() * numValues);
+            SZCompressor compressor(_precision, SZ3::EB_ABS, _szAlgo, _szInterpAlgo);
+            compressor.decompressInto(_readBlob(compressedData, position), field);
+
+            for (size_t column{0}; column < columns.size(); ++column) {
+                const auto [minValue, maxValue] = ranges[column];
+                for (size_t i{0}; i < numValues; ++i) {
+                    columns[column][i] = minValue + field[column * numValues + i] * (maxValue - minValue);
+                }
+            }
+        }
+
+        template <typename T>
+        static void _appendValue(std::vector<uint8_t>& buffer, T value) {
+            const uint8_t* bytes{reinterpret_cast<const uint8_t*>(&value)};
+            buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+        }
+
+        template <typename T>
+        static T _readValue(const std::vector<uint8_t>& buffer, size_t& position) {
+            if (position + sizeof(T) > buffer.size()) {
+                throw std::runtime_error("MultiColumnCompressor: compressed data is truncated");
+            }
+            T value;
+            std::memcpy(&value, buffer.data() + position, sizeof(T));
+            position += sizeof(T);
+            return value;
+        }
+
+        // Blobs are length-prefixed
+        static void _appendBlob(std::vector<uint8_t>& buffer, const std::vector<uint8_t>& blob) {
+            _appendValue(buffer, static_cast<uint64_t>(blob.size()));
+            buffer.insert(buffer.end(), blob.begin(), blob.end());
+        }
+
+        static std::span<const uint8_t> _readBlob(const std::vector<uint8_t>& buffer, size_t& position) {
+            const uint64_t size{_readValue<uint64_t>(buffer, position)};
+            if (position + size > buffer.size()) {
+                throw std::runtime_error("MultiColumnCompressor: compressed data is truncated");
+            }
+            std::span<const uint8_t> blob{buffer.data() + position, size};
+            position += size;
+            return blob;
+        }
+};
+
+#endif
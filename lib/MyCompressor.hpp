@@ -1,7 +1,11 @@
 #ifndef MY_COMPRESSOR_HPP
 #define MY_COMPRESSOR_HPP
 
+#include <algorithm>
 #include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
 #include <vector>
 
 class MyCompressor{
@@ -13,6 +17,23 @@ class MyCompressor{
 
         // Decompress vector of bytes into vector of floats
         virtual std::vector<float> decompress(const std::vector<uint8_t>& compressedData, const size_t& uncompressedSize) = 0;
+
+        // Independent compressor with the same settings, e.g. one per worker thread
+        virtual std::unique_ptr<MyCompressor> clone() const = 0;
+
+        // Compress into a caller-owned buffer, so its capacity can be reused across calls
+        virtual void compressInto(std::span<const float> data, std::vector<uint8_t>& compressedData) {
+            compressedData = compress(std::vector<float>(data.begin(), data.end()));
+        }
+
+        // Decompress into a caller-owned buffer holding exactly the uncompressed number of floats
+        virtual void decompressInto(std::span<const uint8_t> compressedData, std::span<float> decompressedData) {
+            std::vector<float> result{decompress(std::vector<uint8_t>(compressedData.begin(), compressedData.end()), decompressedData.size())};
+            if (result.size() != decompressedData.size()) {
+                throw std::runtime_error("MyCompressor: decompressed size mismatch");
+            }
+            std::copy(result.begin(), result.end(), decompressedData.begin());
+        }
 };
 
-#endif
\ No newline at end of file
+#endif
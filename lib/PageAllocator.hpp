@@ -0,0 +1,275 @@
+#ifndef PAGE_ALLOCATOR_HPP
+#define PAGE_ALLOCATOR_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <new>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Page size and NUMA placement for large buffers
+// DEFAULT leaves both to the allocator and the kernel: 4 KB pages, placed on the node of the thread that first touches
+// them. TRANSPARENT asks for transparent huge pages with madvise, which works whenever THP is in "madvise" or "always"
+// mode. EXPLICIT maps from the hugetlbfs pool (vm.nr_hugepages) and falls back to TRANSPARENT when the pool is empty.
+// A node >= 0 binds the pages to that node with mbind, whichever thread touches them first.
+struct PagePolicy {
+    enum PAGES{DEFAULT, TRANSPARENT, EXPLICIT};
+
+    int pages{DEFAULT};
+    int node{-1};
+};
+
+constexpr size_t HUGE_PAGE_SIZE{2 * 1024 * 1024};
+
+// NUMA topology --------------------------------------------------------------------------------------------------
+
+// Parse a sysfs CPU or node list such as "0-3,8-11"
+std::vector<int> parseCPUList(const std::string& list) {
+    std::vector<int> items{};
+    std::istringstream iss(list);
+    std::string range;
+    while (std::getline(iss, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        const size_t dash{range.find('-')};
+        const int first{std::stoi(range.substr(0, dash))};
+        const int last{dash == std::string::npos ? first : std::stoi(range.substr(dash + 1))};
+        for (int item{first}; item <= last; ++item) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+std::string readSysfs(const std::string& path) {
+    std::ifstream file(path);
+    std::string value{};
+    std::getline(file, value);
+    return value;
+}
+
+// Online NUMA nodes; a machine without NUMA support reports node 0 only
+std::vector<int> numaNodes() {
+    std::vector<int> nodes{parseCPUList(readSysfs("/sys/devices/system/node/online"))};
+    return nodes.empty() ? std::vector<int>{0} : nodes;
+}
+
+// CPUs on a node; every CPU if the node is unknown
+std::vector<int> nodeCPUs(const int node) {
+    std::vector<int> cpus{parseCPUList(readSysfs(std::format("/sys/devices/system/node/node{}/cpulist", node)))};
+    if (cpus.empty()) {
+        for (int cpu{0}; cpu < static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)); ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// Restrict the calling thread to the CPUs of a node, so its chunks stay node-local
+void pinThreadToNode(const int node) {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpu : nodeCPUs(node)) {
+        CPU_SET(cpu, &cpuSet);
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+        throw std::runtime_error(std::format("pinThreadToNode: could not pin thread to node {}", node));
+    }
+}
+
+// CPUs the calling thread may run on, to be put back with setThreadAffinity after pinning a thread that is reused
+cpu_set_t threadAffinity() {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+        throw std::runtime_error("threadAffinity: could not read thread affinity");
+    }
+    return cpuSet;
+}
+
+void setThreadAffinity(const cpu_set_t& cpuSet) {
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+        throw std::runtime_error("setThreadAffinity: could not set thread affinity");
+    }
+}
+
+// Node the calling thread is running on right now
+int currentNode() {
+    unsigned cpu{0};
+    unsigned node{0};
+    return syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 ? static_cast<int>(node) : -1;
+}
+
+// Pages --------------------------------------------------------------------------------------------------------------
+
+// Ask for transparent huge pages on the 2 MB-aligned part of an existing buffer, e.g. a std::vector that was just
+// reserved. Returns false if the kernel refused, e.g. with THP disabled.
+bool adviseHugePages(void* data, size_t bytes) {
+    const uintptr_t begin{(reinterpret_cast<uintptr_t>(data) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1)};
+    const uintptr_t end{(reinterpret_cast<uintptr_t>(data) + bytes) & ~(HUGE_PAGE_SIZE - 1)};
+    if (end <= begin) {
+        return false;
+    }
+    return madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE) == 0;
+}
+
+// Bind pages that have not been touched yet to a node
+void bindToNode(void* data, size_t bytes, const int node) {
+    if (node < 0) {
+        return;
+    }
+    const unsigned long maxNodes{8 * sizeof(unsigned long)};
+    if (static_cast<unsigned long>(node) >= maxNodes) {
+        throw std::invalid_argument(std::format("bindToNode: node {} out of range", node));
+    }
+    const unsigned long nodeMask{1ul << node};
+    if (syscall(SYS_mbind, data, bytes, MPOL_BIND, &nodeMask, maxNodes, 0) != 0) {
+        throw std::runtime_error(std::format("bindToNode: mbind to node {} failed", node));
+    }
+}
+
+// Huge-page-backed bytes, transparent or hugetlbfs, of the mappings that overlap any of the buffers, from
+// /proc/self/smaps. Adjacent buffers with the same flags share a mapping, which is only counted once.
+size_t hugePageBytes(const std::vector<std::span<const std::byte>>& buffers) {
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool inRange{false};
+    size_t total{0};
+    while (std::getline(smaps, line)) {
+        // Mapping lines start with "start-end", field lines with a name and a colon
+        const size_t dash{line.find('-')};
+        const size_t space{line.find(' ')};
+        if (dash != std::string::npos && dash < space && line.find(':') > space) {
+            const uintptr_t mapBegin{std::stoull(line.substr(0, dash), nullptr, 16)};
+            const uintptr_t mapEnd{std::stoull(line.substr(dash + 1, space - dash - 1), nullptr, 16)};
+            inRange = std::any_of(buffers.begin(), buffers.end(), [&](std::span<const std::byte> buffer) {
+                const uintptr_t begin{reinterpret_cast<uintptr_t>(buffer.data())};
+                return !buffer.empty() && mapBegin < begin + buffer.size() && mapEnd > begin;
+            });
+        }
+        else if (inRange) {
+            for (const std::string_view field : {"AnonHugePages:", "Private_Hugetlb:", "Shared_Hugetlb:"}) {
+                if (line.rfind(field, 0) == 0) {
+                    total += std::stoull(line.substr(field.size())) * 1024;
+                }
+            }
+        }
+    }
+    return total;
+}
+
+// Map bytes on a 2 MB boundary, so every page of the buffer can be a huge page; nullptr if the mapping failed
+void* mapPages(size_t bytes, const PagePolicy& policy) {
+    const size_t length{(bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1)};
+
+    void* data{MAP_FAILED};
+    if (policy.pages == PagePolicy::EXPLICIT) {
+        data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (data == MAP_FAILED) {
+        // Over-map by a huge page and trim both ends to align
+        void* mapped{mmap(nullptr, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+        if (mapped == MAP_FAILED) {
+            return nullptr;
+        }
+        const uintptr_t start{reinterpret_cast<uintptr_t>(mapped)};
+        const uintptr_t aligned{(start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1)};
+        if (aligned > start) {
+            munmap(mapped, aligned - start);
+        }
+        if (aligned + length < start + length + HUGE_PAGE_SIZE) {
+            munmap(reinterpret_cast<void*>(aligned + length), start + length + HUGE_PAGE_SIZE - aligned - length);
+        }
+        data = reinterpret_cast<void*>(aligned);
+        if (policy.pages != PagePolicy::DEFAULT) {
+            madvise(data, length, MADV_HUGEPAGE);
+        }
+    }
+
+    try {
+        bindToNode(data, length, policy.node);
+    }
+    catch (...) {
+        munmap(data, length);
+        throw;
+    }
+    return data;
+}
+
+void unmapPages(void* data, size_t bytes) {
+    munmap(data, (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+}
+
+// Allocator that maps buffers of a huge page or more according to a PagePolicy, and leaves smaller ones and the
+// DEFAULT policy without a node to operator new. The policy is per allocator, so containers on different nodes can
+// coexist; containers only swap or move-assign storage when their policies are equal.
+template <typename T>
+class PageAllocator {
+    public:
+        using value_type = T;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        PageAllocator() {}
+
+        PageAllocator(const PagePolicy& policy) : _policy(policy) {}
+
+        template <typename U>
+        PageAllocator(const PageAllocator<U>& other) : _policy(other.getPolicy()) {}
+
+        T* allocate(size_t n) {
+            const size_t bytes{n * sizeof(T)};
+            if (!_mapped(bytes)) {
+                return static_cast<T*>(::operator new(bytes));
+            }
+            void* data{mapPages(bytes, _policy)};
+            if (!data) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(data);
+        }
+
+        void deallocate(T* data, size_t n) {
+            const size_t bytes{n * sizeof(T)};
+            if (!_mapped(bytes)) {
+                ::operator delete(data);
+                return;
+            }
+            unmapPages(data, bytes);
+        }
+
+        const PagePolicy& getPolicy() const { return _policy; }
+
+        template <typename U>
+        bool operator==(const PageAllocator<U>& other) const {
+            return _policy.pages == other.getPolicy().pages && _policy.node == other.getPolicy().node;
+        }
+
+    private:
+        PagePolicy _policy{};
+
+        bool _mapped(size_t bytes) const {
+            return bytes >= HUGE_PAGE_SIZE && (_policy.pages != PagePolicy::DEFAULT || _policy.node >= 0);
+        }
+};
+
+template <typename T>
+using PageVector = std::vector<T, PageAllocator<T>>;
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef PERF_COUNTER_HPP
+#define PERF_COUNTER_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Hardware event counter for the calling thread, through perf_event_open
+// User-space only, so it works with perf_event_paranoid up to 2. Counters are often unavailable in containers and VMs;
+// check isOpen() and report the event as missing rather than zero.
+class PerfCounter {
+    public:
+        // dTLB load misses, the default, and dTLB store misses
+        static constexpr uint64_t DTLB_LOAD_MISSES{PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+        static constexpr uint64_t DTLB_STORE_MISSES{PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_WRITE << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+
+        PerfCounter(const uint32_t type=PERF_TYPE_HW_CACHE, const uint64_t config=DTLB_LOAD_MISSES) {
+            perf_event_attr attributes;
+            std::memset(&attributes, 0, sizeof(attributes));
+            attributes.size = sizeof(attributes);
+            attributes.type = type;
+            attributes.config = config;
+            attributes.disabled = 1;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            _fd = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+        }
+
+        ~PerfCounter() {
+            if (_fd >= 0) {
+                close(_fd);
+            }
+        }
+
+        // Owns a file descriptor
+        PerfCounter(const PerfCounter&) = delete;
+        PerfCounter& operator=(const PerfCounter&) = delete;
+
+        bool isOpen() const { return _fd >= 0; }
+
+        void start() {
+            if (_fd >= 0) {
+                ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+
+        // Events since start
+        uint64_t stop() {
+            uint64_t count{0};
+            if (_fd >= 0) {
+                ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(_fd, &count, sizeof(count)) != sizeof(count)) {
+                    count = 0;
+                }
+            }
+            return count;
+        }
+
+    private:
+        int _fd{-1};
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef PHILOX_HPP
+#define PHILOX_HPP
+
+#include <array>
+#include <cstdint>
+
+// Philox4x32-10 counter-based random number generator (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3")
+// Output depends only on (key, counter), so any element of a generated array can be computed independently, and the
+// result is the same for any number of threads.
+class Philox4x32 {
+    public:
+        using Counter = std::array<uint32_t, 4>;
+        using Key = std::array<uint32_t, 2>;
+
+        Philox4x32(uint64_t seed)
+            : _key{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)} {}
+
+        // Four random words for element `index` of stream `stream`
+        Counter operator()(uint64_t index, uint32_t stream=0) const {
+            Counter counter{static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32), stream, 0};
+            Key key{_key};
+
+            for (int round{0}; round < ROUNDS; ++round) {
+                counter = _round(counter, key);
+                key[0] += W0;
+                key[1] += W1;
+            }
+
+            return counter;
+        }
+
+        // Uniform float in [0, 1) from the top 24 bits of a word
+        static float toUniform(uint32_t word) {
+            return static_cast<float>(word >> 8) * 0x1.0p-24f;
+        }
+
+        // Uniform float in (0, 1], safe to take the logarithm of
+        static float toUniformOpen(uint32_t word) {
+            return static_cast<float>((word >> 8) + 1) * 0x1.0p-24f;
+        }
+
+    private:
+        static constexpr int ROUNDS{10};
+        static constexpr uint32_t M0{0xD2511F53};
+        static constexpr uint32_t M1{0xCD9E8D57};
+        static constexpr uint32_t W0{0x9E3779B9};
+        static constexpr uint32_t W1{0xBB67AE85};
+
+        Key _key;
+
+        static Counter _round(const Counter& counter, const Key& key) {
+            uint64_t product0{static_cast<uint64_t>(M0) * counter[0]};
+            uint64_t product1{static_cast<uint64_t>(M1) * counter[2]};
+
+            return Counter{
+                static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+                static_cast<uint32_t>(product1),
+                static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+                static_cast<uint32_t>(product0)
+            };
+        }
+};
+
+#endif
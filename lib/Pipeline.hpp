@@ -0,0 +1,447 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "BufferPool.hpp"
+#include "MyCompressor.hpp"
+
+// Bounded multi-producer multi-consumer queue (Vyukov's ring of sequenced cells), lock-free on the fast path
+// push and pop block while the queue is full or empty, which is the backpressure between pipeline stages. After close,
+// push fails and pop drains what is left, then fails.
+template <typename T>
+class BoundedQueue {
+    public:
+        BoundedQueue(size_t capacity) : _capacity(std::bit_ceil(std::max<size_t>(capacity, 2))), _cells(_capacity) {
+            for (size_t i{0}; i < _capacity; ++i) {
+                _cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        bool tryPush(T& item) {
+            size_t position{_tail.load(std::memory_order_relaxed)};
+            while (true) {
+                Cell& cell{_cells[position & (_capacity - 1)]};
+                const size_t sequence{cell.sequence.load(std::memory_order_acquire)};
+                const intptr_t difference{static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position)};
+                if (difference == 0) {
+                    if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        cell.data = std::move(item);
+                        cell.sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0) {
+                    return false;   // Full
+                }
+                else {
+                    position = _tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool tryPop(T& item) {
+            size_t position{_head.load(std::memory_order_relaxed)};
+            while (true) {
+                Cell& cell{_cells[position & (_capacity - 1)]};
+                const size_t sequence{cell.sequence.load(std::memory_order_acquire)};
+                const intptr_t difference{static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1)};
+                if (difference == 0) {
+                    if (_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        item = std::move(cell.data);
+                        cell.sequence.store(position + _capacity, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0) {
+                    return false;   // Empty
+                }
+                else {
+                    position = _head.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Wait for space; false if the queue was closed
+        bool push(T& item) {
+            for (int attempt{0}; !_closed.load(std::memory_order_acquire); ++attempt) {
+                if (tryPush(item)) {
+                    return true;
+                }
+                _backoff(attempt);
+            }
+            return false;
+        }
+
+        // Wait for an item; false once the queue is closed and empty
+        bool pop(T& item) {
+            for (int attempt{0}; ; ++attempt) {
+                if (tryPop(item)) {
+                    return true;
+                }
+                if (_closed.load(std::memory_order_acquire)) {
+                    return tryPop(item);
+                }
+                _backoff(attempt);
+            }
+        }
+
+        void close() {
+            _closed.store(true, std::memory_order_release);
+        }
+
+        size_t capacity() const { return _capacity; }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        size_t _capacity;
+        std::vector<Cell> _cells;
+        alignas(64) std::atomic<size_t> _tail{0};
+        alignas(64) std::atomic<size_t> _head{0};
+        alignas(64) std::atomic<bool> _closed{false};
+
+        // Spin briefly, then yield, then sleep, so a stalled stage does not burn its core
+        static void _backoff(int attempt) {
+            if (attempt < 64) {
+                return;
+            }
+            if (attempt < 256) {
+                std::this_thread::yield();
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+};
+
+// Run function, adding its duration in ms to total
+template <typename Function>
+auto timedCall(double& total, Function function) {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    if constexpr (std::is_void_v<decltype(function())>) {
+        function();
+        total += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    else {
+        auto result{function()};
+        total += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        return result;
+    }
+}
+
+// Time a stage spent working and waiting on its queues, summed over its threads
+struct StageStats {
+    std::string name;
+    int threads;
+    size_t items;
+    size_t bytes;
+    double busyTime;    // ms
+    double waitTime;    // ms
+
+    double utilization() const {
+        return busyTime + waitTime > 0 ? busyTime / (busyTime + waitTime) : 0.0;
+    }
+};
+
+struct PipelineResult {
+    std::vector<StageStats> stages;
+    double wallTime;    // ms
+    size_t inputBytes;
+    size_t outputBytes;
+    size_t frames;
+};
+
+// Streams floats from a source through read -> chunk -> compress -> write stages on their own threads
+// The source replaces the contents of a block with the next values and returns how many it wrote, 0 at the end.
+// Blocks are re-cut into fixed-size chunks, compressed by N workers, each with its own clone of the compressor, and
+// written in order as frames of [uint64 number of values][uint64 compressed size][compressed bytes]. Bounded queues
+// between the stages cap the data in flight, so throughput is set by the slowest stage.
+class CompressionPipeline {
+    public:
+        using Source = std::function<size_t(std::vector<float>&)>;
+
+        CompressionPipeline(const MyCompressor& compressor, const size_t chunkSize, const int workers,
+                                const size_t queueDepth=8, bool debug=false)
+            : _debug(debug)
+        {
+            // Validate chunk size, workers and queue depth
+            if (chunkSize == 0) {
+                throw std::invalid_argument("chunk size must be greater than 0");
+            }
+            _chunkSize = chunkSize;
+
+            if (workers <= 0) {
+                throw std::invalid_argument("workers must be greater than 0");
+            }
+            if (queueDepth == 0) {
+                throw std::invalid_argument("queue depth must be greater than 0");
+            }
+            _queueDepth = queueDepth;
+
+            for (int worker{0}; worker < workers; ++worker) {
+                _compressors.push_back(compressor.clone());
+            }
+        }
+
+        PipelineResult run(const Source& source, const std::string& outputFile) {
+            std::ofstream file(outputFile, std::ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("Could not open file: " + outputFile);
+            }
+
+            const int workers{static_cast<int>(_compressors.size())};
+            BoundedQueue<std::vector<float>> blocks(_queueDepth);
+            BoundedQueue<Chunk> chunks(_queueDepth);
+            BoundedQueue<Frame> frames(_queueDepth);
+
+            // Every buffer in flight can come back to a pool
+            BufferPool<float> floatPool(3 * _queueDepth + workers + 2);
+            BufferPool<uint8_t> bytePool(_queueDepth + workers + 2);
+
+            std::vector<StageStats> workerStats(workers, StageStats{"compress", 1, 0, 0, 0, 0});
+            StageStats readStats{"read", 1, 0, 0, 0, 0};
+            StageStats chunkStats{"chunk", 1, 0, 0, 0, 0};
+            StageStats writeStats{"write", 1, 0, 0, 0, 0};
+
+            // error is only touched under errorMutex; the writer polls failed instead
+            std::exception_ptr error{};
+            std::mutex errorMutex{};
+            std::atomic<bool> failed{false};
+            auto fail = [&](std::exception_ptr exception) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) {
+                    error = exception;
+                }
+                failed = true;
+                blocks.close();
+                chunks.close();
+                frames.close();
+            };
+
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+            // Read
+            std::thread reader([&]() {
+                try {
+                    while (true) {
+                        std::vector<float> block{floatPool.acquire(_chunkSize)};
+                        const size_t count{timedCall(readStats.busyTime, [&]() { return source(block); })};
+                        if (count == 0) {
+                            break;
+                        }
+                        readStats.items++;
+                        readStats.bytes += block.size() * sizeof(float);
+                        if (!timedCall(readStats.waitTime, [&]() { return blocks.push(block); })) {
+                            break;
+                        }
+                    }
+                }
+                catch (...) {
+                    fail(std::current_exception());
+                }
+                blocks.close();
+            });
+
+            // Re-cut blocks into chunks
+            std::thread chunker([&]() {
+                try {
+                    size_t index{0};
+                    std::vector<float> chunk{floatPool.acquire(_chunkSize)};
+                    std::vector<float> block{};
+                    bool open{true};
+                    while (open && timedCall(chunkStats.waitTime, [&]() { return blocks.pop(block); })) {
+                        for (size_t position{0}; open && position < block.size();) {
+                            const size_t count{std::min(block.size() - position, _chunkSize - chunk.size())};
+                            timedCall(chunkStats.busyTime, [&]() {
+                                chunk.insert(chunk.end(), block.begin() + position, block.begin() + position + count);
+                            });
+                            position += count;
+
+                            if (chunk.size() == _chunkSize) {
+                                Chunk full{index++, std::move(chunk)};
+                                chunkStats.items++;
+                                chunkStats.bytes += full.data.size() * sizeof(float);
+                                open = timedCall(chunkStats.waitTime, [&]() { return chunks.push(full); });
+                                chunk = floatPool.acquire(_chunkSize);
+                            }
+                        }
+                        floatPool.release(std::move(block));
+                    }
+
+                    // Last partial chunk
+                    if (open && !chunk.empty()) {
+                        Chunk last{index++, std::move(chunk)};
+                        chunkStats.items++;
+                        chunkStats.bytes += last.data.size() * sizeof(float);
+                        chunks.push(last);
+                    }
+                }
+                catch (...) {
+                    fail(std::current_exception());
+                }
+                chunks.close();
+            });
+
+            // Compress
+            std::vector<std::thread> compressors{};
+            for (int worker{0}; worker < workers; ++worker) {
+                compressors.emplace_back([&, worker]() {
+                    StageStats& stats{workerStats[worker]};
+                    try {
+                        Chunk chunk{};
+                        while (timedCall(stats.waitTime, [&]() { return chunks.pop(chunk); })) {
+                            Frame frame{chunk.index, chunk.data.size(), bytePool.acquire()};
+                            timedCall(stats.busyTime, [&]() { _compressors[worker]->compressInto(chunk.data, frame.data); });
+                            stats.items++;
+                            stats.bytes += chunk.data.size() * sizeof(float);
+                            floatPool.release(std::move(chunk.data));
+
+                            if (!timedCall(stats.waitTime, [&]() { return frames.push(frame); })) {
+                                break;
+                            }
+                        }
+                    }
+                    catch (...) {
+                        fail(std::current_exception());
+                    }
+                });
+            }
+
+            // Write in chunk order; frames that arrive early wait in the reorder buffer
+            std::thread writer([&]() {
+                try {
+                    std::map<size_t, Frame> pending{};
+                    size_t next{0};
+                    Frame frame{};
+                    while (timedCall(writeStats.waitTime, [&]() { return frames.pop(frame); })) {
+                        timedCall(writeStats.busyTime, [&]() {
+                            pending.emplace(frame.index, std::move(frame));
+                            for (auto it{pending.find(next)}; it != pending.end(); it = pending.find(++next)) {
+                                _writeFrame(file, it->second);
+                                writeStats.items++;
+                                writeStats.bytes += 2 * sizeof(uint64_t) + it->second.data.size();
+                                bytePool.release(std::move(it->second.data));
+                                pending.erase(it);
+                            }
+                        });
+                    }
+                    if (!pending.empty() && !failed) {
+                        throw std::runtime_error("CompressionPipeline: frames missing from the output");
+                    }
+                }
+                catch (...) {
+                    fail(std::current_exception());
+                }
+            });
+
+            reader.join();
+            chunker.join();
+            for (std::thread& compressor : compressors) {
+                compressor.join();
+            }
+            frames.close();
+            writer.join();
+
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            file.close();
+            if (!file) {
+                throw std::runtime_error("Could not write file: " + outputFile);
+            }
+
+            std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+            // Workers are reported as one stage
+            StageStats compressStats{"compress", workers, 0, 0, 0, 0};
+            for (const StageStats& stats : workerStats) {
+                compressStats.items += stats.items;
+                compressStats.bytes += stats.bytes;
+                compressStats.busyTime += stats.busyTime;
+                compressStats.waitTime += stats.waitTime;
+            }
+
+            PipelineResult result{{readStats, chunkStats, compressStats, writeStats},
+                                  std::chrono::duration<double, std::milli>(end - start).count(),
+                                  readStats.bytes, writeStats.bytes, writeStats.items};
+
+            if (_debug) {
+                for (const StageStats& stats : result.stages) {
+                    std::cerr << std::format("[DEBUG CompressionPipeline]: stage = {}, items = {}, busy = {:.2f} ms, wait = {:.2f} ms",
+                                                stats.name, stats.items, stats.busyTime, stats.waitTime) << std::endl;
+                }
+            }
+
+            return result;
+        }
+
+        // Read back a file written by run
+        static std::vector<float> readFrames(const std::string& inputFile, MyCompressor& compressor) {
+            std::ifstream file(inputFile, std::ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("Could not open file: " + inputFile);
+            }
+
+            std::vector<float> data{};
+            std::vector<uint8_t> compressedData{};
+            uint64_t header[2];
+            while (file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+                compressedData.resize(header[1]);
+                if (!file.read(reinterpret_cast<char*>(compressedData.data()), header[1])) {
+                    throw std::runtime_error("CompressionPipeline: truncated frame in " + inputFile);
+                }
+                const size_t offset{data.size()};
+                data.resize(offset + header[0]);
+                compressor.decompressInto(compressedData, std::span<float>(data.data() + offset, header[0]));
+            }
+
+            return data;
+        }
+
+    private:
+        struct Chunk {
+            size_t index;
+            std::vector<float> data;
+        };
+
+        struct Frame {
+            size_t index;
+            size_t numValues;
+            std::vector<uint8_t> data;
+        };
+
+        size_t _chunkSize;
+        size_t _queueDepth;
+        bool _debug;
+
+        std::vector<std::unique_ptr<MyCompressor>> _compressors;
+
+        static void _writeFrame(std::ofstream& file, const Frame& frame) {
+            const uint64_t header[2]{frame.numValues, frame.data.size()};
+            file.write(reinterpret_cast<const char*>(header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(frame.data.data()), frame.data.size());
+        }
+};
+
+#endif
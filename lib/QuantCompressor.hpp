@@ -0,0 +1,639 @@
+#ifndef QUANT_COMPRESSOR_HPP
+#define QUANT_COMPRESSOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define QUANT_HAVE_AVX2_DECODE 1
+#endif
+
+#include "MyCompressor.hpp"
+#include "Trace.hpp"
+
+// Error-bounded lossy codec: linear quantization with prediction, followed by static rANS entropy coding
+// Every value is reconstructed within the error bound: ABS is an absolute bound, REL is relative to the value range of
+// each call (as SZ3's EB_REL). Each value is predicted from the previous reconstructed value (1-D Lorenzo) or from the
+// middle of the range, whichever gives the lower residual entropy on a sample, and the residual is quantized to a
+// multiple of twice the bound. The reconstruction is checked in float; values that miss the bound, and NaN/Inf, are
+// stored raw. Residuals beyond the symbol alphabet are escaped to a varint side stream.
+// The rANS coder runs sixteen interleaved states that renormalize by 16-bit words, so each state reads at most one
+// word per symbol. That fixes the stream layout for SIMD: on CPUs with AVX2 the decoder advances the states eight at a
+// time in two registers, picking up the words for the lanes of each register that renormalize with a single permute.
+// Other CPUs, and the tail of the stream, use a scalar decoder with the same output.
+class QuantCompressor : public MyCompressor {
+    public:
+        enum ERROR_BOUND{ABS, REL};
+        enum PREDICTOR{LORENZO, MIDRANGE};
+
+        QuantCompressor() {}
+
+        QuantCompressor(const int precision, const int errorBoundMode, bool debug=false) : _debug(debug) {
+            // Validate precision
+            if (precision <= 0 || precision > 7) {
+                throw std::invalid_argument("float precision must be between 1 and 7");
+            }
+            else {
+                _precision = precision;
+                _errorBound = 0.5 * std::pow(10, -_precision);
+            }
+
+            // Validate errorBoundMode
+            if (errorBoundMode < ABS || errorBoundMode > REL) {
+                throw std::invalid_argument("errorBoundMode must be between 0 and 1");
+            }
+            else {
+                _errorBoundMode = errorBoundMode;
+            }
+        }
+
+        std::unique_ptr<MyCompressor> clone() const override {
+            return std::make_unique<QuantCompressor>(*this);
+        }
+
+        std::vector<uint8_t> compress(const std::vector<float>& data) override {
+            std::vector<uint8_t> compressedData{};
+            compressInto(data, compressedData);
+            return compressedData;
+        }
+
+        void compressInto(std::span<const float> data, std::vector<uint8_t>& compressedData) override {
+            if (_debug) {
+                std::cerr << std::format("[DEBUG QuantCompressor]: precision = {}, errorBoundMode = {}, errorBound = {}, dataSize = {}",
+                                            _precision, _errorBoundMode, _errorBound, data.size() * sizeof(float)) << std::endl;
+            }
+
+            // Absolute bound and range midpoint from the finite values
+            std::optional<TraceSpan> span{std::in_place, "QuantCompressor", "prediction", _debug, data.size_bytes()};
+            float minValue{std::numeric_limits<float>::max()};
+            float maxValue{std::numeric_limits<float>::lowest()};
+            for (float value : data) {
+                if (std::isfinite(value)) {
+                    minValue = std::min(minValue, value);
+                    maxValue = std::max(maxValue, value);
+                }
+            }
+            const bool anyFinite{maxValue >= minValue};
+            const double absErrorBound{_errorBoundMode == ABS ? _errorBound
+                                       : anyFinite ? _errorBound * (static_cast<double>(maxValue) - minValue) : 0.0};
+            const float midrange{anyFinite ? static_cast<float>(0.5 * (static_cast<double>(minValue) + maxValue)) : 0.0f};
+            const int predictor{_choosePredictor(data, absErrorBound, midrange)};
+
+            // Quantize
+            span.emplace("QuantCompressor", "quantization", _debug, data.size_bytes());
+            _quantize(data, absErrorBound, predictor, midrange);
+
+            // Entropy-code symbols
+            span.emplace("QuantCompressor", "encoding", _debug, _symbols.size() * sizeof(uint16_t));
+            std::vector<uint32_t> frequencies(_alphabetSize, 0);
+            for (uint16_t symbol : _symbols) {
+                ++frequencies[symbol];
+            }
+            _normalize(frequencies);
+            _encode();
+
+            // Header is number of values, bound, predictor, midrange, then the frequency table
+            span.emplace("QuantCompressor", "copy-out", _debug, _encoded.size() + _escapes.size() + _raw.size() * sizeof(float));
+            compressedData.clear();
+            _appendValue(compressedData, static_cast<uint64_t>(data.size()));
+            _appendValue(compressedData, absErrorBound);
+            _appendValue(compressedData, static_cast<uint8_t>(predictor));
+            _appendValue(compressedData, midrange);
+            _appendValue(compressedData, static_cast<uint32_t>(_alphabetSize));
+            for (uint32_t frequency : _frequencies) {
+                _appendVarint(compressedData, frequency);
+            }
+
+            // Followed by the rANS stream, escaped residuals and raw values
+            _appendValue(compressedData, static_cast<uint64_t>(_encoded.size()));
+            compressedData.insert(compressedData.end(), _encoded.begin(), _encoded.end());
+            _appendValue(compressedData, static_cast<uint64_t>(_escapes.size()));
+            compressedData.insert(compressedData.end(), _escapes.begin(), _escapes.end());
+            _appendValue(compressedData, static_cast<uint64_t>(_raw.size()));
+            const uint8_t* rawBytes{reinterpret_cast<const uint8_t*>(_raw.data())};
+            compressedData.insert(compressedData.end(), rawBytes, rawBytes + _raw.size() * sizeof(float));
+
+            span.reset();
+
+            if (_debug) {
+                std::cerr << std::format("[DEBUG QuantCompressor]: predictor = {}, alphabet = {}, raw values = {}",
+                                            predictor, _alphabetSize, _raw.size()) << std::endl;
+            }
+        }
+
+        std::vector<float> decompress(const std::vector<uint8_t>& compressedData, const size_t& uncompressedSize) override {
+            std::vector<float> decompressedData(uncompressedSize);
+            decompressInto(compressedData, decompressedData);
+            return decompressedData;
+        }
+
+        void decompressInto(std::span<const uint8_t> compressedData, std::span<float> decompressedData) override {
+            size_t position{0};
+            const uint64_t numValues{_readValue<uint64_t>(compressedData, position)};
+            if (numValues != decompressedData.size()) {
+                throw std::runtime_error("QuantCompressor: decompressed size mismatch");
+            }
+            const double absErrorBound{_readValue<double>(compressedData, position)};
+            const uint8_t predictor{_readValue<uint8_t>(compressedData, position)};
+            const float midrange{_readValue<float>(compressedData, position)};
+
+            _alphabetSize = _readValue<uint32_t>(compressedData, position);
+            if (_alphabetSize < FIRST_RESIDUAL || _alphabetSize > MAX_ALPHABET_SIZE) {
+                throw std::runtime_error("QuantCompressor: invalid alphabet size");
+            }
+            _frequencies.resize(_alphabetSize);
+            uint64_t total{0};
+            for (uint32_t& frequency : _frequencies) {
+                frequency = static_cast<uint32_t>(_readVarint(compressedData, position));
+                total += frequency;
+            }
+            if (numValues && total != PROB_SCALE) {
+                throw std::runtime_error("QuantCompressor: invalid frequency table");
+            }
+
+            const std::span<const uint8_t> encoded{_readBlob(compressedData, position)};
+            const std::span<const uint8_t> escapes{_readBlob(compressedData, position)};
+            const uint64_t numRaw{_readValue<uint64_t>(compressedData, position)};
+            if (numRaw > (compressedData.size() - position) / sizeof(float)) {
+                throw std::runtime_error("QuantCompressor: compressed data is truncated");
+            }
+            const uint8_t* raw{compressedData.data() + position};
+
+            {
+                TraceSpan span("QuantCompressor", "decoding", _debug, encoded.size());
+                _decode(encoded, numValues);
+            }
+
+            // Dequantize
+            TraceSpan span("QuantCompressor", "dequantization", _debug, decompressedData.size_bytes());
+            const double step{2 * absErrorBound};
+            float previous{predictor == LORENZO ? 0.0f : midrange};
+            size_t escapePosition{0};
+            size_t rawIndex{0};
+            for (size_t i{0}; i < numValues; ++i) {
+                const uint16_t symbol{_symbols[i]};
+                float value;
+                if (symbol == RAW_SYMBOL) {
+                    if (rawIndex >= numRaw) {
+                        throw std::runtime_error("QuantCompressor: compressed data is truncated");
+                    }
+                    std::memcpy(&value, raw + sizeof(float) * rawIndex++, sizeof(float));
+                }
+                else {
+                    const uint64_t zigzag{symbol == ESCAPE_SYMBOL ? _readVarint(escapes, escapePosition) : symbol - FIRST_RESIDUAL};
+                    value = _reconstruct(previous, _unzigzag(zigzag), step);
+                }
+
+                decompressedData[i] = value;
+                if (predictor == LORENZO && std::isfinite(value)) {
+                    previous = value;
+                }
+            }
+        }
+
+        // Getters
+        int getPrecision() const { return _precision; }
+        int getErrorBoundMode() const { return _errorBoundMode; }
+        double getErrorBound() const { return _errorBound; }
+
+        // Setters
+        // Replaces the bound derived from precision; takes effect on the next compress call
+        void setErrorBound(const int errorBoundMode, const double errorBound) {
+            if (errorBoundMode < ABS || errorBoundMode > REL) {
+                throw std::invalid_argument("errorBoundMode must be between 0 and 1");
+            }
+            if (!(errorBound >= 0)) {
+                throw std::invalid_argument("error bound must not be negative");
+            }
+            _errorBoundMode = errorBoundMode;
+            _errorBound = errorBound;
+        }
+
+    private:
+        // Symbol 0 marks a raw value, 1 an escaped residual; zigzagged residual r is symbol r + 2
+        static constexpr uint16_t RAW_SYMBOL{0};
+        static constexpr uint16_t ESCAPE_SYMBOL{1};
+        static constexpr uint32_t FIRST_RESIDUAL{2};
+        static constexpr uint32_t MAX_ALPHABET_SIZE{4096};
+
+        // rANS with 32-bit states and 16-bit word renormalization
+        static constexpr int PROB_BITS{14};
+        static constexpr uint32_t PROB_SCALE{1u << PROB_BITS};
+        static constexpr uint32_t RANS_LOWER_BOUND{1u << 16};
+        static constexpr int NUM_STATES{16};
+
+        // Values used to pick the predictor
+        static constexpr size_t SAMPLE_SIZE{65536};
+
+        int _precision;
+        int _errorBoundMode;
+        double _errorBound;
+        bool _debug;
+
+        // Scratch reused between calls
+        std::vector<uint16_t> _symbols{};
+        std::vector<uint8_t> _escapes{};
+        std::vector<float> _raw{};
+        std::vector<uint8_t> _encoded{};
+        uint32_t _alphabetSize{FIRST_RESIDUAL};
+        std::vector<uint32_t> _frequencies{};
+        std::vector<uint32_t> _cumulative{};
+        std::vector<uint32_t> _slotSymbol{};
+        std::vector<uint32_t> _slotEntry{};        // Frequency << 16 | slot - cumulative, for each slot
+
+        static uint64_t _zigzag(int64_t value) {
+            return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+        }
+
+        static int64_t _unzigzag(uint64_t value) {
+            return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+        }
+
+        // Encoder and decoder must round identically, so both go through this
+        static float _reconstruct(float prediction, int64_t quantized, double step) {
+            return static_cast<float>(static_cast<double>(prediction) + static_cast<double>(quantized) * step);
+        }
+
+        // Residual entropy of each predictor on a prefix of the data, without error feedback
+        int _choosePredictor(std::span<const float> data, double absErrorBound, float midrange) const {
+            if (absErrorBound <= 0) {
+                return LORENZO;
+            }
+
+            const size_t sampleSize{std::min(data.size(), SAMPLE_SIZE)};
+            const double step{2 * absErrorBound};
+            std::vector<uint32_t> lorenzo(MAX_ALPHABET_SIZE, 0);
+            std::vector<uint32_t> middle(MAX_ALPHABET_SIZE, 0);
+            float previous{0};
+            for (size_t i{0}; i < sampleSize; ++i) {
+                if (!std::isfinite(data[i])) {
+                    continue;
+                }
+                ++lorenzo[_sampleSymbol((static_cast<double>(data[i]) - previous) / step)];
+                ++middle[_sampleSymbol((static_cast<double>(data[i]) - midrange) / step)];
+                previous = data[i];
+            }
+
+            return _entropy(middle) < _entropy(lorenzo) ? MIDRANGE : LORENZO;
+        }
+
+        static size_t _sampleSymbol(double scaled) {
+            const double zigzag{2 * std::abs(std::round(scaled))};
+            return zigzag < MAX_ALPHABET_SIZE - FIRST_RESIDUAL ? static_cast<size_t>(zigzag) + FIRST_RESIDUAL : ESCAPE_SYMBOL;
+        }
+
+        // Escaped residuals are charged their varint size on top of the escape symbol
+        static double _entropy(const std::vector<uint32_t>& histogram) {
+            double total{0};
+            for (uint32_t count : histogram) {
+                total += count;
+            }
+            double bits{0};
+            for (uint32_t count : histogram) {
+                if (count) {
+                    bits -= count * std::log2(count / total);
+                }
+            }
+            return bits + 24.0 * histogram[ESCAPE_SYMBOL];
+        }
+
+        void _quantize(std::span<const float> data, double absErrorBound, int predictor, float midrange) {
+            _symbols.resize(data.size());
+            _escapes.clear();
+            _raw.clear();
+            _alphabetSize = FIRST_RESIDUAL;
+
+            const double step{2 * absErrorBound};
+            float previous{predictor == LORENZO ? 0.0f : midrange};
+            for (size_t i{0}; i < data.size(); ++i) {
+                const float value{data[i]};
+                uint16_t symbol{RAW_SYMBOL};
+
+                if (std::isfinite(value)) {
+                    const double scaled{step > 0 ? (static_cast<double>(value) - previous) / step : 0.0};
+
+                    // Beyond 2^52 the residual no longer fits exactly; store raw
+                    if (std::abs(scaled) < 0x1.0p52) {
+                        const int64_t quantized{static_cast<int64_t>(std::llround(scaled))};
+                        const float reconstructed{_reconstruct(previous, quantized, step)};
+
+                        if (std::abs(static_cast<double>(reconstructed) - value) <= absErrorBound) {
+                            const uint64_t zigzag{_zigzag(quantized)};
+                            if (zigzag < MAX_ALPHABET_SIZE - FIRST_RESIDUAL) {
+                                symbol = static_cast<uint16_t>(zigzag + FIRST_RESIDUAL);
+                            }
+                            else {
+                                symbol = ESCAPE_SYMBOL;
+                                _appendVarint(_escapes, zigzag);
+                            }
+                            if (predictor == LORENZO) {
+                                previous = reconstructed;
+                            }
+                        }
+                    }
+                }
+
+                if (symbol == RAW_SYMBOL) {
+                    _raw.push_back(value);
+                    if (predictor == LORENZO && std::isfinite(value)) {
+                        previous = value;
+                    }
+                }
+
+                _symbols[i] = symbol;
+                _alphabetSize = std::max<uint32_t>(_alphabetSize, symbol + 1u);
+            }
+        }
+
+        // Scale counts to sum to PROB_SCALE, keeping every used symbol at least 1
+        void _normalize(const std::vector<uint32_t>& counts) {
+            _frequencies.assign(counts.size(), 0);
+            uint64_t total{0};
+            for (uint32_t count : counts) {
+                total += count;
+            }
+            if (!total) {
+                return;
+            }
+
+            int64_t sum{0};
+            for (size_t symbol{0}; symbol < counts.size(); ++symbol) {
+                if (counts[symbol]) {
+                    _frequencies[symbol] = std::max<uint32_t>(1, static_cast<uint32_t>(static_cast<uint64_t>(counts[symbol]) * PROB_SCALE / total));
+                    sum += _frequencies[symbol];
+                }
+            }
+
+            // Give the rounding error to, or take it from, the most frequent symbols
+            std::vector<uint32_t> order(counts.size());
+            for (uint32_t symbol{0}; symbol < order.size(); ++symbol) {
+                order[symbol] = symbol;
+            }
+            std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return _frequencies[a] > _frequencies[b]; });
+
+            int64_t difference{static_cast<int64_t>(PROB_SCALE) - sum};
+            if (difference > 0) {
+                _frequencies[order[0]] += static_cast<uint32_t>(difference);
+            }
+            // Used symbols never outnumber PROB_SCALE, so this terminates
+            for (size_t i{0}; difference < 0; i = (i + 1) % order.size()) {
+                const uint32_t symbol{order[i]};
+                if (_frequencies[symbol] > 1) {
+                    const uint32_t take{static_cast<uint32_t>(std::min<int64_t>(-difference, std::max<uint32_t>(1, _frequencies[symbol] / 4)))};
+                    _frequencies[symbol] -= take;
+                    difference += take;
+                }
+            }
+        }
+
+        void _buildCumulative() {
+            _cumulative.resize(_frequencies.size() + 1);
+            _cumulative[0] = 0;
+            for (size_t symbol{0}; symbol < _frequencies.size(); ++symbol) {
+                _cumulative[symbol + 1] = _cumulative[symbol] + _frequencies[symbol];
+            }
+        }
+
+        // Symbols are encoded last to first, each into state i % NUM_STATES, writing words backwards. The decoder then
+        // reads the words in symbol order, so a group of NUM_STATES symbols finds its words in lane order.
+        void _encode() {
+            _buildCumulative();
+
+            // At most one word per symbol, plus the final states
+            _encoded.resize(sizeof(uint16_t) * _symbols.size() + NUM_STATES * sizeof(uint32_t));
+            uint8_t* end{_encoded.data() + _encoded.size()};
+            uint8_t* out{end};
+
+            uint32_t states[NUM_STATES];
+            std::fill(states, states + NUM_STATES, RANS_LOWER_BOUND);
+
+            for (size_t i{_symbols.size()}; i-- > 0;) {
+                uint32_t& state{states[i % NUM_STATES]};
+                const uint32_t frequency{_frequencies[_symbols[i]]};
+                const uint32_t start{_cumulative[_symbols[i]]};
+
+                // In 64 bits: a symbol holding the whole table (frequency == PROB_SCALE) has a bound of 2^32, which
+                // never renormalizes, and would wrap to 0 in 32 bits and write a word for every symbol
+                const uint64_t maxState{static_cast<uint64_t>((RANS_LOWER_BOUND >> PROB_BITS) << 16) * frequency};
+                if (state >= maxState) {
+                    out -= sizeof(uint16_t);
+                    const uint16_t word{static_cast<uint16_t>(state)};
+                    std::memcpy(out, &word, sizeof(word));
+                    state >>= 16;
+                }
+                state = ((state / frequency) << PROB_BITS) + (state % frequency) + start;
+            }
+
+            // Flush so the decoder reads state 0 first
+            for (int s{NUM_STATES - 1}; s >= 0; --s) {
+                out -= sizeof(uint32_t);
+                std::memcpy(out, &states[s], sizeof(uint32_t));
+            }
+
+            _encoded.erase(_encoded.begin(), _encoded.begin() + (out - _encoded.data()));
+        }
+
+        void _decode(std::span<const uint8_t> encoded, size_t numValues) {
+            _symbols.resize(numValues);
+            if (!numValues) {
+                return;
+            }
+
+            _buildCumulative();
+            _slotSymbol.resize(PROB_SCALE);
+            _slotEntry.resize(PROB_SCALE);
+            for (uint32_t symbol{0}; symbol < _frequencies.size(); ++symbol) {
+                for (uint32_t slot{_cumulative[symbol]}; slot < _cumulative[symbol + 1]; ++slot) {
+                    _slotSymbol[slot] = symbol;
+                    _slotEntry[slot] = _frequencies[symbol] << 16 | (slot - _cumulative[symbol]);
+                }
+            }
+
+            if (encoded.size() < NUM_STATES * sizeof(uint32_t)) {
+                throw std::runtime_error("QuantCompressor: compressed data is truncated");
+            }
+            uint32_t states[NUM_STATES];
+            std::memcpy(states, encoded.data(), sizeof(states));
+            const uint8_t* in{encoded.data() + sizeof(states)};
+            const uint8_t* end{encoded.data() + encoded.size()};
+
+            // Whole groups while a group's words, at most one per state, cannot run past the end
+            size_t i{0};
+#ifdef QUANT_HAVE_AVX2_DECODE
+            if (_hasAVX2()) {
+                i = _decodeGroupsAVX2(states, in, end, numValues);
+            }
+#endif
+            for (; i + NUM_STATES <= numValues && end - in >= static_cast<ptrdiff_t>(NUM_STATES * sizeof(uint16_t)); i += NUM_STATES) {
+                for (int s{0}; s < NUM_STATES; ++s) {
+                    _decodeSymbol(states[s], in, i + s);
+                }
+            }
+            for (; i < numValues; ++i) {
+                if (end - in < static_cast<ptrdiff_t>(sizeof(uint16_t))) {
+                    _decodeSymbolChecked(states[i % NUM_STATES], in, end, i);
+                }
+                else {
+                    _decodeSymbol(states[i % NUM_STATES], in, i);
+                }
+            }
+        }
+
+        void _decodeSymbol(uint32_t& state, const uint8_t*& in, size_t i) {
+            const uint32_t entry{_slotEntry[state & (PROB_SCALE - 1)]};
+            _symbols[i] = static_cast<uint16_t>(_slotSymbol[state & (PROB_SCALE - 1)]);
+            state = (entry >> 16) * (state >> PROB_BITS) + (entry & 0xffff);
+            if (state < RANS_LOWER_BOUND) {
+                uint16_t word;
+                std::memcpy(&word, in, sizeof(word));
+                in += sizeof(word);
+                state = state << 16 | word;
+            }
+        }
+
+        void _decodeSymbolChecked(uint32_t& state, const uint8_t*& in, const uint8_t* end, size_t i) {
+            const uint32_t entry{_slotEntry[state & (PROB_SCALE - 1)]};
+            _symbols[i] = static_cast<uint16_t>(_slotSymbol[state & (PROB_SCALE - 1)]);
+            state = (entry >> 16) * (state >> PROB_BITS) + (entry & 0xffff);
+            if (state < RANS_LOWER_BOUND) {
+                if (end - in < static_cast<ptrdiff_t>(sizeof(uint16_t))) {
+                    throw std::runtime_error("QuantCompressor: compressed data is truncated");
+                }
+                uint16_t word;
+                std::memcpy(&word, in, sizeof(word));
+                in += sizeof(word);
+                state = state << 16 | word;
+            }
+        }
+
+#ifdef QUANT_HAVE_AVX2_DECODE
+        static bool _hasAVX2() {
+            static const bool hasAVX2{__builtin_cpu_supports("avx2") != 0};
+            return hasAVX2;
+        }
+
+        // For each mask of lanes that renormalize, the word each lane takes: the k-th renormalizing lane takes word k
+        static const std::array<std::array<uint32_t, 8>, 256>& _refillPermutations() {
+            static const std::array<std::array<uint32_t, 8>, 256> permutations{[] {
+                std::array<std::array<uint32_t, 8>, 256> table{};
+                for (uint32_t mask{0}; mask < 256; ++mask) {
+                    uint32_t next{0};
+                    for (uint32_t lane{0}; lane < 8; ++lane) {
+                        table[mask][lane] = (mask >> lane & 1) ? next++ : 0;
+                    }
+                }
+                return table;
+            }()};
+            return permutations;
+        }
+
+        // Decodes whole groups of NUM_STATES symbols while the group's words are readable, eight states per register.
+        // The registers are independent, so one's gathers overlap the other's arithmetic. Returns the number of symbols
+        // decoded; states and in are left where the scalar decoder continues.
+        __attribute__((target("avx2")))
+        size_t _decodeGroupsAVX2(uint32_t* states, const uint8_t*& in, const uint8_t* end, size_t numValues) {
+            static_assert(NUM_STATES == 16, "two AVX2 registers hold the states");
+            __m256i low{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(states))};
+            __m256i high{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(states + 8))};
+            size_t i{0};
+            for (; i + NUM_STATES <= numValues && end - in >= static_cast<ptrdiff_t>(NUM_STATES * sizeof(uint16_t)); i += NUM_STATES) {
+                _decodeLanesAVX2(low, in, i);
+                _decodeLanesAVX2(high, in, i + 8);
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(states), low);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(states + 8), high);
+            return i;
+        }
+
+        // One symbol for each of eight states, as _decodeSymbol; the lanes that renormalize take the next words in
+        // lane order, which one permute hands out
+        __attribute__((target("avx2")))
+        void _decodeLanesAVX2(__m256i& x, const uint8_t*& in, size_t i) {
+            const __m256i slot{_mm256_and_si256(x, _mm256_set1_epi32(PROB_SCALE - 1))};
+            const __m256i entry{_mm256_i32gather_epi32(reinterpret_cast<const int*>(_slotEntry.data()), slot, 4)};
+            const __m256i symbol{_mm256_i32gather_epi32(reinterpret_cast<const int*>(_slotSymbol.data()), slot, 4)};
+
+            // Symbols are below 2^16, so packing to 16 bits is exact; the pack works per 128-bit half
+            const __m256i packed{_mm256_permute4x64_epi64(_mm256_packus_epi32(symbol, symbol), 0b1000)};
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(_symbols.data() + i), _mm256_castsi256_si128(packed));
+
+            x = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(entry, 16), _mm256_srli_epi32(x, PROB_BITS)),
+                                 _mm256_and_si256(entry, _mm256_set1_epi32(0xffff)));
+
+            // Unsigned x < RANS_LOWER_BOUND, as a signed compare with the sign bits flipped
+            const __m256i signBit{_mm256_set1_epi32(static_cast<int>(0x80000000u))};
+            const __m256i renormalize{_mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(RANS_LOWER_BOUND ^ 0x80000000u)),
+                                                         _mm256_xor_si256(x, signBit))};
+            const uint32_t mask{static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(renormalize)))};
+            const __m256i words{_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)))};
+            const __m256i permutation{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_refillPermutations()[mask].data()))};
+            x = _mm256_blendv_epi8(x, _mm256_or_si256(_mm256_slli_epi32(x, 16), _mm256_permutevar8x32_epi32(words, permutation)), renormalize);
+            in += sizeof(uint16_t) * std::popcount(mask);
+        }
+#endif
+
+        template <typename T>
+        static void _appendValue(std::vector<uint8_t>& buffer, T value) {
+            const uint8_t* bytes{reinterpret_cast<const uint8_t*>(&value)};
+            buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+        }
+
+        template <typename T>
+        static T _readValue(std::span<const uint8_t> buffer, size_t& position) {
+            if (position + sizeof(T) > buffer.size()) {
+                throw std::runtime_error("QuantCompressor: compressed data is truncated");
+            }
+            T value;
+            std::memcpy(&value, buffer.data() + position, sizeof(T));
+            position += sizeof(T);
+            return value;
+        }
+
+        static std::span<const uint8_t> _readBlob(std::span<const uint8_t> buffer, size_t& position) {
+            const uint64_t size{_readValue<uint64_t>(buffer, position)};
+            if (size > buffer.size() - position) {
+                throw std::runtime_error("QuantCompressor: compressed data is truncated");
+            }
+            std::span<const uint8_t> blob{buffer.subspan(position, size)};
+            position += size;
+            return blob;
+        }
+
+        static void _appendVarint(std::vector<uint8_t>& buffer, uint64_t value) {
+            while (value >= 0x80) {
+                buffer.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            buffer.push_back(static_cast<uint8_t>(value));
+        }
+
+        static uint64_t _readVarint(std::span<const uint8_t> buffer, size_t& position) {
+            uint64_t value{0};
+            for (int shift{0}; shift < 64; shift += 7) {
+                if (position >= buffer.size()) {
+                    throw std::runtime_error("QuantCompressor: compressed data is truncated");
+                }
+                const uint8_t byte{buffer[position++]};
+                value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) {
+                    return value;
+                }
+            }
+            throw std::runtime_error("QuantCompressor: invalid varint");
+        }
+};
+
+#endif
@@ -0,0 +1,363 @@
+#ifndef REPORT_HPP
+#define REPORT_HPP
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <RVersion.h>
+#include <zlib.h>
+#if __has_include(<SZ3/version.hpp>)
+#include <SZ3/version.hpp>
+#endif
+
+#include "utils.hpp"
+
+// Build-time metadata, passed in by the Makefile
+#ifndef C2P2_GIT_HASH
+#define C2P2_GIT_HASH "unknown"
+#endif
+#ifndef C2P2_CXXFLAGS
+#define C2P2_CXXFLAGS "unknown"
+#endif
+#ifndef SZ3_VER
+#define SZ3_VER "unknown"
+#endif
+
+// Bump whenever a field is renamed, removed or changes meaning; adding fields at the end keeps the version
+constexpr int REPORT_SCHEMA_VERSION{2};
+
+// One benchmark result as ordered key/value pairs, so the JSON-lines and CSV emitters write the same fields in the same
+// order. Fields that do not apply to a result are null in JSON and empty in CSV, rather than missing.
+class ReportRecord {
+    public:
+        void add(const std::string& key, const std::string& value) {
+            _fields.push_back({key, _quoteJSON(value), _quoteCSV(value)});
+        }
+
+        void add(const std::string& key, const char* value) {
+            add(key, std::string(value));
+        }
+
+        template <typename T>
+            requires std::is_arithmetic_v<T>
+        void add(const std::string& key, T value) {
+            if constexpr (std::is_same_v<T, bool>) {
+                _fields.push_back({key, value ? "true" : "false", value ? "1" : "0"});
+            }
+            else if constexpr (std::is_floating_point_v<T>) {
+                if (!std::isfinite(value)) {
+                    addNull(key);
+                    return;
+                }
+                const std::string number{std::format("{}", value)};
+                _fields.push_back({key, number, number});
+            }
+            else {
+                const std::string number{std::format("{}", value)};
+                _fields.push_back({key, number, number});
+            }
+        }
+
+        // Arrays are JSON arrays, and semicolon-separated lists in CSV
+        void add(const std::string& key, const std::vector<double>& values) {
+            std::string json{"["};
+            std::string csv{};
+            for (size_t i{0}; i < values.size(); ++i) {
+                const std::string number{std::isfinite(values[i]) ? std::format("{}", values[i]) : "null"};
+                json += (i ? "," : "") + number;
+                csv += (i ? ";" : "") + number;
+            }
+            _fields.push_back({key, json + "]", csv});
+        }
+
+        void addNull(const std::string& key) {
+            _fields.push_back({key, "null", ""});
+        }
+
+        std::string toJSON() const {
+            std::string json{"{"};
+            for (size_t i{0}; i < _fields.size(); ++i) {
+                json += std::format("{}{}:{}", i ? "," : "", _quoteJSON(_fields[i].key), _fields[i].json);
+            }
+            return json + "}\n";
+        }
+
+        std::string toCSVHeader() const {
+            std::string header{};
+            for (size_t i{0}; i < _fields.size(); ++i) {
+                header += (i ? "," : "") + _fields[i].key;
+            }
+            return header + "\n";
+        }
+
+        std::string toCSVRow() const {
+            std::string row{};
+            for (size_t i{0}; i < _fields.size(); ++i) {
+                row += (i ? "," : "") + _fields[i].csv;
+            }
+            return row + "\n";
+        }
+
+    private:
+        struct Field {
+            std::string key;
+            std::string json;
+            std::string csv;
+        };
+
+        std::vector<Field> _fields{};
+
+        static std::string _quoteJSON(const std::string& value) {
+            std::string quoted{"\""};
+            for (char c : value) {
+                switch (c) {
+                    case '"':
+                        quoted += "\\\"";
+                        break;
+                    case '\\':
+                        quoted += "\\\\";
+                        break;
+                    case '\n':
+                        quoted += "\\n";
+                        break;
+                    case '\t':
+                        quoted += "\\t";
+                        break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20) {
+                            quoted += std::format("\\u{:04x}", static_cast<int>(c));
+                        } else {
+                            quoted += c;
+                        }
+                }
+            }
+            return quoted + "\"";
+        }
+
+        // Quote only when needed, doubling embedded quotes as in RFC 4180
+        static std::string _quoteCSV(const std::string& value) {
+            if (value.find_first_of(",\"\n") == std::string::npos) {
+                return value;
+            }
+            std::string quoted{"\""};
+            for (char c : value) {
+                quoted += c == '"' ? std::string("\"\"") : std::string(1, c);
+            }
+            return quoted + "\"";
+        }
+};
+
+// CPU model name from /proc/cpuinfo
+std::string getCPUModel() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("model name", 0) == 0) {
+            const size_t colon{line.find(':')};
+            const size_t start{colon == std::string::npos ? colon : line.find_first_not_of(" \t", colon + 1)};
+            if (start != std::string::npos) {
+                return line.substr(start);
+            }
+        }
+    }
+    return "unknown";
+}
+
+// Where and how the benchmark ran, so results from different machines and commits can be told apart
+ReportRecord captureEnvironment() {
+    ReportRecord environment{};
+    environment.add("schema_version", REPORT_SCHEMA_VERSION);
+    environment.add("timestamp", timestamp());
+    environment.add("host", getHost());
+    environment.add("git_hash", C2P2_GIT_HASH);
+    environment.add("compiler", __VERSION__);
+    environment.add("compiler_flags", C2P2_CXXFLAGS);
+    environment.add("cpu_model", getCPUModel());
+    environment.add("cpu_cores", std::thread::hardware_concurrency());
+    environment.add("l2_cache_bytes", cacheSize(2));
+    environment.add("llc_bytes", cacheSize(3));
+    environment.add("zlib_version", ZLIB_VERSION);
+    environment.add("sz3_version", SZ3_VER);
+    environment.add("root_version", ROOT_RELEASE);
+    return environment;
+}
+
+// Reading reports back ------------------------------------------------------------------------------------------
+
+// Field map for one record, with every value in its CSV form: arrays semicolon-separated, nulls empty, booleans 0 or 1
+using ReportFields = std::map<std::string, std::string>;
+
+// Parse one line written by ReportRecord::toJSON. Only the flat objects the emitter writes are supported: string, number,
+// boolean and null values, and arrays of numbers.
+ReportFields parseReportJSON(const std::string& line) {
+    size_t pos{0};
+    auto skipSpace = [&]() {
+        while (pos < line.size() && std::isspace(static_cast<unsigned char>(line[pos]))) {
+            ++pos;
+        }
+    };
+    auto expect = [&](char c) {
+        skipSpace();
+        if (pos >= line.size() || line[pos] != c) {
+            throw std::runtime_error(std::format("parseReportJSON: expected '{}' at position {}", c, pos));
+        }
+        ++pos;
+    };
+    auto parseString = [&]() {
+        expect('"');
+        std::string value{};
+        while (pos < line.size() && line[pos] != '"') {
+            char c{line[pos++]};
+            if (c == '\\' && pos < line.size()) {
+                c = line[pos++];
+                if (c == 'n') {
+                    c = '\n';
+                } else if (c == 't') {
+                    c = '\t';
+                } else if (c == 'u') {
+                    c = static_cast<char>(std::stoi(line.substr(pos, 4), nullptr, 16));
+                    pos += 4;
+                }
+            }
+            value += c;
+        }
+        expect('"');
+        return value;
+    };
+    // Bare token: number, true, false or null
+    auto parseToken = [&]() {
+        skipSpace();
+        const size_t start{pos};
+        while (pos < line.size() && line[pos] != ',' && line[pos] != '}' && line[pos] != ']' && !std::isspace(static_cast<unsigned char>(line[pos]))) {
+            ++pos;
+        }
+        const std::string token{line.substr(start, pos - start)};
+        if (token == "null") {
+            return std::string{};
+        } else if (token == "true") {
+            return std::string{"1"};
+        } else if (token == "false") {
+            return std::string{"0"};
+        }
+        return token;
+    };
+
+    ReportFields fields{};
+    expect('{');
+    skipSpace();
+    if (pos < line.size() && line[pos] == '}') {
+        return fields;
+    }
+    while (true) {
+        const std::string key{parseString()};
+        expect(':');
+        skipSpace();
+        if (pos < line.size() && line[pos] == '"') {
+            fields[key] = parseString();
+        }
+        else if (pos < line.size() && line[pos] == '[') {
+            ++pos;
+            std::string values{};
+            skipSpace();
+            while (pos < line.size() && line[pos] != ']') {
+                values += (values.empty() ? "" : ";") + parseToken();
+                skipSpace();
+                if (pos < line.size() && line[pos] == ',') {
+                    ++pos;
+                }
+            }
+            expect(']');
+            fields[key] = values;
+        }
+        else {
+            fields[key] = parseToken();
+        }
+
+        skipSpace();
+        if (pos < line.size() && line[pos] == ',') {
+            ++pos;
+            continue;
+        }
+        expect('}');
+        return fields;
+    }
+}
+
+// Split one CSV line, honouring RFC 4180 quoting
+std::vector<std::string> parseReportCSV(const std::string& line) {
+    std::vector<std::string> values{};
+    std::string value{};
+    bool quoted{false};
+    for (size_t i{0}; i < line.size(); ++i) {
+        const char c{line[i]};
+        if (quoted) {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                value += '"';
+                ++i;
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                value += c;
+            }
+        }
+        else if (c == '"') {
+            quoted = true;
+        }
+        else if (c == ',') {
+            values.push_back(value);
+            value.clear();
+        }
+        else if (c != '\r') {
+            value += c;
+        }
+    }
+    values.push_back(value);
+    return values;
+}
+
+// Read a JSON-lines or CSV report, telling them apart by the first character
+std::vector<ReportFields> readReport(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("readReport: could not open " + filename);
+    }
+
+    std::vector<ReportFields> records{};
+    std::vector<std::string> header{};
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        if (line[line.find_first_not_of(" \t")] == '{') {
+            records.push_back(parseReportJSON(line));
+            continue;
+        }
+
+        std::vector<std::string> values{parseReportCSV(line)};
+        if (header.empty()) {
+            header = values;
+            continue;
+        }
+        if (values.size() != header.size()) {
+            throw std::runtime_error(std::format("readReport: {} has a row with {} fields, expected {}", filename, values.size(), header.size()));
+        }
+        ReportFields fields{};
+        for (size_t i{0}; i < header.size(); ++i) {
+            fields[header[i]] = values[i];
+        }
+        records.push_back(fields);
+    }
+    return records;
+}
+
+#endif
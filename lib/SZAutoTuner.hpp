@@ -0,0 +1,207 @@
+#ifndef SZ_AUTO_TUNER_HPP
+#define SZ_AUTO_TUNER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <SZ3/api/sz.hpp>
+
+#include "SZCompressor.hpp"
+#include "utils.hpp"
+
+// SZ3 settings chosen for one branch and max-error target
+struct SZTuning {
+    double maxError;
+    int errorBoundMode;
+    double absErrorBound;
+    double relErrorBound;
+    int algo;
+    int interpAlgo;
+    double sampleRatio;     // Ratio reached on the tuning sample
+};
+
+void applySZTuning(SZCompressor& compressor, const SZTuning& tuning) {
+    compressor.setErrorBounds(tuning.errorBoundMode, tuning.absErrorBound, tuning.relErrorBound);
+    compressor.setAlgorithms(tuning.algo, tuning.interpAlgo);
+}
+
+// Picks SZ3 error bounds and predictors that maximize ratio while keeping every value within maxError
+// The target maps onto EB_ABS: SZ3's EB_REL is relative to the value range of each call, so a range-derived bound would
+// loosen on baskets with a wider range than the sample. Predictors are trial-compressed on a sample, with the candidate
+// list narrowed by the sample's smoothness. Results are cached per key (a branch, or a generator and its parameters),
+// and persisted when a cache file is given.
+class SZAutoTuner {
+    public:
+        SZAutoTuner(const double maxError, const std::string& cacheFile="", bool debug=false)
+            : _cacheFile(cacheFile), _debug(debug)
+        {
+            // Validate max error
+            if (!(maxError > 0)) {
+                throw std::invalid_argument("maxError must be greater than 0");
+            }
+            _maxError = maxError;
+
+            if (!_cacheFile.empty()) {
+                _loadCache();
+            }
+        }
+
+        SZTuning tune(const std::string& branchName, std::span<const float> data) {
+            // Nothing to trial-compress: any bound holds on no values, so keep the default predictor and leave the
+            // cache alone rather than storing a choice no data backed
+            if (data.empty()) {
+                _lastWasCached = false;
+                return SZTuning{_maxError, SZ3::EB_ABS, _maxError, 0.0, SZ3::ALGO_LORENZO_REG, SZ3::INTERP_ALGO_LINEAR, 0.0};
+            }
+
+            // Reuse earlier choice for this branch and target
+            auto cached{_cache.find({branchName, _maxError})};
+            _lastWasCached = cached != _cache.end();
+            if (_lastWasCached) {
+                return cached->second;
+            }
+
+            // Value range of the finite values, and smoothness as mean neighbour difference relative to that range
+            std::vector<float> sample{sampleBlocks(data, SAMPLE_BLOCK_SIZE * SAMPLE_BLOCKS, SAMPLE_BLOCK_SIZE)};
+            float minValue{std::numeric_limits<float>::max()};
+            float maxValue{std::numeric_limits<float>::lowest()};
+            for (float value : data) {
+                if (std::isfinite(value)) {
+                    minValue = std::min(minValue, value);
+                    maxValue = std::max(maxValue, value);
+                }
+            }
+            const double range{maxValue >= minValue ? static_cast<double>(maxValue) - minValue : 0.0};
+
+            double smoothness{0};
+            size_t differences{0};
+            for (size_t i{1}; i < sample.size(); ++i) {
+                if (i % SAMPLE_BLOCK_SIZE != 0 && std::isfinite(sample[i]) && std::isfinite(sample[i - 1])) {
+                    smoothness += std::abs(static_cast<double>(sample[i]) - sample[i - 1]);
+                    ++differences;
+                }
+            }
+            smoothness = (differences && range > 0) ? smoothness / differences / range : 0.0;
+
+            // Interpolation only pays off on smooth data, and skipping prediction only on noise-like data
+            std::vector<std::pair<int, int>> candidates{{SZ3::ALGO_LORENZO_REG, SZ3::INTERP_ALGO_LINEAR}};
+            if (smoothness < 0.25) {
+                candidates.push_back({SZ3::ALGO_INTERP_LORENZO, SZ3::INTERP_ALGO_LINEAR});
+                candidates.push_back({SZ3::ALGO_INTERP, SZ3::INTERP_ALGO_LINEAR});
+                candidates.push_back({SZ3::ALGO_INTERP, SZ3::INTERP_ALGO_CUBIC});
+            }
+            if (smoothness >= 0.1) {
+                candidates.push_back({SZ3::ALGO_NOPRED, SZ3::INTERP_ALGO_LINEAR});
+            }
+
+            if (_debug) {
+                std::cerr << std::format("[DEBUG SZAutoTuner]: branch = {}, maxError = {}, range = {}, smoothness = {:.4f}, sampleSize = {}, candidates = {}",
+                                            branchName, _maxError, range, smoothness, sample.size(), candidates.size()) << std::endl;
+            }
+
+            // Trial-compress the sample with each candidate
+            SZTuning best{_maxError, SZ3::EB_ABS, _maxError, 0.0, -1, -1, 0.0};
+            std::vector<uint8_t> compressedSample{};
+            std::vector<float> decompressedSample(sample.size());
+            for (const auto& [algo, interpAlgo] : candidates) {
+                SZCompressor compressor(1, SZ3::EB_ABS, algo, interpAlgo);
+                compressor.setErrorBounds(SZ3::EB_ABS, _maxError, 0.0);
+
+                compressor.compressInto(sample, compressedSample);
+                compressor.decompressInto(compressedSample, decompressedSample);
+
+                // Verify the bound on the sample rather than trusting it
+                double maxObservedError{0};
+                for (size_t i{0}; i < sample.size(); ++i) {
+                    if (std::isfinite(sample[i])) {
+                        maxObservedError = std::max(maxObservedError, std::abs(static_cast<double>(sample[i]) - decompressedSample[i]));
+                    }
+                }
+
+                double ratio{static_cast<double>(sample.size() * sizeof(float)) / static_cast<double>(compressedSample.size())};
+
+                if (_debug) {
+                    std::cerr << std::format("[DEBUG SZAutoTuner]: algo = {}, interpAlgo = {}, ratio = {:.3f}, maxObservedError = {}",
+                                                algo, interpAlgo, ratio, maxObservedError) << std::endl;
+                }
+
+                if (maxObservedError <= _maxError && ratio > best.sampleRatio) {
+                    best.algo = algo;
+                    best.interpAlgo = interpAlgo;
+                    best.sampleRatio = ratio;
+                }
+            }
+
+            if (best.algo < 0) {
+                throw std::runtime_error("SZAutoTuner: no configuration met the error target for branch " + branchName);
+            }
+
+            _cache[{branchName, _maxError}] = best;
+            if (!_cacheFile.empty()) {
+                _saveCache();
+            }
+
+            return best;
+        }
+
+        // Getters
+        double getMaxError() const { return _maxError; }
+        bool lastWasCached() const { return _lastWasCached; }
+
+    private:
+        static constexpr size_t SAMPLE_BLOCK_SIZE{4096};
+        static constexpr size_t SAMPLE_BLOCKS{32};
+
+        double _maxError;
+        std::string _cacheFile;
+        bool _debug;
+        bool _lastWasCached{false};
+
+        std::map<std::pair<std::string, double>, SZTuning> _cache{};
+
+        // Cache file has one tuning per line:
+        // branch maxError errorBoundMode absErrorBound relErrorBound algo interpAlgo sampleRatio
+        void _loadCache() {
+            std::ifstream file(_cacheFile);
+            if (!file.is_open()) {
+                return;     // No cache yet
+            }
+
+            std::string line;
+            while (std::getline(file, line)) {
+                std::istringstream iss(line);
+                std::string branchName;
+                SZTuning tuning;
+                if (iss >> branchName >> tuning.maxError >> tuning.errorBoundMode >> tuning.absErrorBound
+                        >> tuning.relErrorBound >> tuning.algo >> tuning.interpAlgo >> tuning.sampleRatio) {
+                    _cache[{branchName, tuning.maxError}] = tuning;
+                }
+            }
+        }
+
+        void _saveCache() {
+            std::ofstream file(_cacheFile);
+            if (!file.is_open()) {
+                throw std::runtime_error("Could not open file: " + _cacheFile);
+            }
+
+            for (const auto& [key, tuning] : _cache) {
+                file << std::format("{} {} {} {} {} {} {} {}\n", key.first, tuning.maxError, tuning.errorBoundMode,
+                            tuning.absErrorBound, tuning.relErrorBound, tuning.algo, tuning.interpAlgo, tuning.sampleRatio);
+            }
+        }
+};
+
+#endif
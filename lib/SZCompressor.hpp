@@ -1,19 +1,32 @@
 #ifndef MY_SZ_COMPRESSOR_HPP
 #define MY_SZ_COMPRESSOR_HPP
 
-#include <chrono>
+#include <algorithm>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <format>
 #include <iostream>
+#include <memory>
+#include <span>
 #include <stdexcept>
 #include <vector>
 
 #include <SZ3/api/sz.hpp>
 
 #include "MyCompressor.hpp"
+#include "IntegerCompressor.hpp"
+#include "Trace.hpp"
 
 class SZCompressor : public MyCompressor {
     public:
+        // How a jagged (one vector per event) column is laid out for SZ3
+        // FLAT compresses the flattened values as 1-D. EVENT_MAJOR and OBJECT_MAJOR pad each event to the largest
+        // multiplicity and compress an events x objects (or objects x events) 2-D field, so the predictors see the same
+        // object index in neighbouring events. Padding repeats the previous value and is dropped again on decompression;
+        // the per-event counts are stored in front of the SZ3 stream, bit-packed with IntegerCompressor.
+        enum LAYOUT{FLAT, EVENT_MAJOR, OBJECT_MAJOR};
+
         SZCompressor() {}
         
         SZCompressor(const int precision, const int errorBoundMode,
@@ -25,6 +38,7 @@ class SZCompressor : public MyCompressor {
             }
             else {
                 _precision = precision;
+                _relErrorBound = _calculateRelativeError(_precision);
             }
 
             // Validate errorBoundMode
@@ -55,86 +69,87 @@ class SZCompressor : public MyCompressor {
             }
         }
 
+        std::unique_ptr<MyCompressor> clone() const override {
+            return std::make_unique<SZCompressor>(*this);
+        }
+
         std::vector<uint8_t> compress(const std::vector<float>& data) override {
+            std::vector<uint8_t> compressedData{};
+            compressInto(data, compressedData);
+            return compressedData;
+        }
+
+        void compressInto(std::span<const float> data, std::vector<uint8_t>& compressedData) override {
             if (_debug) {
                 std::cerr << std::format("[DEBUG SZCompressor]: precision = {}, errorBoundMode = {}, algo = {}, interpAlgo = {}, dataSize = {}",
                                              _precision, _errorBoundMode, _algo, _interpAlgo, data.size() * sizeof(float)) << std::endl;
             }
 
-            // Perform configuration
-            std::vector<size_t> dims{data.size()};
+            // Jagged layouts compress a padded copy, after the event counts
+            compressedData.clear();
+            if (_layout != FLAT) {
+                TraceSpan span("SZCompressor", "padding", _debug, data.size_bytes());
+                data = _pad(data, compressedData);
+            }
 
-            SZ3::Config conf({dims[0]});
-            conf.lossless = false;
-            conf.dataType = SZ_FLOAT;
-
-            conf.cmprAlgo = static_cast<SZ3::ALGO>(_algo);
-            conf.interpAlgo = static_cast<SZ3::INTERP_ALGO>(_interpAlgo);
-            conf.errorBoundMode = static_cast<SZ3::EB>(_errorBoundMode);
-            
-            switch (_errorBoundMode) {
-                case SZ3::EB_REL:
-                    conf.relErrorBound = _calculateRelativeError(_precision);
-                    break;
-                case SZ3::EB_ABS:
-                    conf.absErrorBound = 0.001;
-                    break;
-                case SZ3::EB_ABS_AND_REL:
-                    conf.absErrorBound = 0.001;
-                    conf.relErrorBound = _calculateRelativeError(_precision);
-                    break;
-                case SZ3::EB_ABS_OR_REL:
-                    conf.absErrorBound = 0.001;
-                    conf.relErrorBound = _calculateRelativeError(_precision);
-                    break;
-                default:
-                    throw std::invalid_argument("Invalid error bound mode");
-                    break;
-            };
+            // Perform configuration; reused while the input shape stays the same
+            _configure(data.size());
 
             // Compress data
             size_t compressedSize;
             char* compressedDataPtr{};
-            if (_debug) {
-                std::chrono::high_resolution_clock::time_point startCompression = std::chrono::high_resolution_clock::now();
-                compressedDataPtr = SZ_compress(conf, data.data(), compressedSize);
-                std::chrono::high_resolution_clock::time_point endCompression = std::chrono::high_resolution_clock::now();
-                std::cerr << std::format("[DEBUG SZCompressor]: compression time = {} ms",
-                                            std::chrono::duration_cast<std::chrono::milliseconds>(endCompression - startCompression).count()) << std::endl;
-            }
-            else {
-                compressedDataPtr = SZ_compress(conf, data.data(), compressedSize);
+            {
+                // Prediction, quantization and encoding all happen inside SZ3, so they are one span
+                TraceSpan span("SZCompressor", "compression", _debug, data.size_bytes());
+                compressedDataPtr = SZ_compress(_conf, data.data(), compressedSize);
             }
 
-            // Wrap result in vector, then free
-            std::vector<uint8_t> compressedData(compressedDataPtr, compressedDataPtr + compressedSize);
+            // Copy result into the caller's buffer, then free
+            TraceSpan span("SZCompressor", "copy-out", _debug, compressedSize);
+            compressedData.insert(compressedData.end(), compressedDataPtr, compressedDataPtr + compressedSize);
             free(compressedDataPtr);
-
-            // Return compressed data
-            return compressedData;
         }
 
         std::vector<float> decompress(const std::vector<uint8_t>& compressedData, const size_t& uncompressedSize) override {
-            // Decompress
-            SZ3::Config conf{};
-            float* decompressedDataPtr = nullptr;
-            if (_debug) {
-                std::chrono::high_resolution_clock::time_point startDecompression = std::chrono::high_resolution_clock::now();
-                SZ_decompress(conf, reinterpret_cast<const char*>(compressedData.data()), compressedData.size() * sizeof(float), decompressedDataPtr);
-                std::chrono::high_resolution_clock::time_point endDecompression = std::chrono::high_resolution_clock::now();
-                std::cerr << std::format("[DEBUG SZCompressor]: decompression time = {} ms",
-                                            std::chrono::duration_cast<std::chrono::milliseconds>(endDecompression - startDecompression).count()) << std::endl;
+            // Allocate space for decompressed data
+            std::vector<float> decompressedData(uncompressedSize);
+
+            decompressInto(compressedData, decompressedData);
+
+            // Return decompressed data
+            return decompressedData;
+        }
+
+        void decompressInto(std::span<const uint8_t> compressedData, std::span<float> decompressedData) override {
+            // Jagged layouts decompress into the padded field, then drop the padding
+            size_t expectedSize{decompressedData.size()};
+            if (_layout != FLAT) {
+                compressedData = _readCounts(compressedData, decompressedData.size());
+                expectedSize = _fieldCounts.size() * _fieldWidth;
             }
-            else {
-                SZ_decompress(conf, reinterpret_cast<const char*>(compressedData.data()), compressedData.size() * sizeof(float), decompressedDataPtr);
+
+            // SZ3 only learns the element count from the stream itself, so let it allocate the output and check the
+            // count before anything reaches the caller's buffer; a corrupt stream could otherwise write past it
+            SZ3::Config conf{};
+            float* decompressedDataPtr{nullptr};
+            {
+                TraceSpan span("SZCompressor", "decompression", _debug, expectedSize * sizeof(float));
+                SZ_decompress(conf, reinterpret_cast<const char*>(compressedData.data()), compressedData.size(), decompressedDataPtr);
             }
+            const std::unique_ptr<float[], decltype(&free)> output{decompressedDataPtr, &free};
 
-            // Wrap result in vector, then free
-            std::vector<float> decompressedVec(decompressedDataPtr, decompressedDataPtr + uncompressedSize);
-            free(decompressedDataPtr);
+            // Check decompressed size
+            if (conf.num != expectedSize) {
+                throw std::runtime_error("SZCompressor: decompressed size mismatch");
+            }
 
-            // Return decompressed data
-            return decompressedVec;
+            if (_layout != FLAT) {
+                TraceSpan span("SZCompressor", "unpadding", _debug, decompressedData.size_bytes());
+                _unpad(std::span<const float>(output.get(), conf.num), decompressedData);
+            } else {
+                TraceSpan span("SZCompressor", "copy-out", _debug, decompressedData.size_bytes());
+                std::copy_n(output.get(), conf.num, decompressedData.begin());
+            }
         }
 
         // Getters
@@ -142,27 +157,91 @@ class SZCompressor : public MyCompressor {
         int getErrorBoundMode() const { return _errorBoundMode; }
         int getAlgo() const { return _algo; }
         int getInterpAlgo() const { return _interpAlgo; }
+        int getLayout() const { return _layout; }
 
         std::string getErrorBoundModeString() { return SZ3::enum2Str(static_cast<SZ3::EB>(_errorBoundMode)); }
         std::string getAlgoString() { return SZ3::enum2Str(static_cast<SZ3::ALGO>(_algo)); }
         std::string getInterpAlgoString() { return SZ3::enum2Str(static_cast<SZ3::INTERP_ALGO>(_interpAlgo)); }
 
+        std::string getLayoutString() const {
+            switch (_layout) {
+                case EVENT_MAJOR:
+                    return "event-major";
+                case OBJECT_MAJOR:
+                    return "object-major";
+                default:
+                    return "flat";
+            }
+        }
+
+        double getAbsErrorBound() const { return _absErrorBound; }
+        double getRelErrorBound() const { return _relErrorBound; }
+
         std::string getErrorBound() {
             switch(_errorBoundMode) {
                 case SZ3::EB_REL:
-                    return std::string("relative error: {}", _calculateRelativeError(_precision));
+                    return std::format("relative error: {}", _relErrorBound);
                 case SZ3::EB_ABS:
-                    return std::string("absolute error: {}", 0.001);
+                    return std::format("absolute error: {}", _absErrorBound);
                 case SZ3::EB_ABS_AND_REL:
-                    return std::string("absolute error: {}, relative error: {}", 0.001, _calculateRelativeError(_precision));
+                    return std::format("absolute error: {}, relative error: {}", _absErrorBound, _relErrorBound);
                 case SZ3::EB_ABS_OR_REL:
-                    return std::string("absolute error: {}, relative error: {}", 0.001, _calculateRelativeError(_precision));
+                    return std::format("absolute error: {}, relative error: {}", _absErrorBound, _relErrorBound);
                 default:
                     throw std::invalid_argument("Invalid error bound mode");
                     break;
             }
         }
 
+        // Setters
+        // These replace the defaults derived from precision and take effect on the next compress call
+        void setErrorBounds(const int errorBoundMode, const double absErrorBound, const double relErrorBound) {
+            if (errorBoundMode < 0 || errorBoundMode > 5) {
+                throw std::invalid_argument("errorBoundMode must be between 0 and 5");
+            }
+            if (absErrorBound < 0 || relErrorBound < 0) {
+                throw std::invalid_argument("error bounds must not be negative");
+            }
+            _errorBoundMode = errorBoundMode;
+            _absErrorBound = absErrorBound;
+            _relErrorBound = relErrorBound;
+            _confReady = false;
+        }
+
+        // Treat input as a multi-dimensional field, slowest-varying dimension first; empty means 1-D
+        void setDimensions(const std::vector<size_t>& dims) {
+            if (!dims.empty() && _layout != FLAT) {
+                throw std::invalid_argument("SZCompressor: explicit dimensions cannot be combined with a jagged layout");
+            }
+            _dims = dims;
+            _confReady = false;
+        }
+
+        // Per-event counts are needed to compress with a jagged layout; decompression reads them from the stream
+        void setLayout(const int layout, const std::vector<uint32_t>& eventCounts={}) {
+            if (layout < FLAT || layout > OBJECT_MAJOR) {
+                throw std::invalid_argument("layout must be between 0 and 2");
+            }
+            if (layout != FLAT && !_dims.empty()) {
+                throw std::invalid_argument("SZCompressor: a jagged layout cannot be combined with explicit dimensions");
+            }
+            _layout = layout;
+            _eventCounts = eventCounts;
+            _confReady = false;
+        }
+
+        void setAlgorithms(const int algo, const int interpAlgo) {
+            if (algo < 0 || algo > 4) {
+                throw std::invalid_argument("algo must be between 0 and 4");
+            }
+            if (interpAlgo < 0 || interpAlgo > 1) {
+                throw std::invalid_argument("interpAlgo must be between 0 and 1");
+            }
+            _algo = algo;
+            _interpAlgo = interpAlgo;
+            _confReady = false;
+        }
+
     private:
         int _precision;
         int _errorBoundMode;
@@ -170,6 +249,199 @@ class SZCompressor : public MyCompressor {
         int _interpAlgo;
         bool _debug;
 
+        double _absErrorBound{0.001};
+        double _relErrorBound;
+
+        // SZ3 configuration kept between calls: the settings are rebuilt only after a setter changes them, and a new
+        // input shape only updates the dimensions
+        SZ3::Config _conf{};
+        size_t _confSize{0};
+        std::vector<size_t> _confDims{};
+        bool _confReady{false};
+        std::vector<size_t> _dims{};
+
+        // Jagged layout state: counts to compress with, and the padded field and counts of the last call
+        int _layout{FLAT};
+        std::vector<uint32_t> _eventCounts{};
+        std::vector<uint32_t> _fieldCounts{};
+        std::vector<float> _field{};
+        size_t _fieldWidth{0};
+        std::vector<uint8_t> _countsBlob{};
+
+        void _configure(size_t size) {
+            // A padded field of the same size may still have a different shape
+            const std::vector<size_t> dims{_layout == EVENT_MAJOR ? std::vector<size_t>{_fieldCounts.size(), _fieldWidth}
+                                          : _layout == OBJECT_MAJOR ? std::vector<size_t>{_fieldWidth, _fieldCounts.size()}
+                                          : _dims};
+            if (_confReady && _confSize == size && _confDims == dims) {
+                return;
+            }
+
+            if (!dims.empty()) {
+                size_t dimsSize{1};
+                for (size_t dim : dims) {
+                    dimsSize *= dim;
+                }
+                if (dimsSize != size) {
+                    throw std::invalid_argument("SZCompressor: dimensions do not match data size");
+                }
+            }
+            const std::vector<size_t> confDims{dims.empty() ? std::vector<size_t>{size} : dims};
+
+            if (_confReady) {
+                _conf.setDims(confDims.begin(), confDims.end());
+                _confSize = size;
+                _confDims = dims;
+                return;
+            }
+
+            _conf = SZ3::Config{};
+            _conf.setDims(confDims.begin(), confDims.end());
+            _conf.lossless = false;
+            _conf.dataType = SZ_FLOAT;
+
+            _conf.cmprAlgo = static_cast<SZ3::ALGO>(_algo);
+            _conf.interpAlgo = static_cast<SZ3::INTERP_ALGO>(_interpAlgo);
+            _conf.errorBoundMode = static_cast<SZ3::EB>(_errorBoundMode);
+            
+            switch (_errorBoundMode) {
+                case SZ3::EB_REL:
+                    _conf.relErrorBound = _relErrorBound;
+                    break;
+                case SZ3::EB_ABS:
+                    _conf.absErrorBound = _absErrorBound;
+                    break;
+                case SZ3::EB_ABS_AND_REL:
+                    _conf.absErrorBound = _absErrorBound;
+                    _conf.relErrorBound = _relErrorBound;
+                    break;
+                case SZ3::EB_ABS_OR_REL:
+                    _conf.absErrorBound = _absErrorBound;
+                    _conf.relErrorBound = _relErrorBound;
+                    break;
+                default:
+                    throw std::invalid_argument("Invalid error bound mode");
+                    break;
+            };
+
+            _confSize = size;
+            _confDims = dims;
+            _confReady = true;
+        }
+
+        // Write the event counts to compressedData and return the padded field
+        std::span<const float> _pad(std::span<const float> data, std::vector<uint8_t>& compressedData) {
+            size_t total{0};
+            for (uint32_t count : _eventCounts) {
+                total += count;
+            }
+            if (_eventCounts.empty() || total != data.size()) {
+                throw std::invalid_argument("SZCompressor: event counts do not match data size");
+            }
+
+            _fieldCounts = _eventCounts;
+            _fieldWidth = std::max<size_t>(1, *std::max_element(_fieldCounts.begin(), _fieldCounts.end()));
+            _fillField(data);
+
+            if (_debug) {
+                std::cerr << std::format("[DEBUG SZCompressor]: layout = {}, events = {}, width = {}, padding = {:.1f}%",
+                                            getLayoutString(), _fieldCounts.size(), _fieldWidth,
+                                            100.0 * static_cast<double>(_field.size() - data.size()) / static_cast<double>(_field.size())) << std::endl;
+            }
+
+            // Header is number of events and size of the packed counts
+            IntegerCompressor(IntegerCompressor::FRAME_OF_REFERENCE).compressInto(_fieldCounts, _countsBlob);
+            const uint64_t header[2]{_fieldCounts.size(), _countsBlob.size()};
+            const uint8_t* headerBytes{reinterpret_cast<const uint8_t*>(header)};
+            compressedData.insert(compressedData.end(), headerBytes, headerBytes + sizeof(header));
+            compressedData.insert(compressedData.end(), _countsBlob.begin(), _countsBlob.end());
+
+            return _field;
+        }
+
+        // Scatter values into the padded field; padding repeats the previous value in memory order, which keeps the
+        // prediction residuals of the padding small
+        void _fillField(std::span<const float> data) {
+            const size_t numEvents{_fieldCounts.size()};
+            _field.resize(numEvents * _fieldWidth);
+
+            if (_layout == EVENT_MAJOR) {
+                size_t position{0};
+                float previous{0};
+                for (size_t event{0}; event < numEvents; ++event) {
+                    float* row{_field.data() + event * _fieldWidth};
+                    for (size_t object{0}; object < _fieldWidth; ++object) {
+                        row[object] = object < _fieldCounts[event] ? data[position++] : previous;
+                        previous = row[object];
+                    }
+                }
+            }
+            else {
+                // Fill columns first so each event's values are read contiguously; then pad each row in order
+                std::vector<uint8_t> present(_field.size(), 0);
+                size_t position{0};
+                for (size_t event{0}; event < numEvents; ++event) {
+                    for (size_t object{0}; object < _fieldCounts[event]; ++object) {
+                        _field[object * numEvents + event] = data[position++];
+                        present[object * numEvents + event] = 1;
+                    }
+                }
+                float previous{0};
+                for (size_t i{0}; i < _field.size(); ++i) {
+                    if (!present[i]) {
+                        _field[i] = previous;
+                    }
+                    previous = _field[i];
+                }
+            }
+        }
+
+        // Read the event counts from the front of compressedData and the padded field width; returns the SZ3 stream
+        std::span<const uint8_t> _readCounts(std::span<const uint8_t> compressedData, size_t uncompressedSize) {
+            uint64_t header[2];
+            if (compressedData.size() < sizeof(header)) {
+                throw std::runtime_error("SZCompressor: compressed data is truncated");
+            }
+            std::memcpy(header, compressedData.data(), sizeof(header));
+            compressedData = compressedData.subspan(sizeof(header));
+            if (header[1] > compressedData.size()) {
+                throw std::runtime_error("SZCompressor: compressed data is truncated");
+            }
+
+            // Every block of counts takes at least its width byte and reference, so the stream size bounds the number of
+            // events before anything is allocated for them
+            const size_t maxEvents{header[1] / (1 + sizeof(uint32_t)) * IntegerCompressor::BLOCK_SIZE};
+            if (header[0] > maxEvents) {
+                throw std::runtime_error("SZCompressor: invalid event count");
+            }
+
+            _fieldCounts.resize(header[0]);
+            IntegerCompressor(IntegerCompressor::FRAME_OF_REFERENCE).decompressInto(compressedData.first(header[1]), _fieldCounts);
+
+            size_t total{0};
+            _fieldWidth = 1;
+            for (uint32_t count : _fieldCounts) {
+                total += count;
+                _fieldWidth = std::max<size_t>(_fieldWidth, count);
+            }
+            if (total != uncompressedSize) {
+                throw std::runtime_error("SZCompressor: event counts do not match decompressed size");
+            }
+            return compressedData.subspan(header[1]);
+        }
+
+        // Gather values back out of a decompressed padded field
+        void _unpad(std::span<const float> field, std::span<float> decompressedData) {
+            const size_t numEvents{_fieldCounts.size()};
+            size_t position{0};
+            for (size_t event{0}; event < numEvents; ++event) {
+                for (size_t object{0}; object < _fieldCounts[event]; ++object) {
+                    decompressedData[position++] = _layout == EVENT_MAJOR ? field[event * _fieldWidth + object]
+                                                                          : field[object * numEvents + event];
+                }
+            }
+        }
+
         double _calculateRelativeError(int precision) {
             return 0.5 * std::pow(10, -precision);
         }
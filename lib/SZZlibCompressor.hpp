@@ -1,10 +1,10 @@
 #ifndef SZZLIB_COMPRESS_HPP
 #define SZZLIB_COMPRESS_HPP
 
-#include <chrono>
 #include <cstdint>
 #include <format>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
@@ -12,6 +12,7 @@
 #include <SZ3/api/sz.hpp>
 
 #include "MyCompressor.hpp"
+#include "Trace.hpp"
 
 class SZZlibCompressor : public MyCompressor {
     public:
@@ -65,6 +66,10 @@ class SZZlibCompressor : public MyCompressor {
             }
         }
 
+        std::unique_ptr<MyCompressor> clone() const override {
+            return std::make_unique<SZZlibCompressor>(*this);
+        }
+
         std::vector<uint8_t> compress(const std::vector<float>& data) override {
             if (_debug) {
                 std::cerr << std::format("[DEBUG SZZlibCompressor]: precision = {}, compressionLevel = {}, errorBoundMode = {}, algo = {}, interpAlgo = {}, dataSize = {}",
@@ -105,14 +110,8 @@ class SZZlibCompressor : public MyCompressor {
             // Compress data
             size_t compressedSize;
             char* compressedDataPtr{};
-            if (_debug) {
-                std::chrono::high_resolution_clock::time_point startCompression = std::chrono::high_resolution_clock::now();
-                compressedDataPtr = SZ_compress(conf, data.data(), compressedSize);
-                std::chrono::high_resolution_clock::time_point endCompression = std::chrono::high_resolution_clock::now();
-                std::cerr << std::format("[DEBUG SZZlibCompressor]: SZ3 compression time = {} ms",
-                                            std::chrono::duration_cast<std::chrono::milliseconds>(endCompression - startCompression).count()) << std::endl;
-            }
-            else {
+            {
+                TraceSpan span("SZZlibCompressor", "SZ3 compression", _debug, data.size() * sizeof(float));
                 compressedDataPtr = SZ_compress(conf, data.data(), compressedSize);
             }
 
@@ -126,15 +125,8 @@ class SZZlibCompressor : public MyCompressor {
             size_t zlibCompressedSize{compressBound(compressedData.size())};
             std::vector<uint8_t> zlibCompressedData(zlibCompressedSize);
             int result;
-            if (_debug) {
-                std::chrono::high_resolution_clock::time_point startZlibCompression = std::chrono::high_resolution_clock::now();
-                result = compress2(zlibCompressedData.data(), &zlibCompressedSize,
-                            compressedData.data(), compressedData.size(), _compressionLevel);
-                std::chrono::high_resolution_clock::time_point endZlibCompression = std::chrono::high_resolution_clock::now();
-                std::cerr << std::format("[DEBUG SZZlibCompressor]: zlib compression time = {} ms",
-                                            std::chrono::duration_cast<std::chrono::milliseconds>(endZlibCompression - startZlibCompression).count()) << std::endl;
-            }
-            else {
+            {
+                TraceSpan span("SZZlibCompressor", "zlib compression", _debug, compressedData.size());
                 result = compress2(zlibCompressedData.data(), &zlibCompressedSize,
                             compressedData.data(), compressedData.size(), _compressionLevel);
             }
@@ -158,15 +150,8 @@ class SZZlibCompressor : public MyCompressor {
 
             size_t uncompressedSizeBytes{uncompressedSize * sizeof(float)};
             int result;
-            if (_debug) {
-                std::chrono::high_resolution_clock::time_point startZlibDecompression = std::chrono::high_resolution_clock::now();
-                result = uncompress(decompressedData.data(), &uncompressedSizeBytes,
-                            compressedData.data(), compressedData.size());
-                std::chrono::high_resolution_clock::time_point endZlibDecompression = std::chrono::high_resolution_clock::now();
-                std::cerr << std::format("[DEBUG SZZlibCompressor]: zlib decompression time = {} ms",
-                                            std::chrono::duration_cast<std::chrono::milliseconds>(endZlibDecompression - startZlibDecompression).count()) << std::endl;
-            }
-            else {
+            {
+                TraceSpan span("SZZlibCompressor", "zlib decompression", _debug, compressedData.size());
                 result = uncompress(decompressedData.data(), &uncompressedSizeBytes,
                             compressedData.data(), compressedData.size());
             }
@@ -185,15 +170,10 @@ class SZZlibCompressor : public MyCompressor {
             // Decompress SZ3 data
             SZ3::Config conf{};
             float* decompressedDataPtr = nullptr;
-            if (_debug) {
-                std::chrono::high_resolution_clock::time_point startSZ3Decompression = std::chrono::high_resolution_clock::now();
+            {
+                // decompressedData holds the SZ3 stream as bytes
+                TraceSpan span("SZZlibCompressor", "SZ3 decompression", _debug, decompressedData.size());
                 SZ_decompress(conf, reinterpret_cast<const char*>(decompressedData.data()), decompressedData.size(), decompressedDataPtr);
-                std::chrono::high_resolution_clock::time_point endSZ3Decompression = std::chrono::high_resolution_clock::now();
-                std::cerr << std::format("[DEBUG SZZlibCompressor]: SZ3 decompression time = {} ms",
-                                            std::chrono::duration_cast<std::chrono::milliseconds>(endSZ3Decompression - startSZ3Decompression).count()) << std::endl;
-            }
-            else {
-                SZ_decompress(conf, reinterpret_cast<const char*>(decompressedData.data()), decompressedData.size() * sizeof(float), decompressedDataPtr);
             }
 
             // Wrap result in vector, then free
@@ -0,0 +1,213 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Compile with -DC2P2_TRACE=0 to remove every span, along with the debug timing lines they print; with tracing compiled
+// in, spans are only recorded after Trace::setEnabled(true) and cost one relaxed load otherwise
+#ifndef C2P2_TRACE
+#define C2P2_TRACE 1
+#endif
+
+// One timed section, e.g. the deflate call of one compress
+struct TraceEvent {
+    const char* category;       // Static or interned strings, so recording never allocates
+    const char* name;
+    uint64_t startNs;
+    uint64_t durationNs;
+    uint64_t bytes;
+};
+
+// Per-stage spans in per-thread rings, exported as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+// Each thread writes only its own ring, so recording takes no lock: the event goes in the slot at the head, then the
+// head is published. When a ring is full the oldest events are overwritten. Rings outlive their threads until clear.
+class Trace {
+    public:
+        static constexpr size_t RING_EVENTS{1 << 16};     // Per thread, about 2.5 MB
+
+        static bool enabled() {
+            return _enabled().load(std::memory_order_relaxed);
+        }
+
+        static void setEnabled(bool enabled) {
+            _enabled().store(enabled, std::memory_order_relaxed);
+        }
+
+        static uint64_t nowNs() {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        static void record(const char* category, const char* name, uint64_t startNs, uint64_t durationNs, uint64_t bytes) {
+            Ring& ring{_threadRing()};
+            const uint64_t head{ring.head.load(std::memory_order_relaxed)};
+            ring.events[head % RING_EVENTS] = TraceEvent{category, name, startNs, durationNs, bytes};
+            ring.head.store(head + 1, std::memory_order_release);
+        }
+
+        // Stable copy of a name built at run time, e.g. a codec chain stage spec; call once per name, not per event
+        static const char* intern(const std::string& name) {
+            Registry& registry{_registry()};
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            return registry.names.insert(name).first->c_str();
+        }
+
+        // Events of every thread, oldest first per thread. Safe while threads are recording: events a thread may have
+        // overwritten during the copy are dropped.
+        static std::vector<std::pair<int, TraceEvent>> events() {
+            Registry& registry{_registry()};
+            std::lock_guard<std::mutex> lock(registry.mutex);
+
+            std::vector<std::pair<int, TraceEvent>> events{};
+            for (const std::unique_ptr<Ring>& ring : registry.rings) {
+                const uint64_t head{ring->head.load(std::memory_order_acquire)};
+                const uint64_t first{head > RING_EVENTS ? head - RING_EVENTS : 0};
+                std::vector<TraceEvent> copied{};
+                for (uint64_t i{first}; i < head; ++i) {
+                    copied.push_back(ring->events[i % RING_EVENTS]);
+                }
+                // The fence keeps the copy ahead of the second load. The writer may be filling the slot of event
+                // `after` without having published it yet, which overwrites event after - RING_EVENTS, so only events
+                // from after + 1 - RING_EVENTS on are known intact
+                std::atomic_thread_fence(std::memory_order_acquire);
+                const uint64_t after{ring->head.load(std::memory_order_relaxed)};
+                const uint64_t valid{after + 1 > RING_EVENTS ? after + 1 - RING_EVENTS : 0};
+                for (uint64_t i{std::max(first, valid)}; i < head; ++i) {
+                    events.emplace_back(ring->thread, copied[i - first]);
+                }
+            }
+            return events;
+        }
+
+        // Drop recorded events; only while no thread is recording
+        static void clear() {
+            Registry& registry{_registry()};
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            for (const std::unique_ptr<Ring>& ring : registry.rings) {
+                ring->head.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        static void writeChromeJson(const std::string& file) {
+            std::ofstream out(file);
+            if (!out.is_open()) {
+                throw std::runtime_error("Could not open file: " + file);
+            }
+
+            const std::vector<std::pair<int, TraceEvent>> recorded{events()};
+            uint64_t origin{UINT64_MAX};
+            for (const auto& [thread, event] : recorded) {
+                origin = std::min(origin, event.startNs);
+            }
+
+            // Complete ("X") events, timestamps in microseconds from the first event
+            out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+            bool first{true};
+            for (const auto& [thread, event] : recorded) {
+                out << std::format("{}\n{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{\"bytes\":{}}}}}",
+                                    first ? "" : ",", event.name, event.category, thread,
+                                    static_cast<double>(event.startNs - origin) / 1000, static_cast<double>(event.durationNs) / 1000, event.bytes);
+                first = false;
+            }
+            out << "\n]}\n";
+        }
+
+    private:
+        struct Ring {
+            int thread{0};
+            std::atomic<uint64_t> head{0};
+            std::array<TraceEvent, RING_EVENTS> events{};
+        };
+
+        struct Registry {
+            std::mutex mutex{};
+            std::vector<std::unique_ptr<Ring>> rings{};
+            std::set<std::string> names{};
+        };
+
+        static std::atomic<bool>& _enabled() {
+            static std::atomic<bool> enabled{false};
+            return enabled;
+        }
+
+        static Registry& _registry() {
+            static Registry registry{};
+            return registry;
+        }
+
+        // The registry owns the rings, so a thread's events survive the thread
+        static Ring& _threadRing() {
+            thread_local Ring* ring{nullptr};
+            if (!ring) {
+                Registry& registry{_registry()};
+                std::lock_guard<std::mutex> lock(registry.mutex);
+                registry.rings.push_back(std::make_unique<Ring>());
+                ring = registry.rings.back().get();
+                ring->thread = static_cast<int>(registry.rings.size());
+            }
+            return *ring;
+        }
+};
+
+// Times its scope as one span, when tracing is enabled. With debug, the time is also printed as the debug timing
+// lines were: [DEBUG category]: name time = x ms
+class TraceSpan {
+    public:
+#if C2P2_TRACE
+        TraceSpan(const char* category, const char* name, bool debug=false, uint64_t bytes=0)
+            : _category(category), _name(name), _debug(debug), _bytes(bytes)
+        {
+            _active = debug || Trace::enabled();
+            if (_active) {
+                _startNs = Trace::nowNs();
+            }
+        }
+
+        ~TraceSpan() {
+            if (!_active) {
+                return;
+            }
+            const uint64_t durationNs{Trace::nowNs() - _startNs};
+            if (Trace::enabled()) {
+                Trace::record(_category, _name, _startNs, durationNs, _bytes);
+            }
+            if (_debug) {
+                std::cerr << std::format("[DEBUG {}]: {} time = {:.3f} ms", _category, _name, static_cast<double>(durationNs) / 1e6) << std::endl;
+            }
+        }
+
+        // Bytes in or out of the stage, known only once it has run
+        void setBytes(uint64_t bytes) { _bytes = bytes; }
+#else
+        TraceSpan(const char*, const char*, bool=false, uint64_t=0) {}
+        void setBytes(uint64_t) {}
+#endif
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+
+#if C2P2_TRACE
+    private:
+        const char* _category;
+        const char* _name;
+        bool _debug;
+        bool _active;
+        uint64_t _bytes;
+        uint64_t _startNs{0};
+#endif
+};
+
+#endif
@@ -2,17 +2,21 @@
 #define MY_TRUNK_COMPRESSOR_HPP
 
 #include <algorithm>
-#include <chrono>
+#include <bit>
 #include <cmath>
 #include <cstdint>
 #include <format>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <span>
 #include <stdexcept>
 #include <vector>
 
 #include <zlib.h>
 
 #include "MyCompressor.hpp"
+#include "Trace.hpp"
 
 class TrunkCompressor : public MyCompressor {
     public:
@@ -40,90 +44,132 @@ class TrunkCompressor : public MyCompressor {
             }
         }
 
+        ~TrunkCompressor() override {
+            if (_deflateReady) {
+                deflateEnd(&_deflateStream);
+            }
+            if (_inflateReady) {
+                inflateEnd(&_inflateStream);
+            }
+        }
+
+        // The zlib streams are owned by this instance, so it cannot be copied; use one instance per thread
+        TrunkCompressor(const TrunkCompressor&) = delete;
+        TrunkCompressor& operator=(const TrunkCompressor&) = delete;
+
+        // z_streams cannot be shared, so a clone starts with fresh ones
+        std::unique_ptr<MyCompressor> clone() const override {
+            std::unique_ptr<TrunkCompressor> compressor{std::make_unique<TrunkCompressor>(_precision, _compressionLevel, _debug)};
+            compressor->setDictionary(_dictionary);
+            return compressor;
+        }
+
         std::vector<uint8_t> compress(const std::vector<float>& data) override {
+            std::vector<uint8_t> compressedData{};
+            compressInto(data, compressedData);
+            return compressedData;
+        }
+
+        void compressInto(std::span<const float> data, std::vector<uint8_t>& compressedData) override {
             if (_debug) {
                 std::cerr << std::format("[DEBUG TrunkCompressor]: precision = {}, bitsTruncated = {}, compressionLevel = {}, dataSize = {}",
                                             _precision, _bitsTruncated, _compressionLevel, data.size() * sizeof(float)) << std::endl;
             }
 
-            // Truncate data if _bitsTruncated > 0
-            std::vector<float> truncatedData;
-            if (_debug) {
-                std::chrono::high_resolution_clock::time_point startTruncation{std::chrono::high_resolution_clock::now()};
-                truncatedData = _bitsTruncated ? _truncateVector(data) : data;
-                std::chrono::high_resolution_clock::time_point endTruncation{std::chrono::high_resolution_clock::now()};
-                std::cerr << std::format("[DEBUG TrunkCompressor]: truncation time = {} ms",
-                                            std::chrono::duration_cast<std::chrono::milliseconds>(endTruncation - startTruncation).count()) << std::endl;
+            // Truncate data into the scratch buffer if _bitsTruncated > 0, otherwise compress the input directly
+            std::span<const float> truncatedData{data};
+            if (_bitsTruncated) {
+                TraceSpan span("TrunkCompressor", "truncation", _debug, data.size_bytes());
+                _truncateVector(data);
+                truncatedData = _truncatedData;
             }
-            else {
-                truncatedData = _bitsTruncated ? _truncateVector(data) : data;
+
+            // Reuse the deflate state from the previous call
+            _resetDeflate();
+
+            // Prime the window with the trained dictionary, if any
+            if (!_dictionary.empty() && deflateSetDictionary(&_deflateStream, _dictionary.data(), _dictionary.size()) != Z_OK) {
+                throw std::runtime_error("TrunkCompressor: failed to set dictionary");
             }
 
-            // Allocate vector for compressed data
-            size_t compressedSize{compressBound(data.size() * sizeof(float))};
-            std::vector<uint8_t> compressedData(compressedSize);
+            // Size output buffer; its capacity is kept between calls
+            compressedData.resize(deflateBound(&_deflateStream, truncatedData.size() * sizeof(float)));
 
             // Compress
             int result;
-            if (_debug) {
-                std::chrono::high_resolution_clock::time_point startCompression{std::chrono::high_resolution_clock::now()};
-                result = compress2(compressedData.data(), &compressedSize,
-                            reinterpret_cast<const uint8_t*>(truncatedData.data()), 
-                            truncatedData.size() * sizeof(float), _compressionLevel);
-                std::chrono::high_resolution_clock::time_point endCompression{std::chrono::high_resolution_clock::now()};
-                std::cerr << std::format("[DEBUG TrunkCompressor]: compression time = {} ms",
-                                            std::chrono::duration_cast<std::chrono::milliseconds>(endCompression - startCompression).count()) << std::endl;
-            }
-            else {
-                result = compress2(compressedData.data(), &compressedSize,
-                            reinterpret_cast<const uint8_t*>(truncatedData.data()), 
-                            truncatedData.size() * sizeof(float), _compressionLevel);
+            {
+                TraceSpan span("TrunkCompressor", "compression", _debug, truncatedData.size_bytes());
+                result = _deflate(truncatedData, compressedData);
             }
 
             // Check for errors
-            if (result != Z_OK) {
+            if (result != Z_STREAM_END) {
                 throw std::runtime_error("TrunkCompressor: compression failed");
             }
 
             // Resize to actual size
-            compressedData.resize(compressedSize);
-
-            // Return compressed data
-            return compressedData;
+            compressedData.resize(_deflateStream.total_out);
         }
 
         std::vector<float> decompress(const std::vector<uint8_t>& compressedData, const size_t& uncompressedSize) override {
             // Allocate space for decompressed data
             std::vector<float> decompressedData(uncompressedSize);
 
+            decompressInto(compressedData, decompressedData);
+
+            // Return decompressed data
+            return decompressedData;
+        }
+
+        void decompressInto(std::span<const uint8_t> compressedData, std::span<float> decompressedData) override {
+            // Reuse the inflate state from the previous call
+            _resetInflate();
+
             // Decompress
-            size_t uncompressedSizeBytes{uncompressedSize * sizeof(float)};
             int result;
-            if (_debug) {
-                std::chrono::high_resolution_clock::time_point startDecompression{std::chrono::high_resolution_clock::now()};
-                result = uncompress(reinterpret_cast<uint8_t*>(decompressedData.data()), &uncompressedSizeBytes,
-                                                                compressedData.data(), compressedData.size());
-                std::chrono::high_resolution_clock::time_point endDecompression{std::chrono::high_resolution_clock::now()};
-                std::cerr << std::format("[DEBUG TrunkCompressor]: decompression time = {} ms",
-                                            std::chrono::duration_cast<std::chrono::milliseconds>(endDecompression - startDecompression).count()) << std::endl;
-            }
-            else {
-                result = uncompress(reinterpret_cast<uint8_t*>(decompressedData.data()), &uncompressedSizeBytes,
-                                                                compressedData.data(), compressedData.size());
+            {
+                TraceSpan span("TrunkCompressor", "decompression", _debug, decompressedData.size_bytes());
+                result = _inflate(compressedData, decompressedData);
             }
 
             // Check for errors
-            if (result != Z_OK) {
+            if (result != Z_STREAM_END || _inflateStream.total_out != decompressedData.size() * sizeof(float)) {
                 throw std::runtime_error("TrunkCompressor: decompression failed");
             }
+        }
 
-            // Return decompressed data
-            return decompressedData;
+        // Use a preset deflate dictionary for compression and decompression
+        // Data compressed with a dictionary can only be decompressed with the same dictionary
+        void setDictionary(std::vector<uint8_t> dictionary) {
+            _dictionary = std::move(dictionary);
+        }
+
+        // Truncate into a caller-owned buffer of the same size, e.g. for a truncation stage in a codec chain
+        void truncateInto(std::span<const float> data, std::span<float> truncatedData) {
+            if (truncatedData.size() != data.size()) {
+                throw std::invalid_argument("TrunkCompressor: truncation buffer size mismatch");
+            }
+            if (!_bitsTruncated) {
+                std::copy(data.begin(), data.end(), truncatedData.begin());
+                return;
+            }
+            std::transform(data.begin(), data.end(), truncatedData.begin(), [this](float value) { return _truncateFloat(value); });
+        }
+
+        // Truncate data the same way compress does, without compressing it
+        std::vector<float> truncate(std::span<const float> data) {
+            if (!_bitsTruncated) {
+                return std::vector<float>(data.begin(), data.end());
+            }
+            _truncateVector(data);
+            return _truncatedData;
         }
 
         // Getters
         int getPrecision() const { return _precision; }
         int getBitsTruncated() const { return _bitsTruncated; }
+        int getCompressionLevel() const { return _compressionLevel; }
+        const std::vector<uint8_t>& getDictionary() const { return _dictionary; }
 
     private:
         int _precision;
@@ -131,6 +177,95 @@ class TrunkCompressor : public MyCompressor {
         int _compressionLevel;
         bool _debug;
 
+        // Persistent codec state and scratch space, reset rather than reallocated on every call
+        z_stream _deflateStream{};
+        z_stream _inflateStream{};
+        bool _deflateReady{false};
+        bool _inflateReady{false};
+        std::vector<float> _truncatedData{};
+        std::vector<uint8_t> _dictionary{};
+
+        void _resetDeflate() {
+            int result{_deflateReady ? deflateReset(&_deflateStream) : deflateInit(&_deflateStream, _compressionLevel)};
+            if (result != Z_OK) {
+                throw std::runtime_error("TrunkCompressor: failed to initialize deflate stream");
+            }
+            _deflateReady = true;
+        }
+
+        void _resetInflate() {
+            int result{_inflateReady ? inflateReset(&_inflateStream) : inflateInit(&_inflateStream)};
+            if (result != Z_OK) {
+                throw std::runtime_error("TrunkCompressor: failed to initialize inflate stream");
+            }
+            _inflateReady = true;
+        }
+
+        // zlib counts in uInt, so feed buffers larger than 4 GB in pieces
+        int _deflate(std::span<const float> data, std::vector<uint8_t>& compressedData) {
+            const uint8_t* in{reinterpret_cast<const uint8_t*>(data.data())};
+            size_t inLeft{data.size() * sizeof(float)};
+            size_t outLeft{compressedData.size()};
+            constexpr size_t maxChunk{std::numeric_limits<uInt>::max()};
+
+            _deflateStream.next_in = const_cast<Bytef*>(in);
+            _deflateStream.next_out = compressedData.data();
+            _deflateStream.avail_in = 0;
+            _deflateStream.avail_out = 0;
+
+            int result{Z_OK};
+            while (result == Z_OK) {
+                if (_deflateStream.avail_in == 0) {
+                    _deflateStream.avail_in = static_cast<uInt>(std::min(inLeft, maxChunk));
+                    inLeft -= _deflateStream.avail_in;
+                }
+                if (_deflateStream.avail_out == 0) {
+                    _deflateStream.avail_out = static_cast<uInt>(std::min(outLeft, maxChunk));
+                    outLeft -= _deflateStream.avail_out;
+                }
+                result = deflate(&_deflateStream, inLeft ? Z_NO_FLUSH : Z_FINISH);
+            }
+
+            return result;
+        }
+
+        int _inflate(std::span<const uint8_t> compressedData, std::span<float> decompressedData) {
+            size_t inLeft{compressedData.size()};
+            size_t outLeft{decompressedData.size() * sizeof(float)};
+            constexpr size_t maxChunk{std::numeric_limits<uInt>::max()};
+
+            _inflateStream.next_in = const_cast<Bytef*>(compressedData.data());
+            // zlib rejects a null output pointer even when nothing is written
+            Bytef emptyOutput{};
+            _inflateStream.next_out = decompressedData.empty() ? &emptyOutput : reinterpret_cast<Bytef*>(decompressedData.data());
+            _inflateStream.avail_in = 0;
+            _inflateStream.avail_out = 0;
+
+            int result{Z_OK};
+            while (result == Z_OK) {
+                if (_inflateStream.avail_in == 0) {
+                    _inflateStream.avail_in = static_cast<uInt>(std::min(inLeft, maxChunk));
+                    inLeft -= _inflateStream.avail_in;
+                }
+                if (_inflateStream.avail_out == 0) {
+                    _inflateStream.avail_out = static_cast<uInt>(std::min(outLeft, maxChunk));
+                    outLeft -= _inflateStream.avail_out;
+                }
+                result = inflate(&_inflateStream, Z_NO_FLUSH);
+                if (result == Z_NEED_DICT) {
+                    if (_dictionary.empty()) {
+                        throw std::runtime_error("TrunkCompressor: data was compressed with a dictionary, but none is set");
+                    }
+                    result = inflateSetDictionary(&_inflateStream, _dictionary.data(), _dictionary.size());
+                }
+                if (result == Z_BUF_ERROR && (inLeft || outLeft)) {
+                    result = Z_OK;
+                }
+            }
+
+            return result;
+        }
+
         void _calculateBitsToTruncate() {
             if (_precision == 7) {
                 _bitsTruncated = 0;
@@ -142,40 +277,44 @@ class TrunkCompressor : public MyCompressor {
 
         float _truncateFloat(float value) {
             // Convert float to int
-            uint32_t intVal{*reinterpret_cast<uint32_t*>(&value)};
+            const uint32_t intVal{std::bit_cast<uint32_t>(value)};
+
+            // NaN and Inf are kept as they are: dropping the low bits of a NaN payload could turn it into Inf
+            constexpr uint32_t exponentMask{0x7F800000u};
+            if ((intVal & exponentMask) == exponentMask) {
+                return value;
+            }
 
             // Create masks for dropping and keeping bits
-            uint32_t dropMask{((1u << _bitsTruncated) - 1u)};
-            uint32_t keepMask{~dropMask};        // This is also the maximum truncated value
+            const uint32_t dropMask{((1u << _bitsTruncated) - 1u)};
+            const uint32_t keepMask{~dropMask};
 
             // Truncate value
             uint32_t truncatedIntVal{intVal & keepMask};
 
-            // Round-to-even if value won't overflow
-            if (truncatedIntVal < keepMask) {
-                // Round-to-even has us round up if the truncated bits are greater than 2^(bits - 1)
-                // Ex: If bits = 4, we round up if the 4 dropped bits are greater than 2^3 = 1000
-                uint32_t droppedVal{intVal & dropMask};      // The dropped bits
-                uint32_t roundUpLimit{(1u << (_bitsTruncated - 1u))};
-
-                if (droppedVal > roundUpLimit) {
-                    truncatedIntVal = ((truncatedIntVal >> _bitsTruncated) + 1u) << _bitsTruncated;
+            // Round up if the truncated bits are greater than 2^(bits - 1)
+            // Ex: If bits = 4, we round up if the 4 dropped bits are greater than 2^3 = 1000
+            const uint32_t droppedVal{intVal & dropMask};      // The dropped bits
+            const uint32_t roundUpLimit{(1u << (_bitsTruncated - 1u))};
+            if (droppedVal > roundUpLimit) {
+                // The carry can ripple into the exponent; that still rounds to the nearest kept value, unless it
+                // overflows values near FLT_MAX to Inf, which are truncated instead
+                const uint32_t roundedIntVal{truncatedIntVal + (1u << _bitsTruncated)};
+                if ((roundedIntVal & exponentMask) != exponentMask) {
+                    truncatedIntVal = roundedIntVal;
                 }
             }
 
             // Return truncated value as float
-            return *reinterpret_cast<float*>(&truncatedIntVal);
+            return std::bit_cast<float>(truncatedIntVal);
         }
 
-        std::vector<float> _truncateVector(const std::vector<float>& data) {
-            // Allocate truncated basket
-            std::vector<float> truncatedData(data.size());
+        void _truncateVector(std::span<const float> data) {
+            // Resize truncated basket; capacity is kept between calls
+            _truncatedData.resize(data.size());
 
             // Truncate basket
-            std::transform(data.begin(), data.end(), truncatedData.begin(), 
-                        [this](float value) { return _truncateFloat(value); });
-
-            return truncatedData;
+            truncateInto(data, _truncatedData);
         }
 };
 
@@ -0,0 +1,65 @@
+#ifndef WORKER_GROUP_HPP
+#define WORKER_GROUP_HPP
+
+#include <barrier>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Runs one job per worker on persistent threads, so thread start-up is not timed at small sizes
+class WorkerGroup {
+    public:
+        explicit WorkerGroup(int threads) : _start(threads + 1), _done(threads + 1) {
+            for (int t{0}; t < threads; ++t) {
+                _workers.emplace_back([this, t] {
+                    while (true) {
+                        _start.arrive_and_wait();
+                        if (_stop) {
+                            break;
+                        }
+                        _job(t);
+                        _done.arrive_and_wait();
+                    }
+                });
+            }
+        }
+
+        ~WorkerGroup() {
+            _stop = true;
+            _start.arrive_and_wait();
+            for (std::thread& worker : _workers) {
+                worker.join();
+            }
+        }
+
+        // Wall time in ms for every worker to run job once
+        double run(const std::function<void(int)>& job) {
+            _job = job;
+            const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            _start.arrive_and_wait();
+            _done.arrive_and_wait();
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+
+    private:
+        std::barrier<> _start;
+        std::barrier<> _done;
+        std::vector<std::thread> _workers{};
+        std::function<void(int)> _job{};
+        bool _stop{false};
+};
+
+// Runs job until both the iteration count and the minimum time are reached, returning the mean time per run in ms.
+// Small inputs finish in microseconds, so a fixed iteration count alone would mostly measure timer noise.
+double timeRuns(WorkerGroup& group, const std::function<void(int)>& job, int iterations, double minTimeMs) {
+    double total{0};
+    int runs{0};
+    while (runs < iterations || total < minTimeMs) {
+        total += group.run(job);
+        ++runs;
+    }
+    return total / runs;
+}
+
+#endif
@@ -3,15 +3,27 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <format>
+#include <fstream>
+#include <functional>
 #include <iostream>
-#include <random>
+#include <map>
+#include <numbers>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 #include <unistd.h>
 
 #include <TFile.h>
+#include <TLeaf.h>
 #include <TTree.h>
 
+#include "Philox.hpp"
+
 // Constants -----------------------------------------------------------------------------------------------------
 
 constexpr size_t KB{1'000};
@@ -47,7 +59,7 @@ const std::vector<std::string> vectorFloatBranches = {
     "largeRjet_eta",
     "largeRjet_m",
     "largeRjet_phi",
-    "largeRjet_pt_syst"
+    "largeRjet_pt_syst",
     "largeRjet_pt",
     "largeRjet_tau32",
     "largeRjet_truthMatched",
@@ -63,8 +75,50 @@ const std::vector<std::string> vectorFloatBranches = {
     "lep_z0"
 };
 
+// Aligned four-vector branches of each object collection, in the column order MultiColumnCompressor expects
+const std::map<std::string, std::vector<std::string>> branchGroups = {
+    {"lep", {"lep_pt", "lep_eta", "lep_phi", "lep_E"}},
+    {"jet", {"jet_pt", "jet_eta", "jet_phi", "jet_E"}},
+    {"largeRjet", {"largeRjet_pt", "largeRjet_eta", "largeRjet_phi", "largeRjet_E", "largeRjet_m"}},
+};
+
+// Integer-valued scalar branches, read as uint32
+const std::vector<std::string> uint32Branches = {
+    "runNumber",
+    "eventNumber",
+    "channelNumber",
+    "lep_n",
+    "jet_n",
+    "largeRjet_n",
+};
+
+const std::vector<std::string> boolBranches = {
+    "trigE",
+    "trigM",
+};
+
+const std::vector<std::string> vectorBoolBranches = {
+    "lep_truthMatched",
+};
+
+bool isFloatBranch(const std::string& branchName) {
+    return std::find(floatBranches.begin(), floatBranches.end(), branchName) != floatBranches.end() ||
+           std::find(vectorFloatBranches.begin(), vectorFloatBranches.end(), branchName) != vectorFloatBranches.end();
+}
+
+bool isUInt32Branch(const std::string& branchName) {
+    return std::find(uint32Branches.begin(), uint32Branches.end(), branchName) != uint32Branches.end();
+}
+
+bool isBoolBranch(const std::string& branchName) {
+    return std::find(boolBranches.begin(), boolBranches.end(), branchName) != boolBranches.end() ||
+           std::find(vectorBoolBranches.begin(), vectorBoolBranches.end(), branchName) != vectorBoolBranches.end();
+}
+
 // Read ROOT file ----------------------------------------------------------------------------------
-std::vector<float> readRootFile(const size_t size, const std::string& filename, const std::string& treeName, const std::string& branchName, bool debug=false) {
+// If eventCounts is given, it receives the number of values in each entry (1 for scalar branches)
+std::vector<float> readRootFile(const size_t size, const std::string& filename, const std::string& treeName, const std::string& branchName, bool debug=false,
+                                std::vector<uint32_t>* eventCounts=nullptr) {
     // Open ROOT file
     if (debug) std::cerr << std::format("[DEBUG benchmark] Reading ROOT file: \"{}\"", filename) << std::endl;
     TFile* file = TFile::Open(filename.c_str());
@@ -88,6 +142,9 @@ std::vector<float> readRootFile(const size_t size, const std::string& filename,
     
     // Get number of entries in the tree
     const size_t numEntries = tree->GetEntries();
+    if (eventCounts) {
+        eventCounts->clear();
+    }
 
     // Each entry is either a float or a vector of floats
     if (std::find(floatBranches.begin(), floatBranches.end(), branchName) != floatBranches.end()) {
@@ -105,6 +162,9 @@ std::vector<float> readRootFile(const size_t size, const std::string& filename,
             if (debug) std::cerr << std::format("[DEBUG benchmark] Entry value: {}", *entry) << std::endl;
             // Print entry
             data.push_back(*entry);
+            if (eventCounts) {
+                eventCounts->push_back(1);
+            }
         }
     } else if (std::find(vectorFloatBranches.begin(), vectorFloatBranches.end(), branchName) != vectorFloatBranches.end()) {
         // If the branch is a vector of floats, set the branch address to a vector pointer
@@ -121,6 +181,9 @@ std::vector<float> readRootFile(const size_t size, const std::string& filename,
             for (size_t j = 0; j < entry->size(); ++j) {
                 data.push_back((*entry)[j]);
             }
+            if (eventCounts) {
+                eventCounts->push_back(static_cast<uint32_t>(entry->size()));
+            }
         }
     } else {
         throw std::runtime_error("Invalid branch name: " + branchName);
@@ -131,34 +194,342 @@ std::vector<float> readRootFile(const size_t size, const std::string& filename,
     return data;
 }
 
+// Open ROOT file and load tree; the file stays open for the lifetime of the process, as in readRootFile
+TTree* openRootTree(const std::string& filename, const std::string& treeName, bool debug=false) {
+    if (debug) std::cerr << std::format("[DEBUG benchmark] Reading ROOT file: \"{}\"", filename) << std::endl;
+    TFile* file = TFile::Open(filename.c_str());
+    if (!file || file->IsZombie()) {
+        throw std::runtime_error("Failed to open ROOT file: " + filename);
+    }
+
+    if (debug) std::cerr << std::format("[DEBUG benchmark] Loading tree: \"{}\"", treeName) << std::endl;
+    TTree* tree = static_cast<TTree*>(file->Get(treeName.c_str()));
+    if (!tree) {
+        throw std::runtime_error("Failed to load tree: " + treeName);
+    }
+
+    return tree;
+}
+
+// Read an integer scalar branch
+// Values go through TLeaf::GetValue, so Int_t and UInt_t leaves both work; 32-bit values are exact in a double
+std::vector<uint32_t> readRootFileUInt32(const std::string& filename, const std::string& treeName, const std::string& branchName, bool debug=false) {
+    if (!isUInt32Branch(branchName)) {
+        throw std::runtime_error("Invalid branch name: " + branchName);
+    }
+
+    TTree* tree{openRootTree(filename, treeName, debug)};
+    TLeaf* leaf{tree->GetLeaf(branchName.c_str())};
+    if (!leaf) {
+        throw std::runtime_error("Failed to load leaf: " + branchName);
+    }
+
+    const size_t numEntries = tree->GetEntries();
+    std::vector<uint32_t> data(numEntries);
+
+    if (debug) std::cerr << std::format("[DEBUG benchmark] Loading uint32 data from tree {} branch {}", treeName, branchName) << std::endl;
+    for (size_t n = 0; n < numEntries; ++n) {
+        tree->GetEntry(n);
+        data[n] = static_cast<uint32_t>(static_cast<int64_t>(leaf->GetValue()));
+    }
+
+    return data;
+}
+
+// Read a bool or vector<bool> branch, flattened to one byte per value
+std::vector<uint8_t> readRootFileBool(const std::string& filename, const std::string& treeName, const std::string& branchName, bool debug=false) {
+    if (!isBoolBranch(branchName)) {
+        throw std::runtime_error("Invalid branch name: " + branchName);
+    }
+
+    TTree* tree{openRootTree(filename, treeName, debug)};
+    const size_t numEntries = tree->GetEntries();
+    std::vector<uint8_t> data{};
+
+    if (std::find(boolBranches.begin(), boolBranches.end(), branchName) != boolBranches.end()) {
+        bool entry{false};
+        tree->SetBranchAddress(branchName.c_str(), &entry);
+
+        if (debug) std::cerr << std::format("[DEBUG benchmark] Loading bool data from tree {} branch {}", treeName, branchName) << std::endl;
+        data.resize(numEntries);
+        for (size_t n = 0; n < numEntries; ++n) {
+            tree->GetEntry(n);
+            data[n] = entry;
+        }
+    } else {
+        std::vector<bool>* entry = nullptr;
+        tree->SetBranchAddress(branchName.c_str(), &entry);
+
+        if (debug) std::cerr << std::format("[DEBUG benchmark] Loading bool-vector data from tree {} branch {}", treeName, branchName) << std::endl;
+        for (size_t n = 0; n < numEntries; ++n) {
+            tree->GetEntry(n);
+            for (size_t j = 0; j < entry->size(); ++j) {
+                data.push_back((*entry)[j]);
+            }
+        }
+    }
+
+    return data;
+}
+
+// Streaming reader for a float or vector<float> branch, for callers that cannot hold the whole branch in memory
+class RootBranchReader {
+    public:
+        RootBranchReader(const std::string& filename, const std::string& treeName, const std::string& branchName, bool debug=false)
+            : _branchName(branchName)
+        {
+            if (!isFloatBranch(branchName)) {
+                throw std::runtime_error("Invalid branch name: " + branchName);
+            }
+
+            _tree = openRootTree(filename, treeName, debug);
+            _numEntries = _tree->GetEntries();
+            _isVector = std::find(vectorFloatBranches.begin(), vectorFloatBranches.end(), branchName) != vectorFloatBranches.end();
+            if (_isVector) {
+                _tree->SetBranchAddress(branchName.c_str(), &_vectorEntry);
+            }
+            else {
+                _tree->SetBranchAddress(branchName.c_str(), &_entry);
+            }
+        }
+
+        // Replace data with the values of the next entries, stopping at the first entry that reaches maxValues
+        // Returns the number of values read, 0 once every entry has been read
+        size_t read(std::vector<float>& data, size_t maxValues) {
+            data.clear();
+            while (data.size() < maxValues && _nextEntry < _numEntries) {
+                _tree->GetEntry(_nextEntry++);
+                if (_isVector) {
+                    data.insert(data.end(), _vectorEntry->begin(), _vectorEntry->end());
+                }
+                else {
+                    data.push_back(_entry);
+                }
+            }
+            return data.size();
+        }
+
+        size_t getNumEntries() const { return _numEntries; }
+
+    private:
+        std::string _branchName;
+        TTree* _tree;
+        size_t _numEntries;
+        size_t _nextEntry{0};
+        bool _isVector;
+        float _entry{0};
+        std::vector<float>* _vectorEntry{nullptr};
+};
+
 // Data generation ----------------------------------------------------------------------------------
-std::vector<float> generateUniformRandomData(size_t size, float min, float max) {
-    std::vector<float> data(size);
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> dis(min, max);
+// Generators are counter-based: element i is computed from (seed, i) alone, so output is reproducible from the seed
+// for any thread count. threads = 0 uses all hardware threads.
+
+// Run function(begin, end) over [0, size) split evenly across threads
+template <typename Function>
+void parallelFor(size_t size, int threads, Function function) {
+    size_t numThreads{threads > 0 ? static_cast<size_t>(threads) : std::max(1u, std::thread::hardware_concurrency())};
+    numThreads = std::max<size_t>(1, std::min(numThreads, size / 4096));
 
-    for (size_t i = 0; i < size; ++i) {
-        data[i] = dis(gen);
+    std::vector<std::thread> workers{};
+    const size_t chunk{(size + numThreads - 1) / numThreads};
+    for (size_t t{1}; t < numThreads; ++t) {
+        const size_t begin{std::min(size, t * chunk)};
+        const size_t end{std::min(size, begin + chunk)};
+        workers.emplace_back(function, begin, end);
     }
+    function(0, std::min(size, chunk));
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+std::vector<float> generateUniformRandomData(size_t size, float min, float max, int seed=12345, int threads=0) {
+    std::vector<float> data(size);
+    Philox4x32 rng(seed);
+
+    parallelFor(size, threads, [&](size_t begin, size_t end) {
+        for (size_t i{begin}; i < end; ++i) {
+            data[i] = min + (max - min) * Philox4x32::toUniform(rng(i)[0]);
+        }
+    });
+
+    return data;
+}
+
+std::vector<float> generateGaussianRandomData(size_t size, float mean, float stddev, int seed, int threads=0) {
+    std::vector<float> data(size);
+    Philox4x32 rng(seed);
+
+    // Box-Muller transform
+    parallelFor(size, threads, [&](size_t begin, size_t end) {
+        for (size_t i{begin}; i < end; ++i) {
+            Philox4x32::Counter words{rng(i)};
+            float radius{std::sqrt(-2.0f * std::log(Philox4x32::toUniformOpen(words[0])))};
+            data[i] = mean + stddev * radius * std::cos(2.0f * std::numbers::pi_v<float> * Philox4x32::toUniform(words[1]));
+        }
+    });
 
     return data;
 }
 
-std::vector<float> generateGaussianRandomData(size_t size, float mean, float stddev, int seed) {
+// Falling exponential pT spectrum above ptMin, with mean ptMean above threshold
+std::vector<float> generateExponentialPtData(size_t size, float ptMin, float ptMean, int seed, int threads=0) {
     std::vector<float> data(size);
-    std::random_device rd{};
-    std::mt19937 gen(seed);
-    std::normal_distribution<float> dis(mean, stddev);
+    Philox4x32 rng(seed);
 
-    for (size_t i = 0; i < size; ++i) {
-        data[i] = dis(gen);
+    parallelFor(size, threads, [&](size_t begin, size_t end) {
+        for (size_t i{begin}; i < end; ++i) {
+            data[i] = ptMin - ptMean * std::log(Philox4x32::toUniformOpen(rng(i)[0]));
+        }
+    });
+
+    return data;
+}
+
+// Azimuthal angles, uniform in [-pi, pi)
+std::vector<float> generateUniformPhiData(size_t size, int seed, int threads=0) {
+    return generateUniformRandomData(size, -std::numbers::pi_v<float>, std::numbers::pi_v<float>, seed, threads);
+}
+
+// Pareto tail above xMin; smaller tailIndex gives heavier tails
+std::vector<float> generateParetoData(size_t size, float xMin, float tailIndex, int seed, int threads=0) {
+    std::vector<float> data(size);
+    Philox4x32 rng(seed);
+
+    parallelFor(size, threads, [&](size_t begin, size_t end) {
+        for (size_t i{begin}; i < end; ++i) {
+            data[i] = xMin * std::pow(Philox4x32::toUniformOpen(rng(i)[0]), -1.0f / tailIndex);
+        }
+    });
+
+    return data;
+}
+
+// Flattened per-event object pT, like a vector<float> branch: each event has a Poisson number of objects with
+// exponential pT, sorted in decreasing pT as in the ATLAS trees. If eventCounts is given, it receives the multiplicities,
+// with the last event cut to fit size.
+std::vector<float> generateJaggedPtData(size_t size, float meanMultiplicity, float ptMin, float ptMean, int seed, int threads=0,
+                                        std::vector<uint32_t>* eventCounts=nullptr) {
+    // Events are drawn until they fill size, so every event must have a chance of being non-empty
+    if (!(meanMultiplicity > 0)) {
+        throw std::invalid_argument("generateJaggedPtData: meanMultiplicity must be greater than 0");
+    }
+    if (!(std::exp(-meanMultiplicity) > 0)) {
+        throw std::invalid_argument("generateJaggedPtData: meanMultiplicity is too large");
+    }
+
+    Philox4x32 rng(seed);
+    constexpr uint32_t MULTIPLICITY_STREAM{1};
+
+    // Multiplicities by inverse-CDF sampling, and each event's offset into the flattened data
+    std::vector<size_t> offsets{0};
+    for (uint64_t event{0}; offsets.back() < size; ++event) {
+        float u{Philox4x32::toUniform(rng(event, MULTIPLICITY_STREAM)[0])};
+        float probability{std::exp(-meanMultiplicity)};
+        float cumulative{probability};
+        size_t multiplicity{0};
+        while (u > cumulative && probability > 0) {
+            ++multiplicity;
+            probability *= meanMultiplicity / multiplicity;
+            cumulative += probability;
+        }
+        offsets.push_back(offsets.back() + multiplicity);
+    }
+
+    std::vector<float> data(offsets.back());
+
+    parallelFor(offsets.size() - 1, threads, [&](size_t begin, size_t end) {
+        for (size_t event{begin}; event < end; ++event) {
+            for (size_t i{offsets[event]}; i < offsets[event + 1]; ++i) {
+                data[i] = ptMin - ptMean * std::log(Philox4x32::toUniformOpen(rng(i)[0]));
+            }
+            std::sort(data.begin() + offsets[event], data.begin() + offsets[event + 1], std::greater<float>());
+        }
+    });
+
+    data.resize(size);
+
+    if (eventCounts) {
+        eventCounts->clear();
+        for (size_t event{0}; event + 1 < offsets.size(); ++event) {
+            eventCounts->push_back(static_cast<uint32_t>(std::min(size, offsets[event + 1]) - offsets[event]));
+        }
     }
 
     return data;
 }
 
+// Input of the benchmarking tools: size values of a ROOT branch, replicated to fill size, or of synthetic pt or normal
+// data with the generators' default parameters
+std::vector<float> loadFloatData(const std::string& dataName, size_t size, const std::string& sourceFile, const std::string& treeName,
+                                 const std::string& branchName, int seed, bool debug=false) {
+    if (dataName == "root") {
+        std::vector<float> branch{readRootFile(0, sourceFile, treeName, branchName, debug)};
+        if (branch.empty()) {
+            throw std::runtime_error("Branch " + branchName + " is empty");
+        }
+        std::vector<float> data(size);
+        for (size_t i{0}; i < size; i += branch.size()) {
+            std::copy_n(branch.begin(), std::min(branch.size(), size - i), data.begin() + i);
+        }
+        return data;
+    }
+    else if (dataName == "pt") {
+        return generateExponentialPtData(size, 25000.0f, 20000.0f, seed);
+    }
+    else if (dataName == "normal") {
+        return generateGaussianRandomData(size, 0.0f, 1.0f, seed);
+    }
+    throw std::invalid_argument("Unknown data source: " + dataName);
+}
+
 // Other utilities ---------------------------------------------------------------------------------------------------
+// Comma-separated command-line list, skipping empty items
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items{};
+    std::istringstream iss(list);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+double elapsedMs(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+double elapsedSeconds(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// About size values as evenly spaced contiguous blocks of blockSize, so codecs and predictors run over a sample still
+// see neighbouring values next to each other; all of data if it is no larger than size
+std::vector<float> sampleBlocks(std::span<const float> data, size_t size, size_t blockSize) {
+    if (data.size() <= size) {
+        return std::vector<float>(data.begin(), data.end());
+    }
+
+    blockSize = std::min(blockSize, size);
+    const size_t blocks{size / blockSize};
+    if (blocks <= 1) {
+        return std::vector<float>(data.begin(), data.begin() + blockSize);
+    }
+
+    std::vector<float> sample{};
+    sample.reserve(blocks * blockSize);
+    const size_t stride{(data.size() - blockSize) / (blocks - 1)};
+    for (size_t block{0}; block < blocks; ++block) {
+        auto start{data.begin() + block * stride};
+        sample.insert(sample.end(), start, start + blockSize);
+    }
+    return sample;
+}
+
 std::string getHost() {
     char hostname[1024];
     gethostname(hostname, sizeof(hostname));
@@ -169,4 +540,32 @@ std::string timestamp() {
     return std::format("{}", std::chrono::system_clock::now().time_since_epoch().count());
 }
 
+// Cache sizes from sysconf, falling back to sysfs where glibc reports 0
+size_t cacheSize(int level) {
+    long size{sysconf(level == 2 ? _SC_LEVEL2_CACHE_SIZE : _SC_LEVEL3_CACHE_SIZE)};
+    if (size > 0) {
+        return static_cast<size_t>(size);
+    }
+
+    for (int index{0}; index < 8; ++index) {
+        const std::string dir{std::format("/sys/devices/system/cpu/cpu0/cache/index{}/", index)};
+        std::ifstream levelFile(dir + "level");
+        std::ifstream sizeFile(dir + "size");
+        int cacheLevel{0};
+        std::string sizeString{};
+        if (!(levelFile >> cacheLevel) || !(sizeFile >> sizeString) || cacheLevel != level) {
+            continue;
+        }
+        // sysfs sizes look like "2048K"
+        size_t value{std::stoul(sizeString)};
+        if (sizeString.back() == 'K') {
+            value *= 1024;
+        } else if (sizeString.back() == 'M') {
+            value *= 1024 * 1024;
+        }
+        return value;
+    }
+    return 0;
+}
+
 #endif
\ No newline at end of file